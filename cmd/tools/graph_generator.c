@@ -429,6 +429,51 @@ void makeRandom(int h, int w, edgefn ef)
     }
 }
 
+/* makePowerLaw:
+ * Preferential attachment: nodes 1 to m form a path, and each later node
+ * is joined to m distinct earlier nodes, each picked with probability
+ * proportional to its degree. The degrees then follow a power law.
+ */
+void makePowerLaw(int n, int m, edgefn ef)
+{
+    int *ends, *picked;
+    int nends = 0, i, j, k, t;
+
+    if (n <= m) {
+	makePath(n, ef);
+	return;
+    }
+    srand(time(0));
+    ends = N_NEW(2 * n * m, int);
+    picked = N_NEW(m, int);
+
+    makePath(m, ef);
+    for (i = 2; i <= m; i++) {
+	ends[nends++] = i - 1;
+	ends[nends++] = i;
+    }
+    for (i = m + 1; i <= n; i++) {
+	for (j = 0; j < m; j++) {
+	    /* by degree if possible, else uniformly; retry on a repeat */
+	    do {
+		if (nends > 0 && rand() % 4)
+		    t = ends[rand() % nends];
+		else
+		    t = 1 + rand() % (i - 1);
+		for (k = 0; k < j && picked[k] != t; k++);
+	    } while (k < j);
+	    picked[j] = t;
+	}
+	for (j = 0; j < m; j++) {
+	    ef(picked[j], i);
+	    ends[nends++] = picked[j];
+	    ends[nends++] = i;
+	}
+    }
+    free(ends);
+    free(picked);
+}
+
 void makeMobius(int w, int h, edgefn ef)
 {
     int i, j;
@@ -27,6 +27,7 @@ extern void makeTorus(int, int, edgefn);
 extern void makeTwistedTorus(int, int, int, int, edgefn);
 extern void makeCylinder(int, int, edgefn);
 extern void makeRandom(int, int, edgefn);
+extern void makePowerLaw(int, int, edgefn);
 extern void makeSquareGrid(int, int, int, int, edgefn);
 extern void makeBinaryTree(int, edgefn);
 extern void makeSierpinski(int, edgefn);
@@ -40,7 +40,7 @@
 
 typedef enum { unknown, grid, circle, complete, completeb, 
     path, tree, torus, cylinder, mobius, randomg, randomt, ball,
-    sierpinski, hypercube, star, wheel, trimesh
+    sierpinski, hypercube, star, wheel, trimesh, powerlaw
 } GraphType;
 
 typedef struct {
@@ -94,6 +94,7 @@ static char *Usage = "Usage: %s [-dv?] [options]\n\
  -N<name>      : use <name> for the graph (\"\")\n\
  -o<outfile>   : put output in <outfile> (stdout)\n\
  -p<x>         : path \n\
+ -P<x>,<m>     : power-law graph on <x> vertices, <m> edges per vertex\n\
  -r<x>,<n>     : random graph\n\
  -R<n>         : random rooted tree on <n> vertices\n\
  -s<x>         : star\n\
@@ -199,6 +200,33 @@ static int setTwo(char *s, opts_t* opts)
     else return d;
 }
 
+/* setTwoPos:
+ * Read 2 numbers, both at least 1.
+ * Return non-zero on error.
+ */
+static int setTwoPos(char *s, opts_t* opts)
+{
+    int d;
+    char *next;
+
+    d = readPos(s, &next, 1);
+    if (d < 0)
+	return d;
+    opts->graphSize1 = d;
+
+    if (*next != ',') {
+	fprintf(stderr, "ill-formed int pair \"%s\" ", s);
+	return -1;
+    }
+
+    s = next + 1;
+    d = readPos(s, &next, 1);
+    if (d < 0)
+	return d;
+    opts->graphSize2 = d;
+    return 0;
+}
+
 /* setTwoTwoOpt:
  * Read 2 numbers
  * Read 2 more optional numbers
@@ -292,7 +320,7 @@ static char* setFold(char *s, opts_t* opts)
     return next;
 }
 
-static char *optList = ":i:M:m:n:N:c:C:dg:G:h:k:b:B:o:p:r:R:s:S:t:T:vw:";
+static char *optList = ":i:M:m:n:N:c:C:dg:G:h:k:b:B:o:p:P:r:R:s:S:t:T:vw:";
 
 static GraphType init(int argc, char *argv[], opts_t* opts)
 {
@@ -378,6 +406,11 @@ static GraphType init(int argc, char *argv[], opts_t* opts)
 	    if (setOne(optarg, opts))
 		errexit(c);
 	    break;
+	case 'P':
+	    graphType = powerlaw;
+	    if (setTwoPos(optarg, opts))
+		errexit(c);
+	    break;
 	case 'S':
 	    graphType = sierpinski;
 	    if (setOne(optarg, opts))
@@ -521,6 +554,9 @@ int main(int argc, char *argv[])
     case randomg:
 	makeRandom (opts.graphSize1, opts.graphSize2, ef);
 	break;
+    case powerlaw:
+	makePowerLaw (opts.graphSize1, opts.graphSize2, ef);
+	break;
     case randomt:
 	{
 	    int i;
@@ -367,7 +367,7 @@ static Agraph_t *makeDotGraph(SparseMatrix A, char *name, int dim,
     return g;
 }
 
-static char* useString = "Usage: %s [-uvcl] [-o file] matrix_market_filename\n\
+static char* useString = "Usage: %s [-uvcl] [-o file] [-b file] matrix_market_filename\n\
   -u   - make graph undirected\n\
   -U i - treat non-square matrix as a bipartite graph\n\
          i = 0   never\n\
@@ -377,7 +377,9 @@ static char* useString = "Usage: %s [-uvcl] [-o file] matrix_market_filename\n\
   -v   - assign len to edges\n\
   -c   - assign color and wt to edges\n\
   -l   - add label\n\
-  -o <file> - output file \n";
+  -o <file> - output file \n\
+  -b <file> - also save the matrix in the binary format that can be mapped into memory\n\
+The input may also be a matrix saved with -b.\n";
 
 static void usage(int eval)
 {
@@ -400,6 +402,7 @@ typedef struct {
     FILE *inf;
     FILE *outf;
     char *infile;
+    char *binfile;
     int undirected;
     int with_label;
     int with_color;
@@ -413,11 +416,14 @@ static void init(int argc, char **argv, parms_t * p)
 
     cmd = argv[0];
     opterr = 0;
-    while ((c = getopt(argc, argv, ":o:uvclU:")) != -1) {
+    while ((c = getopt(argc, argv, ":o:b:uvclU:")) != -1) {
 	switch (c) {
 	case 'o':
 	    p->outf = openF(optarg, "w");
 	    break;
+	case 'b':
+	    p->binfile = optarg;
+	    break;
 	case 'l':
 	    p->with_label = 1;
 	    break;
@@ -465,13 +471,14 @@ int main(int argc, char *argv[])
 {
     Agraph_t *g = 0;
     SparseMatrix A = NULL;
-    int dim=0;
+    int dim=0, flag;
     parms_t pv;
 
     /* ======================= set parameters ==================== */
     pv.inf = stdin;
     pv.outf = stdout;
     pv.infile = "stdin";
+    pv.binfile = NULL;
     pv.undirected = 0;
     pv.with_label = 0;
     pv.with_color = 0;
@@ -481,12 +488,21 @@ int main(int argc, char *argv[])
 
     /* ======================= read graph ==================== */
 
-    A = SparseMatrix_import_matrix_market(pv.inf, FORMAT_CSR);
+    if (pv.inf != stdin)
+	A = SparseMatrix_import_mapped(pv.infile, &flag);
+    if (!A)
+	A = SparseMatrix_import_matrix_market(pv.inf, FORMAT_CSR);
     if (!A) {
 	fprintf (stderr, "Unable to read input file \"%s\"\n", pv.infile); 
 	usage(1);
     }
 
+    if (pv.binfile) {
+	SparseMatrix_export_mapped(pv.binfile, A, &flag);
+	if (flag)
+	    fprintf(stderr, "%s: could not write %s\n", cmd, pv.binfile);
+    }
+
     A = SparseMatrix_to_square_matrix(A, pv.bipartite);
 
     if (!A) {
@@ -19,7 +19,39 @@
 #include "render.h"
 #include <setjmp.h>
 
-static int init_graph(graph_t *);
+/* subtree_t:
+ * A tight subtree built by feasible_tree. Merged subtrees are kept as
+ * a union-find forest; only the roots are in the heap.
+ */
+typedef struct subtree_s {
+    node_t *rep;		/* some node in the tree */
+    int size;			/* number of nodes in the tree */
+    int heap_index;		/* -1 once out of the heap */
+    struct subtree_s *par;	/* union-find parent */
+} subtree_t;
+
+/* nsctx_t:
+ * State of one network simplex run. All of it lives in the context
+ * or in the nodes and edges of the graph being ranked, so rank2 may be
+ * called concurrently on different graphs.
+ */
+typedef struct {
+    jmp_buf jbuf;
+    graph_t *G;
+    int N_nodes, N_edges;
+    int Minrank, Maxrank;
+    int S_i;			/* search index for enter_edge */
+    int Search_size;
+    nlist_t Tree_node;
+    elist Tree_edge;
+    edge_t *Enter;		/* best entering edge found so far */
+    int Low, Lim, Slack;
+    subtree_t *Subtree;		/* tight subtrees, in feasible_tree */
+    subtree_t **Heap;		/* min-heap of subtree roots by size */
+    int Heap_size;
+} nsctx_t;
+
+static int init_graph(nsctx_t *, graph_t *);
 static void dfs_cutval(node_t * v, edge_t * par);
 static int dfs_range(node_t * v, edge_t * par, int low);
 static int x_val(edge_t * e, node_t * v, int dir);
@@ -32,36 +64,28 @@ static void check_cycles(graph_t * g);
 #define SEQ(a,b,c)		(((a) <= (b)) && ((b) <= (c)))
 #define TREE_EDGE(e)	(ED_tree_index(e) >= 0)
 
-static jmp_buf jbuf;
-static graph_t *G;
-static int N_nodes, N_edges;
-static int Minrank, Maxrank;
-static int S_i;			/* search index for enter_edge */
-static int Search_size;
 #define SEARCHSIZE 30
-static nlist_t Tree_node;
-static elist Tree_edge;
 
-static void add_tree_edge(edge_t * e)
+static void add_tree_edge(nsctx_t * ctx, edge_t * e)
 {
     node_t *n;
     if (TREE_EDGE(e)) {
 	agerr(AGERR, "add_tree_edge: missing tree edge\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
-    ED_tree_index(e) = Tree_edge.size;
-    Tree_edge.list[Tree_edge.size++] = e;
+    ED_tree_index(e) = ctx->Tree_edge.size;
+    ctx->Tree_edge.list[ctx->Tree_edge.size++] = e;
     if (ND_mark(agtail(e)) == FALSE)
-	Tree_node.list[Tree_node.size++] = agtail(e);
+	ctx->Tree_node.list[ctx->Tree_node.size++] = agtail(e);
     if (ND_mark(aghead(e)) == FALSE)
-	Tree_node.list[Tree_node.size++] = aghead(e);
+	ctx->Tree_node.list[ctx->Tree_node.size++] = aghead(e);
     n = agtail(e);
     ND_mark(n) = TRUE;
     ND_tree_out(n).list[ND_tree_out(n).size++] = e;
     ND_tree_out(n).list[ND_tree_out(n).size] = NULL;
     if (ND_out(n).list[ND_tree_out(n).size - 1] == 0) {
 	agerr(AGERR, "add_tree_edge: empty outedge list\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
     n = aghead(e);
     ND_mark(n) = TRUE;
@@ -69,17 +93,17 @@ static void add_tree_edge(edge_t * e)
     ND_tree_in(n).list[ND_tree_in(n).size] = NULL;
     if (ND_in(n).list[ND_tree_in(n).size - 1] == 0) {
 	agerr(AGERR, "add_tree_edge: empty inedge list\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
 }
 
-static void exchange_tree_edges(edge_t * e, edge_t * f)
+static void exchange_tree_edges(nsctx_t * ctx, edge_t * e, edge_t * f)
 {
     int i, j;
     node_t *n;
 
     ED_tree_index(f) = ED_tree_index(e);
-    Tree_edge.list[ED_tree_index(e)] = f;
+    ctx->Tree_edge.list[ED_tree_index(e)] = f;
     ED_tree_index(e) = -1;
 
     n = agtail(e);
@@ -106,17 +130,17 @@ static void exchange_tree_edges(edge_t * e, edge_t * f)
 }
 
 static
-void init_rank(void)
+void init_rank(nsctx_t * ctx)
 {
     int i, ctr;
     nodequeue *Q;
     node_t *v;
     edge_t *e;
 
-    Q = new_queue(N_nodes);
+    Q = new_queue(ctx->N_nodes);
     ctr = 0;
 
-    for (v = GD_nlist(G); v; v = ND_next(v)) {
+    for (v = GD_nlist(ctx->G); v; v = ND_next(v)) {
 	if (ND_priority(v) == 0)
 	    enqueue(Q, v);
     }
@@ -131,111 +155,96 @@ void init_rank(void)
 		enqueue(Q, aghead(e));
 	}
     }
-    if (ctr != N_nodes) {
+    if (ctr != ctx->N_nodes) {
 	agerr(AGERR, "trouble in init_rank\n");
-	for (v = GD_nlist(G); v; v = ND_next(v))
+	for (v = GD_nlist(ctx->G); v; v = ND_next(v))
 	    if (ND_priority(v))
 		agerr(AGPREV, "\t%s %d\n", agnameof(v), ND_priority(v));
     }
     free_queue(Q);
 }
 
-static node_t *incident(edge_t * e)
-{
-    if (ND_mark(agtail(e))) {
-	if (ND_mark(aghead(e)) == FALSE)
-	    return agtail(e);
-    } else {
-	if (ND_mark(aghead(e)))
-	    return aghead(e);
-    }
-    return NULL;
-}
-
-static edge_t *leave_edge(void)
+static edge_t *leave_edge(nsctx_t * ctx)
 {
     edge_t *f, *rv = NULL;
     int j, cnt = 0;
 
-    j = S_i;
-    while (S_i < Tree_edge.size) {
-	if (ED_cutvalue(f = Tree_edge.list[S_i]) < 0) {
+    j = ctx->S_i;
+    while (ctx->S_i < ctx->Tree_edge.size) {
+	if (ED_cutvalue(f = ctx->Tree_edge.list[ctx->S_i]) < 0) {
 	    if (rv) {
 		if (ED_cutvalue(rv) > ED_cutvalue(f))
 		    rv = f;
 	    } else
-		rv = Tree_edge.list[S_i];
-	    if (++cnt >= Search_size)
+		rv = ctx->Tree_edge.list[ctx->S_i];
+	    if (++cnt >= ctx->Search_size)
 		return rv;
 	}
-	S_i++;
+	ctx->S_i++;
     }
     if (j > 0) {
-	S_i = 0;
-	while (S_i < j) {
-	    if (ED_cutvalue(f = Tree_edge.list[S_i]) < 0) {
+	ctx->S_i = 0;
+	while (ctx->S_i < j) {
+	    if (ED_cutvalue(f = ctx->Tree_edge.list[ctx->S_i]) < 0) {
 		if (rv) {
 		    if (ED_cutvalue(rv) > ED_cutvalue(f))
 			rv = f;
 		} else
-		    rv = Tree_edge.list[S_i];
-		if (++cnt >= Search_size)
+		    rv = ctx->Tree_edge.list[ctx->S_i];
+		if (++cnt >= ctx->Search_size)
 		    return rv;
 	    }
-	    S_i++;
+	    ctx->S_i++;
 	}
     }
     return rv;
 }
 
-static edge_t *Enter;
-static int Low, Lim, Slack;
-
-static void dfs_enter_outedge(node_t * v)
+static void dfs_enter_outedge(nsctx_t * ctx, node_t * v)
 {
     int i, slack;
     edge_t *e;
 
     for (i = 0; (e = ND_out(v).list[i]); i++) {
 	if (TREE_EDGE(e) == FALSE) {
-	    if (!SEQ(Low, ND_lim(aghead(e)), Lim)) {
+	    if (!SEQ(ctx->Low, ND_lim(aghead(e)), ctx->Lim)) {
 		slack = SLACK(e);
-		if ((slack < Slack) || (Enter == NULL)) {
-		    Enter = e;
-		    Slack = slack;
+		if ((slack < ctx->Slack) || (ctx->Enter == NULL)) {
+		    ctx->Enter = e;
+		    ctx->Slack = slack;
 		}
 	    }
 	} else if (ND_lim(aghead(e)) < ND_lim(v))
-	    dfs_enter_outedge(aghead(e));
+	    dfs_enter_outedge(ctx, aghead(e));
     }
-    for (i = 0; (e = ND_tree_in(v).list[i]) && (Slack > 0); i++)
+    for (i = 0; (e = ND_tree_in(v).list[i]) && (ctx->Slack > 0); i++)
 	if (ND_lim(agtail(e)) < ND_lim(v))
-	    dfs_enter_outedge(agtail(e));
+	    dfs_enter_outedge(ctx, agtail(e));
 }
 
-static void dfs_enter_inedge(node_t * v)
+static void dfs_enter_inedge(nsctx_t * ctx, node_t * v)
 {
     int i, slack;
     edge_t *e;
 
     for (i = 0; (e = ND_in(v).list[i]); i++) {
 	if (TREE_EDGE(e) == FALSE) {
-	    if (!SEQ(Low, ND_lim(agtail(e)), Lim)) {
+	    if (!SEQ(ctx->Low, ND_lim(agtail(e)), ctx->Lim)) {
 		slack = SLACK(e);
-		if ((slack < Slack) || (Enter == NULL)) {
-		    Enter = e;
-		    Slack = slack;
+		if ((slack < ctx->Slack) || (ctx->Enter == NULL)) {
+		    ctx->Enter = e;
+		    ctx->Slack = slack;
 		}
 	    }
 	} else if (ND_lim(agtail(e)) < ND_lim(v))
-	    dfs_enter_inedge(agtail(e));
+	    dfs_enter_inedge(ctx, agtail(e));
     }
-    for (i = 0; (e = ND_tree_out(v).list[i]) && (Slack > 0); i++)
+    for (i = 0; (e = ND_tree_out(v).list[i]) && (ctx->Slack > 0); i++)
 	if (ND_lim(aghead(e)) < ND_lim(v))
-	    dfs_enter_inedge(aghead(e));
+	    dfs_enter_inedge(ctx, aghead(e));
 }
 
-static edge_t *enter_edge(edge_t * e)
+static edge_t *enter_edge(nsctx_t * ctx, edge_t * e)
 {
     node_t *v;
     int outsearch;
@@ -248,107 +257,235 @@ static edge_t *enter_edge(edge_t * e)
 	v = aghead(e);
 	outsearch = TRUE;
     }
-    Enter = NULL;
-    Slack = INT_MAX;
-    Low = ND_low(v);
-    Lim = ND_lim(v);
+    ctx->Enter = NULL;
+    ctx->Slack = INT_MAX;
+    ctx->Low = ND_low(v);
+    ctx->Lim = ND_lim(v);
     if (outsearch)
-	dfs_enter_outedge(v);
+	dfs_enter_outedge(ctx, v);
     else
-	dfs_enter_inedge(v);
-    return Enter;
+	dfs_enter_inedge(ctx, v);
+    return ctx->Enter;
+}
+
+static void init_cutvalues(nsctx_t * ctx)
+{
+    dfs_range(GD_nlist(ctx->G), NULL, 1);
+    dfs_cutval(GD_nlist(ctx->G), NULL);
 }
 
-static int treesearch(node_t * v)
+/* tight_subtree_search:
+ * Grow the tight subtree st from v by adding every tight edge to a
+ * node not yet in a subtree. Returns the number of nodes added.
+ */
+static int tight_subtree_search(nsctx_t * ctx, node_t * v, subtree_t * st)
+{
+    int i, rv;
+    edge_t *e;
+
+    rv = 1;
+    ND_subtree(v) = st;
+    for (i = 0; (e = ND_in(v).list[i]); i++) {
+	if (TREE_EDGE(e))
+	    continue;
+	if ((ND_subtree(agtail(e)) == NULL) && (SLACK(e) == 0)) {
+	    add_tree_edge(ctx, e);
+	    rv += tight_subtree_search(ctx, agtail(e), st);
+	}
+    }
+    for (i = 0; (e = ND_out(v).list[i]); i++) {
+	if (TREE_EDGE(e))
+	    continue;
+	if ((ND_subtree(aghead(e)) == NULL) && (SLACK(e) == 0)) {
+	    add_tree_edge(ctx, e);
+	    rv += tight_subtree_search(ctx, aghead(e), st);
+	}
+    }
+    return rv;
+}
+
+static subtree_t *STsetFind(node_t * n)
+{
+    subtree_t *s = ND_subtree(n);
+
+    while (s->par != s) {
+	if (s->par->par != s->par)
+	    s->par = s->par->par;	/* path halving */
+	s = s->par;
+    }
+    return s;
+}
+
+/* STsetUnion:
+ * Join the subtrees with roots s0 and s1. The root that is still
+ * in the heap becomes the root of the union.
+ */
+static subtree_t *STsetUnion(subtree_t * s0, subtree_t * s1)
+{
+    subtree_t *r;
+
+    if (s1->heap_index == -1)
+	r = s0;
+    else if (s0->heap_index == -1)
+	r = s1;
+    else if (s1->size < s0->size)
+	r = s0;
+    else
+	r = s1;
+    s0->par = s1->par = r;
+    r->size = s0->size + s1->size;
+    return r;
+}
+
+/* inter_tree_edge_search:
+ * Walk the tree edges of v's subtree and return the non-tree edge of
+ * least slack to another subtree, starting from best.
+ */
+static edge_t *inter_tree_edge_search(node_t * v, node_t * from,
+				      edge_t * best)
 {
     int i;
     edge_t *e;
+    subtree_t *ts = STsetFind(v);
 
+    if (best && (SLACK(best) == 0))
+	return best;
     for (i = 0; (e = ND_out(v).list[i]); i++) {
-	if ((ND_mark(aghead(e)) == FALSE) && (SLACK(e) == 0)) {
-	    add_tree_edge(e);
-	    if ((Tree_edge.size == N_nodes - 1) || treesearch(aghead(e)))
-		return TRUE;
+	if (TREE_EDGE(e)) {
+	    if (aghead(e) != from)
+		best = inter_tree_edge_search(aghead(e), v, best);
+	} else if (STsetFind(aghead(e)) != ts) {
+	    if ((best == NULL) || (SLACK(e) < SLACK(best)))
+		best = e;
 	}
     }
     for (i = 0; (e = ND_in(v).list[i]); i++) {
-	if ((ND_mark(agtail(e)) == FALSE) && (SLACK(e) == 0)) {
-	    add_tree_edge(e);
-	    if ((Tree_edge.size == N_nodes - 1) || treesearch(agtail(e)))
-		return TRUE;
+	if (TREE_EDGE(e)) {
+	    if (agtail(e) != from)
+		best = inter_tree_edge_search(agtail(e), v, best);
+	} else if (STsetFind(agtail(e)) != ts) {
+	    if ((best == NULL) || (SLACK(e) < SLACK(best)))
+		best = e;
 	}
     }
-    return FALSE;
+    return best;
 }
 
-static int tight_tree(void)
+static void STheapify(nsctx_t * ctx, int i)
 {
-    int i;
-    node_t *n;
-
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
-	ND_mark(n) = FALSE;
-	ND_tree_in(n).list[0] = ND_tree_out(n).list[0] = NULL;
-	ND_tree_in(n).size = ND_tree_out(n).size = 0;
+    int left, right, smallest;
+    subtree_t **elt = ctx->Heap;
+    subtree_t *t;
+
+    for (;;) {
+	left = 2 * i + 1;
+	right = 2 * i + 2;
+	smallest = i;
+	if ((left < ctx->Heap_size) && (elt[left]->size < elt[smallest]->size))
+	    smallest = left;
+	if ((right < ctx->Heap_size) && (elt[right]->size < elt[smallest]->size))
+	    smallest = right;
+	if (smallest == i)
+	    break;
+	t = elt[i];
+	elt[i] = elt[smallest];
+	elt[smallest] = t;
+	elt[i]->heap_index = i;
+	elt[smallest]->heap_index = smallest;
+	i = smallest;
     }
-    for (i = 0; i < Tree_edge.size; i++)
-	ED_tree_index(Tree_edge.list[i]) = -1;
+}
+
+static subtree_t *STextractmin(nsctx_t * ctx)
+{
+    subtree_t *rv = ctx->Heap[0];
 
-    Tree_node.size = Tree_edge.size = 0;
-    for (n = GD_nlist(G); n && (Tree_edge.size == 0); n = ND_next(n))
-	treesearch(n);
-    return Tree_node.size;
+    rv->heap_index = -1;
+    ctx->Heap[0] = ctx->Heap[--ctx->Heap_size];
+    ctx->Heap[0]->heap_index = 0;
+    STheapify(ctx, 0);
+    return rv;
 }
 
-static void init_cutvalues(void)
+static void tree_adjust(node_t * v, node_t * from, int delta)
 {
-    dfs_range(GD_nlist(G), NULL, 1);
-    dfs_cutval(GD_nlist(G), NULL);
+    int i;
+    edge_t *e;
+
+    ND_rank(v) += delta;
+    for (i = 0; (e = ND_tree_in(v).list[i]); i++)
+	if (agtail(e) != from)
+	    tree_adjust(agtail(e), v, delta);
+    for (i = 0; (e = ND_tree_out(v).list[i]); i++)
+	if (aghead(e) != from)
+	    tree_adjust(aghead(e), v, delta);
 }
 
-static int feasible_tree(void)
+/* merge_trees:
+ * Make e tight by shifting the subtree that has left the heap, then
+ * add e to the tree and join the two subtrees.
+ */
+static subtree_t *merge_trees(nsctx_t * ctx, edge_t * e)
 {
-    int i, delta;
+    subtree_t *t0, *t1;
+    int delta;
+
+    t0 = STsetFind(agtail(e));
+    t1 = STsetFind(aghead(e));
+    delta = SLACK(e);
+    if (delta) {
+	if (t0->heap_index == -1)
+	    tree_adjust(t0->rep, NULL, delta);
+	else
+	    tree_adjust(t1->rep, NULL, -delta);
+    }
+    add_tree_edge(ctx, e);
+    return STsetUnion(t0, t1);
+}
+
+/* feasible_tree:
+ * Build a tight spanning tree, adjusting ranks as needed. Starting
+ * from the tight subtrees of the initial ranking, the smallest subtree
+ * is repeatedly joined to a neighbour along its least slack edge, so
+ * each node is shifted and rescanned only O(log n) times.
+ * Returns 1 if the graph is not connected.
+ */
+static int feasible_tree(nsctx_t * ctx)
+{
+    int i, cnt;
     node_t *n;
-    edge_t *e, *f;
+    edge_t *e;
+    subtree_t *st;
 
-    if (N_nodes <= 1)
+    if (ctx->N_nodes <= 1)
 	return 0;
-    while (tight_tree() < N_nodes) {
-	e = NULL;
-	for (n = GD_nlist(G); n; n = ND_next(n)) {
-	    for (i = 0; (f = ND_out(n).list[i]); i++) {
-		if ((TREE_EDGE(f) == FALSE) && incident(f) && ((e == NULL)
-							       || (SLACK(f)
-								   <
-								   SLACK
-								   (e))))
-		    e = f;
-	    }
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n))
+	ND_subtree(n) = NULL;
+    ctx->Subtree = N_NEW(ctx->N_nodes, subtree_t);
+    ctx->Heap = N_NEW(ctx->N_nodes, subtree_t *);
+    cnt = 0;
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
+	if (ND_subtree(n) == NULL) {
+	    st = ctx->Subtree + cnt;
+	    st->rep = n;
+	    st->par = st;
+	    st->size = tight_subtree_search(ctx, n, st);
+	    st->heap_index = cnt;
+	    ctx->Heap[cnt++] = st;
 	}
-	if (e) {
-	    delta = SLACK(e);
-	    if (delta) {
-		if (incident(e) == aghead(e))
-		    delta = -delta;
-		for (i = 0; i < Tree_node.size; i++)
-		    ND_rank(Tree_node.list[i]) += delta;
-	    }
-	} else {
-#ifdef DEBUG
-	    fprintf(stderr, "not in tight tree:\n");
-	    for (n = GD_nlist(G); n; n = ND_next(n)) {
-		for (i = 0; i < Tree_node.size; i++)
-		    if (Tree_node.list[i] == n)
-			break;
-		if (i >= Tree_node.size)
-		    fprintf(stderr, "\t%s\n", agnameof(n));
-	    }
-#endif
+    }
+    ctx->Heap_size = cnt;
+    for (i = cnt / 2; i >= 0; i--)
+	STheapify(ctx, i);
+
+    while (ctx->Heap_size > 1) {
+	st = STextractmin(ctx);
+	if (!(e = inter_tree_edge_search(st->rep, NULL, NULL)))
 	    return 1;
-	}
+	st = merge_trees(ctx, e);
+	STheapify(ctx, st->heap_index);
     }
-    init_cutvalues();
+    init_cutvalues(ctx);
     return 0;
 }
 
@@ -390,11 +527,41 @@ static void rerank(node_t * v, int delta)
 	    rerank(agtail(e), delta);
 }
 
+/* dfs_rerange:
+ * Redo the low/lim numbering below v after a tree edge exchange.
+ * tlim and hlim are the old lims of the entering edge's endpoints; a
+ * node whose old range contains neither lies off the cycle closed by
+ * that edge, so its subtree is unchanged and, if its parent edge and
+ * low are unchanged as well, so is every number in it.
+ */
+static int dfs_rerange(node_t * v, edge_t * par, int low, int tlim, int hlim)
+{
+    edge_t *e;
+    int i, lim;
+
+    if ((ND_par(v) == par) && (ND_low(v) == low)
+	&& !SEQ(ND_low(v), tlim, ND_lim(v))
+	&& !SEQ(ND_low(v), hlim, ND_lim(v)))
+	return ND_lim(v) + 1;
+
+    lim = low;
+    ND_par(v) = par;
+    ND_low(v) = low;
+    for (i = 0; (e = ND_tree_out(v).list[i]); i++)
+	if (e != par)
+	    lim = dfs_rerange(aghead(e), e, lim, tlim, hlim);
+    for (i = 0; (e = ND_tree_in(v).list[i]); i++)
+	if (e != par)
+	    lim = dfs_rerange(agtail(e), e, lim, tlim, hlim);
+    ND_lim(v) = lim;
+    return lim + 1;
+}
+
 /* e is the tree edge that is leaving and f is the nontree edge that
  * is entering.  compute new cut values, ranks, and exchange e and f.
  */
 static void 
-update(edge_t * e, edge_t * f)
+update(nsctx_t * ctx, edge_t * e, edge_t * f)
 {
     int cutvalue, delta;
     node_t *lca;
@@ -423,31 +590,32 @@ update(edge_t * e, edge_t * f)
     lca = treeupdate(agtail(f), aghead(f), cutvalue, 1);
     if (treeupdate(aghead(f), agtail(f), cutvalue, 0) != lca) {
 	agerr(AGERR, "update: mismatched lca in treeupdates\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
     ED_cutvalue(f) = -cutvalue;
     ED_cutvalue(e) = 0;
-    exchange_tree_edges(e, f);
-    dfs_range(lca, ND_par(lca), ND_low(lca));
+    exchange_tree_edges(ctx, e, f);
+    dfs_rerange(lca, ND_par(lca), ND_low(lca),
+		ND_lim(agtail(f)), ND_lim(aghead(f)));
 }
 
-static void scan_and_normalize(void)
+static void scan_and_normalize(nsctx_t * ctx)
 {
     node_t *n;
 
-    Minrank = INT_MAX;
-    Maxrank = -INT_MAX;
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
+    ctx->Minrank = INT_MAX;
+    ctx->Maxrank = -INT_MAX;
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
 	if (ND_node_type(n) == NORMAL) {
-	    Minrank = MIN(Minrank, ND_rank(n));
-	    Maxrank = MAX(Maxrank, ND_rank(n));
+	    ctx->Minrank = MIN(ctx->Minrank, ND_rank(n));
+	    ctx->Maxrank = MAX(ctx->Maxrank, ND_rank(n));
 	}
     }
-    if (Minrank != 0) {
-	for (n = GD_nlist(G); n; n = ND_next(n))
-	    ND_rank(n) -= Minrank;
-	Maxrank -= Minrank;
-	Minrank = 0;
+    if (ctx->Minrank != 0) {
+	for (n = GD_nlist(ctx->G); n; n = ND_next(n))
+	    ND_rank(n) -= ctx->Minrank;
+	ctx->Maxrank -= ctx->Minrank;
+	ctx->Minrank = 0;
     }
 }
 
@@ -455,22 +623,22 @@ static void
 freeTreeList (graph_t* g)
 {
     node_t *n;
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
+    for (n = GD_nlist(g); n; n = ND_next(n)) {
 	free_list(ND_tree_in(n));
 	free_list(ND_tree_out(n));
 	ND_mark(n) = FALSE;
     }
 }
 
-static void LR_balance(void)
+static void LR_balance(nsctx_t * ctx)
 {
     int i, delta;
     edge_t *e, *f;
 
-    for (i = 0; i < Tree_edge.size; i++) {
-	e = Tree_edge.list[i];
+    for (i = 0; i < ctx->Tree_edge.size; i++) {
+	e = ctx->Tree_edge.list[i];
 	if (ED_cutvalue(e) == 0) {
-	    f = enter_edge(e);
+	    f = enter_edge(ctx, e);
 	    if (f == NULL)
 		continue;
 	    delta = SLACK(f);
@@ -482,31 +650,31 @@ static void LR_balance(void)
 		rerank(aghead(e), -delta / 2);
 	}
     }
-    freeTreeList (G);
+    freeTreeList (ctx->G);
 }
 
-static void TB_balance(void)
+static void TB_balance(nsctx_t * ctx)
 {
     node_t *n;
     edge_t *e;
     int i, low, high, choice, *nrank;
     int inweight, outweight;
 
-    scan_and_normalize();
+    scan_and_normalize(ctx);
 
     /* find nodes that are not tight and move to less populated ranks */
-    nrank = N_NEW(Maxrank + 1, int);
-    for (i = 0; i <= Maxrank; i++)
+    nrank = N_NEW(ctx->Maxrank + 1, int);
+    for (i = 0; i <= ctx->Maxrank; i++)
 	nrank[i] = 0;
-    for (n = GD_nlist(G); n; n = ND_next(n))
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n))
 	if (ND_node_type(n) == NORMAL)
 	    nrank[ND_rank(n)]++;
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
 	if (ND_node_type(n) != NORMAL)
 	    continue;
 	inweight = outweight = 0;
 	low = 0;
-	high = Maxrank;
+	high = ctx->Maxrank;
 	for (i = 0; (e = ND_in(n).list[i]); i++) {
 	    inweight += ED_weight(e);
 	    low = MAX(low, ND_rank(agtail(e)) + ED_minlen(e));
@@ -533,25 +701,27 @@ static void TB_balance(void)
     free(nrank);
 }
 
-static int init_graph(graph_t * g)
+static int init_graph(nsctx_t * ctx, graph_t * g)
 {
     int i, feasible;
     node_t *n;
     edge_t *e;
 
-    G = g;
-    N_nodes = N_edges = S_i = 0;
+    ctx->G = g;
+    ctx->N_nodes = ctx->N_edges = ctx->S_i = 0;
     for (n = GD_nlist(g); n; n = ND_next(n)) {
 	ND_mark(n) = FALSE;
-	N_nodes++;
+	ctx->N_nodes++;
 	for (i = 0; (e = ND_out(n).list[i]); i++)
-	    N_edges++;
+	    ctx->N_edges++;
     }
 
-    Tree_node.list = ALLOC(N_nodes, Tree_node.list, node_t *);
-    Tree_node.size = 0;
-    Tree_edge.list = ALLOC(N_nodes, Tree_edge.list, edge_t *);
-    Tree_edge.size = 0;
+    ctx->Tree_node.list = N_NEW(ctx->N_nodes, node_t *);
+    ctx->Tree_node.size = 0;
+    ctx->Tree_edge.list = N_NEW(ctx->N_nodes, edge_t *);
+    ctx->Tree_edge.size = 0;
+    ctx->Subtree = NULL;
+    ctx->Heap = NULL;
 
     feasible = TRUE;
     for (n = GD_nlist(g); n; n = ND_next(n)) {
@@ -594,58 +764,23 @@ graphSize (graph_t * g, int* nn, int* ne)
     *ne = nedges;
 }
 
-/* rank:
- * Apply network simplex to rank the nodes in a graph.
- * Uses ED_minlen as the internode constraint: if a->b with minlen=ml,
- * rank b - rank a >= ml.
- * Assumes the graph has the following additional structure:
- *   A list of all nodes, starting at GD_nlist, and linked using ND_next.
- *   Out and in edges lists stored in ND_out and ND_in, even if the node
- *  doesn't have any out or in edges.
- * The node rank values are stored in ND_rank.
- * Returns 0 if successful; returns 1 if `he graph was not connected;
- * returns 2 if something seriously wrong;
+/* ns_solve:
+ * Run the simplex iterations and the requested balancing on ctx->G.
+ * Return values are as for rank2.
  */
-int rank2(graph_t * g, int balance, int maxiter, int search_size)
+static int ns_solve(nsctx_t * ctx, int balance, int maxiter)
 {
-    int iter = 0, feasible;
+    int iter = 0;
     char *ns = "network simplex: ";
     edge_t *e, *f;
 
-#ifdef DEBUG
-    check_cycles(g);
-#endif
-    if (Verbose) {
-	int nn, ne;
-	graphSize (g, &nn, &ne);
-	fprintf(stderr, "%s %d nodes %d edges maxiter=%d balance=%d\n", ns,
-	    nn, ne, maxiter, balance);
-	start_timer();
-    }
-    feasible = init_graph(g);
-    if (!feasible)
-	init_rank();
-    if (maxiter <= 0) {
-	freeTreeList (g);
-	return 0;
-    }
-
-    if (search_size >= 0)
-	Search_size = search_size;
-    else
-	Search_size = SEARCHSIZE;
-
-    if (setjmp (jbuf)) {
-	return 2;
-    }
-
-    if (feasible_tree()) {
-	freeTreeList (g);
+    if (feasible_tree(ctx)) {
+	freeTreeList (ctx->G);
 	return 1;
     }
-    while ((e = leave_edge())) {
-	f = enter_edge(e);
-	update(e, f);
+    while ((e = leave_edge(ctx))) {
+	f = enter_edge(ctx, e);
+	update(ctx, e, f);
 	iter++;
 	if (Verbose && (iter % 100 == 0)) {
 	    if (iter % 1000 == 100)
@@ -659,25 +794,82 @@ int rank2(graph_t * g, int balance, int maxiter, int search_size)
     }
     switch (balance) {
     case 1:
-	TB_balance();
+	TB_balance(ctx);
 	break;
     case 2:
-	LR_balance();
+	LR_balance(ctx);
 	break;
     default:
-	scan_and_normalize();
-	freeTreeList (G);
+	scan_and_normalize(ctx);
+	freeTreeList (ctx->G);
 	break;
     }
     if (Verbose) {
 	if (iter >= 100)
 	    fputc('\n', stderr);
 	fprintf(stderr, "%s%d nodes %d edges %d iter %.2f sec\n",
-		ns, N_nodes, N_edges, iter, elapsed_sec());
+		ns, ctx->N_nodes, ctx->N_edges, iter, elapsed_sec());
     }
     return 0;
 }
 
+/* rank:
+ * Apply network simplex to rank the nodes in a graph.
+ * Uses ED_minlen as the internode constraint: if a->b with minlen=ml,
+ * rank b - rank a >= ml.
+ * Assumes the graph has the following additional structure:
+ *   A list of all nodes, starting at GD_nlist, and linked using ND_next.
+ *   Out and in edges lists stored in ND_out and ND_in, even if the node
+ *  doesn't have any out or in edges.
+ * The node rank values are stored in ND_rank.
+ * Returns 0 if successful; returns 1 if `he graph was not connected;
+ * returns 2 if something seriously wrong;
+ * The solver state is local to the call, so different graphs may be
+ * ranked concurrently.
+ */
+int rank2(graph_t * g, int balance, int maxiter, int search_size)
+{
+    int rv, feasible;
+    nsctx_t *ctx;
+
+#ifdef DEBUG
+    check_cycles(g);
+#endif
+    if (Verbose) {
+	int nn, ne;
+	graphSize (g, &nn, &ne);
+	fprintf(stderr, "network simplex:  %d nodes %d edges maxiter=%d balance=%d\n",
+	    nn, ne, maxiter, balance);
+	start_timer();
+    }
+    /* on the heap, as the context is changed between setjmp and longjmp */
+    ctx = NEW(nsctx_t);
+    feasible = init_graph(ctx, g);
+    if (!feasible)
+	init_rank(ctx);
+    if (maxiter <= 0) {
+	freeTreeList (g);
+	rv = 0;
+    }
+    else {
+	if (search_size >= 0)
+	    ctx->Search_size = search_size;
+	else
+	    ctx->Search_size = SEARCHSIZE;
+
+	if (setjmp (ctx->jbuf))
+	    rv = 2;
+	else
+	    rv = ns_solve(ctx, balance, maxiter);
+    }
+    free(ctx->Tree_node.list);
+    free(ctx->Tree_edge.list);
+    free(ctx->Subtree);
+    free(ctx->Heap);
+    free(ctx);
+    return rv;
+}
+
 int rank(graph_t * g, int balance, int maxiter)
 {
     char *s;
@@ -787,7 +979,7 @@ static int dfs_range(node_t * v, edge_t * par, int low)
 }
 
 #ifdef DEBUG
-void tchk(void)
+void tchk(nsctx_t * ctx)
 {
     int i, n_cnt, e_cnt;
     node_t *n;
@@ -795,7 +987,7 @@ void tchk(void)
 
     n_cnt = 0;
     e_cnt = 0;
-    for (n = agfstnode(G); n; n = agnxtnode(G, n)) {
+    for (n = agfstnode(ctx->G); n; n = agnxtnode(ctx->G, n)) {
 	n_cnt++;
 	for (i = 0; (e = ND_tree_out(n).list[i]); i++) {
 	    e_cnt++;
@@ -803,17 +995,17 @@ void tchk(void)
 		fprintf(stderr, "not a tight tree %p", e);
 	}
     }
-    if ((n_cnt != Tree_node.size) || (e_cnt != Tree_edge.size))
+    if ((n_cnt != ctx->Tree_node.size) || (e_cnt != ctx->Tree_edge.size))
 	fprintf(stderr, "something missing\n");
 }
 
-void check_cutvalues(void)
+void check_cutvalues(nsctx_t * ctx)
 {
     node_t *v;
     edge_t *e;
     int i, save;
 
-    for (v = agfstnode(G); v; v = agnxtnode(G, v)) {
+    for (v = agfstnode(ctx->G); v; v = agnxtnode(ctx->G, v)) {
 	for (i = 0; (e = ND_tree_out(v).list[i]); i++) {
 	    save = ED_cutvalue(e);
 	    x_cutval(e);
@@ -823,14 +1015,14 @@ void check_cutvalues(void)
     }
 }
 
-int check_ranks(void)
+int check_ranks(nsctx_t * ctx)
 {
     int cost = 0;
     node_t *n;
     edge_t *e;
 
-    for (n = agfstnode(G); n; n = agnxtnode(G, n)) {
-	for (e = agfstout(G, n); e; e = agnxtout(G, e)) {
+    for (n = agfstnode(ctx->G); n; n = agnxtnode(ctx->G, n)) {
+	for (e = agfstout(ctx->G, n); e; e = agnxtout(ctx->G, e)) {
 	    cost += (ED_weight(e)) * abs(LENGTH(e));
 	    if (ND_rank(aghead(e)) - ND_rank(agtail(e)) - ED_minlen(e) < 0)
 		abort();
@@ -840,13 +1032,13 @@ int check_ranks(void)
     return cost;
 }
 
-void checktree(void)
+void checktree(nsctx_t * ctx)
 {
     int i, n = 0, m = 0;
     node_t *v;
     edge_t *e;
 
-    for (v = agfstnode(G); v; v = agnxtnode(G, v)) {
+    for (v = agfstnode(ctx->G); v; v = agnxtnode(ctx->G, v)) {
 	for (i = 0; (e = ND_tree_out(v).list[i]); i++)
 	    n++;
 	if (i != ND_tree_out(v).size)
@@ -856,7 +1048,7 @@ void checktree(void)
 	if (i != ND_tree_in(v).size)
 	    abort();
     }
-    fprintf(stderr, "%d %d %d\n", Tree_edge.size, n, m);
+    fprintf(stderr, "%d %d %d\n", ctx->Tree_edge.size, n, m);
 }
 
 void check_fast_node(node_t * n)
@@ -42,6 +42,12 @@ static Ppoint_t *polypoints;  /* vertices of polygon defined by boxes */
 static int polypointn;        /* size of polypoints[] */
 static Pedge_t *edges;        /* polygon edges passed to Proutespline */
 static int edgen;             /* size of edges[] */
+/* Each thread routing edges concurrently has its own copy of the
+ * buffers above; ps is allocated on demand by mkspacep in threads
+ * that never call routesplinesinit, and each thread releases its copy
+ * with routesplinesthreadterm before leaving the parallel region.
+ */
+#pragma omp threadprivate(ps, maxpn, polypoints, polypointn, edges, edgen)
 
 static int checkpath(int, boxf*, path*);
 static int mkspacep(int size);
@@ -316,6 +322,8 @@ void routesplinesterm()
 {
     if (--routeinit > 0) return;
     free(ps);
+    ps = NULL;
+    maxpn = 0;
 #ifdef UNUSED
     free(bs), bs = NULL /*, maxbn = bn = 0 */ ;
 #endif
@@ -325,6 +333,24 @@ void routesplinesterm()
 		nedges, nboxes, elapsed_sec());
 }
 
+/* routesplinesthreadterm:
+ * Free the calling thread's copy of the buffers used by routesplines.
+ * Called by every thread at the end of a parallel region routing edges;
+ * later calls in the same thread simply grow the buffers again.
+ */
+void routesplinesthreadterm()
+{
+    free(ps);
+    ps = NULL;
+    maxpn = 0;
+    free(polypoints);
+    polypoints = NULL;
+    polypointn = 0;
+    free(edges);
+    edges = NULL;
+    edgen = 0;
+}
+
 static void
 limitBoxes (boxf* boxes, int boxn, pointf *pps, int pn, int delta)
 {
@@ -405,7 +431,9 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
     int loopcnt, delta = INIT_DELTA;
     boolean unbounded;
 
+#pragma omp atomic
     nedges++;
+#pragma omp atomic
     nboxes += pp->nbox;
 
     for (realedge = (edge_t *) pp->data;
@@ -635,7 +663,7 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	agerr(AGWARN, "Unable to reclaim box space in spline routing for edge \"%s\" -> \"%s\". Something is probably seriously wrong.\n", agnameof(agtail(realedge)), agnameof(aghead(realedge)));
 	make_polyline (pl, &polyspl);
 	limitBoxes (boxes, boxn, polyspl.ps, polyspl.pn, INIT_DELTA);
-	free (polyspl.ps);
+	/* polyspl.ps is make_polyline's buffer; do not free it */
     }
 
     *npoints = spl.pn;
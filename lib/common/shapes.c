@@ -25,6 +25,11 @@ typedef struct {
  
 static port Center = { {0, 0}, -1, 0, 0, 0, 1, 0, 0, 0 };
 
+/* Bumped by gv_initShapes. The inside functions keep per-thread caches
+ * keyed by node, which are dropped when it changes.
+ */
+static int inside_epoch;
+
 #define ATTR_SET(a,n) ((a) && (*(agxget(n,a->index)) != '\0'))
   /* Default point size = 0.05 inches or 3.6 points */
 #define DEF_POINT 0.05
@@ -2266,6 +2271,8 @@ static boolean poly_inside(inside_t * inside_context, pointf p)
     static pointf O;		/* point (0,0) */
     static pointf *vertex;
     static double xsize, ysize, scalex, scaley, box_URx, box_URy;
+    static int epoch;
+#pragma omp threadprivate(lastn, poly, last, outp, sides, O, vertex, xsize, ysize, scalex, scaley, box_URx, box_URy, epoch)
 
     int i, i1, j, s;
     pointf P, Q, R;
@@ -2276,6 +2283,10 @@ static boolean poly_inside(inside_t * inside_context, pointf p)
 	lastn = NULL;
 	return FALSE;
     }
+    if (epoch != inside_epoch) {
+	lastn = NULL;
+	epoch = inside_epoch;
+    }
 
     bp = inside_context->s.bp;
     n = inside_context->s.n;
@@ -3058,6 +3069,8 @@ static boolean point_inside(inside_t * inside_context, pointf p)
 {
     static node_t *lastn;	/* last node argument */
     static double radius;
+    static int epoch;
+#pragma omp threadprivate(lastn, radius, epoch)
     pointf P;
     node_t *n;
 
@@ -3065,6 +3078,10 @@ static boolean point_inside(inside_t * inside_context, pointf p)
 	lastn = NULL;
 	return FALSE;
     }
+    if (epoch != inside_epoch) {
+	lastn = NULL;
+	epoch = inside_epoch;
+    }
 
     n = inside_context->s.n;
     P = ccwrotatepf(p, 90 * GD_rankdir(agraphof(n)));
@@ -3960,11 +3977,17 @@ static boolean star_inside(inside_t * inside_context, pointf p)
     static int outp, sides;
     static pointf *vertex;
     static pointf O;		/* point (0,0) */
+    static int epoch;
+#pragma omp threadprivate(lastn, poly, outp, sides, vertex, O, epoch)
 
     if (!inside_context) {
 	lastn = NULL;
 	return FALSE;
     }
+    if (epoch != inside_epoch) {
+	lastn = NULL;
+	epoch = inside_epoch;
+    }
     boxf *bp = inside_context->s.bp;
     node_t *n = inside_context->s.n;
     pointf P, Q, R;
@@ -4217,6 +4240,8 @@ void resolvePorts(edge_t * e)
 void gv_initShapes(void)
 {
     pointf p;
+
+    inside_epoch++;
     poly_inside(NULL, p);
     point_inside(NULL, p);
     star_inside(NULL, p);
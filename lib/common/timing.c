@@ -11,21 +11,19 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
+/* The timings are wall clock times. Several layout phases run on many
+ * threads, and their CPU time, summed over the threads, would hide any
+ * speed-up.
+ */
 #ifndef WIN32
 
-#include        <unistd.h>
+#include	<stddef.h>
 #include	<sys/types.h>
-#include	<sys/times.h>
-#include	<sys/param.h>
+#include	<sys/time.h>
 
-
-
-#ifndef HZ
-#define HZ 60
-#endif
-typedef struct tms mytime_t;
-#define GET_TIME(S) times(&(S))
-#define DIFF_IN_SECS(S,T) ((S.tms_utime + S.tms_stime - T.tms_utime - T.tms_stime)/(double)HZ)
+typedef struct timeval mytime_t;
+#define GET_TIME(S) gettimeofday(&(S), NULL)
+#define IN_SECS(S) (S.tv_sec + S.tv_usec / 1000000.)
 
 #else
 
@@ -33,9 +31,10 @@ typedef struct tms mytime_t;
 #include "render.h"
 #include    "utils.h"
 
+/* clock() is the wall clock time with the Microsoft C runtime */
 typedef clock_t mytime_t;
 #define GET_TIME(S) S = clock()
-#define DIFF_IN_SECS(S,T) ((S - T) / (double)CLOCKS_PER_SEC)
+#define IN_SECS(S) (S / (double)CLOCKS_PER_SEC)
 
 #endif
 
@@ -53,6 +52,18 @@ double elapsed_sec(void)
     double rv;
 
     GET_TIME(S);
-    rv = DIFF_IN_SECS(S, T);
+    rv = IN_SECS(S) - IN_SECS(T);
     return rv;
 }
+
+/* clock_sec:
+ * The current time in seconds, on the clock of elapsed_sec. Used to time
+ * a span in which start_timer may be called.
+ */
+double clock_sec(void)
+{
+    mytime_t S;
+
+    GET_TIME(S);
+    return IN_SECS(S);
+}
@@ -112,6 +112,7 @@ extern "C" {
     /* from timing.c */
     extern void start_timer(void);
     extern double elapsed_sec(void);
+    extern double clock_sec(void);
 
     /* from psusershape.c */
     extern void cat_libfile(GVJ_t * job, const char **arglib, const char **stdlib);
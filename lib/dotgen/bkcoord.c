@@ -0,0 +1,898 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+
+/*
+ * Brandes-Koepf x coordinate assignment, selected by xcoord=bk.
+ *
+ * U. Brandes and B. Koepf, "Fast and Simple Horizontal Coordinate
+ * Assignment", Graph Drawing 2001. Nodes are aligned into vertical
+ * blocks along median neighbors in four passes (up/down, left/right),
+ * each pass is compacted, and the final coordinate of a node is the
+ * average of its two median candidates. Apart from the cycle checks
+ * for flat edge labels, this is linear in the size of the rank arrays,
+ * so it is much faster than network simplex on large graphs, at the
+ * cost of wider drawings when many long edges cross.
+ *
+ * Clusters are handled by adding a left and a right boundary item for
+ * each cluster on each of its ranks. The boundary items of a cluster
+ * always form one block, so the cluster box is a rectangle, and a
+ * segment may only be aligned if it crosses no boundary.
+ */
+
+#include	"dot.h"
+
+typedef struct {
+    graph_t *g;
+    int parent;			/* enclosing cluster, or -1 */
+    int depth;
+    int margin;
+} bkclust_t;
+
+typedef struct {
+    int v;			/* neighbor item */
+    int e;			/* segment id */
+} bkadj_t;
+
+typedef struct {
+    int pos;			/* order of the node next to the boundary */
+    int side;			/* 0 opens before it, 1 closes after it */
+    int depth;
+    int c;
+} bkevent_t;
+
+typedef struct {
+    int n;			/* number of items */
+    int nlayer;
+    int *layer;			/* layer i holds items layer[i]..layer[i+1]-1 */
+    int *lay;			/* layer of each item */
+    node_t **node;		/* NULL for a cluster boundary */
+    int *bnd;			/* 2*cluster+side for a boundary, else -1 */
+    int *gap;			/* separation from the previous item */
+    int *bup, *bdn;		/* the same boundary one layer up/down */
+    int *clu, *cld;		/* continuing boundaries to the left */
+    int *upstart, *dnstart;
+    bkadj_t *up, *dn;		/* neighbors in the layer above/below */
+    char *mark;			/* segments not to be aligned */
+    int nx;			/* extra constraints x[xr] - x[xl] >= xd */
+    int *xl, *xr, *xd;
+    int nclust;
+    bkclust_t *clust;
+} bkgraph_t;
+
+#define IS_LABEL_VNODE(n) \
+	((ND_node_type(n) == VIRTUAL) && (ND_alg(n) != NULL))
+
+static int count_clusters(graph_t * g)
+{
+    int c, cnt = GD_n_cluster(g);
+
+    for (c = 1; c <= GD_n_cluster(g); c++)
+	cnt += count_clusters(GD_clust(g)[c]);
+    return cnt;
+}
+
+static int collect_clusters(bkgraph_t * bk, graph_t * g, int parent,
+			    int depth, int cnt)
+{
+    int c, i;
+    graph_t *subg;
+
+    for (c = 1; c <= GD_n_cluster(g); c++) {
+	subg = GD_clust(g)[c];
+	i = cnt++;
+	bk->clust[i].g = subg;
+	bk->clust[i].parent = parent;
+	bk->clust[i].depth = depth;
+	bk->clust[i].margin = late_int(subg, G_margin, CL_OFFSET, 0);
+	cnt = collect_clusters(bk, subg, i, depth + 1, cnt);
+    }
+    return cnt;
+}
+
+static int cmpevent(const void *x, const void *y)
+{
+    const bkevent_t *a = (const bkevent_t *) x;
+    const bkevent_t *b = (const bkevent_t *) y;
+
+    if (a->pos != b->pos)
+	return a->pos - b->pos;
+    if (a->side != b->side)
+	return a->side - b->side;
+    if (a->side == 0)
+	return a->depth - b->depth;
+    return b->depth - a->depth;
+}
+
+static int cmpadj(const void *x, const void *y)
+{
+    return ((const bkadj_t *) x)->v - ((const bkadj_t *) y)->v;
+}
+
+/* item_gap:
+ * Separation between consecutive items p and i of a layer, matching
+ * the constraints make_LR_constraints and pos_clusters give to
+ * network simplex.
+ */
+static int
+item_gap(bkgraph_t * bk, int p, int i, int nodesep, int rootmargin)
+{
+    bkclust_t *cp, *ci;
+    double d;
+
+    if (bk->bnd[p] < 0 && bk->bnd[i] < 0)
+	return ROUND(ND_rw(bk->node[p]) + ND_lw(bk->node[i]) + nodesep);
+    if (bk->bnd[p] < 0) {
+	ci = bk->clust + bk->bnd[i] / 2;
+	if (bk->bnd[i] & 1)
+	    d = ND_rw(bk->node[p]) + ci->margin
+		+ GD_border(ci->g)[RIGHT_IX].x;
+	else
+	    d = ND_rw(bk->node[p]) + ci->margin;
+	return ROUND(d);
+    }
+    cp = bk->clust + bk->bnd[p] / 2;
+    if (bk->bnd[i] < 0) {
+	if (bk->bnd[p] & 1)
+	    d = cp->margin + ND_lw(bk->node[i]);
+	else
+	    d = ND_lw(bk->node[i]) + cp->margin
+		+ GD_border(cp->g)[LEFT_IX].x;
+	return ROUND(d);
+    }
+    ci = bk->clust + bk->bnd[i] / 2;
+    if (!(bk->bnd[p] & 1) && !(bk->bnd[i] & 1))	/* into a subcluster */
+	d = cp->margin + GD_border(cp->g)[LEFT_IX].x;
+    else if ((bk->bnd[p] & 1) && (bk->bnd[i] & 1))	/* out of one */
+	d = ci->margin + GD_border(ci->g)[RIGHT_IX].x;
+    else if (ci->parent >= 0)	/* between siblings */
+	d = bk->clust[ci->parent].margin;
+    else
+	d = rootmargin;
+    return ROUND(d);
+}
+
+/* build_items:
+ * Lay out the items of each rank: its nodes, and for every cluster
+ * on the rank a left boundary before its first node and a right
+ * boundary after its last node, outer clusters outside inner ones.
+ */
+static void build_items(bkgraph_t * bk, graph_t * g, int **nodeitem)
+{
+    int r, li, i, j, k, c, n, nev, cnt, nodesep, rootmargin;
+    int sep[2];
+    int *last, *lastlay;
+    bkevent_t *ev;
+    rank_t *rank = GD_rank(g);
+    graph_t *subg;
+    int lastnode, acc, need;
+
+    if (GD_has_labels(g->root) & EDGE_LABEL) {
+	sep[0] = GD_nodesep(g);
+	sep[1] = 5;
+    } else
+	sep[1] = sep[0] = GD_nodesep(g);
+    rootmargin = late_int(g, G_margin, CL_OFFSET, 0);
+
+    n = 0;
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
+	n += rank[r].n;
+    bk->nlayer = GD_maxrank(g) - GD_minrank(g) + 1;
+    n += 2 * bk->nclust * bk->nlayer;
+    bk->layer = N_NEW(bk->nlayer + 1, int);
+    bk->lay = N_NEW(n, int);
+    bk->node = N_NEW(n, node_t *);
+    bk->bnd = N_NEW(n, int);
+    bk->gap = N_NEW(n, int);
+    bk->bup = N_NEW(n, int);
+    bk->bdn = N_NEW(n, int);
+    ev = N_NEW(2 * bk->nclust + 1, bkevent_t);
+    last = N_NEW(2 * bk->nclust + 1, int);
+    lastlay = N_NEW(2 * bk->nclust + 1, int);
+    for (c = 0; c < 2 * bk->nclust; c++)
+	lastlay[c] = -2;
+
+    cnt = 0;
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	li = r - GD_minrank(g);
+	bk->layer[li] = cnt;
+	nodeitem[li] = N_NEW(rank[r].n + 1, int);
+	nodesep = sep[r & 1];
+
+	nev = 0;
+	for (c = 0; c < bk->nclust; c++) {
+	    subg = bk->clust[c].g;
+	    if (r < GD_minrank(subg) || r > GD_maxrank(subg))
+		continue;
+	    k = GD_rank(subg)[r].n;
+	    if (k == 0 || GD_rank(subg)[r].v[0] == NULL)
+		continue;
+	    ev[nev].pos = ND_order(GD_rank(subg)[r].v[0]);
+	    ev[nev].side = 0;
+	    ev[nev].depth = bk->clust[c].depth;
+	    ev[nev++].c = c;
+	    ev[nev].pos = ND_order(GD_rank(subg)[r].v[k - 1]);
+	    ev[nev].side = 1;
+	    ev[nev].depth = bk->clust[c].depth;
+	    ev[nev++].c = c;
+	}
+	qsort(ev, nev, sizeof(bkevent_t), cmpevent);
+
+	lastnode = -1;
+	acc = 0;
+	for (j = 0, k = 0; j < rank[r].n || k < nev;) {
+	    i = cnt++;
+	    bk->lay[i] = li;
+	    bk->bup[i] = bk->bdn[i] = -1;
+	    if (k < nev && (j == rank[r].n || ev[k].pos < j
+			    || (ev[k].pos == j && ev[k].side == 0))) {
+		c = 2 * ev[k].c + ev[k].side;
+		k++;
+		bk->bnd[i] = c;
+		if (lastlay[c] == li - 1) {
+		    bk->bup[i] = last[c];
+		    bk->bdn[last[c]] = i;
+		}
+		last[c] = i;
+		lastlay[c] = li;
+	    } else {
+		bk->bnd[i] = -1;
+		bk->node[i] = rank[r].v[j];
+		nodeitem[li][j++] = i;
+	    }
+	    if (i > bk->layer[li]) {
+		bk->gap[i] = item_gap(bk, i - 1, i, nodesep, rootmargin);
+		acc += bk->gap[i];
+	    }
+	    if (bk->bnd[i] >= 0)
+		continue;
+	    /* nodes separated by boundaries still need nodesep */
+	    if (lastnode >= 0) {
+		need = ROUND(ND_rw(bk->node[lastnode])
+			     + ND_lw(bk->node[i]) + nodesep);
+		if (acc < need)
+		    bk->gap[i] += need - acc;
+	    }
+	    lastnode = i;
+	    acc = 0;
+	}
+    }
+    bk->layer[bk->nlayer] = cnt;
+    bk->n = cnt;
+    free(ev);
+    free(last);
+    free(lastlay);
+}
+
+/* build_segments:
+ * Record the edges between adjacent layers. Label nodes of flat edges
+ * are left out, since they are placed between their endpoints.
+ * A segment is marked if its endpoints are not enclosed by the
+ * same continuing cluster boundaries.
+ */
+static void build_segments(bkgraph_t * bk, graph_t * g, int **nodeitem)
+{
+    int i, j, k, li, cnt, nseg;
+    int *cl;
+    node_t *u, *v;
+    edge_t *e;
+    rank_t *rank = GD_rank(g);
+
+    bk->clu = N_NEW(bk->n, int);
+    bk->cld = N_NEW(bk->n, int);
+    for (li = 0; li < bk->nlayer; li++) {
+	int nu = 0, nd = 0;
+	for (i = bk->layer[li]; i < bk->layer[li + 1]; i++) {
+	    bk->clu[i] = nu;
+	    bk->cld[i] = nd;
+	    if (bk->bnd[i] >= 0) {
+		if (bk->bup[i] >= 0)
+		    nu++;
+		if (bk->bdn[i] >= 0)
+		    nd++;
+	    }
+	}
+    }
+
+    bk->upstart = N_NEW(bk->n + 1, int);
+    bk->dnstart = N_NEW(bk->n + 1, int);
+    nseg = 0;
+    for (i = 0; i < bk->n; i++) {
+	bk->upstart[i] = nseg;
+	v = bk->node[i];
+	li = bk->lay[i];
+	if (v == NULL || li == 0 || IS_LABEL_VNODE(v))
+	    continue;
+	for (k = 0; (e = ND_save_in(v).list[k]); k++) {
+	    u = agtail(e);
+	    if (ND_rank(u) != ND_rank(v) - 1 || IS_LABEL_VNODE(u))
+		continue;
+	    if (rank[ND_rank(u)].v[ND_order(u)] != u)
+		continue;
+	    nseg++;
+	}
+    }
+    bk->upstart[bk->n] = nseg;
+    bk->up = N_NEW(nseg + 1, bkadj_t);
+    bk->dn = N_NEW(nseg + 1, bkadj_t);
+    bk->mark = N_NEW(nseg + 1, char);
+
+    cnt = 0;
+    for (i = 0; i < bk->n; i++) {
+	v = bk->node[i];
+	li = bk->lay[i];
+	if (v == NULL || li == 0 || IS_LABEL_VNODE(v))
+	    continue;
+	for (k = 0; (e = ND_save_in(v).list[k]); k++) {
+	    u = agtail(e);
+	    if (ND_rank(u) != ND_rank(v) - 1 || IS_LABEL_VNODE(u))
+		continue;
+	    if (rank[ND_rank(u)].v[ND_order(u)] != u)
+		continue;
+	    bk->up[cnt++].v = nodeitem[li - 1][ND_order(u)];
+	}
+	qsort(bk->up + bk->upstart[i], cnt - bk->upstart[i],
+	      sizeof(bkadj_t), cmpadj);
+    }
+    for (k = 0; k < nseg; k++)
+	bk->up[k].e = k;
+
+    /* transpose into the down lists, which come out sorted */
+    cl = N_NEW(bk->n + 1, int);
+    for (k = 0; k < nseg; k++)
+	cl[bk->up[k].v]++;
+    for (i = 0, cnt = 0; i < bk->n; i++) {
+	bk->dnstart[i] = cnt;
+	cnt += cl[i];
+	cl[i] = bk->dnstart[i];
+    }
+    bk->dnstart[bk->n] = cnt;
+    for (i = 0; i < bk->n; i++) {
+	for (k = bk->upstart[i]; k < bk->upstart[i + 1]; k++) {
+	    j = cl[bk->up[k].v]++;
+	    bk->dn[j].v = i;
+	    bk->dn[j].e = k;
+	    if (bk->cld[bk->up[k].v] != bk->clu[i])
+		bk->mark[k] = TRUE;
+	}
+    }
+    free(cl);
+}
+
+#define INNER(n) (ND_node_type(n) == VIRTUAL)
+
+/* mark_conflicts:
+ * Mark type 1 conflicts, i.e. segments crossing an inner segment
+ * between two virtual nodes, so long edges are kept straight
+ * (Alg. 1 of Brandes-Koepf).
+ */
+static void mark_conflicts(bkgraph_t * bk)
+{
+    int li, l, l1, k, k0, k1, inner, last;
+
+    for (li = 1; li < bk->nlayer; li++) {
+	k0 = bk->layer[li - 1];
+	l = bk->layer[li];
+	last = bk->layer[li + 1] - 1;
+	for (l1 = bk->layer[li]; l1 <= last; l1++) {
+	    inner = -1;
+	    if (bk->node[l1] && INNER(bk->node[l1])) {
+		for (k = bk->upstart[l1]; k < bk->upstart[l1 + 1]; k++)
+		    if (INNER(bk->node[bk->up[k].v])) {
+			inner = bk->up[k].v;
+			break;
+		    }
+	    }
+	    if (l1 == last || inner >= 0) {
+		k1 = (inner >= 0) ? inner : bk->layer[li] - 1;
+		while (l <= l1) {
+		    for (k = bk->upstart[l]; k < bk->upstart[l + 1]; k++)
+			if (bk->up[k].v < k0 || bk->up[k].v > k1)
+			    bk->mark[k] = TRUE;
+		    l++;
+		}
+		k0 = k1;
+	    }
+	}
+    }
+}
+
+/* mark_labels:
+ * A label node of a flat edge must stay between the endpoints of the
+ * edge in the rank below. Mark the segments crossing its edges to
+ * the endpoints, since a block along one of them would keep an
+ * endpoint on the wrong side of the label.
+ */
+static void mark_labels(bkgraph_t * bk)
+{
+    int i, k, w, lv, li;
+
+    for (i = 0; i < bk->nx; i++) {
+	if (bk->lay[bk->xl[i]] == bk->lay[bk->xr[i]] + 1) {
+	    lv = bk->xr[i];	/* left endpoint xl below the label */
+	    li = bk->lay[bk->xl[i]];
+	    for (w = bk->layer[li]; w <= bk->xl[i]; w++)
+		for (k = bk->upstart[w]; k < bk->upstart[w + 1]; k++)
+		    if (bk->up[k].v > lv)
+			bk->mark[k] = TRUE;
+	} else if (bk->lay[bk->xr[i]] == bk->lay[bk->xl[i]] + 1) {
+	    lv = bk->xl[i];	/* right endpoint xr below the label */
+	    li = bk->lay[bk->xr[i]];
+	    for (w = bk->xr[i]; w < bk->layer[li + 1]; w++)
+		for (k = bk->upstart[w]; k < bk->upstart[w + 1]; k++)
+		    if (bk->up[k].v < lv)
+			bk->mark[k] = TRUE;
+	}
+    }
+}
+
+static int item_pos(bkgraph_t * bk, int hdir, int i)
+{
+    if (hdir)
+	return bk->layer[bk->lay[i] + 1] - 1 - i;
+    return i - bk->layer[bk->lay[i]];
+}
+
+/* vertical_align:
+ * Align each item with a median neighbor in the previous layer of
+ * the sweep (Alg. 2 of Brandes-Koepf). Cluster boundaries are always
+ * aligned with their counterpart.
+ */
+static void
+vertical_align(bkgraph_t * bk, int vdir, int hdir, int *root, int *align)
+{
+    int i, j, k, li, m, d, r, u, v, b, cnt;
+    int *start;
+    bkadj_t *nb;
+
+    for (i = 0; i < bk->n; i++)
+	root[i] = align[i] = i;
+    start = vdir ? bk->dnstart : bk->upstart;
+    nb = vdir ? bk->dn : bk->up;
+    for (k = 0; k < bk->nlayer; k++) {
+	li = vdir ? bk->nlayer - 1 - k : k;
+	cnt = bk->layer[li + 1] - bk->layer[li];
+	r = -1;
+	for (j = 0; j < cnt; j++) {
+	    v = hdir ? bk->layer[li + 1] - 1 - j : bk->layer[li] + j;
+	    if (bk->bnd[v] >= 0) {
+		b = vdir ? bk->bdn[v] : bk->bup[v];
+		if (b >= 0 && r < item_pos(bk, hdir, b)) {
+		    align[b] = v;
+		    root[v] = root[b];
+		    align[v] = root[v];
+		    r = item_pos(bk, hdir, b);
+		}
+		continue;
+	    }
+	    d = start[v + 1] - start[v];
+	    for (m = (d - 1) / 2; m <= d / 2 && d > 0; m++) {
+		if (align[v] != v)
+		    break;
+		i = start[v] + (hdir ? d - 1 - m : m);
+		u = nb[i].v;
+		if (!bk->mark[nb[i].e] && r < item_pos(bk, hdir, u)) {
+		    align[u] = v;
+		    root[v] = root[u];
+		    align[v] = root[v];
+		    r = item_pos(bk, hdir, u);
+		}
+	    }
+	}
+    }
+}
+
+/* reaches:
+ * Return TRUE if block t can be reached from block s along the
+ * constraints added so far.
+ */
+static boolean reaches(int s, int t, int *shead, int *snext, int *to,
+		       int *seen, int stamp, int *stack)
+{
+    int top, b, k;
+
+    top = 0;
+    stack[top++] = s;
+    seen[s] = stamp;
+    while (top > 0) {
+	b = stack[--top];
+	if (b == t)
+	    return TRUE;
+	for (k = shead[b]; k >= 0; k = snext[k]) {
+	    if (seen[to[k]] != stamp) {
+		seen[to[k]] = stamp;
+		stack[top++] = to[k];
+	    }
+	}
+    }
+    return FALSE;
+}
+
+/* horizontal_compaction:
+ * Place the blocks of one pass. Separation constraints between the
+ * blocks form a DAG; as in make_LR_constraints, the constraints from
+ * flat edge labels are only added if they do not close a cycle.
+ * Blocks are first placed as far left as their predecessors allow,
+ * then moved right up to their successors, so blocks with slack are
+ * not left stranded at the left. This replaces the sink/class shifts
+ * of the original algorithm, which can produce overlaps.
+ */
+static void horizontal_compaction(bkgraph_t * bk, int hdir, int *root,
+				  int *x)
+{
+    int i, k, p, b, s, d, ne, cnt, top, m;
+    int *from, *to, *len, *pstart, *pe, *sstart, *se, *ord, *order;
+    int *stack, *next, *shead, *snext;
+    char *state;
+
+    ne = 0;
+    from = N_NEW(bk->n + bk->nx + 1, int);
+    to = N_NEW(bk->n + bk->nx + 1, int);
+    len = N_NEW(bk->n + bk->nx + 1, int);
+    for (i = 0; i < bk->n; i++) {
+	if (hdir) {
+	    if (i + 1 >= bk->layer[bk->lay[i] + 1])
+		continue;
+	    p = i + 1;
+	    d = bk->gap[i + 1];
+	} else {
+	    if (i == bk->layer[bk->lay[i]])
+		continue;
+	    p = i - 1;
+	    d = bk->gap[i];
+	}
+	from[ne] = root[p];
+	to[ne] = root[i];
+	len[ne++] = d;
+    }
+    /* constraints within a layer follow the layer order */
+    for (k = 0; k < bk->nx; k++) {
+	if (bk->lay[bk->xl[k]] != bk->lay[bk->xr[k]])
+	    continue;
+	from[ne] = root[hdir ? bk->xr[k] : bk->xl[k]];
+	to[ne] = root[hdir ? bk->xl[k] : bk->xr[k]];
+	len[ne] = bk->xd[k];
+	if (from[ne] != to[ne])
+	    ne++;
+    }
+    shead = N_NEW(bk->n + 1, int);
+    snext = N_NEW(bk->n + bk->nx + 1, int);
+    next = N_NEW(bk->n + 1, int);
+    stack = N_NEW(bk->n + 1, int);
+    for (i = 0; i < bk->n; i++)
+	shead[i] = -1;
+    for (k = 0; k < ne; k++) {
+	snext[k] = shead[from[k]];
+	shead[from[k]] = k;
+    }
+    for (k = 0; k < bk->nx; k++) {
+	if (bk->lay[bk->xl[k]] == bk->lay[bk->xr[k]])
+	    continue;
+	from[ne] = root[hdir ? bk->xr[k] : bk->xl[k]];
+	to[ne] = root[hdir ? bk->xl[k] : bk->xr[k]];
+	len[ne] = bk->xd[k];
+	if (from[ne] == to[ne]
+	    || reaches(to[ne], from[ne], shead, snext, to, next, k + 1,
+		       stack))
+	    continue;
+	snext[ne] = shead[from[ne]];
+	shead[from[ne]] = ne;
+	ne++;
+    }
+    free(shead);
+    free(snext);
+
+    /* predecessor and successor lists of the blocks */
+    pstart = N_NEW(bk->n + 1, int);
+    sstart = N_NEW(bk->n + 1, int);
+    pe = N_NEW(ne + 1, int);
+    se = N_NEW(ne + 1, int);
+    for (k = 0; k < ne; k++) {
+	pstart[to[k] + 1]++;
+	sstart[from[k] + 1]++;
+    }
+    for (i = 0; i < bk->n; i++) {
+	pstart[i + 1] += pstart[i];
+	sstart[i + 1] += sstart[i];
+    }
+    for (i = 0; i < bk->n; i++)
+	next[i] = pstart[i];
+    for (k = 0; k < ne; k++)
+	pe[next[to[k]]++] = k;
+    for (i = 0; i < bk->n; i++)
+	next[i] = sstart[i];
+    for (k = 0; k < ne; k++)
+	se[next[from[k]]++] = k;
+
+    /* topological order of the blocks by depth first search */
+    state = N_NEW(bk->n, char);
+    ord = N_NEW(bk->n, int);
+    order = N_NEW(bk->n, int);
+    cnt = 0;
+    for (i = 0; i < bk->n; i++) {
+	if (root[i] != i || state[i])
+	    continue;
+	top = 0;
+	stack[top++] = i;
+	state[i] = 1;
+	next[i] = pstart[i];
+	while (top > 0) {
+	    b = stack[top - 1];
+	    if (next[b] < pstart[b + 1]) {
+		p = from[pe[next[b]++]];
+		if (state[p] == 0) {
+		    state[p] = 1;
+		    next[p] = pstart[p];
+		    stack[top++] = p;
+		}
+	    } else {
+		state[b] = 2;
+		ord[b] = cnt;
+		order[cnt++] = b;
+		top--;
+	    }
+	}
+    }
+
+    for (k = 0; k < cnt; k++) {
+	b = order[k];
+	x[b] = 0;
+	for (i = pstart[b]; i < pstart[b + 1]; i++) {
+	    p = from[pe[i]];
+	    if (ord[p] < k)
+		x[b] = MAX(x[b], x[p] + len[pe[i]]);
+	}
+    }
+    for (k = cnt - 1; k >= 0; k--) {
+	b = order[k];
+	m = INT_MAX;
+	for (i = sstart[b]; i < sstart[b + 1]; i++) {
+	    s = to[se[i]];
+	    if (ord[s] > k)
+		m = MIN(m, x[s] - len[se[i]]);
+	}
+	if (m != INT_MAX)
+	    x[b] = MAX(x[b], m);
+    }
+    for (i = 0; i < bk->n; i++)
+	x[i] = x[root[i]];
+
+    free(from);
+    free(to);
+    free(len);
+    free(pstart);
+    free(sstart);
+    free(pe);
+    free(se);
+    free(next);
+    free(state);
+    free(ord);
+    free(order);
+    free(stack);
+}
+
+static void add_extra(bkgraph_t * bk, int l, int r, int d, int *size)
+{
+    if (bk->nx == *size) {
+	*size = 2 * (*size) + 16;
+	bk->xl = ALLOC(*size, bk->xl, int);
+	bk->xr = ALLOC(*size, bk->xr, int);
+	bk->xd = ALLOC(*size, bk->xd, int);
+    }
+    bk->xl[bk->nx] = l;
+    bk->xr[bk->nx] = r;
+    bk->xd[bk->nx++] = d;
+}
+
+/* build_extras:
+ * Constraints that are not between consecutive items: flat edges,
+ * labels of flat edges, and cluster label widths.
+ */
+static void build_extras(bkgraph_t * bk, graph_t * g, int **nodeitem)
+{
+    int i, k, c, r, li, m0, m1, size = 0;
+    double width;
+    node_t *u, *t0, *h0;
+    edge_t *e, *e0, *e1, *ff;
+    graph_t *subg;
+
+    for (i = 0; i < bk->n; i++) {
+	if ((u = bk->node[i]) == NULL)
+	    continue;
+	li = bk->lay[i];
+	if ((e = (edge_t *) ND_alg(u)) && li + 1 < bk->nlayer) {
+	    e0 = ND_save_out(u).list[0];
+	    e1 = ND_save_out(u).list[1];
+	    if (e0 && e1) {
+		if (ND_order(aghead(e0)) > ND_order(aghead(e1))) {
+		    ff = e0;
+		    e0 = e1;
+		    e1 = ff;
+		}
+		m0 = (ED_minlen(e) * GD_nodesep(g)) / 2;
+		m1 = m0 + ND_rw(aghead(e0)) + ND_lw(agtail(e0));
+		add_extra(bk, nodeitem[li + 1][ND_order(aghead(e0))], i, m1,
+			  &size);
+		m1 = m0 + ND_rw(agtail(e1)) + ND_lw(aghead(e1));
+		add_extra(bk, i, nodeitem[li + 1][ND_order(aghead(e1))], m1,
+			  &size);
+	    }
+	}
+	for (k = 0; k < ND_flat_out(u).size; k++) {
+	    e = ND_flat_out(u).list[k];
+	    if (ND_order(agtail(e)) < ND_order(aghead(e))) {
+		t0 = agtail(e);
+		h0 = aghead(e);
+	    } else {
+		t0 = aghead(e);
+		h0 = agtail(e);
+	    }
+	    width = ND_rw(t0) + ND_lw(h0);
+	    m0 = ED_minlen(e) * GD_nodesep(g) + width;
+	    if (ND_order(h0) == ND_order(t0) + 1)
+		m0 = MAX(m0, width + GD_nodesep(g) + ROUND(ED_dist(e)));
+	    else if (ED_label(e))
+		continue;	/* constrained by its label node */
+	    add_extra(bk, nodeitem[li][ND_order(t0)],
+		      nodeitem[li][ND_order(h0)], m0, &size);
+	}
+    }
+
+    if (GD_flip(g))
+	return;
+    for (c = 0; c < bk->nclust; c++) {
+	subg = bk->clust[c].g;
+	if (!GD_label(subg))
+	    continue;
+	for (r = GD_minrank(subg); r <= GD_maxrank(subg); r++) {
+	    int l = -1;
+	    li = r - GD_minrank(g);
+	    for (i = bk->layer[li]; i < bk->layer[li + 1]; i++) {
+		if (bk->bnd[i] == 2 * c)
+		    l = i;
+		else if (bk->bnd[i] == 2 * c + 1 && l >= 0) {
+		    add_extra(bk, l, i,
+			      ROUND(MAX(GD_border(subg)[BOTTOM_IX].x,
+					GD_border(subg)[TOP_IX].x)),
+			      &size);
+		    break;
+		}
+	    }
+	    if (l >= 0)
+		break;
+	}
+    }
+}
+
+static int cmpint(const void *x, const void *y)
+{
+    return *(const int *) x - *(const int *) y;
+}
+
+/* bk_xcoords:
+ * Assign x coordinates to the nodes of g, returned in ND_rank as
+ * network simplex does, and create the cluster boundary nodes
+ * GD_ln and GD_rn used for cluster bounding boxes.
+ */
+void bk_xcoords(graph_t * g)
+{
+    bkgraph_t bk;
+    int **nodeitem;
+    int *xs[4], *root, *align;
+    int i, c, p, pass, best, lo, hi, shift;
+    int vals[4];
+    int minx[4], maxx[4];
+    node_t *ln, *rn;
+
+    memset(&bk, 0, sizeof(bk));
+    bk.nclust = count_clusters(g);
+    bk.clust = N_NEW(bk.nclust + 1, bkclust_t);
+    collect_clusters(&bk, g, -1, 0, 0);
+
+    nodeitem = N_NEW(GD_maxrank(g) - GD_minrank(g) + 1, int *);
+    build_items(&bk, g, nodeitem);
+    build_segments(&bk, g, nodeitem);
+    build_extras(&bk, g, nodeitem);
+    mark_conflicts(&bk);
+    mark_labels(&bk);
+
+    root = N_NEW(bk.n + 1, int);
+    align = N_NEW(bk.n + 1, int);
+    for (pass = 0; pass < 4; pass++) {
+	xs[pass] = N_NEW(bk.n + 1, int);
+	vertical_align(&bk, pass >> 1, pass & 1, root, align);
+	horizontal_compaction(&bk, pass & 1, root, xs[pass]);
+	minx[pass] = INT_MAX;
+	maxx[pass] = INT_MIN;
+	for (i = 0; i < bk.n; i++) {
+	    if (pass & 1)
+		xs[pass][i] = -xs[pass][i];
+	    minx[pass] = MIN(minx[pass], xs[pass][i]);
+	    maxx[pass] = MAX(maxx[pass], xs[pass][i]);
+	}
+    }
+
+    /* align to the narrowest layout, then take the average median */
+    best = 0;
+    for (pass = 1; pass < 4; pass++)
+	if (maxx[pass] - minx[pass] < maxx[best] - minx[best])
+	    best = pass;
+    for (pass = 0; pass < 4; pass++) {
+	if (pass & 1)
+	    shift = maxx[best] - maxx[pass];
+	else
+	    shift = minx[best] - minx[pass];
+	for (i = 0; i < bk.n; i++)
+	    xs[pass][i] += shift;
+    }
+    for (c = 0; c < bk.nclust; c++) {
+	ln = virtual_node(g);
+	ND_node_type(ln) = SLACKNODE;
+	rn = virtual_node(g);
+	ND_node_type(rn) = SLACKNODE;
+	ND_rank(ln) = INT_MAX;
+	ND_rank(rn) = INT_MIN;
+	GD_ln(bk.clust[c].g) = ln;
+	GD_rn(bk.clust[c].g) = rn;
+    }
+    for (i = 0; i < bk.n; i++) {
+	for (p = 0; p < 4; p++)
+	    vals[p] = xs[p][i];
+	qsort(vals, 4, sizeof(int), cmpint);
+	lo = vals[1];
+	hi = vals[2];
+	/* floor keeps the integer separations of all four layouts */
+	p = (lo + hi) >> 1;
+	if (bk.node[i])
+	    ND_rank(bk.node[i]) = p;
+	else if (bk.bnd[i] & 1) {
+	    rn = GD_rn(bk.clust[bk.bnd[i] / 2].g);
+	    ND_rank(rn) = MAX(ND_rank(rn), p);
+	} else {
+	    ln = GD_ln(bk.clust[bk.bnd[i] / 2].g);
+	    ND_rank(ln) = MIN(ND_rank(ln), p);
+	}
+    }
+    for (c = 0; c < bk.nclust; c++) {
+	ln = GD_ln(bk.clust[c].g);
+	rn = GD_rn(bk.clust[c].g);
+	if (ND_rank(ln) > ND_rank(rn))
+	    ND_rank(ln) = ND_rank(rn) = 0;
+    }
+
+    for (i = 0; i < bk.nlayer; i++)
+	free(nodeitem[i]);
+    free(nodeitem);
+    for (pass = 0; pass < 4; pass++)
+	free(xs[pass]);
+    free(root);
+    free(align);
+    free(bk.clust);
+    free(bk.layer);
+    free(bk.lay);
+    free(bk.node);
+    free(bk.bnd);
+    free(bk.gap);
+    free(bk.bup);
+    free(bk.bdn);
+    free(bk.clu);
+    free(bk.cld);
+    free(bk.upstart);
+    free(bk.dnstart);
+    free(bk.up);
+    free(bk.dn);
+    free(bk.mark);
+    free(bk.xl);
+    free(bk.xr);
+    free(bk.xd);
+}
@@ -26,6 +26,7 @@ extern "C" {
 
     extern void acyclic(Agraph_t *);
     extern void allocate_ranks(Agraph_t *);
+    extern void bk_xcoords(Agraph_t *);
     extern void build_ranks(Agraph_t *, int);
     extern void build_skeleton(Agraph_t *, Agraph_t *);
     extern void checkLabelOrder (graph_t* g);
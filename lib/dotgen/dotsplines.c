@@ -52,13 +52,18 @@
 }
 
 static boxf boxes[1000];
+#pragma omp threadprivate(boxes)
 typedef struct {
     int LeftBound, RightBound, Splinesep, Multisep;
     boxf* Rank_box;
 } spline_info_t;
 
+/* a group of equivalent edges, edges[ind .. ind+cnt-1] in the sorted list */
+typedef struct {
+    int ind, cnt;
+} edgegroup_t;
+
 static void adjustregularpath(path *, int, int);
-static Agedge_t *bot_bound(Agedge_t *, int);
 static boolean pathscross(Agnode_t *, Agnode_t *, Agedge_t *, Agedge_t *);
 static Agraph_t *cl_bound(graph_t*, Agnode_t *, Agnode_t *);
 static int cl_vninside(Agraph_t *, Agnode_t *);
@@ -67,6 +72,7 @@ static void completeregularpath(path *, Agedge_t *, Agedge_t *,
 static int edgecmp(Agedge_t **, Agedge_t **);
 static void make_flat_edge(graph_t*, spline_info_t*, path *, Agedge_t **, int, int, int);
 static void make_regular_edge(graph_t* g, spline_info_t*, path *, Agedge_t **, int, int, int);
+static void make_regular_edges(graph_t* g, spline_info_t*, path *, Agedge_t **, edgegroup_t*, int, int);
 static boxf makeregularend(boxf, int, double);
 static boxf maximal_bbox(graph_t* g, spline_info_t*, Agnode_t *, Agedge_t *, Agedge_t *);
 static Agnode_t *neighbor(graph_t*, Agnode_t *, Agedge_t *, Agedge_t *, int);
@@ -77,7 +83,6 @@ static void resize_vn(Agnode_t *, int, int, int);
 static void setflags(Agedge_t *, int, int, int);
 static int straight_len(Agnode_t *);
 static Agedge_t *straight_path(Agedge_t *, int, pointf *, int *);
-static Agedge_t *top_bound(Agedge_t *, int);
 
 #define GROWEDGES (edges = ALLOC (n_edges + CHUNK, edges, edge_t*))
 
@@ -252,12 +257,13 @@ setEdgeLabelPos (graph_t * g)
  */
 static void _dot_splines(graph_t * g, int normalize)
 {
-    int i, j, k, n_nodes, n_edges, ind, cnt;
+    int i, j, k, n_nodes, n_edges, ind, cnt, ngrp;
     node_t *n;
     Agedgeinfo_t fwdedgeai, fwdedgebi;
     Agedgepair_t fwdedgea, fwdedgeb;
     edge_t *e, *e0, *e1, *ea, *eb, *le0, *le1, **edges = NULL;
     path *P = NULL;
+    edgegroup_t *grps = NULL;
     spline_info_t sd;
     int et = EDGE_TYPE(g);
     fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
@@ -366,6 +372,14 @@ static void _dot_splines(graph_t * g, int normalize)
     /* FIXME: just how many boxes can there be? */
     P->boxes = N_NEW(n_nodes + 20 * 2 * NSUB, boxf);
     sd.Rank_box = N_NEW(i, boxf);
+    /* fill the rank box cache now, as regular edges are routed in parallel;
+     * rank -1, made by abomination for flat edge labels, has no box
+     */
+    for (i = MAX(GD_minrank(g), 0); i < GD_maxrank(g); i++)
+	if (GD_rank(g)[i].n && GD_rank(g)[i + 1].n)
+	    rank_box(&sd, g, i);
+    grps = N_NEW(n_edges, edgegroup_t);
+    ngrp = 0;
 
     if (et == ET_LINE) {
     /* place regular edge labels */
@@ -412,6 +426,21 @@ static void _dot_splines(graph_t * g, int normalize)
 		break;
 	}
 
+	/* Consecutive regular edges are routed as a batch by
+	 * make_regular_edges, before any edge that follows them:
+	 * flat edges read the virtual nodes the batch resizes.
+	 */
+	if ((et != ET_CURVED) && (agtail(e0) != aghead(e0))
+	    && (ND_rank(agtail(e0)) != ND_rank(aghead(e0)))) {
+	    grps[ngrp].ind = ind;
+	    grps[ngrp++].cnt = cnt;
+	    continue;
+	}
+	if (ngrp) {
+	    make_regular_edges(g, &sd, P, edges, grps, ngrp, et);
+	    ngrp = 0;
+	}
+
 	if (et == ET_CURVED) {
 	    int ii;
 	    edge_t* e0;
@@ -452,12 +481,11 @@ static void _dot_splines(graph_t * g, int normalize)
 		    updateBB(g, ED_label(e));
 	    }
 	}
-	else if (ND_rank(agtail(e0)) == ND_rank(aghead(e0))) {
-	    make_flat_edge(g, &sd, P, edges, ind, cnt, et);
-	}
 	else
-	    make_regular_edge(g, &sd, P, edges, ind, cnt, et);
+	    make_flat_edge(g, &sd, P, edges, ind, cnt, et);
     }
+    if (ngrp)
+	make_regular_edges(g, &sd, P, edges, grps, ngrp, et);
 
     /* place regular edge labels */
     for (n = GD_nlist(g); n; n = ND_next(n)) {
@@ -508,6 +536,7 @@ finish :
 	free(sd.Rank_box);
 	routesplinesterm();
     } 
+    free(grps);
     State = GVSPLINES;
     EdgeLabelsDone = 1;
 }
@@ -1722,6 +1751,149 @@ makeLineEdge(graph_t* g, edge_t* fe, pointf* points, node_t** hp)
     return pn;
 }
 
+/* regular_edge_nodes:
+ * Find the nodes make_regular_edge visits when routing the group
+ * starting with e. Nodes are numbered by their position in the rank
+ * arrays, offset by base[rank - GD_minrank(g)]. The virtual nodes of
+ * the path, which recover_slack resizes, are stored in wr; the
+ * neighbors whose coordinates and widths maximal_bbox reads along the
+ * path, in rd.
+ */
+static void
+regular_edge_nodes(graph_t* g, edge_t* e, int* base, int* rd, int* nrd,
+		   int* wr, int* nwr)
+{
+    Agedgepair_t fwdedge;
+    edge_t *ie, *oe, *le;
+    node_t *n, *v, *tn, *hn;
+    int dir;
+
+    if (ED_tree_index(e) & BWDEDGE)
+	tn = aghead(e), hn = agtail(e);
+    else
+	tn = agtail(e), hn = aghead(e);
+    if (ABS(ND_rank(tn) - ND_rank(hn)) > 1) {
+	le = getmainedge(e);
+	while (ED_to_virt(le))
+	    le = ED_to_virt(le);
+	hn = aghead(le);
+    }
+    fwdedge.out = *e;
+    fwdedge.in = *AGOUT2IN(e);
+    agtail(&fwdedge.out) = tn;
+    aghead(&fwdedge.out) = hn;
+
+    *nrd = *nwr = 0;
+    n = tn;
+    ie = NULL;
+    oe = &fwdedge.out;
+    while (1) {
+	for (dir = -1; dir <= 1; dir += 2)
+	    if ((v = neighbor(g, n, ie, oe, dir)))
+		rd[(*nrd)++] = base[ND_rank(v) - GD_minrank(g)] + ND_order(v);
+	if (!oe)
+	    break;
+	n = aghead(oe);
+	ie = oe;
+	if ((ND_node_type(n) == VIRTUAL) && !sinfo.splineMerge(n)) {
+	    wr[(*nwr)++] = base[ND_rank(n) - GD_minrank(g)] + ND_order(n);
+	    oe = ND_out(n).list[0];
+	} else
+	    oe = NULL;
+    }
+}
+
+/* make_regular_edges:
+ * Route the groups of regular edges grps[0..ngrp-1].
+ * A group reads the neighbors of the nodes on its path, and resizes its
+ * own virtual nodes after routing. Each group gets a level one more than
+ * any earlier group that writes a node it reads, or reads or writes one
+ * of its virtual nodes. The groups of a level are routed concurrently,
+ * and routing the levels in turn gives the same splines as routing the
+ * groups in list order.
+ * With concentrate=true, merged chains share virtual nodes and splines,
+ * so the groups are routed in order.
+ */
+static void
+make_regular_edges(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges,
+		   edgegroup_t* grps, int ngrp, int et)
+{
+    int i, k, r, lvl, nlvl, n_nodes, nranks, nrd, nwr;
+    int *base, *lastw, *lastr, *level, *start, *order, *rd, *wr;
+
+    if (Concentrate || (ngrp == 1)) {
+	for (k = 0; k < ngrp; k++)
+	    make_regular_edge(g, sp, P, edges, grps[k].ind, grps[k].cnt, et);
+	return;
+    }
+
+    nranks = GD_maxrank(g) - GD_minrank(g) + 1;
+    base = N_NEW(nranks, int);
+    n_nodes = 0;
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	base[r - GD_minrank(g)] = n_nodes;
+	n_nodes += GD_rank(g)[r].n;
+    }
+    lastw = N_NEW(n_nodes, int);
+    lastr = N_NEW(n_nodes, int);
+    rd = N_NEW(2 * (nranks + 1), int);
+    wr = N_NEW(nranks + 1, int);
+    level = N_NEW(ngrp, int);
+    nlvl = 0;
+    for (k = 0; k < ngrp; k++) {
+	regular_edge_nodes(g, edges[grps[k].ind], base, rd, &nrd, wr, &nwr);
+	lvl = 0;
+	for (i = 0; i < nrd; i++)
+	    lvl = MAX(lvl, lastw[rd[i]]);
+	for (i = 0; i < nwr; i++)
+	    lvl = MAX(lvl, MAX(lastw[wr[i]], lastr[wr[i]]));
+	level[k] = ++lvl;
+	nlvl = MAX(nlvl, lvl);
+	for (i = 0; i < nrd; i++)
+	    lastr[rd[i]] = MAX(lastr[rd[i]], lvl);
+	for (i = 0; i < nwr; i++)
+	    lastw[wr[i]] = lvl;
+    }
+
+    /* bucket the groups by level, keeping list order within a level;
+     * level l is then order[start[l-1] .. start[l]-1]
+     */
+    start = N_NEW(nlvl + 2, int);
+    order = N_NEW(ngrp, int);
+    for (k = 0; k < ngrp; k++)
+	start[level[k] + 1]++;
+    for (lvl = 1; lvl <= nlvl; lvl++)
+	start[lvl + 1] += start[lvl];
+    for (k = 0; k < ngrp; k++)
+	order[start[level[k]]++] = k;
+
+#pragma omp parallel
+    {
+	int l, j;
+	path *tp = NEW(path);
+
+	tp->boxes = N_NEW(n_nodes + 20 * 2 * NSUB, boxf);
+	for (l = 1; l <= nlvl; l++) {
+#pragma omp for schedule(dynamic)
+	    for (j = start[l - 1]; j < start[l]; j++)
+		make_regular_edge(g, sp, tp, edges, grps[order[j]].ind,
+				  grps[order[j]].cnt, et);
+	}
+	free(tp->boxes);
+	free(tp);
+	routesplinesthreadterm();
+    }
+
+    free(base);
+    free(lastw);
+    free(lastr);
+    free(rd);
+    free(wr);
+    free(level);
+    free(start);
+    free(order);
+}
+
 #define NUMPTS 2000
 
 /* make_regular_edge:
@@ -1741,6 +1913,7 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
     static pointf* pointfs2;
     static int numpts;
     static int numpts2;
+#pragma omp threadprivate(pointfs, pointfs2, numpts, numpts2)
     int pointn;
 
     fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
@@ -1948,37 +2121,8 @@ completeregularpath(path * P, edge_t * first, edge_t * last,
 		    pathend_t * tendp, pathend_t * hendp, boxf * boxes,
 		    int boxn, int flag)
 {
-    edge_t *uleft, *uright, *lleft, *lright;
     int i, fb, lb;
-    splines *spl;
-    pointf *pp;
-    int pn;
 
-    fb = lb = -1;
-    uleft = uright = NULL;
-    uleft = top_bound(first, -1), uright = top_bound(first, 1);
-    if (uleft) {
-	if (!(spl = getsplinepoints(uleft))) return;
-	pp = spl->list[0].list;
-       	pn = spl->list[0].size;
-    }
-    if (uright) {
-	if (!(spl = getsplinepoints(uright))) return;
-	pp = spl->list[0].list;
-       	pn = spl->list[0].size;
-    }
-    lleft = lright = NULL;
-    lleft = bot_bound(last, -1), lright = bot_bound(last, 1);
-    if (lleft) {
-	if (!(spl = getsplinepoints(lleft))) return;
-	pp = spl->list[spl->size - 1].list;
-       	pn = spl->list[spl->size - 1].size;
-    }
-    if (lright) {
-	if (!(spl = getsplinepoints(lright))) return;
-	pp = spl->list[spl->size - 1].list;
-       	pn = spl->list[spl->size - 1].size;
-    }
     for (i = 0; i < tendp->boxn; i++)
 	add_box(P, tendp->boxes[i]);
     fb = P->nbox + 1;
@@ -1992,6 +2136,8 @@ completeregularpath(path * P, edge_t * first, edge_t * last,
 #else
 void refineregularends(edge_t * left, edge_t * right, pathend_t * endp,
 		       int dir, boxf b, boxf * boxes, int *boxnp);
+static Agedge_t *top_bound(Agedge_t *, int);
+static Agedge_t *bot_bound(Agedge_t *, int);
 
 /* box subdivision is obsolete, I think... ek */
 static void
@@ -2315,6 +2461,7 @@ int lx, cx, rx;
     ND_lw(vn) = cx - lx, ND_rw(vn) = rx - cx;
 }
 
+#ifndef DONT_WANT_ANY_ENDPOINT_PATH_REFINEMENT
 /* side > 0 means right. side < 0 means left */
 static edge_t *top_bound(edge_t * e, int side)
 {
@@ -2359,6 +2506,7 @@ static edge_t *bot_bound(edge_t * e, int side)
     }
     return ans;
 }
+#endif
 
 /* common routines */
 
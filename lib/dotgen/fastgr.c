@@ -261,7 +261,10 @@ void flat_edge(graph_t * g, edge_t * e)
 {
     elist_append(e, ND_flat_out(agtail(e)));
     elist_append(e, ND_flat_in(aghead(e)));
-    GD_has_flat_edges(dot_root(g)) = GD_has_flat_edges(g) = TRUE;
+    /* only write when unset: dot_mincross sets the root's flag before
+     * its components, which may add flat edges concurrently, are ordered */
+    if (!GD_has_flat_edges(g))
+	GD_has_flat_edges(dot_root(g)) = GD_has_flat_edges(g) = TRUE;
 }
 
 void delete_flat_edge(edge_t * e)
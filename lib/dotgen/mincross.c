@@ -17,6 +17,8 @@
  * that avoids edge crossings.  clusters are expanded.
  * N.B. the rank structure is global (not allocated per cluster)
  * because mincross may compare nodes in different clusters.
+ * The connected components of the root are ordered concurrently,
+ * each in its own segment of the rank lists (see mccomp_t).
  */
 
 #include "dot.h"
@@ -35,7 +37,8 @@ static void flat_reorder(graph_t * g);
 static void flat_search(graph_t * g, node_t * v);
 static void init_mincross(graph_t * g);
 static void merge2(graph_t * g);
-static void init_mccomp(graph_t * g, int c);
+static struct mccomp_t *init_mccomps(graph_t * g);
+static void end_mccomps(graph_t * g, struct mccomp_t *comps);
 static void cleanup2(graph_t * g, int nc);
 static int mincross_clust(graph_t * par, graph_t * g, int);
 static int mincross(graph_t * g, int startpass, int endpass, int);
@@ -67,9 +70,30 @@ static double Convergence;
 static graph_t *Root;
 static int GlobalMinRank, GlobalMaxRank;
 static edge_t **TE_list;
-static int *TI_list;
 static boolean ReMincross;
 
+/* mccomp_t:
+ * Working state of the crossing minimization of one connected
+ * component of the root. The components share no nodes, so each
+ * is ordered in its own segment of the root's rank lists, with its
+ * own rank table and scratch space, and they can run in parallel.
+ * MC is the state of the component being ordered by this thread;
+ * outside of the component phase it is RootMC, whose rank table
+ * is GD_rank(Root).
+ */
+typedef struct mccomp_t {
+    rank_t *rank;		/* rank table of the component */
+    node_t *nlist;		/* fast nodes of the component */
+    int *ti_list;		/* scratch for medians */
+    int *tree, tsize;		/* scratch for rcross */
+} mccomp_t;
+
+static mccomp_t RootMC;
+static mccomp_t *MC;
+#pragma omp threadprivate(MC)
+
+#define RANKS(g)	((g) == Root ? MC->rank : GD_rank(g))
+
 #if DEBUG > 1
 static void indent(graph_t* g)
 {
@@ -333,13 +357,31 @@ void dot_mincross(graph_t * g, int doBalance)
 {
     int c, nc;
     char *s;
+    node_t *n;
+    mccomp_t *comps;
 
     init_mincross(g);
 
-    for (nc = c = 0; c < GD_comp(g).size; c++) {
-	init_mccomp(g, c);
+    /* while the components are ordered, flat_rev only adds flat edges
+     * to ranks that already have some; the root's flag is set now, so
+     * that flat_edge only reads it then
+     */
+    for (c = 0; (c < GD_comp(g).size) && !GD_has_flat_edges(g); c++)
+	for (n = GD_comp(g).list[c]; n; n = ND_next(n))
+	    if (ND_flat_out(n).size > 0) {
+		GD_has_flat_edges(g) = TRUE;
+		break;
+	    }
+
+    comps = init_mccomps(g);
+    nc = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:nc)
+    for (c = 0; c < GD_comp(g).size; c++) {
+	MC = comps + c;
 	nc += mincross(g, 0, 2, doBalance);
     }
+    MC = &RootMC;
+    end_mccomps(g, comps);
 
     merge2(g);
 
@@ -384,17 +426,70 @@ static void free_matrix(adjmatrix_t * p)
 
 #define ELT(M,i,j)		(M->data[((i)*M->ncols)+(j)])
 
-static void init_mccomp(graph_t * g, int c)
+/* init_mccomps:
+ * Set up the working state of the components of g, laying them out
+ * one after the other in the rank lists of g.
+ */
+static mccomp_t *init_mccomps(graph_t * g)
 {
-    int r;
+    int c, r, sz;
+    node_t *n;
+    mccomp_t *mc;
+    mccomp_t *comps = N_NEW(GD_comp(g).size, mccomp_t);
 
-    GD_nlist(g) = GD_comp(g).list[c];
-    if (c > 0) {
+    for (c = 0; c < GD_comp(g).size; c++) {
+	mc = comps + c;
+	mc->nlist = GD_comp(g).list[c];
+	mc->rank = N_NEW(GD_maxrank(g) + 2, rank_t);
+	memcpy(mc->rank, GD_rank(g), (GD_maxrank(g) + 2) * sizeof(rank_t));
+	for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
+	    mc->rank[r].n = 0;
+	sz = 0;
+	for (n = mc->nlist; n; n = ND_next(n)) {
+	    mc->rank[ND_rank(n)].n++;
+	    sz = MAX(sz, MAX(ND_in(n).size, ND_out(n).size));
+	}
 	for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	    GD_rank(g)[r].v = GD_rank(g)[r].v + GD_rank(g)[r].n;
-	    GD_rank(g)[r].n = 0;
+	    mc->rank[r].v = GD_rank(g)[r].v;
+	    GD_rank(g)[r].v += mc->rank[r].n;
 	}
+	mc->ti_list = N_NEW(sz + 1, int);
     }
+    return comps;
+}
+
+/* end_mccomps:
+ * Hand the state of the components back to g, as left by ordering
+ * them one at a time: the crossing counts of the last component, and
+ * for each rank, the flat edge matrix of the last component having
+ * flat edges on it. The others are freed.
+ */
+static void end_mccomps(graph_t * g, mccomp_t * comps)
+{
+    int c, r;
+    rank_t *rk;
+
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	for (c = 0; c < GD_comp(g).size; c++) {
+	    rk = comps[c].rank + r;
+	    if (rk->flat) {
+		free_matrix(GD_rank(g)[r].flat);
+		GD_rank(g)[r].flat = rk->flat;
+	    }
+	}
+	if (GD_comp(g).size == 0)
+	    continue;
+	rk = comps[GD_comp(g).size - 1].rank + r;
+	GD_rank(g)[r].candidate = rk->candidate;
+	GD_rank(g)[r].valid = rk->valid;
+	GD_rank(g)[r].cache_nc = rk->cache_nc;
+    }
+    for (c = 0; c < GD_comp(g).size; c++) {
+	free(comps[c].rank);
+	free(comps[c].ti_list);
+	free(comps[c].tree);
+    }
+    free(comps);
 }
 
 static int betweenclust(edge_t * e)
@@ -546,7 +641,7 @@ static int left2right(graph_t * g, node_t * v, node_t * w)
 	if ((ND_clust(v)) != (ND_clust(w)))
 	    return TRUE;
     }
-    M = GD_rank(g)[ND_rank(v)].flat;
+    M = RANKS(g)[ND_rank(v)].flat;
     if (M == NULL)
 	rv = FALSE;
     else {
@@ -555,7 +650,13 @@ static int left2right(graph_t * g, node_t * v, node_t * w)
 	    v = w;
 	    w = t;
 	}
-	rv = ELT(M, flatindex(v), flatindex(w));
+	/* in remincross, the root's matrix may have been left by another
+	 * component and be smaller than these indices
+	 */
+	if ((flatindex(v) >= M->nrows) || (flatindex(w) >= M->ncols))
+	    rv = FALSE;
+	else
+	    rv = ELT(M, flatindex(v), flatindex(w));
     }
     return rv;
 }
@@ -610,9 +711,9 @@ static void exchange(node_t * v, node_t * w)
     vi = ND_order(v);
     wi = ND_order(w);
     ND_order(v) = wi;
-    GD_rank(Root)[r].v[wi] = v;
+    MC->rank[r].v[wi] = v;
     ND_order(w) = vi;
-    GD_rank(Root)[r].v[vi] = w;
+    MC->rank[r].v[vi] = w;
 }
 
 static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
@@ -628,8 +729,8 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
 	return;
 
     /* count the number of dummy and original nodes */
-    for (i = 0; i < GD_rank(g)[r].n; i++) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == NORMAL)
+    for (i = 0; i < RANKS(g)[r].n; i++) {
+	if (ND_node_type(RANKS(g)[r].v[i]) == NORMAL)
 	    cntOri++;
 	else
 	    cntDummy++;
@@ -648,8 +749,8 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
     }
 
     /* get the separator node index */
-    for (i = 0; i < GD_rank(g)[r].n; i++) {
-	if (GD_rank(g)[r].v[i] == s)
+    for (i = 0; i < RANKS(g)[r].n; i++) {
+	if (RANKS(g)[r].v[i] == s)
 	    sepIndex = i;
     }
 
@@ -659,14 +760,14 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
      * right of the separator node 
      */
     for (i = sepIndex - 1; i >= 0; i--) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+	if (ND_node_type(RANKS(g)[r].v[i]) == nullType)
 	    k++;
 	else
 	    break;
     }
 
-    for (i = sepIndex + 1; i < GD_rank(g)[r].n; i++) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+    for (i = sepIndex + 1; i < RANKS(g)[r].n; i++) {
+	if (ND_node_type(RANKS(g)[r].v[i]) == nullType)
 	    m++;
 	else
 	    break;
@@ -677,8 +778,8 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
     exchange(v, w);
 
     /* get the separator node index */
-    for (i = 0; i < GD_rank(g)[r].n; i++) {
-	if (GD_rank(g)[r].v[i] == s)
+    for (i = 0; i < RANKS(g)[r].n; i++) {
+	if (RANKS(g)[r].v[i] == s)
 	    sepIndex = i;
     }
 
@@ -686,14 +787,14 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
      * right of the separator node 
      */
     for (i = sepIndex - 1; i >= 0; i--) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+	if (ND_node_type(RANKS(g)[r].v[i]) == nullType)
 	    k1++;
 	else
 	    break;
     }
 
-    for (i = sepIndex + 1; i < GD_rank(g)[r].n; i++) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+    for (i = sepIndex + 1; i < RANKS(g)[r].n; i++) {
+	if (ND_node_type(RANKS(g)[r].v[i]) == nullType)
 	    m1++;
 	else
 	    break;
@@ -714,10 +815,10 @@ static int balance(graph_t * g)
 
     for (r = GD_maxrank(g); r >= GD_minrank(g); r--) {
 
-	GD_rank(g)[r].candidate = FALSE;
-	for (i = 0; i < GD_rank(g)[r].n - 1; i++) {
-	    v = GD_rank(g)[r].v[i];
-	    w = GD_rank(g)[r].v[i + 1];
+	RANKS(g)[r].candidate = FALSE;
+	for (i = 0; i < RANKS(g)[r].n - 1; i++) {
+	    v = RANKS(g)[r].v[i];
+	    w = RANKS(g)[r].v[i + 1];
 	    assert(ND_order(v) < ND_order(w));
 	    if (left2right(g, v, w))
 		continue;
@@ -727,7 +828,7 @@ static int balance(graph_t * g)
 		c1 += in_cross(w, v);
 	    }
 
-	    if (GD_rank(g)[r + 1].n > 0) {
+	    if (RANKS(g)[r + 1].n > 0) {
 		c0 += out_cross(v, w);
 		c1 += out_cross(w, v);
 	    }
@@ -735,16 +836,16 @@ static int balance(graph_t * g)
 	    if ((c1 < c0) || ((c0 > 0) && reverse && (c1 == c0))) {
 		exchange(v, w);
 		rv += (c0 - c1);
-		GD_rank(Root)[r].valid = FALSE;
-		GD_rank(g)[r].candidate = TRUE;
+		MC->rank[r].valid = FALSE;
+		RANKS(g)[r].candidate = TRUE;
 
 		if (r > GD_minrank(g)) {
-		    GD_rank(Root)[r - 1].valid = FALSE;
-		    GD_rank(g)[r - 1].candidate = TRUE;
+		    MC->rank[r - 1].valid = FALSE;
+		    RANKS(g)[r - 1].candidate = TRUE;
 		}
 		if (r < GD_maxrank(g)) {
-		    GD_rank(Root)[r + 1].valid = FALSE;
-		    GD_rank(g)[r + 1].candidate = TRUE;
+		    MC->rank[r + 1].valid = FALSE;
+		    RANKS(g)[r + 1].candidate = TRUE;
 		}
 	    }
 #endif
@@ -763,10 +864,10 @@ static int transpose_step(graph_t * g, int r, int reverse)
     node_t *v, *w;
 
     rv = 0;
-    GD_rank(g)[r].candidate = FALSE;
-    for (i = 0; i < GD_rank(g)[r].n - 1; i++) {
-	v = GD_rank(g)[r].v[i];
-	w = GD_rank(g)[r].v[i + 1];
+    RANKS(g)[r].candidate = FALSE;
+    for (i = 0; i < RANKS(g)[r].n - 1; i++) {
+	v = RANKS(g)[r].v[i];
+	w = RANKS(g)[r].v[i + 1];
 	assert(ND_order(v) < ND_order(w));
 	if (left2right(g, v, w))
 	    continue;
@@ -775,23 +876,23 @@ static int transpose_step(graph_t * g, int r, int reverse)
 	    c0 += in_cross(v, w);
 	    c1 += in_cross(w, v);
 	}
-	if (GD_rank(g)[r + 1].n > 0) {
+	if (RANKS(g)[r + 1].n > 0) {
 	    c0 += out_cross(v, w);
 	    c1 += out_cross(w, v);
 	}
 	if ((c1 < c0) || ((c0 > 0) && reverse && (c1 == c0))) {
 	    exchange(v, w);
 	    rv += (c0 - c1);
-	    GD_rank(Root)[r].valid = FALSE;
-	    GD_rank(g)[r].candidate = TRUE;
+	    MC->rank[r].valid = FALSE;
+	    RANKS(g)[r].candidate = TRUE;
 
 	    if (r > GD_minrank(g)) {
-		GD_rank(Root)[r - 1].valid = FALSE;
-		GD_rank(g)[r - 1].candidate = TRUE;
+		MC->rank[r - 1].valid = FALSE;
+		RANKS(g)[r - 1].candidate = TRUE;
 	    }
 	    if (r < GD_maxrank(g)) {
-		GD_rank(Root)[r + 1].valid = FALSE;
-		GD_rank(g)[r + 1].candidate = TRUE;
+		MC->rank[r + 1].valid = FALSE;
+		RANKS(g)[r + 1].candidate = TRUE;
 	    }
 	}
     }
@@ -803,7 +904,7 @@ static void transpose(graph_t * g, int reverse)
     int r, delta;
 
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
-	GD_rank(g)[r].candidate = TRUE;
+	RANKS(g)[r].candidate = TRUE;
     do {
 	delta = 0;
 #ifdef NOTDEF
@@ -811,11 +912,11 @@ static void transpose(graph_t * g, int reverse)
 	   i tried making it depend on whether an odd or even pass, 
 	   but that didn't help. */
 	for (r = GD_maxrank(g); r >= GD_minrank(g); r--)
-	    if (GD_rank(g)[r].candidate)
+	    if (RANKS(g)[r].candidate)
 		delta += transpose_step(g, r, reverse);
 #endif
 	for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	    if (GD_rank(g)[r].candidate) {
+	    if (RANKS(g)[r].candidate) {
 		delta += transpose_step(g, r, reverse);
 	    }
 	}
@@ -896,14 +997,14 @@ static void restore_best(graph_t * g)
     /* for (n = GD_nlist(g); n; n = ND_next(n)) */
 	/* ND_order(n) = saveorder(n); */
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    n = GD_rank(g)[r].v[i];
+	for (i = 0; i < RANKS(g)[r].n; i++) {
+	    n = RANKS(g)[r].v[i];
 	    ND_order(n) = saveorder(n);
 	}
     }
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	GD_rank(Root)[r].valid = FALSE;
-	qsort(GD_rank(g)[r].v, GD_rank(g)[r].n, sizeof(GD_rank(g)[0].v[0]),
+	MC->rank[r].valid = FALSE;
+	qsort(RANKS(g)[r].v, RANKS(g)[r].n, sizeof(RANKS(g)[0].v[0]),
 	      (qsort_cmpf) nodeposcmpf);
     }
 }
@@ -915,8 +1016,8 @@ static void save_best(graph_t * g)
 	/* saveorder(n) = ND_order(n); */
     int i, r;
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    n = GD_rank(g)[r].v[i];
+	for (i = 0; i < RANKS(g)[r].n; i++) {
+	    n = RANKS(g)[r].v[i];
 	    saveorder(n) = ND_order(n);
 	}
     }
@@ -981,9 +1082,14 @@ static void cleanup2(graph_t * g, int nc)
     node_t *v;
     edge_t *e;
 
-    if (TI_list) {
-	free(TI_list);
-	TI_list = NULL;
+    if (RootMC.ti_list) {
+	free(RootMC.ti_list);
+	RootMC.ti_list = NULL;
+    }
+    if (RootMC.tree) {
+	free(RootMC.tree);
+	RootMC.tree = NULL;
+	RootMC.tsize = 0;
     }
     if (TE_list) {
 	free(TE_list);
@@ -1030,9 +1136,22 @@ assert((rv == 0) || (ND_order(rv)-ND_order(v))*dir > 0);
     return rv;
 }
 
+/* contains:
+ * agcontains, one thread at a time: the lookup reorganizes the
+ * dictionaries of g, and components are ordered concurrently.
+ */
+static int contains(graph_t * g, void *obj)
+{
+    int rv;
+
+#pragma omp critical (mincross_contains)
+    rv = agcontains(g, obj);
+    return rv;
+}
+
 static int is_a_normal_node_of(graph_t * g, node_t * v)
 {
-    return ((ND_node_type(v) == NORMAL) && agcontains(g, v));
+    return ((ND_node_type(v) == NORMAL) && contains(g, v));
 }
 
 static int is_a_vnode_of_an_edge_of(graph_t * g, node_t * v)
@@ -1042,7 +1161,7 @@ static int is_a_vnode_of_an_edge_of(graph_t * g, node_t * v)
 	edge_t *e = ND_out(v).list[0];
 	while (ED_edge_type(e) != NORMAL)
 	    e = ED_to_orig(e);
-	if (agcontains(g, e))
+	if (contains(g, e))
 	    return TRUE;
     }
     return FALSE;
@@ -1188,13 +1307,15 @@ static void init_mincross(graph_t * g)
        that efence complains about */
     size = agnedges(dot_root(g)) + 1;
     TE_list = N_NEW(size, edge_t *);
-    TI_list = N_NEW(size, int);
+    RootMC.ti_list = N_NEW(size, int);
+    MC = &RootMC;
     mincross_options(g);
     if (GD_flags(g) & NEW_RANK)
 	fillRanks (g);
     class2(g);
     decompose(g, 1);
     allocate_ranks(g);
+    RootMC.rank = GD_rank(g);
     ordered_edges(g);
     GlobalMinRank = GD_minrank(g);
     GlobalMaxRank = GD_maxrank(g);
@@ -1235,7 +1356,7 @@ static void flat_search(graph_t * g, node_t * v)
     int i;
     boolean hascl;
     edge_t *e;
-    adjmatrix_t *M = GD_rank(g)[ND_rank(v)].flat;
+    adjmatrix_t *M = RANKS(g)[ND_rank(v)].flat;
 
     ND_mark(v) = TRUE;
     ND_onstack(v) = TRUE;
@@ -1243,7 +1364,7 @@ static void flat_search(graph_t * g, node_t * v)
     if (ND_flat_out(v).list)
 	for (i = 0; (e = ND_flat_out(v).list[i]); i++) {
 	    if (hascl
-		&& NOT(agcontains(g, agtail(e)) && agcontains(g, aghead(e))))
+		&& NOT(contains(g, agtail(e)) && contains(g, aghead(e))))
 		continue;
 	    if (ED_weight(e) == 0)
 		continue;
@@ -1274,19 +1395,19 @@ static void flat_breakcycles(graph_t * g)
 
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
 	flat = 0;
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    v = GD_rank(g)[r].v[i];
+	for (i = 0; i < RANKS(g)[r].n; i++) {
+	    v = RANKS(g)[r].v[i];
 	    ND_mark(v) = ND_onstack(v) = FALSE;
 	    flatindex(v) = i;
 	    if ((ND_flat_out(v).size > 0) && (flat == 0)) {
-		GD_rank(g)[r].flat =
-		    new_matrix(GD_rank(g)[r].n, GD_rank(g)[r].n);
+		RANKS(g)[r].flat =
+		    new_matrix(RANKS(g)[r].n, RANKS(g)[r].n);
 		flat = 1;
 	    }
 	}
 	if (flat) {
-	    for (i = 0; i < GD_rank(g)[r].n; i++) {
-		v = GD_rank(g)[r].v[i];
+	    for (i = 0; i < RANKS(g)[r].n; i++) {
+		v = RANKS(g)[r].v[i];
 		if (ND_mark(v) == FALSE)
 		    flat_search(g, v);
 	    }
@@ -1333,30 +1454,30 @@ void install_in_rank(graph_t * g, node_t * n)
     int i, r;
 
     r = ND_rank(n);
-    i = GD_rank(g)[r].n;
-    if (GD_rank(g)[r].an <= 0) {
+    i = RANKS(g)[r].n;
+    if (RANKS(g)[r].an <= 0) {
 	agerr(AGERR, "install_in_rank, line %d: %s %s rank %d i = %d an = 0\n",
 	      __LINE__, agnameof(g), agnameof(n), r, i);
 	return;
     }
 
-    GD_rank(g)[r].v[i] = n;
+    RANKS(g)[r].v[i] = n;
     ND_order(n) = i;
-    GD_rank(g)[r].n++;
-    assert(GD_rank(g)[r].n <= GD_rank(g)[r].an);
+    RANKS(g)[r].n++;
+    assert(RANKS(g)[r].n <= RANKS(g)[r].an);
 #ifdef DEBUG
     {
 	node_t *v;
 
-	for (v = GD_nlist(g); v; v = ND_next(v))
+	for (v = (g == Root) ? MC->nlist : GD_nlist(g); v; v = ND_next(v))
 	    if (v == n)
 		break;
 	assert(v != NULL);
     }
 #endif
-    if (ND_order(n) > GD_rank(Root)[r].an) {
-	agerr(AGERR, "install_in_rank, line %d: ND_order(%s) [%d] > GD_rank(Root)[%d].an [%d]\n",
-	      __LINE__, agnameof(n), ND_order(n), r, GD_rank(Root)[r].an);
+    if (ND_order(n) > MC->rank[r].an) {
+	agerr(AGERR, "install_in_rank, line %d: ND_order(%s) [%d] > MC->rank[%d].an [%d]\n",
+	      __LINE__, agnameof(n), ND_order(n), r, MC->rank[r].an);
 	return;
     }
     if ((r < GD_minrank(g)) || (r > GD_maxrank(g))) {
@@ -1364,10 +1485,10 @@ void install_in_rank(graph_t * g, node_t * n)
 	      __LINE__, r, GD_minrank(g), GD_maxrank(g));
 	return;
     }
-    if (GD_rank(g)[r].v + ND_order(n) >
-	GD_rank(g)[r].av + GD_rank(Root)[r].an) {
-	agerr(AGERR, "install_in_rank, line %d: GD_rank(g)[%d].v + ND_order(%s) [%d] > GD_rank(g)[%d].av + GD_rank(Root)[%d].an [%d]\n",
-	      __LINE__, r, agnameof(n),GD_rank(g)[r].v + ND_order(n), r, r, GD_rank(g)[r].av+GD_rank(Root)[r].an);
+    if (RANKS(g)[r].v + ND_order(n) >
+	RANKS(g)[r].av + MC->rank[r].an) {
+	agerr(AGERR, "install_in_rank, line %d: RANKS(g)[%d].v + ND_order(%s) [%d] > RANKS(g)[%d].av + MC->rank[%d].an [%d]\n",
+	      __LINE__, r, agnameof(n),RANKS(g)[r].v + ND_order(n), r, r, RANKS(g)[r].av+MC->rank[r].an);
 	return;
     }
 }
@@ -1379,18 +1500,19 @@ void install_in_rank(graph_t * g, node_t * n)
 void build_ranks(graph_t * g, int pass)
 {
     int i, j;
-    node_t *n, *n0;
+    node_t *n, *n0, *nlist;
     edge_t **otheredges;
     nodequeue *q;
 
     q = new_queue(GD_n_nodes(g));
-    for (n = GD_nlist(g); n; n = ND_next(n))
+    nlist = (g == Root) ? MC->nlist : GD_nlist(g);
+    for (n = nlist; n; n = ND_next(n))
 	MARK(n) = FALSE;
 
 #ifdef DEBUG
     {
 	edge_t *e;
-	for (n = GD_nlist(g); n; n = ND_next(n)) {
+	for (n = nlist; n; n = ND_next(n)) {
 	    for (i = 0; (e = ND_out(n).list[i]); i++)
 		assert(MARK(aghead(e)) == FALSE);
 	    for (i = 0; (e = ND_in(n).list[i]); i++)
@@ -1400,9 +1522,9 @@ void build_ranks(graph_t * g, int pass)
 #endif
 
     for (i = GD_minrank(g); i <= GD_maxrank(g); i++)
-	GD_rank(g)[i].n = 0;
+	RANKS(g)[i].n = 0;
 
-    for (n = GD_nlist(g); n; n = ND_next(n)) {
+    for (n = nlist; n; n = ND_next(n)) {
 	otheredges = ((pass == 0) ? ND_in(n).list : ND_out(n).list);
 	if (otheredges[0] != NULL)
 	    continue;
@@ -1422,11 +1544,11 @@ void build_ranks(graph_t * g, int pass)
     if (dequeue(q))
 	agerr(AGERR, "surprise\n");
     for (i = GD_minrank(g); i <= GD_maxrank(g); i++) {
-	GD_rank(Root)[i].valid = FALSE;
-	if (GD_flip(g) && (GD_rank(g)[i].n > 0)) {
+	MC->rank[i].valid = FALSE;
+	if (GD_flip(g) && (RANKS(g)[i].n > 0)) {
 	    int n, ndiv2;
-	    node_t **vlist = GD_rank(g)[i].v;
-	    n = GD_rank(g)[i].n - 1;
+	    node_t **vlist = RANKS(g)[i].v;
+	    n = RANKS(g)[i].n - 1;
 	    ndiv2 = n / 2;
 	    for (j = 0; j <= ndiv2; j++)
 		exchange(vlist[j], vlist[n - j]);
@@ -1502,17 +1624,17 @@ static void flat_reorder(graph_t * g)
     if (GD_has_flat_edges(g) == FALSE)
 	return;
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	if (GD_rank(g)[r].n == 0) continue;
-	base_order = ND_order(GD_rank(g)[r].v[0]);
-	for (i = 0; i < GD_rank(g)[r].n; i++)
-	    MARK(GD_rank(g)[r].v[i]) = FALSE;
+	if (RANKS(g)[r].n == 0) continue;
+	base_order = ND_order(RANKS(g)[r].v[0]);
+	for (i = 0; i < RANKS(g)[r].n; i++)
+	    MARK(RANKS(g)[r].v[i]) = FALSE;
 	temprank = ALLOC(i + 1, temprank, node_t *);
 	pos = 0;
 
 	/* construct reverse topological sort order in temprank */
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    if (GD_flip(g)) v = GD_rank(g)[r].v[i];
-	    else v = GD_rank(g)[r].v[GD_rank(g)[r].n - i - 1];
+	for (i = 0; i < RANKS(g)[r].n; i++) {
+	    if (GD_flip(g)) v = RANKS(g)[r].v[i];
+	    else v = RANKS(g)[r].v[RANKS(g)[r].n - i - 1];
 
 	    local_in_cnt = local_out_cnt = 0;
 	    for (j = 0; j < ND_flat_in(v).size; j++) {
@@ -1546,14 +1668,14 @@ static void flat_reorder(graph_t * g)
 		    right--;
 		}
 	    }
-	    for (i = 0; i < GD_rank(g)[r].n; i++) {
-		v = GD_rank(g)[r].v[i] = temprank[i];
+	    for (i = 0; i < RANKS(g)[r].n; i++) {
+		v = RANKS(g)[r].v[i] = temprank[i];
 		ND_order(v) = i + base_order;
 	    }
 
 	    /* nonconstraint flat edges must be made LR */
-	    for (i = 0; i < GD_rank(g)[r].n; i++) {
-		v = GD_rank(g)[r].v[i];
+	    for (i = 0; i < RANKS(g)[r].n; i++) {
+		v = RANKS(g)[r].v[i];
 		if (ND_flat_out(v).list) {
 		    for (j = 0; (e = ND_flat_out(v).list[j]); j++) {
 			if ( ((GD_flip(g) == FALSE) && (ND_order(aghead(e)) < ND_order(agtail(e)))) ||
@@ -1569,7 +1691,7 @@ static void flat_reorder(graph_t * g)
 	    /* postprocess to restore intended order */
 	}
 	/* else do no harm! */
-	GD_rank(Root)[r].valid = FALSE;
+	MC->rank[r].valid = FALSE;
     }
     if (temprank)
 	free(temprank);
@@ -1579,10 +1701,10 @@ static void reorder(graph_t * g, int r, int reverse, int hasfixed)
 {
     int changed = 0, nelt;
     boolean muststay, sawclust;
-    node_t **vlist = GD_rank(g)[r].v;
-    node_t **lp, **rp, **ep = vlist + GD_rank(g)[r].n;
+    node_t **vlist = RANKS(g)[r].v;
+    node_t **lp, **rp, **ep = vlist + RANKS(g)[r].n;
 
-    for (nelt = GD_rank(g)[r].n - 1; nelt >= 0; nelt--) {
+    for (nelt = RANKS(g)[r].n - 1; nelt >= 0; nelt--) {
 	lp = vlist;
 	while (lp < ep) {
 	    /* find leftmost node that can be compared */
@@ -1621,9 +1743,9 @@ static void reorder(graph_t * g, int r, int reverse, int hasfixed)
     }
 
     if (changed) {
-	GD_rank(Root)[r].valid = FALSE;
+	MC->rank[r].valid = FALSE;
 	if (r > 0)
-	    GD_rank(Root)[r - 1].valid = FALSE;
+	    MC->rank[r - 1].valid = FALSE;
     }
 }
 
@@ -1694,44 +1816,52 @@ static int local_cross(elist l, int dir)
 
 static int rcross(graph_t * g, int r)
 {
-    static int *Count, C;
-    int top, bot, cross, max, i, k;
+    int *Tree;
+    int top, bot, cross, total, n, i, k, s;
     node_t **rtop, *v;
 
     cross = 0;
-    max = 0;
-    rtop = GD_rank(g)[r].v;
+    total = 0;
+    rtop = RANKS(g)[r].v;
+    n = RANKS(g)[r + 1].n;
 
-    if (C <= GD_rank(Root)[r + 1].n) {
-	C = GD_rank(Root)[r + 1].n + 1;
-	Count = ALLOC(C, Count, int);
+    if (MC->tsize <= n) {
+	MC->tsize = n + 1;
+	MC->tree = ALLOC(MC->tsize, MC->tree, int);
     }
+    Tree = MC->tree;
 
-    for (i = 0; i < GD_rank(g)[r + 1].n; i++)
-	Count[i] = 0;
+    for (i = 0; i <= n; i++)
+	Tree[i] = 0;
 
-    for (top = 0; top < GD_rank(g)[r].n; top++) {
+    /* Tree is a Fenwick tree, indexed by order + 1 in rank r+1, of the
+     * weights of the edges out of rtop[0..top-1]. An edge crosses those
+     * of them ending right of its head, which weigh total minus the
+     * prefix sum up to its head.
+     */
+    for (top = 0; top < RANKS(g)[r].n; top++) {
 	register edge_t *e;
-	if (max > 0) {
+	if (total > 0) {
 	    for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
-		for (k = ND_order(aghead(e)) + 1; k <= max; k++)
-		    cross += Count[k] * ED_xpenalty(e);
+		s = 0;
+		for (k = ND_order(aghead(e)) + 1; k > 0; k -= k & -k)
+		    s += Tree[k];
+		cross += (total - s) * ED_xpenalty(e);
 	    }
 	}
 	for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
-	    register int inv = ND_order(aghead(e));
-	    if (inv > max)
-		max = inv;
-	    Count[inv] += ED_xpenalty(e);
+	    for (k = ND_order(aghead(e)) + 1; k <= n; k += k & -k)
+		Tree[k] += ED_xpenalty(e);
+	    total += ED_xpenalty(e);
 	}
     }
-    for (top = 0; top < GD_rank(g)[r].n; top++) {
-	v = GD_rank(g)[r].v[top];
+    for (top = 0; top < RANKS(g)[r].n; top++) {
+	v = RANKS(g)[r].v[top];
 	if (ND_has_port(v))
 	    cross += local_cross(ND_out(v), 1);
     }
-    for (bot = 0; bot < GD_rank(g)[r + 1].n; bot++) {
-	v = GD_rank(g)[r + 1].v[bot];
+    for (bot = 0; bot < RANKS(g)[r + 1].n; bot++) {
+	v = RANKS(g)[r + 1].v[bot];
 	if (ND_has_port(v))
 	    cross += local_cross(ND_in(v), -1);
     }
@@ -1745,12 +1875,12 @@ int ncross(graph_t * g)
     g = Root;
     count = 0;
     for (r = GD_minrank(g); r < GD_maxrank(g); r++) {
-	if (GD_rank(g)[r].valid)
-	    count += GD_rank(g)[r].cache_nc;
+	if (RANKS(g)[r].valid)
+	    count += RANKS(g)[r].cache_nc;
 	else {
-	    nc = GD_rank(g)[r].cache_nc = rcross(g, r);
+	    nc = RANKS(g)[r].cache_nc = rcross(g, r);
 	    count += nc;
-	    GD_rank(g)[r].valid = TRUE;
+	    RANKS(g)[r].valid = TRUE;
 	}
     }
     return count;
@@ -1810,9 +1940,9 @@ static boolean medians(graph_t * g, int r0, int r1)
     edge_t *e;
     boolean hasfixed = FALSE;
 
-    list = TI_list;
-    v = GD_rank(g)[r0].v;
-    for (i = 0; i < GD_rank(g)[r0].n; i++) {
+    list = MC->ti_list;
+    v = RANKS(g)[r0].v;
+    for (i = 0; i < RANKS(g)[r0].n; i++) {
 	n = v[i];
 	j = 0;
 	if (r1 > r0)
@@ -1853,7 +1983,7 @@ static boolean medians(graph_t * g, int r0, int r1)
 	    }
 	}
     }
-    for (i = 0; i < GD_rank(g)[r0].n; i++) {
+    for (i = 0; i < RANKS(g)[r0].n; i++) {
 	n = v[i];
 	if ((ND_out(n).size == 0) && (ND_in(n).size == 0))
 	    hasfixed |= flat_mval(n);
@@ -24,6 +24,9 @@
 #include "aspect.h"
 
 static int nsiter2(graph_t * g);
+static boolean use_bk(graph_t * g);
+static void allocate_aux_edges(graph_t * g);
+static void self_space(graph_t * g);
 static void create_aux_edges(graph_t * g);
 static void remove_aux_edges(graph_t * g);
 static void set_xcoords(graph_t * g);
@@ -128,10 +131,16 @@ void dot_position(graph_t * g, aspect_t* asp)
     expand_leaves(g);
     if (flat_edges(g))
 	set_ycoords(g);
-    create_aux_edges(g);
-    if (rank(g, 2, nsiter2(g))) { /* LR balance == 2 */
-	connectGraph (g);
-	assert(rank(g, 2, nsiter2(g)) == 0);
+    if (use_bk(g)) {
+	allocate_aux_edges(g);
+	self_space(g);
+	bk_xcoords(g);
+    } else {
+	create_aux_edges(g);
+	if (rank(g, 2, nsiter2(g))) { /* LR balance == 2 */
+	    connectGraph (g);
+	    assert(rank(g, 2, nsiter2(g)) == 0);
+	}
     }
     set_xcoords(g);
     set_aspect(g, asp);
@@ -140,6 +149,17 @@ void dot_position(graph_t * g, aspect_t* asp)
 				 */
 }
 
+/* use_bk:
+ * Return true if xcoord=bk asks for Brandes-Koepf x coordinates
+ * instead of network simplex.
+ */
+static boolean use_bk(graph_t * g)
+{
+    char *s = agget(g, "xcoord");
+
+    return (s && streq(s, "bk"));
+}
+
 static int nsiter2(graph_t * g)
 {
     int maxiter = INT_MAX;
@@ -206,13 +226,55 @@ static void allocate_aux_edges(graph_t * g)
     }
 }
 
+/* add_self_space:
+ * Keep ND_rw(u) in ND_mval(u) and widen u on the right to make room
+ * for its self loops.
+ */
+static void add_self_space(node_t * u)
+{
+    int k, sw;
+    edge_t *e;
+
+    ND_mval(u) = ND_rw(u);	/* keep it somewhere safe */
+    if (ND_other(u).size > 0) {	/* compute self size */
+	/* FIX: dot assumes all self-edges go to the right. This
+	 * is no longer true, though makeSelfEdge still attempts to
+	 * put as many as reasonable on the right. The dot code
+	 * should be modified to allow a box reflecting the placement
+	 * of all self-edges, and use that to reposition the nodes.
+	 * Note that this would not only affect left and right
+	 * positioning but may also affect interrank spacing.
+	 */
+	sw = 0;
+	for (k = 0; (e = ND_other(u).list[k]); k++) {
+	    if (agtail(e) == aghead(e)) {
+		sw += selfRightSpace (e);
+	    }
+	}
+	ND_rw(u) += sw;	/* increment to include self edges */
+    }
+}
+
+/* self_space:
+ * Apply add_self_space to every node; make_LR_constraints does this
+ * for network simplex.
+ */
+static void self_space(graph_t * g)
+{
+    int i, j;
+    rank_t *rank = GD_rank(g);
+
+    for (i = GD_minrank(g); i <= GD_maxrank(g); i++)
+	for (j = 0; j < rank[i].n; j++)
+	    add_self_space(rank[i].v[j]);
+}
+
 /* make_LR_constraints:
  */
 static void 
 make_LR_constraints(graph_t * g)
 {
     int i, j, k;
-    int sw;			/* self width */
     int m0, m1;
     double width;
     int sep[2];
@@ -236,24 +298,7 @@ make_LR_constraints(graph_t * g)
 	nodesep = sep[i & 1];
 	for (j = 0; j < rank[i].n; j++) {
 	    u = rank[i].v[j];
-	    ND_mval(u) = ND_rw(u);	/* keep it somewhere safe */
-	    if (ND_other(u).size > 0) {	/* compute self size */
-		/* FIX: dot assumes all self-edges go to the right. This
-                 * is no longer true, though makeSelfEdge still attempts to
-                 * put as many as reasonable on the right. The dot code
-                 * should be modified to allow a box reflecting the placement
-                 * of all self-edges, and use that to reposition the nodes.
-                 * Note that this would not only affect left and right
-                 * positioning but may also affect interrank spacing.
-                 */
-		sw = 0;
-		for (k = 0; (e = ND_other(u).list[k]); k++) {
-		    if (agtail(e) == aghead(e)) {
-			sw += selfRightSpace (e);
-		    }
-		}
-		ND_rw(u) += sw;	/* increment to include self edges */
-	    }
+	    add_self_space(u);
 	    v = rank[i].v[j + 1];
 	    if (v) {
 		width = ND_rw(u) + ND_lw(v) + nodesep;
@@ -20,6 +20,7 @@
 #include "config.h"
 #endif
 
+#include <stdio.h>
 #include "const.h"
 #include "gvplugin_layout.h"
 #include "gvcint.h"
@@ -31,6 +32,7 @@ extern void graph_init(Agraph_t *g, boolean use_rankdir);
 extern void graph_cleanup(Agraph_t *g);
 extern void gv_fixLocale (int set);
 extern void gv_initShapes (void);
+extern double clock_sec(void);
 
 int gvlayout_select(GVC_t * gvc, const char *layout)
 {
@@ -59,6 +61,7 @@ int gvLayoutJobs(GVC_t * gvc, Agraph_t * g)
     gvlayout_engine_t *gvle;
     char *p;
     int rc;
+    double start = clock_sec();  /* the engines use start_timer() themselves */
 
     agbindrec(g, "Agraphinfo_t", sizeof(Agraphinfo_t), TRUE);
     GD_gvc(g) = gvc;
@@ -91,6 +94,9 @@ int gvLayoutJobs(GVC_t * gvc, Agraph_t * g)
 	    GD_cleanup(g) = gvle->cleanup;
     }
     gv_fixLocale (0);
+    if (gvc->common.verbose)
+	fprintf(stderr, "gvLayoutJobs %s: %.2f secs.\n", agnameof(g),
+		clock_sec() - start);
     return 0;
 }
 
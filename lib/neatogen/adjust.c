@@ -27,7 +27,7 @@
 #include "heap.h"
 #include "hedges.h"
 #include "digcola.h"
-#if ((defined(HAVE_GTS) || defined(HAVE_TRIANGLE)) && defined(SFDP))
+#ifdef SFDP
 #include "overlap.h"
 #endif
 #ifdef IPSEPCOLA
@@ -37,9 +37,9 @@
 
 #define SEPFACT         0.8  /* default esep/sep */
 
-static double margin = 0.05;	/* Create initial bounding box by adding
+#define MARGIN 0.05	/* Create initial bounding box by adding
 				 * margin * dimension around box enclosing
-				 * nodes.
+				 * nodes, unless voro_margin is set.
 				 */
 static double incr = 0.05;	/* Increase bounding box by adding
 				 * incr * dimension around box.
@@ -47,40 +47,32 @@ static double incr = 0.05;	/* Increase bounding box by adding
 static int iterations = -1;	/* Number of iterations */
 static int useIter = 0;		/* Use specified number of iterations */
 
-static int doAll = 0;		/* Move all nodes, regardless of overlap */
-static Site **sites;		/* Array of pointers to sites; used in qsort */
-static Site **endSite;		/* Sentinel on sites array */
-static Point nw, ne, sw, se;	/* Corners of clipping window */
-
-static Site **nextSite;
-
-static void setBoundBox(Point * ll, Point * ur)
+static void setBoundBox(Voronoi_t * vp, Point * ll, Point * ur)
 {
-    pxmin = ll->x;
-    pxmax = ur->x;
-    pymin = ll->y;
-    pymax = ur->y;
-    nw.x = sw.x = pxmin;
-    ne.x = se.x = pxmax;
-    nw.y = ne.y = pymax;
-    sw.y = se.y = pymin;
+    vp->pxmin = ll->x;
+    vp->pxmax = ur->x;
+    vp->pymin = ll->y;
+    vp->pymax = ur->y;
 }
 
  /* freeNodes:
   * Free node resources.
   */
-static void freeNodes(void)
+static void freeNodes(Voronoi_t * vp)
 {
     int i;
-    Info_t *ip = nodeInfo;
+    Info_t *ip = vp->nodeInfo;
 
-    for (i = 0; i < nsites; i++) {
-	breakPoly(&ip->poly);
-	ip++;
+    if (ip) {
+	for (i = 0; i < vp->nsites; i++) {
+	    breakPoly(&ip->poly);
+	    ip++;
+	}
     }
-    polyFree();
-    infoinit();			/* Free vertices */
-    free(nodeInfo);
+    free(vp->nodeInfo);
+    free(vp->sites);
+    free(vp->byx);
+    vorcleanup(vp);
 }
 
 /* chkBoundBox:
@@ -91,7 +83,7 @@ static void freeNodes(void)
  *   graph extremes.
  *   In the first two cases, check that graph fits in bounding box.
  */
-static void chkBoundBox(Agraph_t * graph)
+static void chkBoundBox(Voronoi_t * vp, Agraph_t * graph)
 {
     char *marg;
     Point ll, ur;
@@ -100,11 +92,12 @@ static void chkBoundBox(Agraph_t * graph)
     double xmin, xmax, ymin, ymax;
     double xmn, xmx, ymn, ymx;
     double ydelta, xdelta;
+    double margin = MARGIN;
     Info_t *ip;
     Poly *pp;
     /* int          cnt; */
 
-    ip = nodeInfo;
+    ip = vp->nodeInfo;
     pp = &ip->poly;
     x = ip->site.coord.x;
     y = ip->site.coord.y;
@@ -112,7 +105,7 @@ static void chkBoundBox(Agraph_t * graph)
     ymin = pp->origin.y + y;
     xmax = pp->corner.x + x;
     ymax = pp->corner.y + y;
-    for (i = 1; i < nsites; i++) {
+    for (i = 1; i < vp->nsites; i++) {
 	ip++;
 	pp = &ip->poly;
 	x = ip->site.coord.x;
@@ -142,13 +135,13 @@ static void chkBoundBox(Agraph_t * graph)
     ur.x = xmax + xdelta;
     ur.y = ymax + ydelta;
 
-    setBoundBox(&ll, &ur);
+    setBoundBox(vp, &ll, &ur);
 }
 
  /* makeInfo:
   * For each node in the graph, create a Info data structure 
   */
-static int makeInfo(Agraph_t * graph)
+static int makeInfo(Voronoi_t * vp, Agraph_t * graph)
 {
     Agnode_t *node;
     int i;
@@ -156,13 +149,12 @@ static int makeInfo(Agraph_t * graph)
     expand_t pmargin;
     int (*polyf)(Poly *, Agnode_t *, float, float);
 
-    nsites = agnnodes(graph);
-    geominit();
+    vorinit(vp, agnnodes(graph));
 
-    nodeInfo = N_GNEW(nsites, Info_t);
+    vp->nodeInfo = N_GNEW(vp->nsites, Info_t);
 
     node = agfstnode(graph);
-    ip = nodeInfo;
+    ip = vp->nodeInfo;
 
     pmargin = sepFactor (graph);
 
@@ -174,13 +166,15 @@ static int makeInfo(Agraph_t * graph)
     }
 	
     else polyf = makePoly;
-    for (i = 0; i < nsites; i++) {
+    for (i = 0; i < vp->nsites; i++) {
 	ip->site.coord.x = ND_pos(node)[0];
 	ip->site.coord.y = ND_pos(node)[1];
 
 	if (polyf(&ip->poly, node, pmargin.x, pmargin.y)) {
-	    free (nodeInfo);
-	    nodeInfo = NULL;
+	    while (ip-- > vp->nodeInfo)
+		breakPoly(&ip->poly);
+	    free (vp->nodeInfo);
+	    vp->nodeInfo = NULL;
 	    return 1;
         }
 
@@ -215,63 +209,66 @@ static int scomp(const void *S1, const void *S2)
  /* sortSites:
   * Fill array of pointer to sites and sort the sites using scomp
   */
-static void sortSites(void)
+static void sortSites(Voronoi_t * vp)
 {
     int i;
     Site **sp;
     Info_t *ip;
 
-    if (sites == 0) {
-	sites = N_GNEW(nsites, Site *);
-	endSite = sites + nsites;
+    if (vp->sites == 0) {
+	vp->sites = N_GNEW(vp->nsites, Site *);
+	vp->endSite = vp->sites + vp->nsites;
     }
 
-    sp = sites;
-    ip = nodeInfo;
-    infoinit();
-    for (i = 0; i < nsites; i++) {
+    sp = vp->sites;
+    ip = vp->nodeInfo;
+    infoinit(vp);
+    for (i = 0; i < vp->nsites; i++) {
 	*sp++ = &(ip->site);
 	ip->verts = NULL;
 	ip->site.refcnt = 1;
 	ip++;
     }
 
-    qsort(sites, nsites, sizeof(Site *), scomp);
+    qsort(vp->sites, vp->nsites, sizeof(Site *), scomp);
 
     /* Reset site index for nextOne */
-    nextSite = sites;
+    vp->nextSite = vp->sites;
 
 }
 
-static void geomUpdate(int doSort)
+static void geomUpdate(Voronoi_t * vp, int doSort)
 {
     int i;
+    Site **sites;
+    int nsites = vp->nsites;
 
     if (doSort)
-	sortSites();
+	sortSites(vp);
+    sites = vp->sites;
 
     /* compute ranges */
-    xmin = sites[0]->coord.x;
-    xmax = sites[0]->coord.x;
+    vp->xmin = sites[0]->coord.x;
+    vp->xmax = sites[0]->coord.x;
     for (i = 1; i < nsites; i++) {
-	if (sites[i]->coord.x < xmin)
-	    xmin = sites[i]->coord.x;
-	if (sites[i]->coord.x > xmax)
-	    xmax = sites[i]->coord.x;
+	if (sites[i]->coord.x < vp->xmin)
+	    vp->xmin = sites[i]->coord.x;
+	if (sites[i]->coord.x > vp->xmax)
+	    vp->xmax = sites[i]->coord.x;
     }
-    ymin = sites[0]->coord.y;
-    ymax = sites[nsites - 1]->coord.y;
+    vp->ymin = sites[0]->coord.y;
+    vp->ymax = sites[nsites - 1]->coord.y;
 
-    deltay = ymax - ymin;
-    deltax = xmax - xmin;
+    vp->deltay = vp->ymax - vp->ymin;
+    vp->deltax = vp->xmax - vp->xmin;
 }
 
-static Site *nextOne(void)
+static Site *nextOne(Voronoi_t * vp)
 {
     Site *s;
 
-    if (nextSite < endSite) {
-	s = *nextSite++;
+    if (vp->nextSite < vp->endSite) {
+	s = *vp->nextSite++;
 	return (s);
     } else
 	return ((Site *) NULL);
@@ -281,16 +278,18 @@ static Site *nextOne(void)
  * Check for nodes with identical positions and tweak
  * the positions.
  */
-static void rmEquality(void)
+static void rmEquality(Voronoi_t * vp)
 {
     int i, cnt;
     Site **ip;
     Site **jp;
     Site **kp;
+    Site **endSite;
     double xdel;
 
-    sortSites();
-    ip = sites;
+    sortSites(vp);
+    ip = vp->sites;
+    endSite = vp->endSite;
 
     while (ip < endSite) {
 	jp = ip + 1;
@@ -323,9 +322,9 @@ static void rmEquality(void)
 	} else {		/* nothing is to the right */
 	    Info_t *info;
 	    for (jp = ip + 1; jp < kp; ip++, jp++) {
-		info = nodeInfo + (*ip)->sitenbr;
+		info = vp->nodeInfo + (*ip)->sitenbr;
 		xdel = info->poly.corner.x - info->poly.origin.x;
-		info = nodeInfo + (*jp)->sitenbr;
+		info = vp->nodeInfo + (*jp)->sitenbr;
 		xdel += info->poly.corner.x - info->poly.origin.x;
 		(*jp)->coord.x = (*ip)->coord.x + xdel / 2;
 	    }
@@ -334,31 +333,70 @@ static void rmEquality(void)
     }
 }
 
+/* xcomp:
+ * Order nodes by the left side of their bounding boxes,
+ * then by index.
+ */
+static int xcomp(const void *I1, const void *I2)
+{
+    Info_t *i1 = *(Info_t **) I1;
+    Info_t *i2 = *(Info_t **) I2;
+    double x1 = i1->site.coord.x + i1->poly.origin.x;
+    double x2 = i2->site.coord.x + i2->poly.origin.x;
+
+    if (x1 < x2)
+	return (-1);
+    if (x1 > x2)
+	return (1);
+    return (i1->site.sitenbr - i2->site.sitenbr);
+}
+
 /* countOverlap:
  * Count number of node-node overlaps at iteration iter.
+ * Nodes are swept left to right by bounding box, so only pairs
+ * whose boxes meet in x are tested with polyOverlap; this gives
+ * the same count as testing all pairs.
  */
-static int countOverlap(int iter)
+static int countOverlap(Voronoi_t * vp, int iter)
 {
     int count = 0;
     int i, j;
-    Info_t *ip = nodeInfo;
+    int nsites = vp->nsites;
+    Info_t **byx;
+    Info_t *ip;
     Info_t *jp;
+    double right, top, bottom;
 
-    for (i = 0; i < nsites; i++)
-	nodeInfo[i].overlaps = 0;
+    if (vp->byx == NULL)
+	vp->byx = N_GNEW(nsites, Info_t *);
+    byx = vp->byx;
+    for (i = 0; i < nsites; i++) {
+	vp->nodeInfo[i].overlaps = 0;
+	byx[i] = vp->nodeInfo + i;
+    }
+    qsort(byx, nsites, sizeof(Info_t *), xcomp);
 
     for (i = 0; i < nsites - 1; i++) {
-	jp = ip + 1;
+	ip = byx[i];
+	right = ip->site.coord.x + ip->poly.corner.x;
+	bottom = ip->site.coord.y + ip->poly.origin.y;
+	top = ip->site.coord.y + ip->poly.corner.y;
 	for (j = i + 1; j < nsites; j++) {
-	    if (polyOverlap
-		(ip->site.coord, &ip->poly, jp->site.coord, &jp->poly)) {
+	    jp = byx[j];
+	    if (jp->site.coord.x + jp->poly.origin.x > right)
+		break;
+	    if ((jp->site.coord.y + jp->poly.origin.y > top) ||
+		(jp->site.coord.y + jp->poly.corner.y < bottom))
+		continue;
+	    /* keep the argument order of the all-pairs test */
+	    if (ip < jp ?
+		polyOverlap(ip->site.coord, &ip->poly, jp->site.coord, &jp->poly) :
+		polyOverlap(jp->site.coord, &jp->poly, ip->site.coord, &ip->poly)) {
 		count++;
 		ip->overlaps = 1;
 		jp->overlaps = 1;
 	    }
-	    jp++;
 	}
-	ip++;
     }
 
     if (Verbose > 1)
@@ -366,15 +404,15 @@ static int countOverlap(int iter)
     return count;
 }
 
-static void increaseBoundBox(void)
+static void increaseBoundBox(Voronoi_t * vp)
 {
     double ydelta, xdelta;
     Point ll, ur;
 
-    ur.x = pxmax;
-    ur.y = pymax;
-    ll.x = pxmin;
-    ll.y = pymin;
+    ur.x = vp->pxmax;
+    ur.y = vp->pymax;
+    ll.x = vp->pxmin;
+    ll.y = vp->pymin;
 
     ydelta = incr * (ur.y - ll.y);
     xdelta = incr * (ur.x - ll.x);
@@ -384,7 +422,7 @@ static void increaseBoundBox(void)
     ll.x -= xdelta;
     ll.y -= ydelta;
 
-    setBoundBox(&ll, &ur);
+    setBoundBox(vp, &ll, &ur);
 }
 
  /* areaOf:
@@ -448,22 +486,29 @@ static void newpos(Info_t * ip)
   * Add corners of clipping window to appropriate sites.
   * A site gets a corner if it is the closest site to that corner.
   */
-static void addCorners(void)
+static void addCorners(Voronoi_t * vp)
 {
-    Info_t *ip = nodeInfo;
+    Info_t *ip = vp->nodeInfo;
     Info_t *sws = ip;
     Info_t *nws = ip;
     Info_t *ses = ip;
     Info_t *nes = ip;
-    double swd = dist_2(&ip->site.coord, &sw);
-    double nwd = dist_2(&ip->site.coord, &nw);
-    double sed = dist_2(&ip->site.coord, &se);
-    double ned = dist_2(&ip->site.coord, &ne);
+    Point nw, ne, sw, se;	/* Corners of clipping window */
+    double swd, nwd, sed, ned;
     double d;
     int i;
 
+    nw.x = sw.x = vp->pxmin;
+    ne.x = se.x = vp->pxmax;
+    nw.y = ne.y = vp->pymax;
+    sw.y = se.y = vp->pymin;
+    swd = dist_2(&ip->site.coord, &sw);
+    nwd = dist_2(&ip->site.coord, &nw);
+    sed = dist_2(&ip->site.coord, &se);
+    ned = dist_2(&ip->site.coord, &ne);
+
     ip++;
-    for (i = 1; i < nsites; i++) {
+    for (i = 1; i < vp->nsites; i++) {
 	d = dist_2(&ip->site.coord, &sw);
 	if (d < swd) {
 	    swd = d;
@@ -487,73 +532,59 @@ static void addCorners(void)
 	ip++;
     }
 
-    addVertex(&sws->site, sw.x, sw.y);
-    addVertex(&ses->site, se.x, se.y);
-    addVertex(&nws->site, nw.x, nw.y);
-    addVertex(&nes->site, ne.x, ne.y);
+    addVertex(vp, &sws->site, sw.x, sw.y);
+    addVertex(vp, &ses->site, se.x, se.y);
+    addVertex(vp, &nws->site, nw.x, nw.y);
+    addVertex(vp, &nes->site, ne.x, ne.y);
 }
 
  /* newPos:
   * Calculate the new position of a site as the centroid
-  * of its voronoi polygon, if it overlaps other nodes.
+  * of its voronoi polygon, if it overlaps other nodes
+  * or doAll is set.
   * The polygons are finite by being clipped to the clipping
   * window.
   * We first add the corner of the clipping windows to the
   * vertex lists of the appropriate sites.
   */
-static void newPos(void)
+static void newPos(Voronoi_t * vp, int doAll)
 {
     int i;
-    Info_t *ip = nodeInfo;
+    Info_t *ip = vp->nodeInfo;
 
-    addCorners();
-    for (i = 0; i < nsites; i++) {
+    addCorners(vp);
+    for (i = 0; i < vp->nsites; i++) {
 	if (doAll || ip->overlaps)
 	    newpos(ip);
 	ip++;
     }
 }
 
-/* cleanup:
- * Cleanup voronoi memory.
- * Note that PQcleanup and ELcleanup rely on the number
- * of sites, so should at least be reset everytime we use
- * vAdjust.
- * This could be optimized, over multiple components or
- * even multiple graphs, but probably not worth it.
- */
-static void cleanup(void)
-{
-    PQcleanup();
-    ELcleanup();
-    siteinit();			/* free memory */
-    edgeinit();			/* free memory */
-}
-
-static int vAdjust(void)
+static int vAdjust(Voronoi_t * vp)
 {
     int iterCnt = 0;
     int overlapCnt = 0;
     int badLevel = 0;
     int increaseCnt = 0;
+    int doAll = 0;		/* Move all nodes, regardless of overlap */
     int cnt;
 
     if (!useIter || (iterations > 0))
-	overlapCnt = countOverlap(iterCnt);
+	overlapCnt = countOverlap(vp, iterCnt);
 
     if ((overlapCnt == 0) || (iterations == 0))
 	return 0;
 
-    rmEquality();
-    geomUpdate(0);
-    voronoi(0, nextOne);
+    rmEquality(vp);
+    geomUpdate(vp, 0);
+    voronoi(vp, 0, nextOne);
     while (1) {
-	newPos();
+	newPos(vp, doAll);
 	iterCnt++;
 
 	if (useIter && (iterCnt == iterations))
 	    break;
-	cnt = countOverlap(iterCnt);
+	cnt = countOverlap(vp, iterCnt);
 	if (cnt == 0)
 	    break;
 	if (cnt >= overlapCnt)
@@ -574,12 +605,12 @@ static int vAdjust(void)
 	default:
 	    doAll = 1;
 	    increaseCnt++;
-	    increaseBoundBox();
+	    increaseBoundBox(vp);
 	    break;
 	}
 
-	geomUpdate(1);
-	voronoi(0, nextOne);
+	geomUpdate(vp, 1);
+	voronoi(vp, 0, nextOne);
     }
 
     if (Verbose) {
@@ -587,17 +618,16 @@ static int vAdjust(void)
 	fprintf(stderr, "Number of increases = %d\n", increaseCnt);
     }
 
-    cleanup();
     return 1;
 }
 
-static double rePos(Point c)
+static double rePos(Voronoi_t * vp, Point c)
 {
     int i;
-    Info_t *ip = nodeInfo;
+    Info_t *ip = vp->nodeInfo;
     double f = 1.0 + incr;
 
-    for (i = 0; i < nsites; i++) {
+    for (i = 0; i < vp->nsites; i++) {
 	/* ip->site.coord.x = f*(ip->site.coord.x - c.x) + c.x; */
 	/* ip->site.coord.y = f*(ip->site.coord.y - c.y) + c.y; */
 	ip->site.coord.x = f * ip->site.coord.x;
@@ -607,7 +637,7 @@ static double rePos(Point c)
     return f;
 }
 
-static int sAdjust(void)
+static int sAdjust(Voronoi_t * vp)
 {
     int iterCnt = 0;
     int overlapCnt = 0;
@@ -616,21 +646,21 @@ static int sAdjust(void)
     /* double sc; */
 
     if (!useIter || (iterations > 0))
-	overlapCnt = countOverlap(iterCnt);
+	overlapCnt = countOverlap(vp, iterCnt);
 
     if ((overlapCnt == 0) || (iterations == 0))
 	return 0;
 
-    rmEquality();
-    center.x = (pxmin + pxmax) / 2.0;
-    center.y = (pymin + pymax) / 2.0;
+    rmEquality(vp);
+    center.x = (vp->pxmin + vp->pxmax) / 2.0;
+    center.y = (vp->pymin + vp->pymax) / 2.0;
     while (1) {
-	/* sc = */ rePos(center);
+	/* sc = */ rePos(vp, center);
 	iterCnt++;
 
 	if (useIter && (iterCnt == iterations))
 	    break;
-	cnt = countOverlap(iterCnt);
+	cnt = countOverlap(vp, iterCnt);
 	if (cnt == 0)
 	    break;
     }
@@ -645,15 +675,15 @@ static int sAdjust(void)
  /* updateGraph:
   * Enter new node positions into the graph
   */
-static void updateGraph(Agraph_t * graph)
+static void updateGraph(Voronoi_t * vp)
 {
     /* Agnode_t*    node; */
     int i;
     Info_t *ip;
     /* char         pos[100]; */
 
-    ip = nodeInfo;
-    for (i = 0; i < nsites; i++) {
+    ip = vp->nodeInfo;
+    for (i = 0; i < vp->nsites; i++) {
 	ND_pos(ip->node)[0] = ip->site.coord.x;
 	ND_pos(ip->node)[1] = ip->site.coord.y;
 	ip++;
@@ -769,7 +799,7 @@ SparseMatrix makeMatrix(Agraph_t* g, int dim, SparseMatrix *D)
     return A;
 }
 
-#if ((defined(HAVE_GTS) || defined(HAVE_TRIANGLE)) && defined(SFDP))
+#ifdef SFDP
 static int
 fdpAdjust (graph_t* g, adjust_data* am)
 {
@@ -985,7 +1015,7 @@ typedef struct {
  */
 static lookup_t adjustMode[] = {
     ITEM(AM_NONE, "", "none"),
-#if ((defined(HAVE_GTS) || defined(HAVE_TRIANGLE)) && defined(SFDP))
+#ifdef SFDP
     ITEM(AM_PRISM, "prism", "prism"),
 #endif
     ITEM(AM_VOR, "voronoi", "Voronoi"),
@@ -1003,7 +1033,7 @@ static lookup_t adjustMode[] = {
     ITEM(AM_PORTHO_YX, "portho_yx", "pseudo-orthogonal constraints"),
     ITEM(AM_PORTHOXY, "porthoxy", "xy pseudo-orthogonal constraints"),
     ITEM(AM_PORTHOYX, "porthoyx", "yx pseudo-orthogonal constraints"),
-#if !((defined(HAVE_GTS) || defined(HAVE_TRIANGLE)) && defined(SFDP))
+#ifndef SFDP
     ITEM(AM_PRISM, "prism", 0),
 #endif
     {AM_NONE, 0, 0, 0}
@@ -1116,6 +1146,7 @@ int
 removeOverlapWith (graph_t * G, adjust_data* am)
 {
     int ret, nret;
+    Voronoi_t vor;
 
     if (agnnodes(G) < 2)
 	return 0;
@@ -1160,7 +1191,7 @@ removeOverlapWith (graph_t * G, adjust_data* am)
 	case AM_COMPRESS:
 	    ret = scAdjust(G, -1);
 	    break;
-#if ((defined(HAVE_GTS) || defined(HAVE_TRIANGLE)) && defined(SFDP))
+#ifdef SFDP
 	case AM_PRISM:
 	    ret = fdpAdjust(G, am);
 	    break;
@@ -1185,27 +1216,23 @@ removeOverlapWith (graph_t * G, adjust_data* am)
 
     /* create main array */
 /* start_timer(); */
-    if (makeInfo(G)) {
-	freeNodes();
-	free(sites);
-	sites = 0;
+    if (makeInfo(&vor, G)) {
+	freeNodes(&vor);
 	return nret;
     }
 
     /* establish and verify bounding box */
-    chkBoundBox(G);
+    chkBoundBox(&vor, G);
 
     if (am->mode == AM_SCALE)
-	ret = sAdjust();
+	ret = sAdjust(&vor);
     else
-	ret = vAdjust();
+	ret = vAdjust(&vor);
 
     if (ret)
-	updateGraph(G);
+	updateGraph(&vor);
 
-    freeNodes();
-    free(sites);
-    sites = 0;
+    freeNodes(&vor);
 /* fprintf (stderr, "%s %.4f sec\n", am->print, elapsed_sec()); */
 
     return ret+nret;
@@ -20,12 +20,81 @@
 #include "memory.h"
 #include "delaunay.h"
 
+/* tri_graph:
+ * Return the symmetric matrix of the triangulation edges of the
+ * n points, with a diagonal. This is the sum of the matrix of the
+ * edges and its transpose, built directly with the entries in the
+ * order SparseMatrix_symmetrize gives them: in row i, the edges
+ * listed from i, the diagonal, then the edges listed to i by
+ * increasing source.
+ */
+static SparseMatrix tri_graph(int n, int *edgelist, int numberofedges)
+{
+    int two[2];
+    int i, j, k, nz;
+    int *ia, *ja, *pos, *nout;
+    real *a;
+    real diag = 2;
+    SparseMatrix A;
+
+    if (n == 2) {		/* if two points, add edge i->j */
+	two[0] = 0;
+	two[1] = 1;
+	edgelist = two;
+	numberofedges = 1;
+    }
+    if (numberofedges == 0)	/* diagonal matrix, already symmetric */
+	diag = 1;
+
+    nz = n + 2 * numberofedges;
+    A = SparseMatrix_new(n, n, nz, MATRIX_TYPE_REAL, FORMAT_CSR);
+    ia = A->ia;
+    ja = A->ja;
+    a = (real *) A->a;
+    pos = N_GNEW(n, int);
+    nout = N_NEW(n, int);
+
+    for (i = 0; i <= n; i++)
+	ia[i] = 0;
+    for (i = 0; i < numberofedges; i++) {
+	nout[edgelist[i * 2]]++;
+	ia[edgelist[i * 2] + 1]++;
+	ia[edgelist[i * 2 + 1] + 1]++;
+    }
+    for (i = 0; i < n; i++)
+	ia[i + 1] += ia[i] + 1;
+    for (i = 0; i < n; i++)
+	pos[i] = ia[i];
+    for (i = 0; i < numberofedges; i++) {
+	j = pos[edgelist[i * 2]]++;
+	ja[j] = edgelist[i * 2 + 1];
+	a[j] = 1;
+    }
+    for (i = 0; i < n; i++) {
+	j = pos[i]++;
+	ja[j] = i;
+	a[j] = diag;
+    }
+    for (i = 0; i < n; i++) {
+	for (k = ia[i]; k < ia[i] + nout[i]; k++) {
+	    j = pos[ja[k]]++;
+	    ja[j] = i;
+	    a[j] = 1;
+	}
+    }
+    A->nz = nz;
+    SparseMatrix_set_symmetric(A);
+    SparseMatrix_set_pattern_symmetric(A);
+
+    free(pos);
+    free(nout);
+    return A;
+}
+
 SparseMatrix call_tri(int n, int dim, real * x)
 {
-    real one = 1;
-    int i, ii, jj;
     SparseMatrix A;
-    SparseMatrix B;
+    int i;
     int* edgelist = NULL;
     real* xv = N_GNEW(n, real);
     real* yv = N_GNEW(n, real);
@@ -42,30 +111,42 @@ SparseMatrix call_tri(int n, int dim, real * x)
 	numberofedges = 0;
     }
 
-    A = SparseMatrix_new(n, n, 1, MATRIX_TYPE_REAL, FORMAT_COORD);
-    for (i = 0; i < numberofedges; i++) {
-	ii = edgelist[i * 2];
-	jj = edgelist[i * 2 + 1];
-	SparseMatrix_coordinate_form_add_entries(A, 1, &(ii), &(jj), &one);
-    }
-    if (n == 2) {		/* if two points, add edge i->j */
-	ii = 0;
-	jj = 1;
-	SparseMatrix_coordinate_form_add_entries(A, 1, &(ii), &(jj), &one);
-    }
+    A = tri_graph(n, edgelist, numberofedges);
+    free (edgelist);
+    free (xv);
+    free (yv);
+    return A;
+}
+
+/* call_tri_update:
+ * As call_tri, for points that have moved since the last call with dt.
+ * See delaunay_tri_update.
+ */
+SparseMatrix call_tri_update(delaunay_t * dt, int n, int dim, real * x)
+{
+    SparseMatrix A;
+    int i;
+    int* edgelist = NULL;
+    real* xv = N_GNEW(n, real);
+    real* yv = N_GNEW(n, real);
+    int numberofedges;
+
     for (i = 0; i < n; i++) {
-	SparseMatrix_coordinate_form_add_entries(A, 1, &i, &i, &one);
+	xv[i] = x[i * 2];
+	yv[i] = x[i * 2 + 1];
     }
-    B = SparseMatrix_from_coordinate_format(A);
-    SparseMatrix_delete(A);
-    A = SparseMatrix_symmetrize(B, FALSE);
-    SparseMatrix_delete(B);
-    B = A;
 
+    if (n > 2) {
+	edgelist = delaunay_tri_update (dt, xv, yv, n, &numberofedges);
+    } else {
+	numberofedges = 0;
+    }
+
+    A = tri_graph(n, edgelist, numberofedges);
     free (edgelist);
     free (xv);
     free (yv);
-    return B;
+    return A;
 }
 
 SparseMatrix call_tri2(int n, int dim, real * xx)
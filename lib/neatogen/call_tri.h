@@ -14,7 +14,10 @@
 #ifndef CALL_TRI_H
 #define CALL_TRI_H
 
+#include "delaunay.h"
+
 SparseMatrix call_tri(int n, int dim, real * x);
+SparseMatrix call_tri_update(delaunay_t * dt, int n, int dim, real * x);
 SparseMatrix call_tri2(int n, int dim, real * x);
 
 #endif
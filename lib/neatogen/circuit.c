@@ -18,6 +18,21 @@
  * Return 1 if successful; 0 otherwise (e.g., graph is disconnected).
  */
 #include	"neato.h"
+#include	"stress.h"
+#include	<math.h>
+
+/* Above this envelope size per matrix entry, the columns are found by
+ * conjugate gradients instead of the envelope factorization. Long
+ * envelopes come from expander-like graphs, on which CG converges fast;
+ * meshes have short envelopes but slow CG.
+ */
+#define ENVELOPE_RATIO 128
+
+/* Relative residual at which the CG solve of a column stops */
+#define CG_TOL 1e-12
+
+/* start of row i in a packed upper triangle of order n */
+#define ROW(i,n) ((size_t)(i) * (n) - (size_t)(i) * ((i) - 1) / 2)
 
 int solveCircuit(int nG, double **Gm, double **Gm_inv)
 {
@@ -38,40 +53,482 @@ int solveCircuit(int nG, double **Gm, double **Gm_inv)
     return matinv(Gm, Gm_inv, nG - 1);
 }
 
+/* The sparse circuit solver.
+ * As in solveCircuit, the last node is grounded. This leaves the
+ * conductance matrix G of the other n = nG-1 nodes, which is symmetric
+ * positive definite if the graph is connected. Column j of G^-1 holds
+ * the potentials when a unit current enters at j and leaves at the
+ * ground, and the resistance between i and j is
+ *   Ginv[i][i] + Ginv[j][j] - 2*Ginv[i][j]
+ * The columns are found one at a time from a sparse G, so the only
+ * O(n^2) storage is the result. G is stored by rows (ia, ja, a) with
+ * its diagonal kept apart in diag.
+ */
+typedef struct {
+    int n;
+    int *ia;
+    int *ja;
+    double *a;
+    double *diag;
+} circuit_t;
+
+static boolean connected(vtx_data * graph, int nG)
+{
+    char *mark = N_NEW(nG, char);
+    int *stack = N_NEW(nG, int);
+    int top = 0, cnt = 1;
+    int i, e, j;
+
+    stack[top++] = 0;
+    mark[0] = 1;
+    while (top > 0) {
+	i = stack[--top];
+	for (e = 1; e < graph[i].nedges; e++) {
+	    j = graph[i].edges[e];
+	    if (!mark[j]) {
+		mark[j] = 1;
+		cnt++;
+		stack[top++] = j;
+	    }
+	}
+    }
+    free(mark);
+    free(stack);
+    return (cnt == nG);
+}
+
+/* mkCircuit:
+ * Conductance matrix of the nodes but the last. The conductance of
+ * an edge is 1/resistance, and the resistance is the edge length.
+ */
+static void mkCircuit(vtx_data * graph, int nG, circuit_t * c)
+{
+    int n = nG - 1;
+    int i, e, j, nz;
+    double w;
+
+    for (nz = 0, i = 0; i < n; i++)
+	nz += graph[i].nedges - 1;
+    c->n = n;
+    c->ia = N_NEW(n + 1, int);
+    c->ja = N_NEW(nz, int);
+    c->a = N_NEW(nz, double);
+    c->diag = N_NEW(n, double);
+    for (nz = 0, i = 0; i < n; i++) {
+	c->ia[i] = nz;
+	for (e = 1; e < graph[i].nedges; e++) {
+	    j = graph[i].edges[e];
+	    if (j == i)
+		continue;
+	    w = graph->ewgts ? 1.0 / graph[i].ewgts[e] : 1.0;
+	    c->diag[i] += w;
+	    if (j < n) {
+		c->ja[nz] = j;
+		c->a[nz++] = -w;
+	    }
+	}
+    }
+    c->ia[n] = nz;
+}
+
+static void freeCircuit(circuit_t * c)
+{
+    free(c->ia);
+    free(c->ja);
+    free(c->a);
+    free(c->diag);
+}
+
+/* rcm:
+ * Reverse Cuthill-McKee ordering of G: perm[k] is the row placed k-th.
+ * Each component starts from a node of least degree at the far end of
+ * a breadth-first search, and the neighbors of a node are taken in
+ * order of increasing degree.
+ */
+static void rcm(circuit_t * c, int *perm)
+{
+    int n = c->n;
+    int *ia = c->ia, *ja = c->ja;
+    char *mark = N_NEW(n, char);
+    int *level = N_NEW(n, int);
+    int i, k, s, head, tail, first, t, v, u;
+
+#define DEG(x) (ia[(x)+1] - ia[(x)])
+    for (tail = 0, s = 0; s < n; s++) {
+	if (mark[s])
+	    continue;
+	/* find a node far from s, then number from there */
+	first = tail;
+	perm[tail++] = s;
+	mark[s] = 1;
+	for (head = first; head < tail; head++) {
+	    v = perm[head];
+	    for (i = ia[v]; i < ia[v + 1]; i++) {
+		u = ja[i];
+		if (!mark[u]) {
+		    mark[u] = 1;
+		    level[u] = level[v] + 1;
+		    perm[tail++] = u;
+		}
+	    }
+	}
+	v = perm[tail - 1];
+	for (k = first; k < tail; k++) {
+	    u = perm[k];
+	    if ((level[u] == level[v]) && (DEG(u) < DEG(v)))
+		v = u;
+	    mark[u] = 0;
+	}
+
+	tail = first;
+	perm[tail++] = v;
+	mark[v] = 1;
+	for (head = first; head < tail; head++) {
+	    v = perm[head];
+	    k = tail;
+	    for (i = ia[v]; i < ia[v + 1]; i++) {
+		u = ja[i];
+		if (!mark[u]) {
+		    mark[u] = 1;
+		    perm[tail++] = u;
+		}
+	    }
+	    /* insertion sort of the new nodes by degree */
+	    for (i = k + 1; i < tail; i++) {
+		u = perm[i];
+		for (t = i; (t > k) && (DEG(perm[t - 1]) > DEG(u)); t--)
+		    perm[t] = perm[t - 1];
+		perm[t] = u;
+	    }
+	}
+    }
+#undef DEG
+    for (i = 0, k = n - 1; i < k; i++, k--) {
+	t = perm[i];
+	perm[i] = perm[k];
+	perm[k] = t;
+    }
+    free(mark);
+    free(level);
+}
+
+/* The envelope factor L of the reordered G = L L^T. Row k holds the
+ * entries in columns first[k]..k-1 at env[xenv[k]..], and L[k][k] is
+ * in diag[k].
+ */
+typedef struct {
+    int n;
+    int *first;
+    size_t *xenv;
+    double *env;
+    double *diag;
+} envelope_t;
+
+/* envSize:
+ * Entries below the diagonal in the envelope of G reordered by perm,
+ * with first[k] the first column of row k. pos is the inverse of perm.
+ */
+static size_t envSize(circuit_t * c, int *perm, int *pos, int *first)
+{
+    size_t size = 0;
+    int k, i, f;
+
+    for (k = 0; k < c->n; k++) {
+	f = k;
+	for (i = c->ia[perm[k]]; i < c->ia[perm[k] + 1]; i++)
+	    f = MIN(f, pos[c->ja[i]]);
+	first[k] = f;
+	size += k - f;
+    }
+    return size;
+}
+
+/* envFactor:
+ * Cholesky factorization of G in envelope form. The envelope does not
+ * grow, so L fits where G is stored. Returns 0 if a pivot is not
+ * positive, which only rounding could cause.
+ */
+static int
+envFactor(circuit_t * c, int *perm, int *pos, envelope_t * L)
+{
+    int n = c->n;
+    int *first = L->first;
+    int k, j, p, i, f;
+    double *rk, *rj;
+    double s;
+
+    L->xenv = N_NEW(n + 1, size_t);
+    for (k = 0; k < n; k++)
+	L->xenv[k + 1] = L->xenv[k] + (k - first[k]);
+    L->env = N_NEW(L->xenv[n], double);
+    L->diag = N_NEW(n, double);
+    for (k = 0; k < n; k++) {
+	L->diag[k] = c->diag[perm[k]];
+	rk = L->env + L->xenv[k] - first[k];
+	for (i = c->ia[perm[k]]; i < c->ia[perm[k] + 1]; i++) {
+	    j = pos[c->ja[i]];
+	    if (j < k)
+		rk[j] = c->a[i];
+	}
+    }
+
+    /* row k is rk[first[k]..k-1] */
+    for (k = 0; k < n; k++) {
+	rk = L->env + L->xenv[k] - first[k];
+	for (j = first[k]; j < k; j++) {
+	    rj = L->env + L->xenv[j] - first[j];
+	    f = MAX(first[k], first[j]);
+	    s = rk[j];
+	    for (p = f; p < j; p++)
+		s -= rk[p] * rj[p];
+	    rk[j] = s / L->diag[j];
+	}
+	s = L->diag[k];
+	for (p = first[k]; p < k; p++)
+	    s -= rk[p] * rk[p];
+	if (s <= 0)
+	    return 0;
+	L->diag[k] = sqrt(s);
+    }
+    return 1;
+}
+
+/* envSolve:
+ * Solve G x = e_q, with the unknowns in the permuted order. Rows
+ * before q stay zero in the forward pass.
+ */
+static void envSolve(envelope_t * L, int q, double *x)
+{
+    int n = L->n;
+    int k, p, f;
+    double *rk;
+    double s;
+
+    for (k = 0; k < q; k++)
+	x[k] = 0;
+    x[q] = 1 / L->diag[q];
+    for (k = q + 1; k < n; k++) {
+	rk = L->env + L->xenv[k] - L->first[k];
+	f = MAX(L->first[k], q);
+	s = 0;
+	for (p = f; p < k; p++)
+	    s -= rk[p] * x[p];
+	x[k] = s / L->diag[k];
+    }
+    for (k = n - 1; k >= 0; k--) {
+	rk = L->env + L->xenv[k] - L->first[k];
+	x[k] /= L->diag[k];
+	s = x[k];
+	for (p = L->first[k]; p < k; p++)
+	    x[p] -= rk[p] * s;
+    }
+}
+
+static void
+mult(circuit_t * c, double *x, double *y)
+{
+    int i, k;
+    double s;
+
+    for (i = 0; i < c->n; i++) {
+	s = c->diag[i] * x[i];
+	for (k = c->ia[i]; k < c->ia[i + 1]; k++)
+	    s += c->a[k] * x[c->ja[k]];
+	y[i] = s;
+    }
+}
+
+/* cgSolve:
+ * Solve G x = e_q by conjugate gradients with the diagonal of G as
+ * preconditioner. work has room for 3n doubles.
+ */
+static void cgSolve(circuit_t * c, int q, double *x, double *work)
+{
+    int n = c->n;
+    double *r = work, *p = work + n, *Ap = work + 2 * n;
+    double rz, rz_new, alpha, beta, tol;
+    int i, it;
+
+    for (i = 0; i < n; i++)
+	x[i] = r[i] = 0;
+    r[q] = 1;
+    for (i = 0; i < n; i++)
+	p[i] = r[i] / c->diag[i];
+    rz = 1 / c->diag[q];
+    tol = CG_TOL * CG_TOL * rz;
+    for (it = 0; (it < 2 * n) && (rz > tol); it++) {
+	mult(c, p, Ap);
+	alpha = 0;
+	for (i = 0; i < n; i++)
+	    alpha += p[i] * Ap[i];
+	if (alpha <= 0)
+	    break;
+	alpha = rz / alpha;
+	rz_new = 0;
+	for (i = 0; i < n; i++) {
+	    x[i] += alpha * p[i];
+	    r[i] -= alpha * Ap[i];
+	    rz_new += r[i] * r[i] / c->diag[i];
+	}
+	beta = rz_new / rz;
+	rz = rz_new;
+	for (i = 0; i < n; i++)
+	    p[i] = r[i] / c->diag[i] + beta * p[i];
+    }
+}
+
+/* circuitResistances:
+ * Effective resistances of the connected graph, treating each edge as
+ * a resistor of its length (1 if graph->ewgts is NULL), stored in Rij
+ * as the packed upper triangle, with row i at i*nG - i*(i-1)/2.
+ * Returns 1 if successful; 0 if the graph is disconnected.
+ */
+int circuitResistances(vtx_data * graph, int nG, double *Rij)
+{
+    circuit_t c;
+    envelope_t L;
+    int *perm, *pos;
+    int n = nG - 1;
+    int i, j, useCG;
+    size_t size, nz, count;
+    double *diag;
+
+    if (nG <= 1) {
+	if (nG == 1)
+	    Rij[0] = 0;
+	return 1;
+    }
+    if (!connected(graph, nG))
+	return 0;
+    if (Verbose)
+	fprintf(stderr, "Calculating circuit model");
+
+    mkCircuit(graph, nG, &c);
+    perm = N_NEW(n, int);
+    pos = N_NEW(n, int);
+    rcm(&c, perm);
+    for (i = 0; i < n; i++)
+	pos[perm[i]] = i;
+    L.n = n;
+    L.first = N_NEW(n, int);
+    L.xenv = NULL;
+    L.env = NULL;
+    L.diag = NULL;
+    size = envSize(&c, perm, pos, L.first);
+    nz = c.ia[n] + n;
+    useCG = (size > ENVELOPE_RATIO * nz);
+    if (Verbose)
+	fprintf(stderr, " (%s, envelope %lu)\n", useCG ? "CG" : "Cholesky",
+		(unsigned long) size);
+    if (!useCG && !envFactor(&c, perm, pos, &L))
+	useCG = 1;
+
+    /* the columns are independent, so they run in parallel */
+#pragma omp parallel
+    {
+	double *x = N_NEW(n, double);
+	double *work = (useCG ? N_NEW(3 * n, double) : NULL);
+	int i, j;
+
+#pragma omp for schedule(dynamic, 16)
+	for (j = 0; j < n; j++) {
+	    if (useCG) {
+		cgSolve(&c, j, x, work);
+		for (i = 0; i <= j; i++)
+		    Rij[ROW(i, nG) + (j - i)] = x[i];
+	    } else {
+		envSolve(&L, pos[j], x);
+		for (i = 0; i <= j; i++)
+		    Rij[ROW(i, nG) + (j - i)] = x[pos[i]];
+	    }
+	}
+	free(x);
+	free(work);
+    }
+
+    /* Rij holds Ginv; the ground row and column of Ginv are 0 */
+    diag = N_NEW(nG, double);
+    for (i = 0; i < n; i++)
+	diag[i] = Rij[ROW(i, nG)];
+    for (i = 0; i < nG; i++) {
+	count = ROW(i, nG);
+	Rij[count++] = 0;
+	for (j = i + 1; j < n; j++, count++)
+	    Rij[count] = diag[i] + diag[j] - 2 * Rij[count];
+	if (i < n)
+	    Rij[count] = diag[i];
+    }
+
+    free(diag);
+    free(perm);
+    free(pos);
+    free(L.first);
+    free(L.xenv);
+    free(L.env);
+    free(L.diag);
+    freeCircuit(&c);
+    return 1;
+}
+
+/* circuit_model:
+ * The graph is copied into a vtx_data, in which the last of several
+ * edges between two nodes gives the resistance, as in the dense model.
+ */
 int circuit_model(graph_t * g, int nG)
 {
-    double **Gm;
-    double **Gm_inv;
-    int rv;
+    vtx_data *graph;
+    int *edges, *edges0, *idx;
+    float *ewgts, *ewgts0;
+    double *Rij;
+    int rv, ne;
     long i, j;
+    size_t k;
     node_t *v;
     edge_t *e;
 
-    Gm = new_array(nG, nG, 0.0);
-    Gm_inv = new_array(nG, nG, 0.0);
-
-    /* set non-diagonal entries */
+    for (ne = nG, v = agfstnode(g); v; v = agnxtnode(g, v))
+	for (e = agfstedge(g, v); e; e = agnxtedge(g, e, v))
+	    ne++;
+    graph = N_NEW(nG, vtx_data);
+    edges = edges0 = N_NEW(ne, int);
+    ewgts = ewgts0 = N_NEW(ne, float);
+    idx = N_NEW(nG, int);
+    for (i = 0; i < nG; i++)
+	idx[i] = -1;
     for (v = agfstnode(g); v; v = agnxtnode(g, v)) {
+	i = ND_id(v);
+	graph[i].edges = edges;
+	graph[i].ewgts = ewgts;
+	graph[i].nedges = 1;
+	edges[0] = i;
 	for (e = agfstedge(g, v); e; e = agnxtedge(g, e, v)) {
-	    i = AGSEQ(agtail(e));
-	    j = AGSEQ(aghead(e));
+	    j = agtail(e) == v ? ND_id(aghead(e)) : ND_id(agtail(e));
 	    if (i == j)
 		continue;
-	    /* conductance is 1/resistance */
-	    Gm[i][j] = Gm[j][i] = -1.0 / ED_dist(e);	/* negate */
+	    if (idx[j] < 0) {
+		idx[j] = graph[i].nedges++;
+		edges[idx[j]] = j;
+	    }
+	    ewgts[idx[j]] = ED_dist(e);
 	}
+	for (k = 1; k < graph[i].nedges; k++)
+	    idx[edges[k]] = -1;
+	edges += graph[i].nedges;
+	ewgts += graph[i].nedges;
     }
 
-    rv = solveCircuit(nG, Gm, Gm_inv);
-
+    Rij = N_NEW((size_t) nG * (nG + 1) / 2, double);
+    rv = circuitResistances(graph, nG, Rij);
     if (rv)
 	for (i = 0; i < nG; i++) {
-	    for (j = 0; j < nG; j++) {
-		GD_dist(g)[i][j] =
-		    Gm_inv[i][i] + Gm_inv[j][j] - 2.0 * Gm_inv[i][j];
-	    }
+	    k = i * nG - i * (i - 1) / 2;
+	    for (j = i; j < nG; j++, k++)
+		GD_dist(g)[i][j] = GD_dist(g)[j][i] = Rij[k];
 	}
-    free_array(Gm);
-    free_array(Gm_inv);
+    free(Rij);
+    free(edges0);
+    free(ewgts0);
+    free(graph);
+    free(idx);
     return rv;
 }
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include "cgraph.h"     /* for agerr() and friends */
 #include "delaunay.h"
 #include "memory.h"
@@ -691,6 +692,928 @@ delaunay_tri (double *x, double *y, int n, int* nedges)
     return out.edgelist;
 }
 
+surface_t* 
+mkSurface (double *x, double *y, int n, int* segs, int nsegs)
+{
+    agerr (AGERR, "mkSurface not yet implemented using Triangle library\n");
+    assert (0);
+    return 0;
+}
+void 
+freeSurface (surface_t* s)
+{
+    agerr (AGERR, "freeSurface not yet implemented using Triangle library\n");
+    assert (0);
+}
+#else
+/* Built-in triangulation, used when neither GTS nor Triangle is
+ * available: the divide and conquer algorithm of Guibas and Stolfi,
+ * "Primitives for the manipulation of general subdivisions and the
+ * computation of Voronoi diagrams", ACM TOG 4(2), 1985. It takes
+ * O(n log n) time. Duplicate points are triangulated once, using the
+ * first copy, so later copies have no edges, as with GTS.
+ */
+
+/* A quad edge q is made of the 4 quarter edges 4q,...,4q+3, which
+ * are the edge, its dual, its reverse and the reverse dual.
+ */
+typedef struct {
+    int *next;		/* onext of each quarter edge */
+    int *org;		/* origin of each quarter edge; -1 if deleted */
+    int nq;		/* quad edges used */
+    int maxq;		/* quad edges allocated */
+    int freeq;		/* list of deleted quad edges, linked by next */
+    double *x, *y;	/* point coordinates */
+    int *pts;		/* points sorted on x, then y */
+    int npts;		/* distinct points triangulated */
+    int hull;		/* an edge with the outer face on its left */
+} qedges_t;
+
+#define ROT(e) (((e) & ~3) | (((e) + 1) & 3))
+#define SYM(e) (((e) & ~3) | (((e) + 2) & 3))
+#define INVROT(e) (((e) & ~3) | (((e) + 3) & 3))
+#define ONEXT(qe,e) ((qe)->next[e])
+#define OPREV(qe,e) ROT(ONEXT(qe,ROT(e)))
+#define LNEXT(qe,e) ROT(ONEXT(qe,INVROT(e)))
+#define RPREV(qe,e) ONEXT(qe,SYM(e))
+#define ORG(qe,e) ((qe)->org[e])
+#define DEST(qe,e) ((qe)->org[SYM(e)])
+
+/* Geometric predicates, after J. R. Shewchuk, "Adaptive precision
+ * floating-point arithmetic and fast robust geometric predicates",
+ * Discrete Comput. Geom. 18, 1997. The result is computed in double
+ * and checked against an error bound; if it is too close to zero to
+ * trust, it is recomputed exactly using expansions, sums of doubles
+ * kept in increasing order of magnitude. The Delaunay code can loop
+ * or leave faces untriangulated if the predicates are inconsistent,
+ * which plain doubles are for nearly degenerate points.
+ */
+
+/* The expansion arithmetic relies on the rounding of each operation.
+ * The volatile temporaries stop the compiler from simplifying it, as
+ * it otherwise would under -ffast-math.
+ */
+#define INEXACT volatile
+
+#define EPS_ERR (DBL_EPSILON / 2)
+#define CCW_ERRBOUND ((3.0 + 16.0 * EPS_ERR) * EPS_ERR)
+#define ICC_ERRBOUND ((10.0 + 96.0 * EPS_ERR) * EPS_ERR)
+#define SPLITTER 134217729.0	/* 2^27 + 1, to split a double in halves */
+
+/* twoSum:
+ * Set x + y = a + b exactly, with x = fl(a + b).
+ */
+static void twoSum(double a, double b, double *x, double *y)
+{
+    INEXACT double s = a + b;
+    INEXACT double bv = s - a;
+    INEXACT double av = s - bv;
+    INEXACT double br = b - bv;
+    INEXACT double ar = a - av;
+
+    *x = s;
+    *y = ar + br;
+}
+
+/* fastTwoSum:
+ * As twoSum, when |a| >= |b|.
+ */
+static void fastTwoSum(double a, double b, double *x, double *y)
+{
+    INEXACT double s = a + b;
+    INEXACT double bv = s - a;
+
+    *x = s;
+    *y = b - bv;
+}
+
+static void split(double a, double *hi, double *lo)
+{
+    INEXACT double c = SPLITTER * a;
+    INEXACT double big = c - a;
+    INEXACT double h = c - big;
+
+    *hi = h;
+    *lo = a - h;
+}
+
+/* twoProduct:
+ * Set x + y = a * b exactly, with x = fl(a * b).
+ */
+static void twoProduct(double a, double b, double *x, double *y)
+{
+    INEXACT double p = a * b;
+    INEXACT double t;
+    double ahi, alo, bhi, blo;
+    INEXACT double err;
+
+    split(a, &ahi, &alo);
+    split(b, &bhi, &blo);
+    t = ahi * bhi;
+    err = p - t;
+    t = alo * bhi;
+    err = err - t;
+    t = ahi * blo;
+    err = err - t;
+    t = alo * blo;
+    *x = p;
+    *y = t - err;
+}
+
+/* expSum:
+ * Set h = e + f, returning the length of h, which has room for
+ * elen + flen components. Zero components are dropped.
+ */
+static int expSum(int elen, double *e, int flen, double *f, double *h)
+{
+    double q, qnew, hh, enow, fnow;
+    int ei = 0, fi = 0, hi = 0;
+
+    enow = e[0];
+    fnow = f[0];
+    if ((fnow > enow) == (fnow > -enow)) {
+	q = enow;
+	enow = (++ei < elen) ? e[ei] : 0;
+    } else {
+	q = fnow;
+	fnow = (++fi < flen) ? f[fi] : 0;
+    }
+    if ((ei < elen) && (fi < flen)) {
+	if ((fnow > enow) == (fnow > -enow)) {
+	    fastTwoSum(enow, q, &qnew, &hh);
+	    enow = (++ei < elen) ? e[ei] : 0;
+	} else {
+	    fastTwoSum(fnow, q, &qnew, &hh);
+	    fnow = (++fi < flen) ? f[fi] : 0;
+	}
+	q = qnew;
+	if (hh != 0.0)
+	    h[hi++] = hh;
+	while ((ei < elen) && (fi < flen)) {
+	    if ((fnow > enow) == (fnow > -enow)) {
+		twoSum(q, enow, &qnew, &hh);
+		enow = (++ei < elen) ? e[ei] : 0;
+	    } else {
+		twoSum(q, fnow, &qnew, &hh);
+		fnow = (++fi < flen) ? f[fi] : 0;
+	    }
+	    q = qnew;
+	    if (hh != 0.0)
+		h[hi++] = hh;
+	}
+    }
+    while (ei < elen) {
+	twoSum(q, enow, &qnew, &hh);
+	enow = (++ei < elen) ? e[ei] : 0;
+	q = qnew;
+	if (hh != 0.0)
+	    h[hi++] = hh;
+    }
+    while (fi < flen) {
+	twoSum(q, fnow, &qnew, &hh);
+	fnow = (++fi < flen) ? f[fi] : 0;
+	q = qnew;
+	if (hh != 0.0)
+	    h[hi++] = hh;
+    }
+    if ((q != 0.0) || (hi == 0))
+	h[hi++] = q;
+    return hi;
+}
+
+/* expScale:
+ * Set h = b * e, returning the length of h, which has room for
+ * 2 * elen components.
+ */
+static int expScale(int elen, double *e, double b, double *h)
+{
+    double q, sum, hh, p1, p0;
+    int i, hi = 0;
+
+    twoProduct(e[0], b, &q, &hh);
+    if (hh != 0.0)
+	h[hi++] = hh;
+    for (i = 1; i < elen; i++) {
+	twoProduct(e[i], b, &p1, &p0);
+	twoSum(q, p0, &sum, &hh);
+	if (hh != 0.0)
+	    h[hi++] = hh;
+	fastTwoSum(p1, sum, &q, &hh);
+	if (hh != 0.0)
+	    h[hi++] = hh;
+    }
+    if ((q != 0.0) || (hi == 0))
+	h[hi++] = q;
+    return hi;
+}
+
+/* Longest product of two expansions of length 16 */
+#define MAXPROD 512
+
+/* expProduct:
+ * Set h = e * f, returning the length of h, which has room for
+ * 2 * elen * flen components. flen is at most 16.
+ */
+static int expProduct(int elen, double *e, int flen, double *f, double *h)
+{
+    double t[32], acc[2][MAXPROD];
+    int i, tlen, alen, cur = 0;
+
+    alen = expScale(elen, e, f[0], acc[cur]);
+    for (i = 1; i < flen; i++) {
+	tlen = expScale(elen, e, f[i], t);
+	alen = expSum(alen, acc[cur], tlen, t, acc[1 - cur]);
+	cur = 1 - cur;
+    }
+    memcpy(h, acc[cur], alen * sizeof(double));
+    return alen;
+}
+
+static void expNegate(int elen, double *e)
+{
+    int i;
+
+    for (i = 0; i < elen; i++)
+	e[i] = -e[i];
+}
+
+/* diff2:
+ * Set h to the expansion of a - b, returning its length, 1 if the
+ * difference is exact and 2 otherwise.
+ */
+static int diff2(double a, double b, double *h)
+{
+    INEXACT double s = a - b;
+    INEXACT double bv = a - s;
+    INEXACT double av = s + bv;
+    INEXACT double br = bv - b;
+    INEXACT double ar = a - av;
+    double t = ar + br;
+
+    if (t == 0.0) {
+	h[0] = s;
+	return 1;
+    }
+    h[0] = t;
+    h[1] = s;
+    return 2;
+}
+
+/* cross:
+ * Set h = u0 * v1 - u1 * v0 for expansions of length at most 2.
+ */
+static int cross(int u0len, double *u0, int v1len, double *v1,
+		 int u1len, double *u1, int v0len, double *v0, double *h)
+{
+    double p[8], q[8];
+    int plen = expProduct(u0len, u0, v1len, v1, p);
+    int qlen = expProduct(u1len, u1, v0len, v0, q);
+
+    expNegate(qlen, q);
+    return expSum(plen, p, qlen, q, h);
+}
+
+static double ccwExact(double *x, double *y, int a, int b, int c)
+{
+    double acx[2], bcx[2], acy[2], bcy[2], h[16];
+    int acxlen = diff2(x[a], x[c], acx);
+    int bcxlen = diff2(x[b], x[c], bcx);
+    int acylen = diff2(y[a], y[c], acy);
+    int bcylen = diff2(y[b], y[c], bcy);
+    int hlen = cross(acxlen, acx, bcylen, bcy, acylen, acy, bcxlen, bcx, h);
+
+    return h[hlen - 1];
+}
+
+/* ccw:
+ * Return positive, negative or zero as points a, b, c are in
+ * counterclockwise order, clockwise order or collinear.
+ */
+static double ccw(qedges_t * qe, int a, int b, int c)
+{
+    double *x = qe->x;
+    double *y = qe->y;
+    double l = (x[a] - x[c]) * (y[b] - y[c]);
+    double r = (y[a] - y[c]) * (x[b] - x[c]);
+    double det = l - r;
+
+    if (fabs(det) > CCW_ERRBOUND * (fabs(l) + fabs(r)))
+	return det;
+    return ccwExact(x, y, a, b, c);
+}
+
+/* incircleExact:
+ * The incircle determinant, exactly. The differences of nearby
+ * points are usually exact, which keeps the expansions short.
+ */
+static double incircleExact(double *x, double *y, int a, int b, int c,
+			    int d)
+{
+    double dx[3][2], dy[3][2];
+    double minor[16], lift[16], sq[8], term[3][MAXPROD];
+    double ab[2 * MAXPROD], det[3 * MAXPROD];
+    int dxlen[3], dylen[3], pts[3];
+    int i, j, k, mlen, llen, slen, tlen[3], ablen, dlen;
+
+    pts[0] = a;
+    pts[1] = b;
+    pts[2] = c;
+    for (i = 0; i < 3; i++) {
+	dxlen[i] = diff2(x[pts[i]], x[d], dx[i]);
+	dylen[i] = diff2(y[pts[i]], y[d], dy[i]);
+    }
+    /* det = sum over i of lift(i) * cross(j, k), with i, j, k cyclic */
+    for (i = 0; i < 3; i++) {
+	j = (i + 1) % 3;
+	k = (i + 2) % 3;
+	mlen = cross(dxlen[j], dx[j], dylen[k], dy[k],
+		     dxlen[k], dx[k], dylen[j], dy[j], minor);
+	slen = expProduct(dxlen[i], dx[i], dxlen[i], dx[i], sq);
+	llen = expProduct(dylen[i], dy[i], dylen[i], dy[i], lift);
+	llen = expSum(slen, sq, llen, lift, term[i]);
+	memcpy(lift, term[i], llen * sizeof(double));
+	tlen[i] = expProduct(llen, lift, mlen, minor, term[i]);
+    }
+    ablen = expSum(tlen[0], term[0], tlen[1], term[1], ab);
+    dlen = expSum(ablen, ab, tlen[2], term[2], det);
+    return det[dlen - 1];
+}
+
+/* incircle:
+ * Return true if d lies inside the circle through a, b, c, which
+ * are in counterclockwise order.
+ */
+static int incircle(qedges_t * qe, int a, int b, int c, int d)
+{
+    double *x = qe->x;
+    double *y = qe->y;
+    double adx = x[a] - x[d], ady = y[a] - y[d];
+    double bdx = x[b] - x[d], bdy = y[b] - y[d];
+    double cdx = x[c] - x[d], cdy = y[c] - y[d];
+    double alift = adx * adx + ady * ady;
+    double blift = bdx * bdx + bdy * bdy;
+    double clift = cdx * cdx + cdy * cdy;
+    double bc = bdx * cdy - cdx * bdy;
+    double ca = cdx * ady - adx * cdy;
+    double ab = adx * bdy - bdx * ady;
+    double det = alift * bc + blift * ca + clift * ab;
+    double perm = (fabs(bdx * cdy) + fabs(cdx * bdy)) * alift
+	+ (fabs(cdx * ady) + fabs(adx * cdy)) * blift
+	+ (fabs(adx * bdy) + fabs(bdx * ady)) * clift;
+
+    if (fabs(det) > ICC_ERRBOUND * perm)
+	return det > 0;
+    return incircleExact(x, y, a, b, c, d) > 0;
+}
+
+#define RIGHTOF(qe,p,e) (ccw(qe, p, DEST(qe,e), ORG(qe,e)) > 0)
+#define LEFTOF(qe,p,e) (ccw(qe, p, ORG(qe,e), DEST(qe,e)) > 0)
+
+static int makeEdge(qedges_t * qe, int a, int b)
+{
+    int e;
+
+    if (qe->freeq >= 0) {
+	e = qe->freeq;
+	qe->freeq = qe->next[e];
+    } else {
+	if (qe->nq == qe->maxq) {
+	    qe->maxq *= 2;
+	    qe->next = RALLOC(4 * qe->maxq, qe->next, int);
+	    qe->org = RALLOC(4 * qe->maxq, qe->org, int);
+	}
+	e = 4 * qe->nq++;
+    }
+    qe->next[e] = e;
+    qe->next[e + 1] = e + 3;
+    qe->next[e + 2] = e + 2;
+    qe->next[e + 3] = e + 1;
+    qe->org[e] = a;
+    qe->org[e + 1] = -1;
+    qe->org[e + 2] = b;
+    qe->org[e + 3] = -1;
+    return e;
+}
+
+static void splice(qedges_t * qe, int a, int b)
+{
+    int alpha = ROT(ONEXT(qe, a));
+    int beta = ROT(ONEXT(qe, b));
+    int t;
+
+    t = qe->next[a];
+    qe->next[a] = qe->next[b];
+    qe->next[b] = t;
+    t = qe->next[alpha];
+    qe->next[alpha] = qe->next[beta];
+    qe->next[beta] = t;
+}
+
+/* connectEdges:
+ * Add an edge from the destination of a to the origin of b,
+ * so that a, the new edge and b share a left face.
+ */
+static int connectEdges(qedges_t * qe, int a, int b)
+{
+    int e = makeEdge(qe, DEST(qe, a), ORG(qe, b));
+
+    splice(qe, e, LNEXT(qe, a));
+    splice(qe, SYM(e), b);
+    return e;
+}
+
+static void deleteEdge(qedges_t * qe, int e)
+{
+    e &= ~3;
+    splice(qe, e, OPREV(qe, e));
+    splice(qe, SYM(e), OPREV(qe, SYM(e)));
+    qe->org[e] = qe->org[e + 2] = -1;
+    qe->next[e] = qe->freeq;
+    qe->freeq = e;
+}
+
+/* divconq:
+ * Triangulate the sorted points pts[lo..hi-1], at least 2 of them.
+ * Return in *le the counterclockwise convex hull edge out of the
+ * leftmost point and in *re the clockwise one out of the rightmost.
+ */
+static void divconq(qedges_t * qe, int lo, int hi, int *le, int *re)
+{
+    int *pts = qe->pts;
+    int a, b, c;
+    int ldo, ldi, rdi, rdo, basel, lcand, rcand, t;
+    int n = hi - lo;
+    int mid;
+    double ct;
+
+    if (n == 2) {
+	a = makeEdge(qe, pts[lo], pts[lo + 1]);
+	*le = a;
+	*re = SYM(a);
+	return;
+    }
+    if (n == 3) {
+	a = makeEdge(qe, pts[lo], pts[lo + 1]);
+	b = makeEdge(qe, pts[lo + 1], pts[lo + 2]);
+	splice(qe, SYM(a), b);
+	ct = ccw(qe, pts[lo], pts[lo + 1], pts[lo + 2]);
+	if (ct > 0) {
+	    connectEdges(qe, b, a);
+	    *le = a;
+	    *re = SYM(b);
+	} else if (ct < 0) {
+	    c = connectEdges(qe, b, a);
+	    *le = SYM(c);
+	    *re = c;
+	} else {
+	    *le = a;
+	    *re = SYM(b);
+	}
+	return;
+    }
+
+    mid = lo + n / 2;
+    divconq(qe, lo, mid, &ldo, &ldi);
+    divconq(qe, mid, hi, &rdi, &rdo);
+
+    /* find the lower common tangent of the two halves */
+    for (;;) {
+	if (LEFTOF(qe, ORG(qe, rdi), ldi))
+	    ldi = LNEXT(qe, ldi);
+	else if (RIGHTOF(qe, ORG(qe, ldi), rdi))
+	    rdi = RPREV(qe, rdi);
+	else
+	    break;
+    }
+
+    basel = connectEdges(qe, SYM(rdi), ldi);
+    if (ORG(qe, ldi) == ORG(qe, ldo))
+	ldo = SYM(basel);
+    if (ORG(qe, rdi) == ORG(qe, rdo))
+	rdo = basel;
+
+    /* zip the halves together, bottom to top */
+    for (;;) {
+	int lvalid, rvalid;
+
+	lcand = ONEXT(qe, SYM(basel));
+	if ((lvalid = RIGHTOF(qe, DEST(qe, lcand), basel))) {
+	    while (incircle(qe, DEST(qe, basel), ORG(qe, basel),
+			    DEST(qe, lcand), DEST(qe, ONEXT(qe, lcand)))) {
+		t = ONEXT(qe, lcand);
+		deleteEdge(qe, lcand);
+		lcand = t;
+	    }
+	}
+	rcand = OPREV(qe, basel);
+	if ((rvalid = RIGHTOF(qe, DEST(qe, rcand), basel))) {
+	    while (incircle(qe, DEST(qe, basel), ORG(qe, basel),
+			    DEST(qe, rcand), DEST(qe, OPREV(qe, rcand)))) {
+		t = OPREV(qe, rcand);
+		deleteEdge(qe, rcand);
+		rcand = t;
+	    }
+	}
+	if (!lvalid && !rvalid)
+	    break;
+	if (!lvalid || (rvalid && incircle(qe, DEST(qe, lcand),
+					   ORG(qe, lcand), ORG(qe, rcand),
+					   DEST(qe, rcand))))
+	    basel = connectEdges(qe, rcand, SYM(basel));
+	else
+	    basel = connectEdges(qe, SYM(basel), SYM(lcand));
+    }
+    *le = ldo;
+    *re = rdo;
+}
+
+/* The points are sorted as records carrying their coordinates, so the
+ * comparison needs no global state and triangulations may run in
+ * several threads at once.
+ */
+typedef struct {
+    double x, y;
+    int idx;
+} xypt_t;
+typedef int (*qsort_cmpf) (const void *, const void *);
+
+static int xycmp(xypt_t *a, xypt_t *b)
+{
+    if (a->x < b->x) return -1;
+    if (a->x > b->x) return 1;
+    if (a->y < b->y) return -1;
+    if (a->y > b->y) return 1;
+    return a->idx - b->idx;
+}
+
+/* qeTriangulate:
+ * Build the Delaunay triangulation of the n points (x[i],y[i]).
+ * Return 0 if there are fewer than 2 distinct points.
+ */
+static int qeTriangulate(qedges_t * qe, double *x, double *y, int n)
+{
+    int i, m, le, re;
+    xypt_t *ps;
+
+    qe->x = x;
+    qe->y = y;
+    qe->nq = 0;
+    qe->maxq = 3 * n + 3;
+    qe->freeq = -1;
+    qe->next = N_GNEW(4 * qe->maxq, int);
+    qe->org = N_GNEW(4 * qe->maxq, int);
+    qe->pts = N_GNEW(n, int);
+
+    ps = N_GNEW(n, xypt_t);
+    for (i = 0; i < n; i++) {
+	ps[i].x = x[i];
+	ps[i].y = y[i];
+	ps[i].idx = i;
+    }
+    qsort(ps, n, sizeof(xypt_t), (qsort_cmpf) xycmp);
+    for (i = 0; i < n; i++)
+	qe->pts[i] = ps[i].idx;
+    free(ps);
+
+    /* drop duplicates, keeping the lowest index */
+    for (m = 0, i = 0; i < n; i++) {
+	if (m > 0 && x[qe->pts[i]] == x[qe->pts[m - 1]]
+	    && y[qe->pts[i]] == y[qe->pts[m - 1]])
+	    continue;
+	qe->pts[m++] = qe->pts[i];
+    }
+
+    qe->npts = m;
+    if (m < 2)
+	return 0;
+    divconq(qe, 0, m, &le, &re);
+    qe->hull = SYM(le);
+    return 1;
+}
+
+static void freeQedges(qedges_t * qe)
+{
+    free(qe->next);
+    free(qe->org);
+    free(qe->pts);
+}
+
+/* swapEdge:
+ * Replace e, a diagonal of the quadrilateral made by its two faces,
+ * with the other diagonal.
+ */
+static void swapEdge(qedges_t * qe, int e)
+{
+    int a = OPREV(qe, e);
+    int b = OPREV(qe, SYM(e));
+
+    splice(qe, e, a);
+    splice(qe, SYM(e), b);
+    splice(qe, e, LNEXT(qe, a));
+    splice(qe, SYM(e), LNEXT(qe, b));
+    qe->org[e] = DEST(qe, a);
+    qe->org[SYM(e)] = DEST(qe, b);
+}
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define Q_HULL 1
+#define Q_QUEUED 2
+
+/* qeRepair:
+ * Make the triangulation Delaunay again after the points have
+ * moved, by flipping edges as in Lawson's algorithm. Where the hull
+ * is no longer convex, the dents are first filled with triangles.
+ * This needs the triangulation to still be valid at the new
+ * positions: every triangle counterclockwise and the hull going
+ * around once. If it is not, return 0; the triangulation must then
+ * be built again. When the points have moved a little, this takes
+ * time linear in the number of edges and flips.
+ */
+static int qeRepair(qedges_t * qe)
+{
+    char *state, *outer;
+    int *stack;
+    int nq, e, f, g, i, q, top, changed, ok = 1;
+    int nbrs[4];
+    double c, ux, uy, vx, vy, turn = 0;
+    double *x = qe->x;
+    double *y = qe->y;
+
+    if (qe->npts < 3)
+	return 0;
+
+    /* the outer face goes clockwise around the hull; a counterclockwise
+     * turn is a dent, closed by an edge making a new triangle
+     */
+    do {
+	changed = 0;
+	e = qe->hull;
+	do {
+	    f = LNEXT(qe, e);
+	    c = ccw(qe, ORG(qe, e), DEST(qe, e), DEST(qe, f));
+	    if (c > 0) {
+		if (LNEXT(qe, f) == e)	/* the hull is a triangle */
+		    return 0;
+		e = qe->hull = SYM(connectEdges(qe, f, e));
+		changed = 1;
+	    } else
+		e = f;
+	} while (e != qe->hull);
+    } while (changed);
+
+    nq = qe->nq;
+    state = N_NEW(nq, char);
+    outer = N_NEW(2 * nq, char);	/* by primal edge, e / 2 */
+    e = qe->hull;
+    do {
+	f = LNEXT(qe, e);
+	ux = x[DEST(qe, e)] - x[ORG(qe, e)];
+	uy = y[DEST(qe, e)] - y[ORG(qe, e)];
+	vx = x[DEST(qe, f)] - x[ORG(qe, f)];
+	vy = y[DEST(qe, f)] - y[ORG(qe, f)];
+	turn += atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+	if (ccw(qe, ORG(qe, e), DEST(qe, e), DEST(qe, f)) == 0
+	    && ux * vx + uy * vy <= 0)
+	    ok = 0;		/* the hull doubles back */
+	state[e >> 2] = Q_HULL;
+	outer[e >> 1] = 1;
+	e = f;
+    } while (e != qe->hull);
+    /* all turns are clockwise; going around more than once adds 2 pi */
+    if (turn < -3 * M_PI)
+	ok = 0;
+
+    /* the other faces are counterclockwise triangles */
+    for (e = 0; ok && e < 4 * nq; e += 2) {
+	if (qe->org[e] < 0 || outer[e >> 1])
+	    continue;
+	f = LNEXT(qe, e);
+	g = LNEXT(qe, f);
+	if (LNEXT(qe, g) != e)
+	    ok = 0;
+	else if (e < f && e < g
+		 && ccw(qe, ORG(qe, e), ORG(qe, f), ORG(qe, g)) <= 0)
+	    ok = 0;
+    }
+    free(outer);
+    if (!ok) {
+	free(state);
+	return 0;
+    }
+
+    stack = N_GNEW(nq, int);
+    top = 0;
+    for (q = 0; q < nq; q++) {
+	if (qe->org[4 * q] >= 0 && !state[q]) {
+	    stack[top++] = q;
+	    state[q] = Q_QUEUED;
+	}
+    }
+    while (top > 0) {
+	q = stack[--top];
+	state[q] = 0;
+	e = 4 * q;
+	f = SYM(e);
+	if (!incircle(qe, ORG(qe, e), DEST(qe, e), DEST(qe, LNEXT(qe, e)),
+		      DEST(qe, LNEXT(qe, f))))
+	    continue;
+	nbrs[0] = LNEXT(qe, e);
+	nbrs[1] = LNEXT(qe, nbrs[0]);
+	nbrs[2] = LNEXT(qe, f);
+	nbrs[3] = LNEXT(qe, nbrs[2]);
+	swapEdge(qe, e);
+	for (i = 0; i < 4; i++) {
+	    q = nbrs[i] >> 2;
+	    if (!state[q]) {
+		stack[top++] = q;
+		state[q] = Q_QUEUED;
+	    }
+	}
+    }
+    free(stack);
+    free(state);
+    return 1;
+}
+
+/* qeEdges:
+ * Return the edges of the triangulation as pairs of point indices,
+ * setting *pnedges to their number.
+ */
+static int *qeEdges(qedges_t * qe, int *pnedges)
+{
+    int *edges = N_GNEW(2 * qe->nq, int);
+    int i, nedges = 0;
+
+    for (i = 0; i < qe->nq; i++) {
+	if (qe->org[4 * i] < 0)
+	    continue;
+	edges[2 * nedges] = qe->org[4 * i];
+	edges[2 * nedges + 1] = qe->org[4 * i + 2];
+	nedges++;
+    }
+    *pnedges = nedges;
+    return edges;
+}
+
+/* delaunay_tri:
+ * As above. Collinear points come out as the n-1 edges joining
+ * neighbors on the line, as the algorithm builds them.
+ */
+int *delaunay_tri(double *x, double *y, int n, int* pnedges)
+{
+    qedges_t qe;
+    int *edges = NULL;
+
+    *pnedges = 0;
+    if (qeTriangulate(&qe, x, y, n))
+	edges = qeEdges(&qe, pnedges);
+    freeQedges(&qe);
+    return edges;
+}
+
+struct delaunay_s {
+    qedges_t qe;
+    int n;		/* points in qe, or -1 if there is none */
+};
+
+delaunay_t *mkDelaunay(void)
+{
+    delaunay_t *dt = NEW(delaunay_t);
+
+    dt->n = -1;
+    return dt;
+}
+
+/* delaunay_tri_update:
+ * As delaunay_tri, for points that have moved since the last call
+ * with dt. The previous triangulation is repaired if it can be, and
+ * is otherwise built again. The result is a Delaunay triangulation
+ * either way, but among cocircular points it may pick other edges
+ * than delaunay_tri.
+ */
+int *delaunay_tri_update(delaunay_t * dt, double *x, double *y, int n,
+			 int *pnedges)
+{
+    qedges_t *qe = &dt->qe;
+
+    *pnedges = 0;
+    qe->x = x;
+    qe->y = y;
+    if (dt->n != n || qe->npts != n || !qeRepair(qe)) {
+	if (dt->n >= 0)
+	    freeQedges(qe);
+	dt->n = n;
+	if (!qeTriangulate(qe, x, y, n))
+	    return NULL;
+    }
+    return qeEdges(qe, pnedges);
+}
+
+void freeDelaunay(delaunay_t * dt)
+{
+    if (!dt)
+	return;
+    if (dt->n >= 0)
+	freeQedges(&dt->qe);
+    free(dt);
+}
+
+/* get_triangles:
+ * Given n points whose coordinates are stored as (x[2*i],x[2*i+1]),
+ * compute a Delaunay triangulation of the points.
+ * The number of triangles in the triangulation is returned in tris.
+ * The return value t is an array of 3*(*tris) integers,
+ * with triangle i having points whose indices are t[3*i], t[3*i+1] and t[3*i+2],
+ * in counterclockwise order.
+ */
+int* get_triangles (double *x, int n, int* tris)
+{
+    qedges_t qe;
+    double *xs, *ys;
+    int *faces = NULL;
+    char *done;
+    int i, e, e1, e2, nfaces = 0;
+
+    if (n <= 2) return NULL;
+
+    xs = N_GNEW(n, double);
+    ys = N_GNEW(n, double);
+    for (i = 0; i < n; i++) {
+	xs[i] = x[2 * i];
+	ys[i] = x[2 * i + 1];
+    }
+
+    if (qeTriangulate(&qe, xs, ys, n)) {
+	/* Each triangle is the left face of 3 directed edges; the
+	 * outer face is excluded by its orientation.
+	 */
+	faces = N_GNEW(2 * qe.nq, int);
+	done = N_NEW(4 * qe.nq, char);
+	for (e = 0; e < 4 * qe.nq; e += 2) {
+	    if (done[e] || qe.org[e] < 0)
+		continue;
+	    e1 = LNEXT(&qe, e);
+	    e2 = LNEXT(&qe, e1);
+	    if (LNEXT(&qe, e2) != e ||
+		ccw(&qe, ORG(&qe, e), ORG(&qe, e1), ORG(&qe, e2)) <= 0)
+		continue;
+	    done[e] = done[e1] = done[e2] = 1;
+	    faces[3 * nfaces] = ORG(&qe, e);
+	    faces[3 * nfaces + 1] = ORG(&qe, e1);
+	    faces[3 * nfaces + 2] = ORG(&qe, e2);
+	    nfaces++;
+	}
+	free(done);
+    }
+    freeQedges(&qe);
+    free(xs);
+    free(ys);
+
+    *tris = nfaces;
+    return faces;
+}
+
+static char* err = "Graphviz built without GTS";
+surface_t* 
+mkSurface (double *x, double *y, int n, int* segs, int nsegs)
+{
+    agerr(AGERR, "mkSurface: %s\n", err);
+    return 0;
+}
+void 
+freeSurface (surface_t* s)
+{
+    agerr (AGERR, "freeSurface: %s\n", err);
+}
+#endif
+
+#if HAVE_GTS || HAVE_TRIANGLE
+/* The libraries triangulate from scratch each time. */
+struct delaunay_s {
+    int n;
+};
+
+delaunay_t *mkDelaunay(void)
+{
+    return NEW(delaunay_t);
+}
+
+int *delaunay_tri_update(delaunay_t * dt, double *x, double *y, int n,
+			 int *pnedges)
+{
+    return delaunay_tri(x, y, n, pnedges);
+}
+
+void freeDelaunay(delaunay_t * dt)
+{
+    free(dt);
+}
+#endif
+
+#if !HAVE_GTS
 v_data *delaunay_triangulation(double *x, double *y, int n)
 {
     v_data *delaunay;
@@ -727,48 +1650,6 @@ v_data *delaunay_triangulation(double *x, double *y, int n)
     free(edgelist);
     return delaunay;
 }
-
-surface_t* 
-mkSurface (double *x, double *y, int n, int* segs, int nsegs)
-{
-    agerr (AGERR, "mkSurface not yet implemented using Triangle library\n");
-    assert (0);
-    return 0;
-}
-void 
-freeSurface (surface_t* s)
-{
-    agerr (AGERR, "freeSurface not yet implemented using Triangle library\n");
-    assert (0);
-}
-#else
-static char* err = "Graphviz built without any triangulation library\n";
-int* get_triangles (double *x, int n, int* tris)
-{
-    agerr(AGERR, "get_triangles: %s\n", err);
-    return 0;
-}
-v_data *delaunay_triangulation(double *x, double *y, int n)
-{
-    agerr(AGERR, "delaunay_triangulation: %s\n", err);
-    return 0;
-}
-int *delaunay_tri(double *x, double *y, int n, int* nedges)
-{
-    agerr(AGERR, "delaunay_tri: %s\n", err);
-    return 0;
-}
-surface_t* 
-mkSurface (double *x, double *y, int n, int* segs, int nsegs)
-{
-    agerr(AGERR, "mkSurface: %s\n", err);
-    return 0;
-}
-void 
-freeSurface (surface_t* s)
-{
-    agerr (AGERR, "freeSurface: %s\n", err);
-}
 #endif
 
 static void remove_edge(v_data * graph, int source, int dest)
@@ -28,6 +28,17 @@ v_data *delaunay_triangulation(double *x, double *y, int n);
 
 int *delaunay_tri (double *x, double *y, int n, int* nedges);
 
+/* A triangulation kept from one call of delaunay_tri_update to the
+ * next, for points that move a little between calls.
+ */
+typedef struct delaunay_s delaunay_t;
+
+delaunay_t *mkDelaunay (void);
+
+int *delaunay_tri_update (delaunay_t *dt, double *x, double *y, int n, int* nedges);
+
+void freeDelaunay (delaunay_t *dt);
+
 int *get_triangles (double *x, int n, int* ntris);
 
 v_data *UG_graph(double *x, double *y, int n, int accurate_computation);
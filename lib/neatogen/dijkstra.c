@@ -158,12 +158,13 @@ void dijkstra(int vertex, vtx_data * graph, int n, DistType * dist)
     heap H;
     int closestVertex, neighbor;
     DistType closestDist, prevClosestDist = INT_MAX;
-    static int *index;
+    int *index;
 
 #ifdef OBSOLETE
     mkHeap(&H, n);
 #endif
-    index = (int *) realloc(index, n * sizeof(int));
+    /* not static, so that searches can run in parallel */
+    index = N_GNEW(n, int);
 
     /* initial distances with edge weights: */
     for (i = 0; i < n; i++)
@@ -193,6 +194,7 @@ void dijkstra(int vertex, vtx_data * graph, int n, DistType * dist)
 	if (dist[i] == MAX_DIST)	/* 'i' is not connected to 'vertex' */
 	    dist[i] = prevClosestDist + 10;
     freeHeap(&H);
+    free(index);
 }
 
  /* Dijkstra bounded to nodes in *unweighted* radius */
@@ -12,29 +12,22 @@
  *************************************************************************/
 
 #include "neato.h"
-#include "mem.h"
-#include "info.h"
-#include "edges.h"
+#include "voronoi.h"
 #include <math.h>
 
 
-double pxmin, pxmax, pymin, pymax;	/* clipping window */
-
-static int nedges;
-static Freelist efl;
-
-void edgeinit()
+void edgeinit(Voronoi_t * vp)
 {
-    freeinit(&efl, sizeof(Edge));
-    nedges = 0;
+    freereset(&vp->efl);
+    vp->nedges = 0;
 }
 
-Edge *bisect(Site * s1, Site * s2)
+Edge *bisect(Voronoi_t * vp, Site * s1, Site * s2)
 {
     double dx, dy, adx, ady;
     Edge *newedge;
 
-    newedge = (Edge *) getfree(&efl);
+    newedge = (Edge *) getfree(&vp->efl);
 
     newedge->reg[0] = s1;
     newedge->reg[1] = s2;
@@ -59,27 +52,32 @@ Edge *bisect(Site * s1, Site * s2)
 	newedge->c /= dy;
     };
 
-    newedge->edgenbr = nedges;
+    newedge->edgenbr = vp->nedges;
 #ifdef STANDALONE
     out_bisector(newedge);
 #endif
-    nedges += 1;
+    vp->nedges += 1;
     return (newedge);
 }
 
 
-static void doSeg(Edge * e, double x1, double y1, double x2, double y2)
+static void doSeg(Voronoi_t * vp, Edge * e, double x1, double y1,
+		  double x2, double y2)
 {
-    addVertex(e->reg[0], x1, y1);
-    addVertex(e->reg[0], x2, y2);
-    addVertex(e->reg[1], x1, y1);
-    addVertex(e->reg[1], x2, y2);
+    addVertex(vp, e->reg[0], x1, y1);
+    addVertex(vp, e->reg[0], x2, y2);
+    addVertex(vp, e->reg[1], x1, y1);
+    addVertex(vp, e->reg[1], x2, y2);
 }
 
-void clip_line(Edge * e)
+void clip_line(Voronoi_t * vp, Edge * e)
 {
     Site *s1, *s2;
     double x1, x2, y1, y2;
+    double pxmin = vp->pxmin;
+    double pxmax = vp->pxmax;
+    double pymin = vp->pymin;
+    double pymax = vp->pymax;
 
     if (e->a == 1.0 && e->b >= 0.0) {
 	s1 = e->ep[1];
@@ -189,24 +187,24 @@ void clip_line(Edge * e)
 	};
     }
 
-    doSeg(e, x1, y1, x2, y2);
+    doSeg(vp, e, x1, y1, x2, y2);
 #ifdef STANDALONE
     if (doPS)
 	line(x1, y1, x2, y2);
 #endif
 }
 
-void endpoint(Edge * e, int lr, Site * s)
+void endpoint(Voronoi_t * vp, Edge * e, int lr, Site * s)
 {
     e->ep[lr] = s;
     ref(s);
     if (e->ep[re - lr] == (Site *) NULL)
 	return;
-    clip_line(e);
+    clip_line(vp, e);
 #ifdef STANDALONE
     out_ep(e);
 #endif
-    deref(e->reg[le]);
-    deref(e->reg[re]);
-    makefree(e, &efl);
+    deref(vp, e->reg[le]);
+    deref(vp, e->reg[re]);
+    makefree(e, &vp->efl);
 }
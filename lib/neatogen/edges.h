@@ -32,11 +32,10 @@ extern "C" {
 #define le 0
 #define re 1
 
-    extern double pxmin, pxmax, pymin, pymax;	/* clipping window */
-    extern void edgeinit(void);
-    extern void endpoint(Edge *, int, Site *);
-    extern void clip_line(Edge * e);
-    extern Edge *bisect(Site *, Site *);
+    extern void edgeinit(Voronoi_t *);
+    extern void endpoint(Voronoi_t *, Edge *, int, Site *);
+    extern void clip_line(Voronoi_t *, Edge * e);
+    extern Edge *bisect(Voronoi_t *, Site *, Site *);
 
 #endif
 
@@ -30,13 +30,6 @@ extern "C" {
 
     extern Point origin;
 
-    extern double xmin, xmax, ymin, ymax;	/* extreme x,y values of sites */
-    extern double deltax, deltay;	/* xmax - xmin, ymax - ymin */
-
-    extern int nsites;		/* Number of sites */
-    extern int sqrt_nsites;
-
-    extern void geominit(void);
     extern double dist_2(Point *, Point *);	/* Distance squared between two points */
     extern void subpt(Point * a, Point b, Point c);
     extern void addpt(Point * a, Point b, Point c);
@@ -15,41 +15,34 @@
 #include "render.h"
 #include <stdio.h>
 
-#include "mem.h"
-#include "hedges.h"
-#include "heap.h"
+#include "voronoi.h"
 
 
-static Halfedge *PQhash;
-static int PQhashsize;
-static int PQcount;
-static int PQmin;
-
-static int PQbucket(Halfedge * he)
+static int PQbucket(Voronoi_t * vp, Halfedge * he)
 {
     int bucket;
     double b;
 
-    b = (he->ystar - ymin) / deltay * PQhashsize;
+    b = (he->ystar - vp->ymin) / vp->deltay * vp->PQhashsize;
     if (b < 0)
 	bucket = 0;
-    else if (b >= PQhashsize)
-	bucket = PQhashsize - 1;
+    else if (b >= vp->PQhashsize)
+	bucket = vp->PQhashsize - 1;
     else
 	bucket = b;
-    if (bucket < PQmin)
-	PQmin = bucket;
+    if (bucket < vp->PQmin)
+	vp->PQmin = bucket;
     return (bucket);
 }
 
-void PQinsert(Halfedge * he, Site * v, double offset)
+void PQinsert(Voronoi_t * vp, Halfedge * he, Site * v, double offset)
 {
     Halfedge *last, *next;
 
     he->vertex = v;
     ref(v);
     he->ystar = v->coord.y + offset;
-    last = &PQhash[PQbucket(he)];
+    last = &vp->PQhash[PQbucket(vp, he)];
     while ((next = last->PQnext) != (struct Halfedge *) NULL &&
 	   (he->ystar > next->ystar ||
 	    (he->ystar == next->ystar
@@ -58,70 +51,71 @@ void PQinsert(Halfedge * he, Site * v, double offset)
     }
     he->PQnext = last->PQnext;
     last->PQnext = he;
-    PQcount += 1;
+    vp->PQcount += 1;
 }
 
-void PQdelete(Halfedge * he)
+void PQdelete(Voronoi_t * vp, Halfedge * he)
 {
     Halfedge *last;
 
     if (he->vertex != (Site *) NULL) {
-	last = &PQhash[PQbucket(he)];
+	last = &vp->PQhash[PQbucket(vp, he)];
 	while (last->PQnext != he)
 	    last = last->PQnext;
 	last->PQnext = he->PQnext;
-	PQcount -= 1;
-	deref(he->vertex);
+	vp->PQcount -= 1;
+	deref(vp, he->vertex);
 	he->vertex = (Site *) NULL;
     }
 }
 
 
-int PQempty(void)
+int PQempty(Voronoi_t * vp)
 {
-    return (PQcount == 0);
+    return (vp->PQcount == 0);
 }
 
 
-Point PQ_min(void)
+Point PQ_min(Voronoi_t * vp)
 {
     Point answer;
+    Halfedge *PQhash = vp->PQhash;
 
-    while (PQhash[PQmin].PQnext == (struct Halfedge *) NULL) {
-	PQmin += 1;
+    while (PQhash[vp->PQmin].PQnext == (struct Halfedge *) NULL) {
+	vp->PQmin += 1;
     }
-    answer.x = PQhash[PQmin].PQnext->vertex->coord.x;
-    answer.y = PQhash[PQmin].PQnext->ystar;
+    answer.x = PQhash[vp->PQmin].PQnext->vertex->coord.x;
+    answer.y = PQhash[vp->PQmin].PQnext->ystar;
     return (answer);
 }
 
-Halfedge *PQextractmin(void)
+Halfedge *PQextractmin(Voronoi_t * vp)
 {
     Halfedge *curr;
 
-    curr = PQhash[PQmin].PQnext;
-    PQhash[PQmin].PQnext = curr->PQnext;
-    PQcount -= 1;
+    curr = vp->PQhash[vp->PQmin].PQnext;
+    vp->PQhash[vp->PQmin].PQnext = curr->PQnext;
+    vp->PQcount -= 1;
     return (curr);
 }
 
-void PQcleanup(void)
+void PQcleanup(Voronoi_t * vp)
 {
-    free(PQhash);
-    PQhash = NULL;
+    free(vp->PQhash);
+    vp->PQhash = NULL;
 }
 
-void PQinitialize(void)
+void PQinitialize(Voronoi_t * vp)
 {
     int i;
 
-    PQcount = 0;
-    PQmin = 0;
-    PQhashsize = 4 * sqrt_nsites;
-    if (PQhash == NULL)
-	PQhash = N_GNEW(PQhashsize, Halfedge);
-    for (i = 0; i < PQhashsize; i += 1)
-	PQhash[i].PQnext = (Halfedge *) NULL;
+    vp->PQcount = 0;
+    vp->PQmin = 0;
+    vp->PQhashsize = 4 * vp->sqrt_nsites;
+    if (vp->PQhash == NULL)
+	vp->PQhash = N_GNEW(vp->PQhashsize, Halfedge);
+    for (i = 0; i < vp->PQhashsize; i += 1)
+	vp->PQhash[i].PQnext = (Halfedge *) NULL;
 }
 
 static void PQdumphe(Halfedge * p)
@@ -132,14 +126,14 @@ static void PQdumphe(Halfedge * p)
 	   p->ystar);
 }
 
-void PQdump(void)
+void PQdump(Voronoi_t * vp)
 {
     int i;
     Halfedge *p;
 
-    for (i = 0; i < PQhashsize; i += 1) {
+    for (i = 0; i < vp->PQhashsize; i += 1) {
 	printf("[%d]\n", i);
-	p = PQhash[i].PQnext;
+	p = vp->PQhash[i].PQnext;
 	while (p != NULL) {
 	    PQdumphe(p);
 	    p = p->PQnext;
@@ -22,13 +22,13 @@ extern "C" {
 
 #include "hedges.h"
 
-    extern void PQinitialize(void);
-    extern void PQcleanup(void);
-    extern Halfedge *PQextractmin(void);
-    extern Point PQ_min(void);
-    extern int PQempty(void);
-    extern void PQdelete(Halfedge *);
-    extern void PQinsert(Halfedge *, Site *, double);
+    extern void PQinitialize(Voronoi_t *);
+    extern void PQcleanup(Voronoi_t *);
+    extern Halfedge *PQextractmin(Voronoi_t *);
+    extern Point PQ_min(Voronoi_t *);
+    extern int PQempty(Voronoi_t *);
+    extern void PQdelete(Voronoi_t *, Halfedge *);
+    extern void PQinsert(Voronoi_t *, Halfedge *, Site *, double);
 
 #endif
 
@@ -11,49 +11,42 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
-#include "mem.h"
-#include "hedges.h"
 #include "render.h"
+#include "voronoi.h"
 
 
 #define DELETED -2
 
-Halfedge *ELleftend, *ELrightend;
-
-static Freelist hfl;
-static int ELhashsize;
-static Halfedge **ELhash;
-static int ntry, totalsearch;
-
-void ELcleanup()
+void ELcleanup(Voronoi_t * vp)
 {
-    freeinit(&hfl, sizeof **ELhash);
-    free(ELhash);
-    ELhash = NULL;
+    free(vp->ELhash);
+    vp->ELhash = NULL;
 }
 
-void ELinitialize()
+void ELinitialize(Voronoi_t * vp)
 {
     int i;
-
-    freeinit(&hfl, sizeof **ELhash);
-    ELhashsize = 2 * sqrt_nsites;
-    if (ELhash == NULL)
-	ELhash = N_GNEW(ELhashsize, Halfedge *);
-    for (i = 0; i < ELhashsize; i += 1)
+    Halfedge **ELhash;
+
+    freereset(&vp->hfl);
+    vp->ELhashsize = 2 * vp->sqrt_nsites;
+    if (vp->ELhash == NULL)
+	vp->ELhash = N_GNEW(vp->ELhashsize, Halfedge *);
+    ELhash = vp->ELhash;
+    for (i = 0; i < vp->ELhashsize; i += 1)
 	ELhash[i] = (Halfedge *) NULL;
-    ELleftend = HEcreate((Edge *) NULL, 0);
-    ELrightend = HEcreate((Edge *) NULL, 0);
-    ELleftend->ELleft = (Halfedge *) NULL;
-    ELleftend->ELright = ELrightend;
-    ELrightend->ELleft = ELleftend;
-    ELrightend->ELright = (Halfedge *) NULL;
-    ELhash[0] = ELleftend;
-    ELhash[ELhashsize - 1] = ELrightend;
+    vp->ELleftend = HEcreate(vp, (Edge *) NULL, 0);
+    vp->ELrightend = HEcreate(vp, (Edge *) NULL, 0);
+    vp->ELleftend->ELleft = (Halfedge *) NULL;
+    vp->ELleftend->ELright = vp->ELrightend;
+    vp->ELrightend->ELleft = vp->ELleftend;
+    vp->ELrightend->ELright = (Halfedge *) NULL;
+    ELhash[0] = vp->ELleftend;
+    ELhash[vp->ELhashsize - 1] = vp->ELrightend;
 }
 
 
-Site *hintersect(Halfedge * el1, Halfedge * el2)
+Site *hintersect(Voronoi_t * vp, Halfedge * el1, Halfedge * el2)
 {
     Edge *e1, *e2, *e;
     Halfedge *el;
@@ -89,7 +82,7 @@ Site *hintersect(Halfedge * el1, Halfedge * el2)
 	(!right_of_site && el->ELpm == re))
 	return ((Site *) NULL);
 
-    v = getsite();
+    v = getsite(vp);
     v->refcnt = 0;
     v->coord.x = xint;
     v->coord.y = yint;
@@ -144,10 +137,10 @@ int right_of(Halfedge * el, Point * p)
     return (el->ELpm == le ? above : !above);
 }
 
-Halfedge *HEcreate(Edge * e, char pm)
+Halfedge *HEcreate(Voronoi_t * vp, Edge * e, char pm)
 {
     Halfedge *answer;
-    answer = (Halfedge *) getfree(&hfl);
+    answer = (Halfedge *) getfree(&vp->hfl);
     answer->ELedge = e;
     answer->ELpm = pm;
     answer->PQnext = (Halfedge *) NULL;
@@ -166,45 +159,47 @@ void ELinsert(Halfedge * lb, Halfedge * new)
 }
 
 /* Get entry from hash table, pruning any deleted nodes */
-static Halfedge *ELgethash(int b)
+static Halfedge *ELgethash(Voronoi_t * vp, int b)
 {
     Halfedge *he;
 
-    if (b < 0 || b >= ELhashsize)
+    if (b < 0 || b >= vp->ELhashsize)
 	return ((Halfedge *) NULL);
-    he = ELhash[b];
+    he = vp->ELhash[b];
     if (he == (Halfedge *) NULL || he->ELedge != (Edge *) DELETED)
 	return (he);
 
 /* Hash table points to deleted half edge.  Patch as necessary. */
-    ELhash[b] = (Halfedge *) NULL;
+    vp->ELhash[b] = (Halfedge *) NULL;
     if ((he->ELrefcnt -= 1) == 0)
-	makefree(he, &hfl);
+	makefree(he, &vp->hfl);
     return ((Halfedge *) NULL);
 }
 
-Halfedge *ELleftbnd(Point * p)
+Halfedge *ELleftbnd(Voronoi_t * vp, Point * p)
 {
     int i, bucket;
     Halfedge *he;
+    Halfedge *ELleftend = vp->ELleftend;
+    Halfedge *ELrightend = vp->ELrightend;
+    Halfedge **ELhash = vp->ELhash;
+    int ELhashsize = vp->ELhashsize;
 
 /* Use hash table to get close to desired halfedge */
-    bucket = (p->x - xmin) / deltax * ELhashsize;
+    bucket = (p->x - vp->xmin) / vp->deltax * ELhashsize;
     if (bucket < 0)
 	bucket = 0;
     if (bucket >= ELhashsize)
 	bucket = ELhashsize - 1;
-    he = ELgethash(bucket);
+    he = ELgethash(vp, bucket);
     if (he == (Halfedge *) NULL) {
 	for (i = 1; 1; i += 1) {
-	    if ((he = ELgethash(bucket - i)) != (Halfedge *) NULL)
+	    if ((he = ELgethash(vp, bucket - i)) != (Halfedge *) NULL)
 		break;
-	    if ((he = ELgethash(bucket + i)) != (Halfedge *) NULL)
+	    if ((he = ELgethash(vp, bucket + i)) != (Halfedge *) NULL)
 		break;
 	};
-	totalsearch += i;
     };
-    ntry += 1;
 /* Now search linear list of halfedges for the corect one */
     if (he == ELleftend || (he != ELrightend && right_of(he, p))) {
 	do {
@@ -248,16 +243,16 @@ Halfedge *ELleft(Halfedge * he)
 }
 
 
-Site *leftreg(Halfedge * he)
+Site *leftreg(Voronoi_t * vp, Halfedge * he)
 {
     if (he->ELedge == (Edge *) NULL)
-	return (bottomsite);
+	return (vp->bottomsite);
     return (he->ELpm == le ? he->ELedge->reg[le] : he->ELedge->reg[re]);
 }
 
-Site *rightreg(Halfedge * he)
+Site *rightreg(Voronoi_t * vp, Halfedge * he)
 {
     if (he->ELedge == (Edge *) NULL)
-	return (bottomsite);
+	return (vp->bottomsite);
     return (he->ELpm == le ? he->ELedge->reg[re] : he->ELedge->reg[le]);
 }
@@ -33,19 +33,17 @@ extern "C" {
 	struct Halfedge *PQnext;
     } Halfedge;
 
-    extern Halfedge *ELleftend, *ELrightend;
-
-    extern void ELinitialize(void);
-    extern void ELcleanup(void);
+    extern void ELinitialize(Voronoi_t *);
+    extern void ELcleanup(Voronoi_t *);
     extern int right_of(Halfedge *, Point *);
-    extern Site *hintersect(Halfedge *, Halfedge *);
-    extern Halfedge *HEcreate(Edge *, char);
+    extern Site *hintersect(Voronoi_t *, Halfedge *, Halfedge *);
+    extern Halfedge *HEcreate(Voronoi_t *, Edge *, char);
     extern void ELinsert(Halfedge *, Halfedge *);
-    extern Halfedge *ELleftbnd(Point *);
+    extern Halfedge *ELleftbnd(Voronoi_t *, Point *);
     extern void ELdelete(Halfedge *);
     extern Halfedge *ELleft(Halfedge *), *ELright(Halfedge *);
-    extern Halfedge *ELleftbnd(Point *);
-    extern Site *leftreg(Halfedge *), *rightreg(Halfedge *);
+    extern Site *leftreg(Voronoi_t *, Halfedge *);
+    extern Site *rightreg(Voronoi_t *, Halfedge *);
 
 #endif
 
@@ -13,16 +13,12 @@
 
 #include "neato.h"
 #include <stdio.h>
-#include "mem.h"
-#include "info.h"
+#include "voronoi.h"
 
 
-Info_t *nodeInfo;		/* Array of node info */
-static Freelist pfl;
-
-void infoinit()
+void infoinit(Voronoi_t * vp)
 {
-    freeinit(&pfl, sizeof(PtItem));
+    freereset(&vp->pfl);
 }
 
 /* compare:
@@ -158,7 +154,7 @@ static int sorted(Point * origin, PtItem * vp)
 }
 #endif
 
-void addVertex(Site * s, double x, double y)
+void addVertex(Voronoi_t * vp, Site * s, double x, double y)
 {
     Info_t *ip;
     PtItem *p;
@@ -168,7 +164,7 @@ void addVertex(Site * s, double x, double y)
     PtItem tmp;
     int cmp;
 
-    ip = nodeInfo + (s->sitenbr);
+    ip = vp->nodeInfo + (s->sitenbr);
     curr = ip->verts;
 
     tmp.p.x = x;
@@ -178,7 +174,7 @@ void addVertex(Site * s, double x, double y)
     if (cmp == 0)
 	return;
     else if (cmp < 0) {
-	p = (PtItem *) getfree(&pfl);
+	p = (PtItem *) getfree(&vp->pfl);
 	p->p.x = x;
 	p->p.y = y;
 	p->next = curr;
@@ -194,7 +190,7 @@ void addVertex(Site * s, double x, double y)
     }
     if (cmp == 0)
 	return;
-    p = (PtItem *) getfree(&pfl);
+    p = (PtItem *) getfree(&vp->pfl);
     p->p.x = x;
     p->p.y = y;
     prev->next = p;
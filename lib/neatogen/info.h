@@ -19,7 +19,7 @@ extern "C" {
 #ifndef INFO_H
 #define INFO_H
 
-#include "voronoi.h"
+#include "site.h"
 #include "poly.h"
 
     typedef struct ptitem {	/* Point list */
@@ -36,11 +36,9 @@ extern "C" {
 	/* voronoi polygon */
     } Info_t;
 
-    extern Info_t *nodeInfo;	/* Array of node info */
-
-    extern void infoinit(void);
+    extern void infoinit(Voronoi_t *);
     /* Insert vertex into sorted list */
-    extern void addVertex(Site *, double, double);
+    extern void addVertex(Voronoi_t *, Site *, double, double);
 #endif
 
 #ifdef __cplusplus
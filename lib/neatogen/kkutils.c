@@ -55,6 +55,8 @@ void empty_neighbors_vec(vtx_data * graph, int vtx, int *vtx_vec)
 
 /* compute_apsp_dijkstra:
  * Assumes the graph has weights
+ * The sources are independent and each fills its own row,
+ * so they run in parallel.
  */
 static DistType **compute_apsp_dijkstra(vtx_data * graph, int n)
 {
@@ -67,6 +69,7 @@ static DistType **compute_apsp_dijkstra(vtx_data * graph, int n)
     for (i = 0; i < n; i++)
 	dij[i] = storage + i * n;
 
+#pragma omp parallel for schedule(dynamic, 16)
     for (i = 0; i < n; i++) {
 	dijkstra(i, graph, n, dij[i]);
     }
@@ -80,17 +83,23 @@ static DistType **compute_apsp_simple(vtx_data * graph, int n)
     int i;
     DistType *storage = N_GNEW(n * n, int);
     DistType **dij;
-    Queue Q;
 
     dij = N_GNEW(n, DistType *);
     for (i = 0; i < n; i++) {
 	dij[i] = storage + i * n;
     }
-    mkQueue(&Q, n);
-    for (i = 0; i < n; i++) {
-	bfs(i, graph, n, dij[i], &Q);
+#pragma omp parallel
+    {
+	Queue Q;		/* one queue per thread */
+	int j;
+
+	mkQueue(&Q, n);
+#pragma omp for schedule(dynamic, 16)
+	for (j = 0; j < n; j++) {
+	    bfs(j, graph, n, dij[j], &Q);
+	}
+	freeQueue(&Q);
     }
-    freeQueue(&Q);
     return dij;
 }
 
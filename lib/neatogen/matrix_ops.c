@@ -16,10 +16,31 @@
 #include "memory.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 static double p_iteration_threshold = 1e-3;
 
+/* On x86-64 with gcc and glibc, the kernels for packed matrices are
+ * compiled for AVX2 and AVX as well, and the loader picks the version
+ * for the running cpu.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 6) && defined(__x86_64__) && defined(__GLIBC__)
+#define SIMD_CLONES __attribute__((target_clones("avx2","avx","default")))
+#else
+#define SIMD_CLONES
+#endif
+
+/* The rows of a packed matrix are multiplied in this many blocks,
+ * each with an equal share of the entries and its own buffer for the
+ * entries below the diagonal. The buffers are added in block order,
+ * so the product does not depend on the number of threads.
+ */
+#define PACKED_BLOCKS 32
+
+/* Packed matrices with fewer rows are multiplied in one block */
+#define PACKED_PARALLEL_N 2000
+
 int
 power_iteration(double **square_mat, int n, int neigs, double **eigs,
 		double *evals, int initialize)
@@ -549,13 +570,14 @@ void orthog1f(int n, float *vec)
 
     sum = 0.0;
     pntr = vec;
-    for (i = n; i; i--) {
-	sum += *pntr++;
+#pragma omp simd reduction(+:sum)
+    for (i = 0; i < n; i++) {
+	sum += pntr[i];
     }
     sum /= n;
-    pntr = vec;
-    for (i = n; i; i--) {
-	*pntr++ -= sum;
+#pragma omp simd
+    for (i = 0; i < n; i++) {
+	pntr[i] -= sum;
     }
 }
 
@@ -590,28 +612,84 @@ void right_mult_with_vector_fd
 #endif
 
 /* inline */
-void right_mult_with_vector_ff
-    (float *packed_matrix, int n, float *vector, float *result) {
-    /* packed matrix is the upper-triangular part of a symmetric matrix arranged in a vector row-wise */
-    int i, j, index;
-    float vector_i;
+/* packed_rows_mult:
+ * Multiply rows i0 to i1-1 of the packed symmetric matrix by vector.
+ * index is the position of row i0 in packed_matrix. Row i adds its
+ * dot product with vector to result[i] and its entries times vector[i]
+ * to result[j], j > i, so result must be zero from i0 on.
+ * vector and result must not overlap.
+ */
+SIMD_CLONES static void
+packed_rows_mult(float *packed_matrix, size_t index, int n, int i0,
+		 int i1, float *vector, float *result)
+{
+    int i, j, len;
+    float vector_i, res;
+    float *row, *vec, *out;
 
-    float res;
-    for (i = 0; i < n; i++) {
-	result[i] = 0;
-    }
-    for (index = 0, i = 0; i < n; i++) {
-	res = 0;
+    for (i = i0; i < i1; i++) {
+	row = packed_matrix + index;
 	vector_i = vector[i];
 	/* deal with main diag */
-	res += packed_matrix[index++] * vector_i;
+	res = row[0] * vector_i;
 	/* deal with off diag */
-	for (j = i + 1; j < n; j++, index++) {
-	    res += packed_matrix[index] * vector[j];
-	    result[j] += packed_matrix[index] * vector_i;
+	len = n - i - 1;
+	row++;
+	vec = vector + i + 1;
+	out = result + i + 1;
+#pragma omp simd reduction(+:res)
+	for (j = 0; j < len; j++) {
+	    res += row[j] * vec[j];
+	    out[j] += row[j] * vector_i;
 	}
 	result[i] += res;
+	index += n - i;
+    }
+}
+
+void right_mult_with_vector_ff
+    (float *packed_matrix, int n, float *vector, float *result) {
+    /* packed matrix is the upper-triangular part of a symmetric matrix arranged in a vector row-wise */
+    int start[PACKED_BLOCKS + 1];
+    size_t index[PACKED_BLOCKS];
+    size_t count, total;
+    float *buf;
+    int b, i, j;
+
+    memset(result, 0, n * sizeof(float));
+    if (n < PACKED_PARALLEL_N) {
+	packed_rows_mult(packed_matrix, 0, n, 0, n, vector, result);
+	return;
+    }
+
+    /* split the rows into blocks of about total/PACKED_BLOCKS entries */
+    total = (size_t) n *(n + 1) / 2;
+    for (b = 0, i = 0, count = 0; b < PACKED_BLOCKS; b++) {
+	while (count < total / PACKED_BLOCKS * b) {
+	    count += n - i;
+	    i++;
+	}
+	start[b] = i;
+	index[b] = count;
+    }
+    start[PACKED_BLOCKS] = n;
+
+    /* block 0 goes directly into result */
+    buf = N_GNEW((size_t) (PACKED_BLOCKS - 1) * n, float);
+#pragma omp parallel for private(i) schedule(dynamic, 1)
+    for (b = 0; b < PACKED_BLOCKS; b++) {
+	float *out = (b == 0) ? result : buf + (size_t) (b - 1) * n;
+	for (i = start[b]; i < n; i++)
+	    out[i] = 0;
+	packed_rows_mult(packed_matrix, index[b], n, start[b], start[b + 1],
+			 vector, out);
+    }
+#pragma omp parallel for private(b)
+    for (j = 0; j < n; j++) {
+	for (b = 1; (b < PACKED_BLOCKS) && (start[b] <= j); b++)
+	    result[j] += buf[(size_t) (b - 1) * n + j];
     }
+    free(buf);
 }
 
 /* inline */
@@ -619,6 +697,7 @@ void
 vectors_substractionf(int n, float *vector1, float *vector2, float *result)
 {
     int i;
+#pragma omp simd
     for (i = 0; i < n; i++) {
 	result[i] = vector1[i] - vector2[i];
     }
@@ -629,6 +708,7 @@ void
 vectors_additionf(int n, float *vector1, float *vector2, float *result)
 {
     int i;
+#pragma omp simd
     for (i = 0; i < n; i++) {
 	result[i] = vector1[i] + vector2[i];
     }
@@ -639,6 +719,7 @@ void
 vectors_mult_additionf(int n, float *vector1, float alpha, float *vector2)
 {
     int i;
+#pragma omp simd
     for (i = 0; i < n; i++) {
 	vector1[i] = vector1[i] + alpha * vector2[i];
     }
@@ -648,6 +729,7 @@ vectors_mult_additionf(int n, float *vector1, float alpha, float *vector2)
 void vectors_scalar_multf(int n, float *vector, float alpha, float *result)
 {
     int i;
+#pragma omp simd
     for (i = 0; i < n; i++) {
 	result[i] = (float) vector[i] * alpha;
     }
@@ -656,9 +738,7 @@ void vectors_scalar_multf(int n, float *vector, float alpha, float *result)
 /* inline */
 void copy_vectorf(int n, float *source, float *dest)
 {
-    int i;
-    for (i = 0; i < n; i++)
-	dest[i] = source[i];
+    memcpy(dest, source, n * sizeof(float));
 }
 
 /* inline */
@@ -666,6 +746,7 @@ double vectors_inner_productf(int n, float *vector1, float *vector2)
 {
     int i;
     double result = 0;
+#pragma omp simd reduction(+:result)
     for (i = 0; i < n; i++) {
 	result += vector1[i] * vector2[i];
     }
@@ -694,9 +775,12 @@ double max_absf(int n, float *vector)
 {
     int i;
     float max_val = -1e30f;
-    for (i = 0; i < n; i++)
-	if (fabs(vector[i]) > max_val)
-	    max_val = (float) (fabs(vector[i]));
+    float v;
+#pragma omp simd reduction(max:max_val) private(v)
+    for (i = 0; i < n; i++) {
+	v = fabsf(vector[i]);
+	max_val = v > max_val ? v : max_val;
+    }
 
     return max_val;
 }
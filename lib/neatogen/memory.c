@@ -11,7 +11,6 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
-#include "geometry.h"
 #include "render.h"
 
 typedef struct freenode {
@@ -40,11 +39,16 @@ static int gcd(int y, int x)
 
 #define LCM(x,y) ((x)%(y) == 0 ? (x) : (y)%(x) == 0 ? (y) : x*(y/gcd(x,y)))
 
-void freeinit(Freelist * fl, int size)
+/* freeinit:
+ * Set up fl for nodes of the given size, allocated nodesperblock
+ * at a time. Any blocks fl already holds are freed.
+ */
+void freeinit(Freelist * fl, int size, int nodesperblock)
 {
 
     fl->head = NULL;
     fl->nodesize = LCM(size, sizeof(Freenode));
+    fl->nodesperblock = nodesperblock;
     if (fl->blocklist != NULL) {
 	Freeblock *bp, *np;
 
@@ -59,6 +63,24 @@ void freeinit(Freelist * fl, int size)
     fl->blocklist = NULL;
 }
 
+/* freereset:
+ * Return every node of fl to the free list, keeping the blocks
+ * for reuse. Any node handed out by getfree becomes invalid.
+ */
+void freereset(Freelist * fl)
+{
+    Freeblock *bp;
+    char *cp;
+    int i;
+
+    fl->head = NULL;
+    for (bp = fl->blocklist; bp != NULL; bp = bp->next) {
+	cp = (char *) (bp->nodes);
+	for (i = 0; i < fl->nodesperblock; i++)
+	    makefree(cp + i * fl->nodesize, fl);
+    }
+}
+
 void *getfree(Freelist * fl)
 {
     int i;
@@ -70,9 +92,9 @@ void *getfree(Freelist * fl)
 	char *cp;
 
 	mem = GNEW(Freeblock);
-	mem->nodes = gmalloc(sqrt_nsites * size);
+	mem->nodes = gmalloc(fl->nodesperblock * size);
 	cp = (char *) (mem->nodes);
-	for (i = 0; i < sqrt_nsites; i++) {
+	for (i = 0; i < fl->nodesperblock; i++) {
 	    makefree(cp + i * size, fl);
 	}
 	mem->next = fl->blocklist;
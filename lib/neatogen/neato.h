@@ -28,6 +28,12 @@
 #define MODE_MAJOR       1
 #define MODE_HIER        2
 #define MODE_IPSEP       3
+#define MODE_SPARSE      4
+
+/* Components with more nodes than this use MODE_SPARSE unless
+ * a mode is given, as the other modes need quadratic memory.
+ */
+#define SPARSE_NODES     10000
 
 #define INIT_ERROR       -1
 #define INIT_SELF        0
@@ -662,6 +662,8 @@ static int neatoMode(graph_t * g)
 	    mode = MODE_KK;
 	else if (streq(str, "major"))
 	    mode = MODE_MAJOR;
+	else if (streq(str, "sparse"))
+	    mode = MODE_SPARSE;
 #ifdef DIGCOLA
 	else if (streq(str, "hier"))
 	    mode = MODE_HIER;
@@ -1120,7 +1122,7 @@ void dumpOpts (ipsep_options* opp, int nv)
  * Solve stress using majorization.
  * Old neato attributes to incorporate:
  *  weight
- * mode will be MODE_MAJOR, MODE_HIER or MODE_IPSEP
+ * mode will be MODE_MAJOR, MODE_SPARSE, MODE_HIER or MODE_IPSEP
  */
 static void
 majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, int steps, adjust_data* am)
@@ -1136,7 +1138,7 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, int
     expand_t margin;
 #endif
 #endif
-    int init = checkStart(g, nv, (mode == MODE_HIER ? INIT_SELF : INIT_RANDOM));
+    int init = checkStart(g, nv, ((mode == MODE_HIER) || (mode == MODE_SPARSE) ? INIT_SELF : INIT_RANDOM));
     int opts = checkExp (g);
 	
     if (init == INIT_SELF)
@@ -1161,6 +1163,9 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, int
 	fprintf(stderr, "%d nodes %.2f sec\n", nv, elapsed_sec());
     }
 
+    if (mode == MODE_SPARSE)
+	rv = sparse_stress_majorization_kD(gp, nv, ne, coords, nodes, Ndim, opts, model, MaxIter, num_pivots_sparse);
+    else
 #ifdef DIGCOLA
     if (mode != MODE_MAJOR) {
         double lgap = late_double(g, agfindgraphattr(g, "levelsgap"), 0.0, -MAXDOUBLE);
@@ -1334,6 +1339,46 @@ static void kkNeato(Agraph_t * g, int nG, int model)
     solve_model(g, nG);
 }
 
+/* largestComp:
+ * Return the number of nodes in the largest connected component of g.
+ * The graph passed to neatoLayout may hold several components, e.g.,
+ * when it is not packed or they are merged by pinned nodes.
+ */
+static int largestComp(Agraph_t * g)
+{
+    Agnode_t *n, *v, *w;
+    Agedge_t *e;
+    Agnode_t **stk = N_NEW(agnnodes(g), Agnode_t *);
+    int top, sz, maxsz = 0;
+
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	ND_mark(n) = FALSE;
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	if (ND_mark(n))
+	    continue;
+	ND_mark(n) = TRUE;
+	stk[0] = n;
+	top = 1;
+	sz = 0;
+	while (top > 0) {
+	    v = stk[--top];
+	    sz++;
+	    for (e = agfstedge(g, v); e; e = agnxtedge(g, e, v)) {
+		w = (agtail(e) == v) ? aghead(e) : agtail(e);
+		if (!ND_mark(w)) {
+		    ND_mark(w) = TRUE;
+		    stk[top++] = w;
+		}
+	    }
+	}
+	maxsz = MAX(maxsz, sz);
+    }
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	ND_mark(n) = FALSE;
+    free(stk);
+    return maxsz;
+}
+
 /* neatoLayout:
  * Use stress optimization to layout a single component
  */
@@ -1344,9 +1389,19 @@ neatoLayout(Agraph_t * mg, Agraph_t * g, int layoutMode, int layoutModel,
     int nG;
     char *str;
 
+    /* large components use sparse stress unless a mode is given */
+    if ((layoutMode == MODE_MAJOR) && (agnnodes(g) > SPARSE_NODES)
+	&& (layoutModel != MODEL_CIRCUIT)
+	&& (!(str = agget(g, "mode")) || !*str)
+	&& (largestComp(g) > SPARSE_NODES)) {
+	if (Verbose)
+	    fprintf(stderr, "component of more than %d nodes: using mode=sparse\n", SPARSE_NODES);
+	layoutMode = MODE_SPARSE;
+    }
+
     if ((str = agget(g, "maxiter")))
 	MaxIter = atoi(str);
-    else if (layoutMode == MODE_MAJOR)
+    else if ((layoutMode == MODE_MAJOR) || (layoutMode == MODE_SPARSE))
 	MaxIter = DFLT_ITERATIONS;
     else
 	MaxIter = 100 * agnnodes(g);
@@ -22,17 +22,13 @@ extern "C" {
     extern int allow_edits(int);
     extern void avoid_cycling(graph_t *, Agnode_t *, double *);
     extern int checkStart(graph_t * G, int nG, int);
-    extern Agnode_t *choose_node(graph_t *, int);
     extern int circuit_model(graph_t *, int);
-    extern void D2E(Agraph_t *, int, int, double *);
     extern void diffeq_model(graph_t *, int);
     extern double distvec(double *, double *, double *);
     extern void final_energy(graph_t *, int);
     extern double fpow32(double);
     extern Ppolyline_t getPath(edge_t *, vconfig_t *, int, Ppoly_t **,
 			       int);
-    extern void heapdown(Agnode_t *);
-    extern void heapup(Agnode_t *);
     extern void initial_positions(graph_t *, int);
     extern int init_port(Agnode_t *, Agedge_t *, char *, boolean);
     extern void jitter3d(Agnode_t *, int);
@@ -41,16 +37,12 @@ extern "C" {
     extern void makeSelfArcs(path * P, edge_t * e, int stepx);
     extern void makeSpline(graph_t*, edge_t *, Ppoly_t **, int, boolean);
     extern void make_spring(graph_t *, Agnode_t *, Agnode_t *, double);
-    extern void move_node(graph_t *, int, Agnode_t *);
     extern int init_nop(graph_t * g, int);
     extern void neato_cleanup(graph_t * g);
-    extern node_t *neato_dequeue(void);
-    extern void neato_enqueue(node_t *);
     extern void neato_init_node(node_t * n);
     extern void neato_layout(Agraph_t * g);
     extern int Plegal_arrangement(Ppoly_t ** polys, int n_polys);
     extern void randompos(Agnode_t *, int);
-    extern void s1(graph_t *, node_t *);
     extern int scan_graph(graph_t *);
     extern int scan_graph_mode(graph_t * G, int mode);
     extern void free_scan_graph(graph_t *);
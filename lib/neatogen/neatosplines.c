@@ -599,12 +599,20 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
 	    (vconfig ? (edgetype == ET_SPLINE ? "splines" : "polylines") : 
 		"line segments"));
     if (vconfig) {
-	/* path-finding pass */
+	/* path-finding pass. Pobspath only reads vconfig, so the paths
+	 * are found in parallel.
+	 */
+	edge_t **edges = N_NEW(agnedges(g), edge_t *);
+	int nedges = 0;
 	for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
 	    for (e = agfstout(g, n); e; e = agnxtout(g, e)) {
-		ED_path(e) = getPath(e, vconfig, TRUE, obs, npoly);
+		edges[nedges++] = e;
 	    }
 	}
+#pragma omp parallel for schedule(dynamic)
+	for (i = 0; i < nedges; i++)
+	    ED_path(edges[i]) = getPath(edges[i], vconfig, TRUE, obs, npoly);
+	free(edges);
     }
 #ifdef ORTHO
     else if (legal && (edgetype == ET_ORTHO)) {
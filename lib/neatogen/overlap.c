@@ -15,12 +15,11 @@
 #include "config.h"
 #endif
 
-#if ((defined(HAVE_GTS) || defined(HAVE_TRIANGLE)) && defined(SFDP))
+#ifdef SFDP
 
 #include "SparseMatrix.h"
 #include "overlap.h"
 #include "call_tri.h"
-#include "red_black_tree.h"
 #include "types.h"
 #include "memory.h"
 #include "globals.h"
@@ -77,14 +76,9 @@ static void ideal_distance_avoid_overlap(int dim, SparseMatrix A, real *x, real
   return;
 }
 
-#define collide(i,j) ((ABS(x[(i)*dim] - x[(j)*dim]) < width[(i)*dim]+width[(j)*dim]) || (ABS(x[(i)*dim+1] - x[(j)*dim+1]) < width[(i)*dim+1]+width[(j)*dim+1]))
-
-enum {INTV_OPEN, INTV_CLOSE};
-
 struct scan_point_struct{
   int node;
   real x;
-  int status;
 };
 
 typedef struct scan_point_struct scan_point;
@@ -108,157 +102,80 @@ static int comp_scan_points(const void *p, const void *q){
   return 0;
 }
 
-
-void NodeDest(void* a) {
-  /*  free((int*)a);*/
-}
-
-
-
-int NodeComp(const void* a,const void* b) {
-  return comp_scan_points(a,b);
-
-}
-
-void NodePrint(const void* a) {
-  scan_point *aa;
-
-  aa = (scan_point *) a;
-  fprintf(stderr, "node {%d, %f, %d}\n", aa->node, aa->x, aa->status);
-
-}
-
-void InfoPrint(void* a) {
-  ;
-}
-
-void InfoDest(void *a){
-  ;
+static int scan_overlaps(int dim, int n, real *x, real *width, scan_point *scanpoints, int k, int *neighbors){
+  /* find the nodes overlapping scanpoints[k].node that come after it in scanpoints, which is sorted on
+     the left side of the boxes. These start before box k ends. Return how many there are, storing them
+     in neighbors if not NULL. */
+  int i = scanpoints[k].node, j, nz = 0;
+  real xsto = x[i*dim] + width[i*dim];
+  real bsta = x[i*dim+1] - width[i*dim+1], bsto = x[i*dim+1] + width[i*dim+1], bbsta, bbsto;
+
+  for (k++; k < n && scanpoints[k].x <= xsto; k++){
+    j = scanpoints[k].node;
+    bbsta = x[j*dim+1] - width[j*dim+1]; bbsto = x[j*dim+1] + width[j*dim+1];
+    if (ABS(0.5*(bsta+bsto) - 0.5*(bbsta+bbsto)) < 0.5*(bsto-bsta) + 0.5*(bbsto-bbsta)){/* if the distance of the centers of the interval is less than sum of width, we have overlap */
+      if (neighbors) neighbors[nz] = j;
+      nz++;
+    }
+  }
+  return nz;
 }
 
 static SparseMatrix get_overlap_graph(int dim, int n, real *x, real *width, int check_overlap_only){
-  /* if check_overlap_only = TRUE, we only check whether there is one overlap */
-  scan_point *scanpointsx, *scanpointsy;
-  int i, k, neighbor;
+  /* if check_overlap_only = TRUE, we only check whether there is one overlap.
+     Boxes are sorted on their left side and each is checked against those starting before it ends.
+     The boxes are independent, so this runs in parallel: the overlaps of each box are counted,
+     then stored in the slots the counts give. */
+  scan_point *scanpoints;
+  int i, k, nz = 0, *start, *irn, *jcn;
+  real *val;
   SparseMatrix A = NULL, B = NULL;
-  rb_red_blk_node *newNode, *newNode0, *newNode2 = NULL;
-  rb_red_blk_tree* treey;
-  real one = 1;
-
-  A = SparseMatrix_new(n, n, 1, MATRIX_TYPE_REAL, FORMAT_COORD);
-
-  scanpointsx = N_GNEW(2*n,scan_point);
-  for (i = 0; i < n; i++){
-    scanpointsx[2*i].node = i;
-    scanpointsx[2*i].x = x[i*dim] - width[i*dim];
-    scanpointsx[2*i].status = INTV_OPEN;
-    scanpointsx[2*i+1].node = i+n;
-    scanpointsx[2*i+1].x = x[i*dim] + width[i*dim];
-    scanpointsx[2*i+1].status = INTV_CLOSE;
-  }
-  qsort(scanpointsx, 2*n, sizeof(scan_point), comp_scan_points);
 
-  scanpointsy = N_GNEW(2*n,scan_point);
+  scanpoints = N_GNEW(n,scan_point);
   for (i = 0; i < n; i++){
-    scanpointsy[i].node = i;
-    scanpointsy[i].x = x[i*dim+1] - width[i*dim+1];
-    scanpointsy[i].status = INTV_OPEN;
-    scanpointsy[i+n].node = i;
-    scanpointsy[i+n].x = x[i*dim+1] + width[i*dim+1];
-    scanpointsy[i+n].status = INTV_CLOSE;
+    scanpoints[i].node = i;
+    scanpoints[i].x = x[i*dim] - width[i*dim];
   }
-
-
-  treey = RBTreeCreate(NodeComp,NodeDest,InfoDest,NodePrint,InfoPrint);
-
-  for (i = 0; i < 2*n; i++){
-#ifdef DEBUG_RBTREE
-    fprintf(stderr," k = %d node = %d x====%f\n",(scanpointsx[i].node)%n, (scanpointsx[i].node), (scanpointsx[i].x));
-#endif
-
-    k = (scanpointsx[i].node)%n;
-
-
-    if (scanpointsx[i].status == INTV_OPEN){
-#ifdef DEBUG_RBTREE
-      fprintf(stderr, "inserting...");
-      treey->PrintKey(&(scanpointsy[k]));
-#endif
-
-      RBTreeInsert(treey, &(scanpointsy[k]), NULL); /* add both open and close int for y */
-
-#ifdef DEBUG_RBTREE
-      fprintf(stderr, "inserting2...");
-      treey->PrintKey(&(scanpointsy[k+n]));
-#endif
-
-      RBTreeInsert(treey, &(scanpointsy[k+n]), NULL);
-    } else {
-      real bsta, bbsta, bsto, bbsto; int ii; 
-
-      assert(scanpointsx[i].node >= n);
-
-      newNode = newNode0 = RBExactQuery(treey, &(scanpointsy[k + n]));
-      ii = ((scan_point *)newNode->key)->node;
-      assert(ii < n);
-      bsta = scanpointsy[ii].x; bsto = scanpointsy[ii+n].x;
-
-#ifdef DEBUG_RBTREE
-      fprintf(stderr, "poping..%d....yinterval={%f,%f}\n", scanpointsy[k + n].node, bsta, bsto);
-      treey->PrintKey(newNode->key);
-#endif
-
-     assert(treey->nil != newNode);
-      while ((newNode) && ((newNode = TreePredecessor(treey, newNode)) != treey->nil)){
-	neighbor = (((scan_point *)newNode->key)->node)%n;
-	bbsta = scanpointsy[neighbor].x; bbsto = scanpointsy[neighbor+n].x;/* the y-interval of the node that has one end of the interval lower than the top of the leaving interval (bsto) */
-#ifdef DEBUG_RBTREE
-	fprintf(stderr," predecessor is node %d y = %f\n", ((scan_point *)newNode->key)->node, ((scan_point *)newNode->key)->x);
-#endif
-	if (neighbor != k){
-	  if (ABS(0.5*(bsta+bsto) - 0.5*(bbsta+bbsto)) < 0.5*(bsto-bsta) + 0.5*(bbsto-bbsta)){/* if the distance of the centers of the interval is less than sum of width, we have overlap */
-	    A = SparseMatrix_coordinate_form_add_entries(A, 1, &neighbor, &k, &one);
-#ifdef DEBUG_RBTREE
-	    fprintf(stderr,"======================================  %d %d\n",k,neighbor);
-#endif
-	    if (check_overlap_only) goto check_overlap_RETURN;
-	  }
-	} else {
-	  newNode2 = newNode;
-	}
-
-      }
-
-#ifdef DEBUG_RBTREE
-      fprintf(stderr, "deleteing...");
-      treey->PrintKey(newNode0->key);
-#endif
-
-      if (newNode0) RBDelete(treey,newNode0);
-
-
-     if (newNode2 && newNode2 != treey->nil && newNode2 != newNode0) {
-
-#ifdef DEBUG_RBTREE
-	fprintf(stderr, "deleteing2...");
-	treey->PrintKey(newNode2->key);
-#endif
-
-	if (newNode0) RBDelete(treey,newNode2);
+  qsort(scanpoints, n, sizeof(scan_point), comp_scan_points);
+
+  if (check_overlap_only){
+    irn = N_GNEW(1, int);
+    jcn = N_GNEW(n, int);
+    for (k = 0; k < n && nz == 0; k++){
+      if (scan_overlaps(dim, n, x, width, scanpoints, k, jcn) > 0){
+	irn[0] = scanpoints[k].node;
+	nz = 1;/* only the first is kept */
       }
-
     }
+  } else {
+    start = N_GNEW(n + 1, int);
+    start[0] = 0;
+#pragma omp parallel for schedule(dynamic, 64)
+    for (k = 0; k < n; k++){
+      start[k+1] = scan_overlaps(dim, n, x, width, scanpoints, k, NULL);
+    }
+    for (k = 0; k < n; k++) start[k+1] += start[k];
+    nz = start[n];
+    irn = N_GNEW(MAX(nz, 1), int);
+    jcn = N_GNEW(MAX(nz, 1), int);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (k = 0; k < n; k++){
+      int j;
+      scan_overlaps(dim, n, x, width, scanpoints, k, jcn + start[k]);
+      for (j = start[k]; j < start[k+1]; j++) irn[j] = scanpoints[k].node;
+    }
+    FREE(start);
   }
+  val = N_GNEW(MAX(nz, 1), real);
+  for (i = 0; i < nz; i++) val[i] = 1;
 
-check_overlap_RETURN:
-   FREE(scanpointsx);
-  FREE(scanpointsy);
-  RBTreeDestroy(treey);
-
-  B = SparseMatrix_from_coordinate_format(A);
-  SparseMatrix_delete(A);
+  B = SparseMatrix_from_coordinate_arrays(nz, n, n, irn, jcn, val, MATRIX_TYPE_REAL, sizeof(real));
   A = SparseMatrix_symmetrize(B, FALSE);
   SparseMatrix_delete(B);
+  FREE(scanpoints);
+  FREE(irn);
+  FREE(jcn);
+  FREE(val);
   if (Verbose) fprintf(stderr, "found %d clashes\n", A->nz);
   return A;
 }
@@ -378,8 +295,11 @@ real overlap_scaling(int dim, int m, real *x, real *width, real scale_sta, real
 OverlapSmoother OverlapSmoother_new(SparseMatrix A, int m, 
 				    int dim, real lambda0, real *x, real *width, int include_original_graph, int neighborhood_only, 
 				    real *max_overlap, real *min_overlap,
-				    int edge_labeling_scheme, int n_constr_nodes, int *constr_nodes, SparseMatrix A_constr, int shrink
+				    int edge_labeling_scheme, int n_constr_nodes, int *constr_nodes, SparseMatrix A_constr, int shrink,
+				    delaunay_t *dt
 				    ){
+  /* if dt is not NULL, the proximity graph is updated from the triangulation kept in it,
+     rather than built from scratch */
   OverlapSmoother sm;
   int i, j, k, *iw, *jw, jdiag;
   SparseMatrix B;
@@ -403,7 +323,11 @@ OverlapSmoother OverlapSmoother_new(SparseMatrix A, int m,
   lambda = sm->lambda = N_GNEW(m,real);
   for (i = 0; i < m; i++) sm->lambda[i] = lambda0;
   
-  B= call_tri(m, dim, x);
+  if (dt) {
+    B = call_tri_update(dt, m, dim, x);
+  } else {
+    B = call_tri(m, dim, x);
+  }
 
   if (!neighborhood_only){
     SparseMatrix C, D;
@@ -575,6 +499,7 @@ void remove_overlap(int dim, SparseMatrix A, real *x, real *label_sizes, int ntr
   int has_penalty_terms = FALSE;
   real epsilon = 0.005;
   int shrink = 0;
+  delaunay_t *dt;
 
 #ifdef TIME
   clock_t  cpu;
@@ -618,10 +543,11 @@ void remove_overlap(int dim, SparseMatrix A, real *x, real *label_sizes, int ntr
 #endif
 
   has_penalty_terms = (edge_labeling_scheme != ELSCHEME_NONE && n_constr_nodes > 0);
+  dt = mkDelaunay();/* the nodes move little from one try to the next, so the triangulation is kept */
   for (i = 0; i < ntry; i++){
     if (Verbose) print_bounding_box(A->m, dim, x);
     sm = OverlapSmoother_new(A, A->m, dim, lambda, x, label_sizes, include_original_graph, neighborhood_only,
-			     &max_overlap, &min_overlap, edge_labeling_scheme, n_constr_nodes, constr_nodes, A_constr, shrink); 
+			     &max_overlap, &min_overlap, edge_labeling_scheme, n_constr_nodes, constr_nodes, A_constr, shrink, dt); 
     if (Verbose) fprintf(stderr, "overlap removal neighbors only?= %d iter -- %d, overlap factor = %g underlap factor = %g\n", neighborhood_only, i, max_overlap - 1, min_overlap);
     if (check_convergence(max_overlap, res, has_penalty_terms, epsilon)){
     
@@ -643,6 +569,7 @@ void remove_overlap(int dim, SparseMatrix A, real *x, real *label_sizes, int ntr
 #endif
     OverlapSmoother_delete(sm);
   }
+  freeDelaunay(dt);
   if (Verbose) fprintf(stderr, "overlap removal neighbors only?= %d iter -- %d, overlap factor = %g underlap factor = %g\n", neighborhood_only, i, max_overlap - 1, min_overlap);
 
 #ifdef ANIMATE
@@ -691,7 +618,7 @@ void remove_overlap(int dim, SparseMatrix A, int m, real *x, real *label_sizes,
 
     if (once == 0) {
 	once = 1;
-	agerr(AGERR, "remove_overlap: Graphviz not built with triangulation library\n");
+	agerr(AGERR, "remove_overlap: Graphviz not built with sfdp\n");
     }
 }
 #endif
@@ -15,6 +15,7 @@
 #define OVERLAP_H
 
 #include "post_process.h"
+#include "delaunay.h"
 
 typedef  StressMajorizationSmoother OverlapSmoother;
 
@@ -25,7 +26,8 @@ void OverlapSmoother_delete(OverlapSmoother sm);
 OverlapSmoother OverlapSmoother_new(SparseMatrix A, int m, 
 				    int dim, real lambda0, real *x, real *width, int include_original_graph, int neighborhood_only, 
 				    real *max_overlap, real *min_overlap,
-				    int edge_labeling_scheme, int n_constr_nodes, int *constr_nodes, SparseMatrix A_constr, int shrink
+				    int edge_labeling_scheme, int n_constr_nodes, int *constr_nodes, SparseMatrix A_constr, int shrink,
+				    delaunay_t *dt
 				    );
 
 enum {ELSCHEME_NONE = 0, ELSCHEME_PENALTY, ELSCHEME_PENALTY2, ELSCHEME_STRAIGHTLINE_PENALTY, ELSCHEME_STRAIGHTLINE_PENALTY2};
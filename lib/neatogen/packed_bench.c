@@ -0,0 +1,255 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/* Micro-benchmark of the packed matrix kernels used by stress
+ * majorization: the matrix-vector product, the float vector helpers
+ * and conjugate_gradient_mkernel. The matrix is a dense weighted
+ * Laplacian, as built by stress_majorization_kD_mkernel.
+ *
+ * Build with "make packed_bench". The number of threads is set
+ * with OMP_NUM_THREADS.
+ */
+
+#include "neato.h"
+#include "matrix_ops.h"
+#include "conjgrad.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static double now(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return clock() / (double) CLOCKS_PER_SEC;
+#endif
+}
+
+/* reference_mult:
+ * The plain loop of right_mult_with_vector_ff, to check results
+ * and to compare times.
+ */
+static void
+reference_mult(float *packed_matrix, int n, float *vector, float *result)
+{
+    int i, j;
+    size_t index;
+    float vector_i;
+    float res;
+
+    for (i = 0; i < n; i++) {
+	result[i] = 0;
+    }
+    for (index = 0, i = 0; i < n; i++) {
+	res = 0;
+	vector_i = vector[i];
+	res += packed_matrix[index++] * vector_i;
+	for (j = i + 1; j < n; j++, index++) {
+	    res += packed_matrix[index] * vector[j];
+	    result[j] += packed_matrix[index] * vector_i;
+	}
+	result[i] += res;
+    }
+}
+
+/* exact_mult:
+ * The product in double precision, against which both float
+ * kernels are measured. The Laplacian rows sum to zero, so the
+ * float sums cancel and their order matters.
+ */
+static void
+exact_mult(float *packed_matrix, int n, float *vector, double *result)
+{
+    int i, j;
+    size_t index;
+
+    for (i = 0; i < n; i++)
+	result[i] = 0;
+    for (index = 0, i = 0; i < n; i++) {
+	result[i] += (double) packed_matrix[index++] * vector[i];
+	for (j = i + 1; j < n; j++, index++) {
+	    result[i] += (double) packed_matrix[index] * vector[j];
+	    result[j] += (double) packed_matrix[index] * vector[i];
+	}
+    }
+}
+
+/* maxdiff:
+ * Largest difference of y from the exact product, relative to the
+ * largest entry of the exact product.
+ */
+static double maxdiff(int n, double *exact, float *y)
+{
+    double err = 0, scale = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+	err = MAX(err, fabs(exact[i] - y[i]));
+	scale = MAX(scale, fabs(exact[i]));
+    }
+    return scale > 0 ? err / scale : err;
+}
+
+/* mkLaplacian:
+ * Packed Laplacian with weights 1/d^2 for random points in the plane.
+ */
+static float *mkLaplacian(int n)
+{
+    float *lap = N_GNEW((size_t) n * (n + 1) / 2, float);
+    double *x = N_GNEW(2 * n, double);
+    double *degrees = N_NEW(n, double);
+    double dx, dy, w;
+    size_t count;
+    int i, j;
+
+    for (i = 0; i < 2 * n; i++)
+	x[i] = drand48();
+    for (count = 0, i = 0; i < n; i++) {
+	count++;		/* diagonal entry */
+	for (j = i + 1; j < n; j++, count++) {
+	    dx = x[2 * i] - x[2 * j];
+	    dy = x[2 * i + 1] - x[2 * j + 1];
+	    w = 1. / (dx * dx + dy * dy + 1e-3);
+	    lap[count] = (float) -w;
+	    degrees[i] += w;
+	    degrees[j] += w;
+	}
+    }
+    for (count = 0, i = 0; i < n; count += n - i, i++)
+	lap[count] = (float) degrees[i];
+    free(x);
+    free(degrees);
+    return lap;
+}
+
+static void usage(char *cmd, int eval)
+{
+    fprintf(stderr, "Usage: %s [-n size] [-r repeat]\n", cmd);
+    fprintf(stderr, " -n size   : number of rows (5000)\n");
+    fprintf(stderr, " -r repeat : runs of each kernel (10)\n");
+    exit(eval);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 5000;
+    int repeat = 10;
+    int c, i, r;
+    float *lap, *x, *y, *z, *b;
+    double *exact;
+    double t, t_ref, t_mult, maxerr;
+    double ts[4];
+
+    while ((c = getopt(argc, argv, "n:r:?")) != -1) {
+	switch (c) {
+	case 'n':
+	    n = atoi(optarg);
+	    break;
+	case 'r':
+	    repeat = atoi(optarg);
+	    break;
+	case '?':
+	    usage(argv[0], optopt != '?');
+	    break;
+	}
+    }
+    if ((n < 2) || (repeat < 1))
+	usage(argv[0], 1);
+
+    srand48(123);
+    lap = mkLaplacian(n);
+    x = N_GNEW(n, float);
+    y = N_GNEW(n, float);
+    z = N_GNEW(n, float);
+    b = N_GNEW(n, float);
+    exact = N_GNEW(n, double);
+    for (i = 0; i < n; i++)
+	x[i] = (float) drand48();
+
+#ifdef _OPENMP
+    printf("n %d threads %d\n", n, omp_get_max_threads());
+#else
+    printf("n %d threads 1\n", n);
+#endif
+
+    /* matrix-vector product */
+    t = now();
+    for (r = 0; r < repeat; r++)
+	reference_mult(lap, n, x, y);
+    t_ref = (now() - t) / repeat;
+    t = now();
+    for (r = 0; r < repeat; r++)
+	right_mult_with_vector_ff(lap, n, x, z);
+    t_mult = (now() - t) / repeat;
+    exact_mult(lap, n, x, exact);
+    printf("%-24s %10.3f ms  error %.2g\n", "reference matvec",
+	   1000 * t_ref, maxdiff(n, exact, y));
+    printf("%-24s %10.3f ms  error %.2g  speedup %.2f\n",
+	   "right_mult_with_vector_ff", 1000 * t_mult,
+	   maxdiff(n, exact, z), t_ref / t_mult);
+
+    /* vector helpers, over enough calls to be measurable */
+    memset(ts, 0, sizeof(ts));
+    for (r = 0; r < 100 * repeat; r++) {
+	t = now();
+	vectors_inner_productf(n, x, z);
+	ts[0] += now() - t;
+	t = now();
+	vectors_mult_additionf(n, y, 1e-6f, x);
+	ts[1] += now() - t;
+	t = now();
+	orthog1f(n, y);
+	ts[2] += now() - t;
+	t = now();
+	max_absf(n, y);
+	ts[3] += now() - t;
+    }
+    printf("%-24s %10.3f us\n", "vectors_inner_productf",
+	   1e6 * ts[0] / (100 * repeat));
+    printf("%-24s %10.3f us\n", "vectors_mult_additionf",
+	   1e6 * ts[1] / (100 * repeat));
+    printf("%-24s %10.3f us\n", "orthog1f", 1e6 * ts[2] / (100 * repeat));
+    printf("%-24s %10.3f us\n", "max_absf", 1e6 * ts[3] / (100 * repeat));
+
+    /* a solve as in stress majorization */
+    for (i = 0; i < n; i++) {
+	b[i] = (float) (drand48() - 0.5);
+	x[i] = 0;
+    }
+    t = now();
+    conjugate_gradient_mkernel(lap, x, b, n, 1e-3, n);
+    t = now() - t;
+    right_mult_with_vector_ff(lap, n, x, y);
+    orthog1f(n, b);
+    for (maxerr = 0, i = 0; i < n; i++)
+	maxerr = MAX(maxerr, fabs(y[i] - b[i]));
+    printf("%-24s %10.3f ms  residual %.2g\n",
+	   "conjugate_gradient_mkernel", 1000 * t, maxerr);
+
+    free(lap);
+    free(x);
+    free(y);
+    free(z);
+    free(b);
+    free(exact);
+    return 0;
+}
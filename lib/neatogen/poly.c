@@ -27,21 +27,8 @@
 #define CIRCLE 2
 #define ISCIRCLE(p) ((p)->kind & CIRCLE)
 
-static int maxcnt = 0;
-static Point *tp1 = NULL;
-static Point *tp2 = NULL;
-static Point *tp3 = NULL;
-
-void polyFree()
-{
-    maxcnt = 0;
-    free(tp1);
-    free(tp2);
-    free(tp3);
-    tp1 = NULL;
-    tp2 = NULL;
-    tp3 = NULL;
-}
+/* Vertex count up to which polyOverlap works on the stack */
+#define SMALLCNT 64
 
 void breakPoly(Poly * pp)
 {
@@ -267,8 +254,6 @@ int makeAddPoly(Poly * pp, Agnode_t * n, float xmargin, float ymargin)
     pp->nverts = sides;
     bbox(verts, sides, &pp->origin, &pp->corner);
 
-    if (sides > maxcnt)
-	maxcnt = sides;
     return 0;
 }
 
@@ -348,8 +333,6 @@ int makePoly(Poly * pp, Agnode_t * n, float xmargin, float ymargin)
     pp->nverts = sides;
     bbox(verts, sides, &pp->origin, &pp->corner);
 
-    if (sides > maxcnt)
-	maxcnt = sides;
     return 0;
 }
 
@@ -430,23 +413,17 @@ static int inPoly(Point vertex[], int n, Point q)
     int i, i1;			/* point index; i1 = i-1 mod n */
     double x;			/* x intersection of e with ray */
     double crossings = 0;	/* number of edge/ray crossings */
-
-    if (tp3 == NULL)
-	tp3 = N_GNEW(maxcnt, Point);
-
-    /* Shift so that q is the origin. */
-    for (i = 0; i < n; i++) {
-	tp3[i].x = vertex[i].x - q.x;
-	tp3[i].y = vertex[i].y - q.y;
-    }
+    Point tp3[2];		/* edge shifted so that q is the origin */
 
     /* For each edge e=(i-1,i), see if crosses ray. */
     for (i = 0; i < n; i++) {
 	i1 = (i + n - 1) % n;
+	subpt(&tp3[0], vertex[i], q);
+	subpt(&tp3[1], vertex[i1], q);
 
 	/* if edge is horizontal, test to see if the point is on it */
-	if ((tp3[i].y == 0) && (tp3[i1].y == 0)) {
-	    if ((tp3[i].x * tp3[i1].x) < 0) {
+	if ((tp3[0].y == 0) && (tp3[1].y == 0)) {
+	    if ((tp3[0].x * tp3[1].x) < 0) {
 		return 1;
 	    } else {
 		continue;
@@ -454,11 +431,11 @@ static int inPoly(Point vertex[], int n, Point q)
 	}
 
 	/* if e straddles the x-axis... */
-	if (((tp3[i].y >= 0) && (tp3[i1].y <= 0)) ||
-	    ((tp3[i1].y >= 0) && (tp3[i].y <= 0))) {
+	if (((tp3[0].y >= 0) && (tp3[1].y <= 0)) ||
+	    ((tp3[1].y >= 0) && (tp3[0].y <= 0))) {
 	    /* e straddles ray, so compute intersection with ray. */
-	    x = (tp3[i].x * tp3[i1].y - tp3[i1].x * tp3[i].y)
-		/ (double) (tp3[i1].y - tp3[i].y);
+	    x = (tp3[0].x * tp3[1].y - tp3[1].x * tp3[0].y)
+		/ (double) (tp3[1].y - tp3[0].y);
 
 	    /* if intersect at origin, we've found intersection */
 	    if (x == 0)
@@ -466,7 +443,7 @@ static int inPoly(Point vertex[], int n, Point q)
 
 	    /* crosses ray if strictly positive intersection. */
 	    if (x > 0) {
-		if ((tp3[i].y == 0) || (tp3[i1].y == 0)) {
+		if ((tp3[0].y == 0) || (tp3[1].y == 0)) {
 		    crossings += .5;	/* goes thru vertex */
 		} else {
 		    crossings += 1.0;
@@ -505,6 +482,9 @@ int polyOverlap(Point p, Poly * pp, Point q, Poly * qp)
 {
     Point op, cp;
     Point oq, cq;
+    Point buf[SMALLCNT];
+    Point *tp1, *tp2;
+    int rv;
 
     /* translate bounding boxes */
     addpt(&op, p, pp->origin);
@@ -529,14 +509,18 @@ int polyOverlap(Point p, Poly * pp, Point q, Poly * qp)
 	    return 1;
     }
 
-    if (tp1 == NULL) {
-	tp1 = N_GNEW(maxcnt, Point);
-	tp2 = N_GNEW(maxcnt, Point);
-    }
+    if (pp->nverts + qp->nverts <= SMALLCNT)
+	tp1 = buf;
+    else
+	tp1 = N_GNEW(pp->nverts + qp->nverts, Point);
+    tp2 = tp1 + pp->nverts;
 
     transCopy(pp->verts, pp->nverts, p, tp1);
     transCopy(qp->verts, qp->nverts, q, tp2);
-    return (edgesIntersect(tp1, tp2, pp->nverts, qp->nverts) ||
-	    (inBox(*tp1, oq, cq) && inPoly(tp2, qp->nverts, *tp1)) ||
-	    (inBox(*tp2, op, cp) && inPoly(tp1, pp->nverts, *tp2)));
+    rv = (edgesIntersect(tp1, tp2, pp->nverts, qp->nverts) ||
+	  (inBox(*tp1, oq, cq) && inPoly(tp2, qp->nverts, *tp1)) ||
+	  (inBox(*tp2, op, cp) && inPoly(tp1, pp->nverts, *tp2)));
+    if (tp1 != buf)
+	free(tp1);
+    return rv;
 }
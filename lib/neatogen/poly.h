@@ -28,7 +28,6 @@ extern "C" {
 	int kind;
     } Poly;
 
-    extern void polyFree(void);
     extern int polyOverlap(Point, Poly *, Point, Poly *);
     extern int makePoly(Poly *, Agnode_t *, float, float);
     extern int makeAddPoly(Poly *, Agnode_t *, float, float);
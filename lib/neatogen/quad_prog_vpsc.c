@@ -308,6 +308,8 @@ CMajEnvVPSC *initCMajVPSC(int n, float *packedMat, vtx_data * graph,
 
     e->m = 0;
     e->cs = NULL;
+    e->vpsc = NULL;
+    e->k = -1;
     if (e->gm > 0) {
 	e->vpsc = newIncVPSC(n + e->ndv, e->vs, e->gm, e->gcs);
 	e->m = e->gm;
@@ -341,8 +343,9 @@ void deleteCMajEnvVPSC(CMajEnvVPSC * e)
 	free(e->A[0]);
 	free(e->A);
     }
-    if (e->m > 0) {
+    if (e->vpsc)
 	deleteVPSC(e->vpsc);
+    if (e->m > 0) {
 	if (e->cs != e->gcs && e->gcs != NULL)
 	    deleteConstraints(0, e->gcs);
 	deleteConstraints(e->m, e->cs);
@@ -380,8 +383,8 @@ void generateNonoverlapConstraints(CMajEnvVPSC * e,
 				   boolean transitiveClosure,
 				   ipsep_options * opt)
 {
-    Constraint **csol, **csolptr;
-    int i, j, mol = 0;
+    Constraint **csol, **csolptr, **cs;
+    int i, j, m, mol = 0;
     int n = e->nv + e->nldv;
 #ifdef WIN32
     boxf* bb = N_GNEW (n, boxf);
@@ -421,6 +424,21 @@ void generateNonoverlapConstraints(CMajEnvVPSC * e,
 	Constraint **cscl[opt->clusters->nclusters + 1];
 	int cm[opt->clusters->nclusters + 1];
 #endif
+	/* each cluster gets its own constraints, which can be built in
+	 * parallel as long as no two clusters share a node
+	 */
+	boolean disjoint = TRUE;
+	char *seen = N_NEW(n, char);
+	for (i = 0; i < opt->clusters->nclusters; i++) {
+	    for (j = 0; j < opt->clusters->clustersizes[i]; j++) {
+		int iv = opt->clusters->clusters[i][j];
+		if (seen[iv])
+		    disjoint = FALSE;
+		seen[iv] = 1;
+	    }
+	}
+	free(seen);
+#pragma omp parallel for private(j) reduction(+:mol) schedule(dynamic) if (disjoint)
 	for (i = 0; i < opt->clusters->nclusters; i++) {
 	    int cn = opt->clusters->clustersizes[i];
 #ifdef WIN32
@@ -557,42 +575,54 @@ void generateNonoverlapConstraints(CMajEnvVPSC * e,
 	    mol = genYConstraints(n, bb, e->vs, &csol);
 	}
     }
-    /* remove constraints from previous iteration */
-    if (e->m > 0) {
-	/* can't reuse instance of VPSC when constraints change! */
-	deleteVPSC(e->vpsc);
-	for (i = e->gm == 0 ? 0 : e->gm; i < e->m; i++) {
-	    /* delete previous overlap constraints */
-	    deleteConstraint(e->cs[i]);
-	}
-	/* just delete the array, not the elements */
-	if (e->cs != e->gcs)
-	    deleteConstraints(0, e->cs);
-    }
     /* if we have no global constraints then the overlap constraints
      * are all we have to worry about.
      * Otherwise, we have to copy the global and overlap constraints 
      * into the one array
      */
     if (e->gm == 0) {
-	e->m = mol;
-	e->cs = csol;
+	m = mol;
+	cs = csol;
     } else {
-	e->m = mol + e->gm;
-	e->cs = newConstraints(e->m);
-	for (i = 0; i < e->m; i++) {
+	m = mol + e->gm;
+	cs = newConstraints(m);
+	for (i = 0; i < m; i++) {
 	    if (i < e->gm) {
-		e->cs[i] = e->gcs[i];
+		cs[i] = e->gcs[i];
 	    } else {
-		e->cs[i] = csol[i - e->gm];
+		cs[i] = csol[i - e->gm];
 	    }
 	}
 	/* just delete the array, not the elements */
 	deleteConstraints(0, csol);
     }
     if (Verbose)
-	fprintf(stderr, "  generated %d constraints\n", e->m);
-    e->vpsc = newIncVPSC(e->nv + e->nldv + e->ndv, e->vs, e->m, e->cs);
+	fprintf(stderr, "  generated %d constraints\n", m);
+    /* most overlap constraints come back from one iteration to the
+     * next, so the solver keeps its blocks and only splits those held
+     * together by constraints that are gone. Blocks found in the other
+     * dimension are of no use, though.
+     */
+    if (e->vpsc) {
+	if (e->k < 0 || e->k == k)
+	    updateIncVPSC((IncVPSC *) e->vpsc, m, cs);
+	else {
+	    deleteVPSC(e->vpsc);
+	    e->vpsc = NULL;
+	}
+    }
+    /* remove constraints from previous iteration */
+    for (i = e->gm; i < e->m; i++) {
+	deleteConstraint(e->cs[i]);
+    }
+    /* just delete the array, not the elements */
+    if (e->cs != e->gcs)
+	deleteConstraints(0, e->cs);
+    if (!e->vpsc)
+	e->vpsc = newIncVPSC(e->nv + e->nldv + e->ndv, e->vs, m, cs);
+    e->m = m;
+    e->cs = cs;
+    e->k = k;
 #ifdef MOSEK
     if (opt->mosek) {
 	if (e->mosekEnv != NULL) {
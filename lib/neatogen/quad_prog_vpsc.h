@@ -50,6 +50,7 @@ typedef struct CMajEnvVPSC {
 	/* global constraints are persistant throughout optimisation process */
 	Constraint **gcs;
 	VPSC *vpsc;
+	int k; /* dimension of the overlap constraints, -1 if none yet */
 	float *fArray1; /* utility arrays - reusable memory */
 	float *fArray2;
 	float *fArray3;
@@ -11,31 +11,21 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
-#include "mem.h"
-#include "site.h"
+#include "neato.h"
+#include "voronoi.h"
 #include <math.h>
 
 
-int siteidx;
-Site *bottomsite;
-
-static Freelist sfl;
-static int nvertices;
-
-void siteinit()
+void siteinit(Voronoi_t * vp)
 {
-    /* double sn; */
-
-    freeinit(&sfl, sizeof(Site));
-    nvertices = 0;
-    /* sn = nsites+4; */
-    /* sqrt_nsites = sqrt(sn); */
+    freereset(&vp->sfl);
+    vp->nvertices = 0;
 }
 
 
-Site *getsite()
+Site *getsite(Voronoi_t * vp)
 {
-    return ((Site *) getfree(&sfl));
+    return ((Site *) getfree(&vp->sfl));
 }
 
 double dist(Site * s, Site * t)
@@ -50,21 +40,21 @@ double dist(Site * s, Site * t)
 }
 
 
-void makevertex(Site * v)
+void makevertex(Voronoi_t * vp, Site * v)
 {
-    v->sitenbr = nvertices;
-    nvertices += 1;
+    v->sitenbr = vp->nvertices;
+    vp->nvertices += 1;
 #ifdef STANDALONE
     out_vertex(v);
 #endif
 }
 
 
-void deref(Site * v)
+void deref(Voronoi_t * vp, Site * v)
 {
     v->refcnt -= 1;
     if (v->refcnt == 0)
-	makefree(v, &sfl);
+	makefree(v, &vp->sfl);
 }
 
 void ref(Site * v)
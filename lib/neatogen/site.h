@@ -22,6 +22,9 @@ extern "C" {
 
 #include "geometry.h"
 
+    /* State of one construction of a diagram; see voronoi.h */
+    typedef struct Voronoi_t Voronoi_t;
+
     /* Sites are also used as vertices on line segments */
     typedef struct Site {
 	Point coord;
@@ -29,15 +32,12 @@ extern "C" {
 	int refcnt;
     } Site;
 
-    extern int siteidx;
-    extern Site *bottomsite;
-
-    extern void siteinit(void);
-    extern Site *getsite(void);
+    extern void siteinit(Voronoi_t *);
+    extern Site *getsite(Voronoi_t *);
     extern double dist(Site *, Site *);	/* Distance between two sites */
-    extern void deref(Site *);	/* Increment refcnt of site  */
-    extern void ref(Site *);	/* Decrement refcnt of site  */
-    extern void makevertex(Site *);	/* Transform a site into a vertex */
+    extern void deref(Voronoi_t *, Site *);	/* Decrement refcnt of site  */
+    extern void ref(Site *);	/* Increment refcnt of site  */
+    extern void makevertex(Voronoi_t *, Site *);	/* Transform a site into a vertex */
 #endif
 
 #ifdef __cplusplus
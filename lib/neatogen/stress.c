@@ -198,54 +198,20 @@ initLayout(vtx_data * graph, int n, int dim, double **coords,
 
 float *circuitModel(vtx_data * graph, int nG)
 {
-    int i, j, e, rv, count;
-    float *Dij = N_NEW(nG * (nG + 1) / 2, float);
-    double **Gm;
-    double **Gm_inv;
-
-    Gm = new_array(nG, nG, 0.0);
-    Gm_inv = new_array(nG, nG, 0.0);
-
-    /* set non-diagonal entries */
-    if (graph->ewgts) {
-	for (i = 0; i < nG; i++) {
-	    for (e = 1; e < graph[i].nedges; e++) {
-		j = graph[i].edges[e];
-		/* conductance is 1/resistance */
-		Gm[i][j] = Gm[j][i] = -1.0 / graph[i].ewgts[e];	/* negate */
-	    }
-	}
-    } else {
-	for (i = 0; i < nG; i++) {
-	    for (e = 1; e < graph[i].nedges; e++) {
-		j = graph[i].edges[e];
-		/* conductance is 1/resistance */
-		Gm[i][j] = Gm[j][i] = -1.0;	/* ewgts are all 1 */
-	    }
-	}
-    }
-
-    rv = solveCircuit(nG, Gm, Gm_inv);
+    int i, j;
+    size_t count;
+    float *Dij;
+    double *Rij = N_NEW((size_t) nG * (nG + 1) / 2, double);
 
-    if (rv) {
-	float v;
-	count = 0;
-	for (i = 0; i < nG; i++) {
-	    for (j = i; j < nG; j++) {
-		if (i == j)
-		    v = 0.0;
-		else
-		    v = (float) (Gm_inv[i][i] + Gm_inv[j][j] -
-				 2.0 * Gm_inv[i][j]);
-		Dij[count++] = v;
-	    }
-	}
-    } else {
-	free(Dij);
-	Dij = NULL;
+    if (!circuitResistances(graph, nG, Rij)) {
+	free(Rij);
+	return NULL;
     }
-    free_array(Gm);
-    free_array(Gm_inv);
+    Dij = N_NEW((size_t) nG * (nG + 1) / 2, float);
+    for (count = 0, i = 0; i < nG; i++)
+	for (j = i; j < nG; j++, count++)
+	    Dij[count] = (float) Rij[count];
+    free(Rij);
     return Dij;
 }
 
@@ -712,23 +678,25 @@ finish0:
  */
 static float *compute_weighted_apsp_packed(vtx_data * graph, int n)
 {
-    int i, j, count;
+    int i;
     float *Dij = N_NEW(n * (n + 1) / 2, float);
 
-    float *Di = N_NEW(n, float);
-    Queue Q;
-
-    mkQueue(&Q, n);
+    /* the sources fill disjoint rows, so they run in parallel */
+#pragma omp parallel
+    {
+	float *Di = N_NEW(n, float);
+	int j, count;
 
-    count = 0;
-    for (i = 0; i < n; i++) {
-	dijkstra_f(i, graph, n, Di);
-	for (j = i; j < n; j++) {
-	    Dij[count++] = Di[j];
+#pragma omp for schedule(dynamic, 16)
+	for (i = 0; i < n; i++) {
+	    dijkstra_f(i, graph, n, Di);
+	    count = i * n - i * (i - 1) / 2;	/* start of row i */
+	    for (j = i; j < n; j++) {
+		Dij[count++] = Di[j];
+	    }
 	}
+	free(Di);
     }
-    free(Di);
-    freeQueue(&Q);
     return Dij;
 }
 
@@ -771,23 +739,28 @@ float *mdsModel(vtx_data * graph, int nG)
  */
 float *compute_apsp_packed(vtx_data * graph, int n)
 {
-    int i, j, count;
+    int i;
     float *Dij = N_NEW(n * (n + 1) / 2, float);
 
-    DistType *Di = N_NEW(n, DistType);
-    Queue Q;
+    /* the sources fill disjoint rows, so they run in parallel */
+#pragma omp parallel
+    {
+	DistType *Di = N_NEW(n, DistType);
+	Queue Q;		/* one queue per thread */
+	int j, count;
 
-    mkQueue(&Q, n);
-
-    count = 0;
-    for (i = 0; i < n; i++) {
-	bfs(i, graph, n, Di, &Q);
-	for (j = i; j < n; j++) {
-	    Dij[count++] = ((float) Di[j]);
+	mkQueue(&Q, n);
+#pragma omp for schedule(dynamic, 16)
+	for (i = 0; i < n; i++) {
+	    bfs(i, graph, n, Di, &Q);
+	    count = i * n - i * (i - 1) / 2;	/* start of row i */
+	    for (j = i; j < n; j++) {
+		Dij[count++] = ((float) Di[j]);
+	    }
 	}
+	free(Di);
+	freeQueue(&Q);
     }
-    free(Di);
-    freeQueue(&Q);
     return Dij;
 }
 
@@ -878,6 +851,47 @@ static void dumpMatrix(float *Dij, int n)
 }
 #endif
 
+/* smartLayout:
+ * Initial layout from a quick stress optimization within the
+ * subspace of the high-dimensional embedding, scaled down for
+ * numerical stability. Returns a negative value on failure.
+ */
+static int smartLayout(vtx_data * graph, int n, int nedges_graph,
+		       double **d_coords, int dim, int exp,
+		       int reweight_graph)
+{
+    int i, j;
+
+    /* optimize layout quickly within subspace */
+    /* perform at most 50 iterations within 30-D subspace to 
+       get an estimate */
+    if (sparse_stress_subspace_majorization_kD(graph, n, nedges_graph,
+					       d_coords, dim, TRUE, exp,
+					       reweight_graph, 50,
+					       neighborhood_radius_subspace,
+					       num_pivots_stress) < 0)
+	return -1;
+
+    for (i = 0; i < dim; i++) {
+	/* for numerical stability, scale down layout */
+	double max = 1;
+	for (j = 0; j < n; j++) {
+	    if (fabs(d_coords[i][j]) > max) {
+		max = fabs(d_coords[i][j]);
+	    }
+	}
+	for (j = 0; j < n; j++) {
+	    d_coords[i][j] /= max;
+	}
+	/* add small random noise */
+	for (j = 0; j < n; j++) {
+	    d_coords[i][j] += 1e-6 * (drand48() - 0.5);
+	}
+	orthog1(n, d_coords[i]);
+    }
+    return 0;
+}
+
 /* Accumulator type for diagonal of Laplacian. Needs to be as large
  * as possible. Use long double; configure to double if necessary.
  */
@@ -985,35 +999,11 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 
     if (smart_ini && (n > 1)) {
 	havePinned = 0;
-	/* optimize layout quickly within subspace */
-	/* perform at most 50 iterations within 30-D subspace to 
-	   get an estimate */
-	if (sparse_stress_subspace_majorization_kD(graph, n, nedges_graph,
-					       d_coords, dim, smart_ini, exp,
-					       (model == MODEL_SUBSET), 50,
-					       neighborhood_radius_subspace,
-					       num_pivots_stress) < 0) {
+	if (smartLayout(graph, n, nedges_graph, d_coords, dim, exp,
+			(model == MODEL_SUBSET)) < 0) {
 	    iterations = -1;
 	    goto finish1;
 	}
-
-	for (i = 0; i < dim; i++) {
-	    /* for numerical stability, scale down layout */
-	    double max = 1;
-	    for (j = 0; j < n; j++) {
-		if (fabs(d_coords[i][j]) > max) {
-		    max = fabs(d_coords[i][j]);
-		}
-	    }
-	    for (j = 0; j < n; j++) {
-		d_coords[i][j] /= max;
-	    }
-	    /* add small random noise */
-	    for (j = 0; j < n; j++) {
-		d_coords[i][j] += 1e-6 * (drand48() - 0.5);
-	    }
-	    orthog1(n, d_coords[i]);
-	}
     } else {
 	havePinned = initLayout(graph, n, dim, d_coords, nodes);
     }
@@ -1313,3 +1303,318 @@ finish1:
     free(lap1);
     return iterations;
 }
+
+static int cmpf(const void *a, const void *b)
+{
+    float fa = *(float *) a;
+    float fb = *(float *) b;
+
+    if (fa < fb)
+	return -1;
+    else if (fa > fb)
+	return 1;
+    else
+	return 0;
+}
+
+/* countWithin:
+ * Return the number of entries of the sorted array vals
+ * which are at most v.
+ */
+static int countWithin(float *vals, int n, float v)
+{
+    int lo = 0, hi = n, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (vals[mid] <= v)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/* sparse_stress_majorization_kD:
+ * Sparse stress model of Ortmann, Klimenta and Brandes.
+ * Only the terms for the edges and for num_pivots pivots are kept.
+ * The term of a node i and a pivot p stands for the nodes in the
+ * region of p (the nodes having p as closest pivot) which are within
+ * half of d(i,p) from p, and is weighted by their number. This needs
+ * O(n*num_pivots) memory instead of the n^2 of
+ * stress_majorization_kD_mkernel.
+ * Nodes are moved one at a time to the minimum of the majorant of their
+ * terms, so no linear system is solved.
+ * The ideal distance of an edge is its length, as in the mds model.
+ * The circuit model needs all pairs and is replaced by shortpath.
+ */
+int sparse_stress_majorization_kD(vtx_data * graph,	/* Input graph in sparse representation */
+				  int n,	/* Number of nodes */
+				  int nedges_graph,	/* Number of edges */
+				  double **d_coords,	/* coordinates of nodes (output layout) */
+				  node_t ** nodes,	/* original nodes */
+				  int dim,	/* dimemsionality of layout */
+				  int opts,	/* options */
+				  int model,	/* model */
+				  int maxi,	/* max iterations */
+				  int num_pivots	/* number of pivots */
+    )
+{
+    int iterations;		/* output: number of iteration of the process */
+    int i, j, k, p, e, node;
+    int smart_ini = opts & opt_smart_init;
+    int exp = opts & opt_exp_flag;
+    int havePinned = 0;
+    int reweight = (model == MODEL_SUBSET);
+    float *old_weights = graph[0].ewgts;
+    float **Dp = NULL;		/* distances of the nodes from each pivot */
+    float **Wp = NULL;		/* weights of the node-pivot terms */
+    int *pivots = NULL;
+    int *pivotIndex = NULL;	/* index of a pivot node, else -1 */
+    int *region = NULL;		/* closest pivot of each node */
+    int *rstart = NULL;
+    int *rcount = NULL;
+    float *rdist = NULL;	/* distances within regions, sorted */
+    DistType *Di = NULL;
+    float *mindist = NULL;
+    Queue Q;
+    double *num = NULL;
+    double den, snum, sden, dist_ij, d_ij, w_ij, diff, s;
+    double old_stress, new_stress;
+    boolean converged;
+
+    if (maxi < 0)
+	return 0;
+    if (n == 1)
+	return 0;
+
+    if (model == MODEL_CIRCUIT) {
+	agerr(AGWARN,
+	      "the circuit model is not supported with mode=sparse.\n");
+	agerr(AGPREV, "Reverting to the shortest path model.\n");
+    }
+
+    if (Verbose) {
+	fprintf(stderr, "Setting initial positions");
+	start_timer();
+    }
+    if (smart_ini) {
+	if (smartLayout(graph, n, nedges_graph, d_coords, dim, exp,
+			reweight) < 0)
+	    return -1;
+    } else
+	havePinned = initLayout(graph, n, dim, d_coords, nodes);
+    if (Verbose) {
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+	fprintf(stderr, "Calculating pivot distances");
+	start_timer();
+    }
+    if (maxi == 0)
+	return 0;
+
+    if (reweight)
+	compute_new_weights(graph, n);
+
+    /* select the pivots: each new pivot is the node farthest from */
+    /* the previous ones */
+    num_pivots = MIN(num_pivots, n);
+    pivots = N_GNEW(num_pivots, int);
+    pivotIndex = N_GNEW(n, int);
+    Dp = N_GNEW(num_pivots, float *);
+    Dp[0] = N_GNEW(num_pivots * n, float);
+    for (p = 1; p < num_pivots; p++)
+	Dp[p] = Dp[0] + p * n;
+    mindist = N_GNEW(n, float);
+    if (!graph[0].ewgts) {
+	Di = N_GNEW(n, DistType);
+	mkQueue(&Q, n);
+    }
+    for (i = 0; i < n; i++) {
+	pivotIndex[i] = -1;
+	mindist[i] = MAXFLOAT;
+    }
+    node = rand() % n;
+    for (p = 0; p < num_pivots; p++) {
+	pivots[p] = node;
+	pivotIndex[node] = p;
+	if (Di) {
+	    bfs(node, graph, n, Di, &Q);
+	    for (i = 0; i < n; i++)
+		Dp[p][i] = (float) Di[i];
+	} else
+	    dijkstra_f(node, graph, n, Dp[p]);
+	node = -1;
+	for (i = 0; i < n; i++) {
+	    mindist[i] = MIN(mindist[i], Dp[p][i]);
+	    if ((pivotIndex[i] < 0)
+		&& ((node < 0) || (mindist[i] > mindist[node])))
+		node = i;
+	}
+    }
+
+    /* partition the nodes into the regions of the pivots */
+    region = N_GNEW(n, int);
+    rcount = N_NEW(num_pivots, int);
+    rstart = N_GNEW(num_pivots, int);
+    rdist = N_GNEW(n, float);
+    for (i = 0; i < n; i++) {
+	region[i] = 0;
+	for (p = 1; p < num_pivots; p++) {
+	    if (Dp[p][i] < Dp[region[i]][i])
+		region[i] = p;
+	}
+	rcount[region[i]]++;
+    }
+    for (k = 0, p = 0; p < num_pivots; p++) {
+	rstart[p] = k;
+	k += rcount[p];
+	rcount[p] = 0;
+    }
+    for (i = 0; i < n; i++) {
+	p = region[i];
+	rdist[rstart[p] + rcount[p]++] = Dp[p][i];
+    }
+    for (p = 0; p < num_pivots; p++)
+	qsort(rdist + rstart[p], rcount[p], sizeof(float), cmpf);
+
+    /* weights of the node-pivot terms; these are dropped when */
+    /* the pivot is a neighbor, as the edge term covers it */
+    Wp = N_GNEW(num_pivots, float *);
+    Wp[0] = N_GNEW(num_pivots * n, float);
+    for (p = 1; p < num_pivots; p++)
+	Wp[p] = Wp[0] + p * n;
+    for (p = 0; p < num_pivots; p++) {
+	for (i = 0; i < n; i++) {
+	    d_ij = Dp[p][i];
+	    if ((d_ij <= 0) || (d_ij >= MAXFLOAT))
+		Wp[p][i] = 0;
+	    else {
+		w_ij = countWithin(rdist + rstart[p], rcount[p], d_ij / 2);
+		Wp[p][i] = (float) (exp == 2 ? w_ij / (d_ij * d_ij) : w_ij / d_ij);
+	    }
+	}
+    }
+    for (i = 0; i < n; i++) {
+	for (e = 1; e < graph[i].nedges; e++) {
+	    p = pivotIndex[graph[i].edges[e]];
+	    if (p >= 0)
+		Wp[p][i] = 0;
+	}
+    }
+    free(mindist);
+    free(region);
+    free(rcount);
+    free(rstart);
+    free(rdist);
+    if (Di) {
+	free(Di);
+	freeQueue(&Q);
+    }
+
+    if (Verbose) {
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+	fprintf(stderr, "Solving model: ");
+	start_timer();
+    }
+
+    /* bring the initial layout to the scale of the distances */
+    if (!havePinned) {
+	snum = sden = 0;
+	for (i = 0; i < n; i++) {
+	    for (e = 1; e < graph[i].nedges; e++) {
+		d_ij = (graph[i].ewgts ? graph[i].ewgts[e] : 1);
+		if (d_ij <= 0)
+		    continue;
+		w_ij = (exp == 2 ? 1 / (d_ij * d_ij) : 1 / d_ij);
+		dist_ij = distance_kD(d_coords, dim, i, graph[i].edges[e]);
+		snum += w_ij * d_ij * dist_ij;
+		sden += w_ij * dist_ij * dist_ij;
+	    }
+	    for (p = 0; p < num_pivots; p++) {
+		if ((w_ij = Wp[p][i]) == 0)
+		    continue;
+		dist_ij = distance_kD(d_coords, dim, i, pivots[p]);
+		snum += w_ij * Dp[p][i] * dist_ij;
+		sden += w_ij * dist_ij * dist_ij;
+	    }
+	}
+	if ((snum > 0) && (sden > 0)) {
+	    s = snum / sden;
+	    for (k = 0; k < dim; k++)
+		for (i = 0; i < n; i++)
+		    d_coords[k][i] *= s;
+	}
+    }
+
+	/*************************
+	** Layout optimization  **
+	*************************/
+
+    num = N_GNEW(dim, double);
+    old_stress = MAXDOUBLE;	/* at least one iteration */
+    for (converged = FALSE, iterations = 0;
+	 iterations < maxi && !converged; iterations++) {
+	new_stress = 0;
+	for (i = 0; i < n; i++) {
+	    den = 0;
+	    for (k = 0; k < dim; k++)
+		num[k] = 0;
+	    for (e = 1; e < graph[i].nedges + num_pivots; e++) {
+		if (e < graph[i].nedges) {
+		    j = graph[i].edges[e];
+		    d_ij = (graph[i].ewgts ? graph[i].ewgts[e] : 1);
+		    if (d_ij <= 0)
+			continue;
+		    w_ij = (exp == 2 ? 1 / (d_ij * d_ij) : 1 / d_ij);
+		} else {
+		    p = e - graph[i].nedges;
+		    if ((w_ij = Wp[p][i]) == 0)
+			continue;
+		    j = pivots[p];
+		    d_ij = Dp[p][i];
+		}
+		dist_ij = distance_kD(d_coords, dim, i, j);
+		diff = dist_ij - d_ij;
+		new_stress += w_ij * diff * diff;
+		den += w_ij;
+		for (k = 0; k < dim; k++) {
+		    num[k] += w_ij * d_coords[k][j];
+		    if (dist_ij > 1e-30)	/* skip zero distances */
+			num[k] += w_ij * d_ij *
+			    (d_coords[k][i] - d_coords[k][j]) / dist_ij;
+		}
+	    }
+	    if ((den > 0) && !(havePinned && isFixed(nodes[i]))) {
+		for (k = 0; k < dim; k++)
+		    d_coords[k][i] = num[k] / den;
+	    }
+	}
+
+	{
+	    double change = ABS(old_stress - new_stress);
+	    converged = (((change / old_stress) < Epsilon)
+			 || (new_stress < Epsilon));
+	}
+	old_stress = new_stress;
+	if (Verbose && (iterations % 5 == 0)) {
+	    fprintf(stderr, "%.3f ", new_stress);
+	    if ((iterations + 5) % 50 == 0)
+		fprintf(stderr, "\n");
+	}
+    }
+    if (Verbose) {
+	fprintf(stderr, "\nfinal e = %f %d iterations %.2f sec\n",
+		old_stress, iterations, elapsed_sec());
+    }
+
+    if (reweight)
+	restore_old_weights(graph, n, old_weights);
+    free(num);
+    free(pivots);
+    free(pivotIndex);
+    free(Dp[0]);
+    free(Dp);
+    free(Wp[0]);
+    free(Wp);
+    return iterations;
+}
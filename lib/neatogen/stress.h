@@ -32,6 +32,9 @@ extern "C" {
 #define num_pivots_smart_ini   0
 #define num_pivots_no_ini   50
 
+    /* number of pivots in the sparse stress model */
+#define num_pivots_sparse 50
+
     /* relevant when using sparse distance matrix
      * when optimizing within subspace it can be set to 0
      * otherwise, recommended value is above zero (usually around 3-6)
@@ -56,9 +59,24 @@ extern "C" {
 					      int maxi	/* max iterations */
 	);
 
+    /* Sparse stress optimization using the edges and a set of pivots */
+    /* Memory is linear in the number of nodes; used for large graphs */
+    extern int sparse_stress_majorization_kD(vtx_data * graph,	/* Input graph in sparse representation */
+					     int n,	/* Number of nodes */
+					     int nedges_graph,	/* Number of edges */
+					     double **coords,	/* coordinates of nodes (output layout)  */
+					     node_t **nodes,	/* original nodes  */
+					     int dim,	/* dimemsionality of layout */
+					     int opts,	/* option flags */
+					     int model,	/* model */
+					     int maxi,	/* max iterations */
+					     int num_pivots	/* number of pivots */
+	);
+
 extern float *compute_apsp_packed(vtx_data * graph, int n);
 extern float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n);
 extern float* circuitModel(vtx_data * graph, int nG);
+extern int circuitResistances(vtx_data * graph, int nG, double *Rij);
 extern float* mdsModel (vtx_data * graph, int nG);
 extern int initLayout(vtx_data * graph, int n, int dim, double **coords, node_t** nodes);
 
@@ -71,40 +71,6 @@ void free_array(double **rv)
 }
 
 
-static double ***new_3array(int m, int n, int p, double ival)
-{
-    double ***rv;
-    int i, j, k;
-
-    rv = N_NEW(m + 1, double **);
-    for (i = 0; i < m; i++) {
-	rv[i] = N_NEW(n + 1, double *);
-	for (j = 0; j < n; j++) {
-	    rv[i][j] = N_NEW(p, double);
-	    for (k = 0; k < p; k++)
-		rv[i][j][k] = ival;
-	}
-	rv[i][j] = NULL;	/* NULL terminate so we can clean up */
-    }
-    rv[i] = NULL;
-    return rv;
-}
-
-static void free_3array(double ***rv)
-{
-    int i, j;
-
-    if (rv) {
-	for (i = 0; rv[i]; i++) {
-	    for (j = 0; rv[i][j]; j++)
-		free(rv[i][j]);
-	    free(rv[i]);
-	}
-	free(rv);
-    }
-}
-
-
 /* lenattr:
  * Return 1 if attribute not defined
  * Return 2 if attribute string bad
@@ -282,7 +248,6 @@ int scan_graph_mode(graph_t * G, int mode)
 	GD_dist(G) = new_array(nV, nV, Initial_dist);
 	GD_spring(G) = new_array(nV, nV, 1.0);
 	GD_sum_t(G) = new_array(nV, Ndim, 1.0);
-	GD_t(G) = new_3array(nV, nV, Ndim, 0.0);
     }
 
     return nV;
@@ -300,8 +265,6 @@ void free_scan_graph(graph_t * g)
 	free_array(GD_dist(g));
 	free_array(GD_spring(g));
 	free_array(GD_sum_t(g));
-	free_3array(GD_t(g));
-	GD_t(g) = NULL;
     }
 }
 
@@ -383,13 +346,11 @@ void diffeq_model(graph_t * G, int nG)
 		continue;
 	    vj = GD_neato_nlist(G)[j];
 	    dist = distvec(ND_pos(vi), ND_pos(vj), del);
-	    for (k = 0; k < Ndim; k++) {
-		GD_t(G)[i][j][k] =
+	    for (k = 0; k < Ndim; k++)
+		GD_sum_t(G)[i][k] +=
 		    GD_spring(G)[i][j] * (del[k] -
 					  GD_dist(G)[i][j] * del[k] /
 					  dist);
-		GD_sum_t(G)[i][k] += GD_t(G)[i][j][k];
-	    }
 	}
     }
     if (Verbose) {
@@ -424,299 +385,500 @@ static double total_e(graph_t * G, int nG)
     return e;
 }
 
-void solve_model(graph_t * G, int nG)
+void final_energy(graph_t * G, int nG)
 {
-    node_t *np;
+    fprintf(stderr, "iterations = %d final e = %f\n", GD_move(G),
+	    total_e(G, nG));
+}
 
-    Epsilon2 = Epsilon * Epsilon;
+/* The Kamada-Kawai solver.
+ * The gradient of node i is the sum of the terms t(i,j) over j, where
+ * t(i,j) = K[i][j] * (del - D[i][j] * del / |del|) with del = pos(i) - pos(j)
+ * and t(j,i) = -t(i,j). Moving node m only changes the t(m,j), and the
+ * old ones can be recomputed from the old position of m, so they are not
+ * stored. The terms are found in the same pass as the Hessian of m, and
+ * all values are computed by the same expressions, in the same order, as
+ * when the terms were stored, so the layouts are the same.
+ *
+ * The positions and gradients are kept by dimension in arrays indexed by
+ * ND_id, and copied back to the graph at the end. The per-node work of
+ * a move runs in parallel for large graphs; the sums over the nodes are
+ * then taken in node order, so results do not depend on the number of
+ * threads.
+ *
+ * Every move changes the gradients of all nodes, so the node to move is
+ * found by a scan rather than kept in a priority queue.
+ */
 
-    while ((np = choose_node(G, nG))) {
-	move_node(G, nG, np);
-    }
-    if (Verbose) {
-	fprintf(stderr, "\nfinal e = %f", total_e(G, nG));
-	fprintf(stderr, " %d%s iterations %.2f sec\n",
-		GD_move(G), (GD_move(G) == MaxIter ? "!" : ""),
-		elapsed_sec());
+/* Below this number of nodes, a move is too short to be worth threads. */
+#define KK_PARALLEL_N 2000
+
+typedef struct {
+    int n;
+    double *pos[MAXDIM];	/* pos[k][i]: coordinate k of node i */
+    double *sum_t[MAXDIM];	/* sum_t[k][i]: gradient of node i */
+    double *told[MAXDIM];	/* t(m,j) before moving node m */
+    double *tnew[MAXDIM];	/* t(m,j) after moving node m */
+    double *hterm;		/* terms of the Hessian of m, n per entry */
+    double *sq;			/* squared distances from m */
+    double *dist;		/* distances from m */
+    double *scale;		/* distances from m to the -3 */
+    double *mag;		/* squared gradient; 0 for fixed nodes */
+    boolean *fixed;
+    double **K;
+    double **D;
+} kk_t;
+
+static void kkInit(kk_t * kk, graph_t * G, int nG)
+{
+    int i, k;
+    node_t *np;
+
+    kk->n = nG;
+    for (k = 0; k < Ndim; k++) {
+	kk->pos[k] = N_GNEW(nG, double);
+	kk->sum_t[k] = N_GNEW(nG, double);
+	kk->told[k] = N_GNEW(nG, double);
+	kk->tnew[k] = N_GNEW(nG, double);
+    }
+    kk->hterm = N_GNEW(nG * Ndim * (Ndim + 1) / 2, double);
+    kk->sq = N_GNEW(nG, double);
+    kk->dist = N_GNEW(nG, double);
+    kk->scale = N_GNEW(nG, double);
+    kk->mag = N_GNEW(nG, double);
+    kk->fixed = N_GNEW(nG, boolean);
+    kk->K = GD_spring(G);
+    kk->D = GD_dist(G);
+    for (i = 0; i < nG; i++) {
+	np = GD_neato_nlist(G)[i];
+	for (k = 0; k < Ndim; k++) {
+	    kk->pos[k][i] = ND_pos(np)[k];
+	    kk->sum_t[k][i] = GD_sum_t(G)[i][k];
+	}
+	kk->fixed[i] = (ND_pinned(np) > P_SET);
     }
-    if (GD_move(G) == MaxIter)
-	agerr(AGWARN, "Max. iterations (%d) reached on graph %s\n",
-	      MaxIter, agnameof(G));
 }
 
-void update_arrays(graph_t * G, int nG, int i)
+/* kkFinish:
+ * Copy the positions and gradients back to the graph.
+ */
+static void kkFinish(kk_t * kk, graph_t * G)
 {
-    int j, k;
-    double del[MAXDIM], dist, old;
-    node_t *vi, *vj;
+    int i, k;
+    node_t *np;
 
-    vi = GD_neato_nlist(G)[i];
-    for (k = 0; k < Ndim; k++)
-	GD_sum_t(G)[i][k] = 0.0;
-    for (j = 0; j < nG; j++) {
-	if (i == j)
-	    continue;
-	vj = GD_neato_nlist(G)[j];
-	dist = distvec(ND_pos(vi), ND_pos(vj), del);
+    for (i = 0; i < kk->n; i++) {
+	np = GD_neato_nlist(G)[i];
 	for (k = 0; k < Ndim; k++) {
-	    old = GD_t(G)[i][j][k];
-	    GD_t(G)[i][j][k] =
-		GD_spring(G)[i][j] * (del[k] -
-				      GD_dist(G)[i][j] * del[k] / dist);
-	    GD_sum_t(G)[i][k] += GD_t(G)[i][j][k];
-	    old = GD_t(G)[j][i][k];
-	    GD_t(G)[j][i][k] = -GD_t(G)[i][j][k];
-	    GD_sum_t(G)[j][k] += (GD_t(G)[j][i][k] - old);
+	    ND_pos(np)[k] = kk->pos[k][i];
+	    GD_sum_t(G)[i][k] = kk->sum_t[k][i];
 	}
     }
+    for (k = 0; k < Ndim; k++) {
+	free(kk->pos[k]);
+	free(kk->sum_t[k]);
+	free(kk->told[k]);
+	free(kk->tnew[k]);
+    }
+    free(kk->hterm);
+    free(kk->sq);
+    free(kk->dist);
+    free(kk->scale);
+    free(kk->mag);
+    free(kk->fixed);
 }
 
-#define Msub(i,j)  M[(i)*Ndim+(j)]
-void D2E(graph_t * G, int nG, int n, double *M)
+static double kkMag(kk_t * kk, int i)
 {
-    int i, l, k;
-    node_t *vi, *vn;
-    double scale, sq, t[MAXDIM];
-    double **K = GD_spring(G);
-    double **D = GD_dist(G);
+    int k;
+    double m = 0.0;
 
-    vn = GD_neato_nlist(G)[n];
-    for (l = 0; l < Ndim; l++)
-	for (k = 0; k < Ndim; k++)
-	    Msub(l, k) = 0.0;
-    for (i = 0; i < nG; i++) {
-	if (n == i)
-	    continue;
-	vi = GD_neato_nlist(G)[i];
-	sq = 0.0;
-	for (k = 0; k < Ndim; k++) {
-	    t[k] = ND_pos(vn)[k] - ND_pos(vi)[k];
-	    sq += (t[k] * t[k]);
-	}
-	scale = 1 / fpow32(sq);
-	for (k = 0; k < Ndim; k++) {
-	    for (l = 0; l < k; l++)
-		Msub(l, k) += K[n][i] * D[n][i] * t[k] * t[l] * scale;
-	    Msub(k, k) +=
-		K[n][i] * (1.0 - D[n][i] * (sq - (t[k] * t[k])) * scale);
+    if (kk->fixed[i])
+	return 0.0;
+    for (k = 0; k < Ndim; k++)
+	m += (kk->sum_t[k][i] * kk->sum_t[k][i]);
+    return m;
+}
+
+/* kkChoose:
+ * Return the movable node with the largest gradient, or -1 if the
+ * gradients are all below Epsilon or the iterations are used up.
+ * Ties go to the node with the smaller id.
+ */
+static int kkChoose(kk_t * kk, graph_t * G, int cnt)
+{
+    int i, choice = -1;
+    double max = 0.0;
+
+    if (GD_move(G) >= MaxIter)
+	return -1;
+    for (i = 0; i < kk->n; i++) {
+	/* could set the color=energy of the node here */
+	if (kk->mag[i] > max) {
+	    choice = i;
+	    max = kk->mag[i];
 	}
     }
-    for (k = 1; k < Ndim; k++)
-	for (l = 0; l < k; l++)
-	    Msub(k, l) = Msub(l, k);
+    if (max < Epsilon2)
+	choice = -1;
+    else if (Verbose && (cnt % 100 == 0)) {
+	fprintf(stderr, "%.3f ", sqrt(max));
+	if (cnt % 1000 == 0)
+	    fprintf(stderr, "\n");
+    }
+    return choice;
 }
 
-void final_energy(graph_t * G, int nG)
+/* sumExcept:
+ * Sum of v[0..n-1] but v[m], in order.
+ */
+static double sumExcept(double *v, int n, int m)
 {
-    fprintf(stderr, "iterations = %d final e = %f\n", GD_move(G),
-	    total_e(G, nG));
+    double s = 0.0;
+    int i;
+
+    for (i = 0; i < m; i++)
+	s += v[i];
+    for (i = m + 1; i < n; i++)
+	s += v[i];
+    return s;
 }
 
-node_t *choose_node(graph_t * G, int nG)
+/* kkDist:
+ * Set sq[i] and dist[i] to the squared and plain distances from node m,
+ * with 1 for m itself. Called inside a parallel region.
+ */
+static void kkDist(kk_t * kk, int m)
 {
+    int n = kk->n;
+    double *sq = kk->sq;
+    double *dist = kk->dist;
+    double *p, t;
     int i, k;
-    double m, max;
-    node_t *choice, *np;
-    static int cnt = 0;
-#if 0
-    double e;
-    static double save_e = MAXDOUBLE;
-#endif
 
-    cnt++;
-    if (GD_move(G) >= MaxIter)
-	return NULL;
-#if 0
-    if ((cnt % 100) == 0) {
-	e = total_e(G, nG);
-	if (e - save_e > 0)
-	    return NULL;
-	save_e = e;
+    for (k = 0; k < Ndim; k++) {
+	p = kk->pos[k];
+#pragma omp for simd schedule(static) private(t)
+	for (i = 0; i < n; i++) {
+	    t = p[m] - p[i];
+	    sq[i] = (k ? sq[i] : 0.0) + t * t;
+	}
     }
-#endif
-    max = 0.0;
-    choice = NULL;
-    for (i = 0; i < nG; i++) {
-	np = GD_neato_nlist(G)[i];
-	if (ND_pinned(np) > P_SET)
-	    continue;
-	for (m = 0.0, k = 0; k < Ndim; k++)
-	    m += (GD_sum_t(G)[i][k] * GD_sum_t(G)[i][k]);
-	/* could set the color=energy of the node here */
-	if (m > max) {
-	    choice = np;
-	    max = m;
+#pragma omp for simd schedule(static)
+    for (i = 0; i < n; i++) {
+	sq[i] = (i == m ? 1.0 : sq[i]);
+	dist[i] = sqrt(sq[i]);
+    }
+}
+
+/* kkHessian:
+ * Store in M the Hessian of the energy at node m, and in told the terms
+ * t(m,j).
+ */
+#define Msub(i,j)  M[(i)*Ndim+(j)]
+static void kkHessian(kk_t * kk, int m, double *M)
+{
+    int n = kk->n;
+    double *K = kk->K[m];
+    double *D = kk->D[m];
+    double *sq = kk->sq;
+    double *dist = kk->dist;
+    double *scale = kk->scale;
+    int i, k, l;
+    double *h;
+
+    /* Threads may be given different iterations of each SIMD loop, so
+     * the loops keep their implied barriers. */
+#pragma omp parallel private(i, k, l, h) if (n >= KK_PARALLEL_N)
+    {
+	double *pk, *pl, *tk, tkv, tlv;
+
+	kkDist(kk, m);
+#pragma omp for simd schedule(static)
+	for (i = 0; i < n; i++)
+	    scale[i] = 1 / (dist[i] * dist[i] * dist[i]);	/* fpow32 */
+	for (h = kk->hterm, k = 0; k < Ndim; k++) {
+	    pk = kk->pos[k];
+	    tk = kk->told[k];
+	    for (l = 0; l < k; l++, h += n) {
+		pl = kk->pos[l];
+#pragma omp for simd schedule(static) private(tkv, tlv)
+		for (i = 0; i < n; i++) {
+		    tkv = pk[m] - pk[i];
+		    tlv = pl[m] - pl[i];
+		    h[i] = K[i] * D[i] * tkv * tlv * scale[i];
+		}
+	    }
+#pragma omp for simd schedule(static) private(tkv)
+	    for (i = 0; i < n; i++) {
+		tkv = pk[m] - pk[i];
+		tk[i] = K[i] * (tkv - D[i] * tkv / dist[i]);
+		h[i] = K[i] * (1.0 - D[i] * (sq[i] - (tkv * tkv)) * scale[i]);
+	    }
+	    h += n;
 	}
     }
-    if (max < Epsilon2)
-	choice = NULL;
-    else {
-	if (Verbose && (cnt % 100 == 0)) {
-	    fprintf(stderr, "%.3f ", sqrt(max));
-	    if (cnt % 1000 == 0)
-		fprintf(stderr, "\n");
+
+    for (h = kk->hterm, k = 0; k < Ndim; k++) {
+	for (l = 0; l <= k; l++, h += n)
+	    Msub(l, k) = sumExcept(h, n, m);
+    }
+    for (k = 1; k < Ndim; k++)
+	for (l = 0; l < k; l++)
+	    Msub(k, l) = Msub(l, k);
+}
+
+/* kkUpdate:
+ * Update the gradients after node m has moved.
+ */
+static void kkUpdate(kk_t * kk, int m)
+{
+    int n = kk->n;
+    double *K = kk->K[m];
+    double *D = kk->D[m];
+    double *dist = kk->dist;
+    double *mag = kk->mag;
+    int i, k;
+
+#pragma omp parallel private(i, k) if (n >= KK_PARALLEL_N)
+    {
+	double *pk, *sk, *tk, *nk, t, del;
+
+	kkDist(kk, m);
+	for (k = 0; k < Ndim; k++) {
+	    pk = kk->pos[k];
+	    sk = kk->sum_t[k];
+	    tk = kk->told[k];
+	    nk = kk->tnew[k];
+#pragma omp for simd schedule(static) private(del, t)
+	    for (i = 0; i < n; i++) {
+		del = pk[m] - pk[i];
+		t = K[i] * (del - D[i] * del / dist[i]);
+		nk[i] = t;
+		sk[i] += (tk[i] - t);
+	    }
 	}
-#if 0
-	e = total_e(G, nG);
-	if (fabs((e - save_e) / save_e) < 1e-5) {
-	    choice = NULL;
+	for (k = 0; k < Ndim; k++) {
+	    sk = kk->sum_t[k];
+#pragma omp for simd schedule(static)
+	    for (i = 0; i < n; i++)
+		mag[i] = (k ? mag[i] : 0.0) + (sk[i] * sk[i]);
 	}
-#endif
     }
-    return choice;
+
+    /* m itself; the loops above left garbage there */
+    for (k = 0; k < Ndim; k++)
+	kk->sum_t[k][m] = sumExcept(kk->tnew[k], n, m);
+    for (i = 0; i < n; i++)
+	if (kk->fixed[i])
+	    mag[i] = 0.0;
+    mag[m] = kkMag(kk, m);
 }
 
-void move_node(graph_t * G, int nG, node_t * n)
+static void kkMove(kk_t * kk, graph_t * G, int m)
 {
-    int i, m;
+    int i;
     static double *a, b[MAXDIM], c[MAXDIM];
 
-    m = ND_id(n);
     a = ALLOC(Ndim * Ndim, a, double);
-    D2E(G, nG, m, a);
+    kkHessian(kk, m, a);
     for (i = 0; i < Ndim; i++)
-	c[i] = -GD_sum_t(G)[m][i];
+	c[i] = -kk->sum_t[i][m];
     solve(a, b, c, Ndim);
     for (i = 0; i < Ndim; i++) {
 	b[i] = (Damping + 2 * (1 - Damping) * drand48()) * b[i];
-	ND_pos(n)[i] += b[i];
+	kk->pos[i][m] += b[i];
     }
     GD_move(G)++;
-    update_arrays(G, nG, m);
+    kkUpdate(kk, m);
     if (test_toggle()) {
 	double sum = 0;
 	for (i = 0; i < Ndim; i++) {
 	    sum += fabs(b[i]);
 	}			/* Why not squared? */
 	sum = sqrt(sum);
-	fprintf(stderr, "%s %.3f\n", agnameof(n), sum);
+	fprintf(stderr, "%s %.3f\n", agnameof(GD_neato_nlist(G)[m]), sum);
     }
 }
 
-static node_t **Heap;
-static int Heapsize;
-static node_t *Src;
-
-void heapup(node_t * v)
+void solve_model(graph_t * G, int nG)
 {
-    int i, par;
-    node_t *u;
+    kk_t kk;
+    int i, cnt;
 
-    for (i = ND_heapindex(v); i > 0; i = par) {
-	par = (i - 1) / 2;
-	u = Heap[par];
-	if (ND_dist(u) <= ND_dist(v))
-	    break;
-	Heap[par] = v;
-	ND_heapindex(v) = par;
-	Heap[i] = u;
-	ND_heapindex(u) = i;
+    Epsilon2 = Epsilon * Epsilon;
+
+    kkInit(&kk, G, nG);
+    for (i = 0; i < nG; i++)
+	kk.mag[i] = kkMag(&kk, i);
+    for (cnt = 1; (i = kkChoose(&kk, G, cnt)) >= 0; cnt++)
+	kkMove(&kk, G, i);
+    kkFinish(&kk, G);
+    if (Verbose) {
+	fprintf(stderr, "\nfinal e = %f", total_e(G, nG));
+	fprintf(stderr, " %d%s iterations %.2f sec\n",
+		GD_move(G), (GD_move(G) == MaxIter ? "!" : ""),
+		elapsed_sec());
     }
+    if (GD_move(G) == MaxIter)
+	agerr(AGWARN, "Max. iterations (%d) reached on graph %s\n",
+	      MaxIter, agnameof(G));
 }
 
-void heapdown(node_t * v)
+/* The graph as adjacency arrays: the edges of node i are
+ * adj[start[i]] ... adj[start[i+1]-1], in agfstedge order.
+ */
+typedef struct {
+    int *start;
+    int *adj;
+    double *len;
+} adjlist_t;
+
+static void mkAdjList(graph_t * G, int nG, adjlist_t * al)
 {
-    int i, left, right, c;
-    node_t *u;
+    node_t *v, *u;
+    edge_t *e;
+    int i, k;
 
-    i = ND_heapindex(v);
-    while ((left = 2 * i + 1) < Heapsize) {
-	right = left + 1;
-	if ((right < Heapsize)
-	    && (ND_dist(Heap[right]) < ND_dist(Heap[left])))
-	    c = right;
-	else
-	    c = left;
-	u = Heap[c];
-	if (ND_dist(v) <= ND_dist(u))
-	    break;
-	Heap[c] = v;
-	ND_heapindex(v) = c;
-	Heap[i] = u;
-	ND_heapindex(u) = i;
-	i = c;
+    al->start = N_NEW(nG + 1, int);
+    for (k = 0, i = 0; (v = GD_neato_nlist(G)[i]); i++) {
+	al->start[i] = k;
+	for (e = agfstedge(G, v); e; e = agnxtedge(G, e, v))
+	    k++;
+    }
+    al->start[nG] = k;
+    al->adj = N_NEW(k, int);
+    al->len = N_NEW(k, double);
+    for (k = 0, i = 0; (v = GD_neato_nlist(G)[i]); i++) {
+	for (e = agfstedge(G, v); e; e = agnxtedge(G, e, v)) {
+	    if ((u = agtail(e)) == v)
+		u = aghead(e);
+	    al->adj[k] = ND_id(u);
+	    al->len[k++] = ED_dist(e);
+	}
     }
 }
 
-void neato_enqueue(node_t * v)
+/* sssp:
+ * Dijkstra's algorithm from node src, on adjacency arrays with a
+ * private heap, so that searches from several sources can run at once.
+ * Only row src of dij is written.
+ */
+static void sssp(adjlist_t * al, int nG, int src, double **dij,
+		 double *dist, int *hidx, int *heap)
 {
-    int i;
-
-    assert(ND_heapindex(v) < 0);
-    i = Heapsize++;
-    ND_heapindex(v) = i;
-    Heap[i] = v;
-    if (i > 0)
-	heapup(v);
-}
+    int i, c, par, left, right, v, u, k;
+    int hsize;
+    double f;
 
-node_t *neato_dequeue(void)
-{
-    int i;
-    node_t *rv, *v;
-
-    if (Heapsize == 0)
-	return NULL;
-    rv = Heap[0];
-    i = --Heapsize;
-    v = Heap[i];
-    Heap[0] = v;
-    ND_heapindex(v) = 0;
-    if (i > 1)
-	heapdown(v);
-    ND_heapindex(rv) = -1;
-    return rv;
+    for (i = 0; i < nG; i++) {
+	dist[i] = Initial_dist;
+	hidx[i] = -1;
+    }
+    dist[src] = 0;
+    heap[0] = src;
+    hidx[src] = 0;
+    hsize = 1;
+
+    while (hsize > 0) {
+	/* dequeue */
+	v = heap[0];
+	i = --hsize;
+	u = heap[i];
+	heap[0] = u;
+	hidx[u] = 0;
+	if (i > 1) {		/* heapdown(u) */
+	    i = 0;
+	    while ((left = 2 * i + 1) < hsize) {
+		right = left + 1;
+		if ((right < hsize) && (dist[heap[right]] < dist[heap[left]]))
+		    c = right;
+		else
+		    c = left;
+		if (dist[u] <= dist[heap[c]])
+		    break;
+		heap[i] = heap[c];
+		hidx[heap[i]] = i;
+		heap[c] = u;
+		hidx[u] = c;
+		i = c;
+	    }
+	}
+	hidx[v] = -1;
+
+	if (v != src)
+	    dij[src][v] = dist[v];
+	for (k = al->start[v]; k < al->start[v + 1]; k++) {
+	    u = al->adj[k];
+	    f = dist[v] + al->len[k];
+	    if (dist[u] > f) {
+		dist[u] = f;
+		if (hidx[u] < 0) {	/* enqueue */
+		    hidx[u] = hsize;
+		    heap[hsize++] = u;
+		}
+		for (i = hidx[u]; i > 0; i = par) {	/* heapup(u) */
+		    par = (i - 1) / 2;
+		    if (dist[heap[par]] <= dist[u])
+			break;
+		    heap[i] = heap[par];
+		    hidx[heap[i]] = i;
+		    heap[par] = u;
+		    hidx[u] = par;
+		}
+	    }
+	}
+    }
 }
 
+/* shortest_path:
+ * Set GD_dist to the shortest path lengths between all pairs.
+ * cgraph traversals are not reentrant, so the graph is first copied
+ * into adjacency arrays; then the single source searches run in
+ * parallel, each filling its own row of GD_dist.
+ * As when the sources were searched one after another, the value kept
+ * for a pair is the one from the later source, if it reached the other
+ * node.
+ */
 void shortest_path(graph_t * G, int nG)
 {
-    node_t *v;
+    adjlist_t al;
+    double **dij = GD_dist(G);
+    int i, j;
 
-    Heap = N_NEW(nG + 1, node_t *);
     if (Verbose) {
 	fprintf(stderr, "Calculating shortest paths: ");
 	start_timer();
     }
-    for (v = agfstnode(G); v; v = agnxtnode(G, v))
-	s1(G, v);
-    if (Verbose) {
-	fprintf(stderr, "%.2f sec\n", elapsed_sec());
+    mkAdjList(G, nG, &al);
+#pragma omp parallel
+    {
+	double *dist = N_NEW(nG, double);
+	int *hidx = N_NEW(nG, int);
+	int *heap = N_NEW(nG + 1, int);
+	int src;
+
+#pragma omp for schedule(dynamic, 16)
+	for (src = 0; src < nG; src++)
+	    sssp(&al, nG, src, dij, dist, hidx, heap);
+	free(dist);
+	free(hidx);
+	free(heap);
     }
-    free(Heap);
-}
-
-void s1(graph_t * G, node_t * node)
-{
-    node_t *v, *u;
-    edge_t *e;
-    int t;
-    double f;
-
-    for (t = 0; (v = GD_neato_nlist(G)[t]); t++)
-	ND_dist(v) = Initial_dist;
-    Src = node;
-    ND_dist(Src) = 0;
-    ND_hops(Src) = 0;
-    neato_enqueue(Src);
-
-    while ((v = neato_dequeue())) {
-	if (v != Src)
-	    make_spring(G, Src, v, ND_dist(v));
-	for (e = agfstedge(G, v); e; e = agnxtedge(G, e, v)) {
-	    if ((u = agtail(e)) == v)
-		u = aghead(e);
-	    f = ND_dist(v) + ED_dist(e);
-	    if (ND_dist(u) > f) {
-		ND_dist(u) = f;
-		if (ND_heapindex(u) >= 0)
-		    heapup(u);
-		else {
-		    ND_hops(u) = ND_hops(v) + 1;
-		    neato_enqueue(u);
-		}
-	    }
+    for (i = 0; i < nG; i++) {
+	for (j = i + 1; j < nG; j++) {
+	    if (dij[j][i] < Initial_dist)
+		dij[i][j] = dij[j][i];
+	    else
+		dij[j][i] = dij[i][j];
 	}
     }
+    free(al.start);
+    free(al.adj);
+    free(al.len);
+    if (Verbose) {
+	fprintf(stderr, "%.2f sec\n", elapsed_sec());
+    }
 }
 
 void make_spring(graph_t * G, node_t * u, node_t * v, double f)
@@ -11,15 +11,41 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
-#include "mem.h"
-#include "geometry.h"
-#include "edges.h"
-#include "hedges.h"
-#include "heap.h"
+#include "render.h"
 #include "voronoi.h"
+#include <math.h>
 
 
-void voronoi(int triangulate, Site * (*nextsite) (void))
+/* vorinit:
+ * Set up vp for nsites sites. The node info and site arrays
+ * belong to the caller.
+ */
+void vorinit(Voronoi_t * vp, int nsites)
+{
+    memset(vp, 0, sizeof(Voronoi_t));
+    vp->nsites = nsites;
+    vp->sqrt_nsites = (int) sqrt((double) (nsites + 4));
+    freeinit(&vp->sfl, sizeof(Site), vp->sqrt_nsites);
+    freeinit(&vp->efl, sizeof(Edge), vp->sqrt_nsites);
+    freeinit(&vp->hfl, sizeof(Halfedge), vp->sqrt_nsites);
+    freeinit(&vp->pfl, sizeof(PtItem), vp->sqrt_nsites);
+}
+
+/* vorcleanup:
+ * Free the memory held by vp.
+ */
+void vorcleanup(Voronoi_t * vp)
+{
+    PQcleanup(vp);
+    ELcleanup(vp);
+    freeinit(&vp->sfl, sizeof(Site), vp->sqrt_nsites);
+    freeinit(&vp->efl, sizeof(Edge), vp->sqrt_nsites);
+    freeinit(&vp->hfl, sizeof(Halfedge), vp->sqrt_nsites);
+    freeinit(&vp->pfl, sizeof(PtItem), vp->sqrt_nsites);
+}
+
+void voronoi(Voronoi_t * vp, int triangulate,
+	     Site * (*nextsite) (Voronoi_t *))
 {
     Site *newsite, *bot, *top, *temp, *p;
     Site *v;
@@ -28,21 +54,21 @@ void voronoi(int triangulate, Site * (*nextsite) (void))
     Halfedge *lbnd, *rbnd, *llbnd, *rrbnd, *bisector;
     Edge *e;
 
-    edgeinit();
-    siteinit();
-    PQinitialize();
-    bottomsite = (*nextsite) ();
+    edgeinit(vp);
+    siteinit(vp);
+    PQinitialize(vp);
+    vp->bottomsite = (*nextsite) (vp);
 #ifdef STANDALONE
-    out_site(bottomsite);
+    out_site(vp->bottomsite);
 #endif
-    ELinitialize();
+    ELinitialize(vp);
 
-    newsite = (*nextsite) ();
+    newsite = (*nextsite) (vp);
     while (1) {
-	if (!PQempty())
-	    newintstar = PQ_min();
+	if (!PQempty(vp))
+	    newintstar = PQ_min(vp);
 
-	if (newsite != (struct Site *) NULL && (PQempty()
+	if (newsite != (struct Site *) NULL && (PQempty(vp)
 						|| newsite->coord.y <
 						newintstar.y
 						|| (newsite->coord.y ==
@@ -53,39 +79,39 @@ void voronoi(int triangulate, Site * (*nextsite) (void))
 #ifdef STANDALONE
 	    out_site(newsite);
 #endif
-	    lbnd = ELleftbnd(&(newsite->coord));
+	    lbnd = ELleftbnd(vp, &(newsite->coord));
 	    rbnd = ELright(lbnd);
-	    bot = rightreg(lbnd);
-	    e = bisect(bot, newsite);
-	    bisector = HEcreate(e, le);
+	    bot = rightreg(vp, lbnd);
+	    e = bisect(vp, bot, newsite);
+	    bisector = HEcreate(vp, e, le);
 	    ELinsert(lbnd, bisector);
-	    if ((p = hintersect(lbnd, bisector)) != (struct Site *) NULL) {
-		PQdelete(lbnd);
-		PQinsert(lbnd, p, dist(p, newsite));
+	    if ((p = hintersect(vp, lbnd, bisector)) != (struct Site *) NULL) {
+		PQdelete(vp, lbnd);
+		PQinsert(vp, lbnd, p, dist(p, newsite));
 	    }
 	    lbnd = bisector;
-	    bisector = HEcreate(e, re);
+	    bisector = HEcreate(vp, e, re);
 	    ELinsert(lbnd, bisector);
-	    if ((p = hintersect(bisector, rbnd)) != (struct Site *) NULL)
-		PQinsert(bisector, p, dist(p, newsite));
-	    newsite = (*nextsite) ();
-	} else if (!PQempty()) {
+	    if ((p = hintersect(vp, bisector, rbnd)) != (struct Site *) NULL)
+		PQinsert(vp, bisector, p, dist(p, newsite));
+	    newsite = (*nextsite) (vp);
+	} else if (!PQempty(vp)) {
 	    /* intersection is smallest */
-	    lbnd = PQextractmin();
+	    lbnd = PQextractmin(vp);
 	    llbnd = ELleft(lbnd);
 	    rbnd = ELright(lbnd);
 	    rrbnd = ELright(rbnd);
-	    bot = leftreg(lbnd);
-	    top = rightreg(rbnd);
+	    bot = leftreg(vp, lbnd);
+	    top = rightreg(vp, rbnd);
 #ifdef STANDALONE
-	    out_triple(bot, top, rightreg(lbnd));
+	    out_triple(bot, top, rightreg(vp, lbnd));
 #endif
 	    v = lbnd->vertex;
-	    makevertex(v);
-	    endpoint(lbnd->ELedge, lbnd->ELpm, v);
-	    endpoint(rbnd->ELedge, rbnd->ELpm, v);
+	    makevertex(vp, v);
+	    endpoint(vp, lbnd->ELedge, lbnd->ELpm, v);
+	    endpoint(vp, rbnd->ELedge, rbnd->ELpm, v);
 	    ELdelete(lbnd);
-	    PQdelete(rbnd);
+	    PQdelete(vp, rbnd);
 	    ELdelete(rbnd);
 	    pm = le;
 	    if (bot->coord.y > top->coord.y) {
@@ -94,26 +120,26 @@ void voronoi(int triangulate, Site * (*nextsite) (void))
 		top = temp;
 		pm = re;
 	    }
-	    e = bisect(bot, top);
-	    bisector = HEcreate(e, pm);
+	    e = bisect(vp, bot, top);
+	    bisector = HEcreate(vp, e, pm);
 	    ELinsert(llbnd, bisector);
-	    endpoint(e, re - pm, v);
-	    deref(v);
-	    if ((p = hintersect(llbnd, bisector)) != (struct Site *) NULL) {
-		PQdelete(llbnd);
-		PQinsert(llbnd, p, dist(p, bot));
+	    endpoint(vp, e, re - pm, v);
+	    deref(vp, v);
+	    if ((p = hintersect(vp, llbnd, bisector)) != (struct Site *) NULL) {
+		PQdelete(vp, llbnd);
+		PQinsert(vp, llbnd, p, dist(p, bot));
 	    }
-	    if ((p = hintersect(bisector, rrbnd)) != (struct Site *) NULL) {
-		PQinsert(bisector, p, dist(p, bot));
+	    if ((p = hintersect(vp, bisector, rrbnd)) != (struct Site *) NULL) {
+		PQinsert(vp, bisector, p, dist(p, bot));
 	    }
 	} else
 	    break;
     }
 
-    for (lbnd = ELright(ELleftend); lbnd != ELrightend;
+    for (lbnd = ELright(vp->ELleftend); lbnd != vp->ELrightend;
 	 lbnd = ELright(lbnd)) {
 	e = lbnd->ELedge;
-	clip_line(e);
+	clip_line(vp, e);
 #ifdef STANDALONE
 	out_ep(e);
 #endif
@@ -20,9 +20,47 @@ extern "C" {
 #ifndef VORONOI_H
 #define VORONOI_H
 
+#include "mem.h"
 #include "site.h"
+#include "edges.h"
+#include "hedges.h"
+#include "heap.h"
+#include "info.h"
 
-    extern void voronoi(int, Site * (*)(void));
+    /* All the state of Fortune's sweep, so that diagrams can be
+     * built concurrently. The freelists and hash tables are sized
+     * by vorinit and reused by each call to voronoi.
+     */
+    struct Voronoi_t {
+	int nsites;		/* Number of sites */
+	int sqrt_nsites;
+	double xmin, xmax, ymin, ymax;	/* extreme x,y values of sites */
+	double deltax, deltay;	/* xmax - xmin, ymax - ymin */
+	double pxmin, pxmax, pymin, pymax;	/* clipping window */
+	Info_t *nodeInfo;	/* Array of node info */
+	Site **sites;		/* Sites sorted on y, then x */
+	Site **endSite;		/* Sentinel on sites array */
+	Site **nextSite;	/* Next site for the sweep */
+	Info_t **byx;		/* Scratch for counting overlaps */
+	Site *bottomsite;
+	int nvertices;
+	int nedges;
+	Freelist sfl;		/* Sites used as vertices */
+	Freelist efl;		/* Edges */
+	Freelist hfl;		/* Halfedges */
+	Freelist pfl;		/* Polygon vertices of sites */
+	Halfedge *ELleftend, *ELrightend;
+	int ELhashsize;
+	Halfedge **ELhash;
+	Halfedge *PQhash;
+	int PQhashsize;
+	int PQcount;
+	int PQmin;
+    };
+
+    extern void vorinit(Voronoi_t *, int);
+    extern void vorcleanup(Voronoi_t *);
+    extern void voronoi(Voronoi_t *, int, Site * (*)(Voronoi_t *));
 
 #endif
 
@@ -107,10 +107,7 @@ void Pobsclose(vconfig_t * config)
     free(config->start);
     free(config->next);
     free(config->prev);
-    if (config->vis) {
-	free(config->vis[0]);
-	free(config->vis);
-    }
+    freeVisibility(config);
     free(config);
 }
 
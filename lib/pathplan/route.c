@@ -72,6 +72,9 @@ static elist_t *elist;
 static Ppoint_t *ops;
 static int opn, opl;
 
+/* Proutespline may be called concurrently from several threads */
+#pragma omp threadprivate(jbuf, ops, opn, opl)
+
 static int reallyroutespline(Pedge_t *, int,
 			     Ppoint_t *, int, Ppoint_t, Ppoint_t);
 static int mkspline(Ppoint_t *, int, tna_t *, Ppoint_t, Ppoint_t,
@@ -206,6 +209,7 @@ static int reallyroutespline(Pedge_t * edges, int edgen,
 
     static tna_t *tnas;
     static int tnan;
+#pragma omp threadprivate(tnas, tnan)
 
     if (tnan < inpn) {
 	if (!tnas) {
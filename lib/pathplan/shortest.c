@@ -82,6 +82,9 @@ static deque_t dq;
 static Ppoint_t *ops;
 static int opn;
 
+/* Pshortestpath may be called concurrently from several threads */
+#pragma omp threadprivate(jbuf, pnls, pnlps, pnln, pnll, tris, trin, tril, dq, ops, opn)
+
 static void triangulate(pointnlink_t **, int);
 static int isdiagonal(int, int, pointnlink_t **, int);
 static void loadtriangle(pointnlink_t *, pointnlink_t *, pointnlink_t *);
@@ -12,6 +12,7 @@
  *************************************************************************/
 
 
+#include <string.h>
 #include "vis.h"
 
 #ifdef DMALLOC
@@ -87,6 +88,136 @@ int *shortestPath(int root, int target, int V, array2 wadj)
     return dad;
 }
 
+typedef struct {
+    COORD d;
+    int v;
+} hitem;
+
+#define HLESS(a,b) (((a).d < (b).d) || (((a).d == (b).d) && ((a).v < (b).v)))
+
+static void hpush(hitem ** heap, int *n, int *sz, COORD d, int v)
+{
+    hitem *h;
+    hitem it;
+    int i = (*n)++;
+
+    if (*n > *sz) {
+	*sz *= 2;
+	*heap = (hitem *) realloc(*heap, *sz * sizeof(hitem));
+    }
+    h = *heap;
+    it.d = d;
+    it.v = v;
+    while (i > 0 && HLESS(it, h[(i - 1) / 2])) {
+	h[i] = h[(i - 1) / 2];
+	i = (i - 1) / 2;
+    }
+    h[i] = it;
+}
+
+static hitem hpop(hitem * h, int *n)
+{
+    hitem top = h[0];
+    hitem last = h[--(*n)];
+    int i = 0, c;
+
+    while ((c = 2 * i + 1) < *n) {
+	if (c + 1 < *n && HLESS(h[c + 1], h[c]))
+	    c++;
+	if (!HLESS(h[c], last))
+	    break;
+	h[i] = h[c];
+	i = c;
+    }
+    h[i] = last;
+    return top;
+}
+
+/* shortestPathAdj:
+ * As shortestPath, from the point p with visibility vector pvis to the
+ * point q with visibility vector qvis, using the adjacency lists of conf
+ * in place of the matrix rows. Vertices are settled in the same order,
+ * closest first with ties going to the lowest index, and with the same
+ * arithmetic, so the result is the same as that of shortestPath.
+ * Returns NULL if q cannot be reached, in which case shortestPath
+ * should be used.
+ */
+static int *shortestPathAdj(vconfig_t * conf, COORD * pvis, COORD * qvis)
+{
+    int V = conf->N;
+    int root = V + 1;
+    int target = V;
+    int *dad;
+    COORD *val;
+    char *done;
+    hitem *heap;
+    hitem it;
+    int n = 0, sz = 64;
+    int i, k, t;
+
+    dad = (int *) malloc((V + 2) * sizeof(int));
+    val = (COORD *) malloc((V + 2) * sizeof(COORD));
+    done = (char *) calloc(V + 2, sizeof(char));
+    heap = (hitem *) malloc(sz * sizeof(hitem));
+    for (k = 0; k < V + 2; k++) {
+	dad[k] = -1;
+	val[k] = unseen;
+    }
+
+    k = root;
+    val[k] = 0;
+    for (;;) {
+	done[k] = 1;
+	if (k == root) {
+	    for (t = 0; t <= V; t++) {
+		COORD newpri = val[k] + pvis[t];
+		if ((pvis[t] != 0) && (newpri < val[t])) {
+		    val[t] = newpri;
+		    dad[t] = k;
+		    hpush(&heap, &n, &sz, newpri, t);
+		}
+	    }
+	} else {
+	    for (i = conf->adjstart[k]; i < conf->adjstart[k + 1]; i++) {
+		COORD newpri = val[k] + conf->adjw[i];
+		t = conf->adj[i];
+		if (!done[t] && (newpri < val[t])) {
+		    val[t] = newpri;
+		    dad[t] = k;
+		    hpush(&heap, &n, &sz, newpri, t);
+		}
+	    }
+	    if (qvis[k] != 0 && (val[k] + qvis[k] < val[target])) {
+		val[target] = val[k] + qvis[k];
+		dad[target] = k;
+		hpush(&heap, &n, &sz, val[target], target);
+	    }
+	}
+
+	/* next closest vertex, skipping stale entries */
+	do {
+	    if (n == 0) {
+		k = -1;
+		break;
+	    }
+	    it = hpop(heap, &n);
+	    k = it.v;
+	} while (done[k] || it.d != val[k]);
+	if (k < 0) {
+	    free(dad);
+	    dad = NULL;
+	    break;
+	}
+	if (k == target)
+	    break;
+    }
+
+    free(val);
+    free(done);
+    free(heap);
+    return dad;
+}
+
 /* makePath:
  * Given two points p and q in two polygons pp and qp of a vconfig_t conf, 
  * and the visibility vectors of p and q relative to conf, 
@@ -95,7 +226,7 @@ int *shortestPath(int root, int target, int V, array2 wadj)
  * conf, then the path is V(==q), dad[V], dad[dad[V]], ..., V+1(==p).
  * NB: This is the only path that is guaranteed to be valid.
  * We have dad[V+1] = -1.
- * 
+ * conf is not modified, so paths may be computed concurrently.
  */
 int *makePath(Ppoint_t p, int pp, COORD * pvis,
 	      Ppoint_t q, int qp, COORD * qvis, vconfig_t * conf)
@@ -108,9 +239,15 @@ int *makePath(Ppoint_t p, int pp, COORD * pvis,
 	dad[V + 1] = -1;
 	return dad;
     } else {
-	array2 wadj = conf->vis;
-	wadj[V] = qvis;
-	wadj[V + 1] = pvis;
-	return (shortestPath(V + 1, V, V + 2, wadj));
+	int *dad = shortestPathAdj(conf, pvis, qvis);
+	if (!dad) {
+	    array2 wadj = (array2) malloc((V + 2) * sizeof(COORD *));
+	    memcpy(wadj, conf->vis, V * sizeof(COORD *));
+	    wadj[V] = qvis;
+	    wadj[V + 1] = pvis;
+	    dad = shortestPath(V + 1, V, V + 2, wadj);
+	    free(wadj);
+	}
+	return dad;
     }
 }
@@ -83,6 +83,7 @@ make_polyline(Ppolyline_t line, Ppolyline_t* sline)
 {
     static int isz = 0;
     static Ppoint_t* ispline = 0;
+#pragma omp threadprivate(isz, ispline)
     int i, j;
     int npts = 4 + 3*(line.pn-2);
 
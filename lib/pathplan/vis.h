@@ -45,6 +45,23 @@ extern "C" {
 
 	/* this is computed from the above */
 	array2 vis;
+
+	/* adjacency lists of vis: the vertices seen from vertex i are
+	 * adj[adjstart[i]], ..., adj[adjstart[i+1]-1], at distances adjw[]
+	 */
+	int *adjstart;
+	int *adj;
+	COORD *adjw;
+
+	/* uniform grid over the barrier segments, with lower left corner
+	 * LL and gw x gh cells of size cw x ch. The segments meeting cell
+	 * c = y*gw + x are cellseg[cellstart[c]], ..., cellseg[cellstart[c+1]-1]
+	 */
+	Ppoint_t LL;
+	double cw, ch;
+	int gw, gh;
+	int *cellstart;
+	int *cellseg;
     };
 #ifdef WIN32
 #ifndef PATHPLAN_EXPORTS
@@ -56,6 +73,7 @@ extern "C" {
 	extern COORD *ptVis(vconfig_t *, int, Ppoint_t);
     extern int directVis(Ppoint_t, int, Ppoint_t, int, vconfig_t *);
     extern void visibility(vconfig_t *);
+    extern void freeVisibility(vconfig_t *);
     extern int *makePath(Ppoint_t p, int pp, COORD * pvis,
 			 Ppoint_t q, int qp, COORD * qvis,
 			 vconfig_t * conf);
@@ -12,6 +12,7 @@
  *************************************************************************/
 
 
+#include <string.h>
 #include "vis.h"
 
 #ifdef DMALLOC
@@ -25,6 +26,13 @@
 #define INTERSECT(a,b,c,d,e) intersect((a),(b),(c),(d))
 #endif
 
+#ifndef MIN
+#define MIN(a,b)	((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b)	((a) > (b) ? (a) : (b))
+#endif
+
 /* allocArray:
  * Allocate a VxV array of COORD values.
  * (array2 is a pointer to an array of pointers; the array is
@@ -231,23 +239,151 @@ static int inCone(int i, int j, Ppoint_t pts[], int nextPt[], int prevPt[])
     return in_cone(pts[prevPt[i]], pts[i], pts[nextPt[i]], pts[j]);
 }
 
-/* clear:
- * Return true if no polygon line segment non-trivially intersects
- * the segment [pti,ptj], ignoring segments in [start,end).
+/* cellIdx:
+ * Return the index of the grid cell of size sz, among n cells starting at lo,
+ * containing v. Values outside the grid are mapped to the boundary cells.
  */
-static int clear(Ppoint_t pti, Ppoint_t ptj,
-		 int start, int end,
-		 int V, Ppoint_t pts[], int nextPt[], int prevPt[])
+static int cellIdx(double v, double lo, double sz, int n)
 {
-    int k;
+    double f = (v - lo) / sz;
 
-    for (k = 0; k < start; k++) {
-	if (INTERSECT(pti, ptj, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
+    if (f < 0)
+	return 0;
+    else if (f >= n)
+	return n - 1;
+    else
+	return (int) f;
+}
+
+/* mkGrid:
+ * Build a uniform grid over the barrier segments, with about one
+ * polygon per cell. Each segment is recorded in every cell met by
+ * its bounding box.
+ */
+static void mkGrid(vconfig_t * conf)
+{
+    int V = conf->N;
+    Ppoint_t *pts = conf->P;
+    int *nextPt = conf->next;
+    Ppoint_t LL, UR, p, q;
+    double w, h, sz;
+    int i, k, x, y, x0, x1, y0, y1, ncells;
+    int *cnt;
+
+    LL.x = LL.y = 0;
+    UR = LL;
+    for (k = 0; k < V; k++) {
+	p = pts[k];
+	if (k == 0 || p.x < LL.x)
+	    LL.x = p.x;
+	if (k == 0 || p.y < LL.y)
+	    LL.y = p.y;
+	if (k == 0 || p.x > UR.x)
+	    UR.x = p.x;
+	if (k == 0 || p.y > UR.y)
+	    UR.y = p.y;
     }
-    for (k = end; k < V; k++) {
-	if (INTERSECT(pti, ptj, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
+    w = UR.x - LL.x;
+    h = UR.y - LL.y;
+    sz = (conf->Npoly > 0) ? sqrt(w * h / conf->Npoly) : 0;
+    conf->gw = (sz > 0 && w / sz < V) ? (int) (w / sz) + 1 : (w > 0 ? V : 1);
+    conf->gh = (sz > 0 && h / sz < V) ? (int) (h / sz) + 1 : (h > 0 ? V : 1);
+    conf->LL = LL;
+    conf->cw = (w > 0) ? w / conf->gw : 1;
+    conf->ch = (h > 0) ? h / conf->gh : 1;
+    ncells = conf->gw * conf->gh;
+
+    cnt = (int *) calloc(ncells + 1, sizeof(int));
+    for (i = 0; i < 2; i++) {
+	for (k = 0; k < V; k++) {
+	    p = pts[k];
+	    q = pts[nextPt[k]];
+	    x0 = cellIdx(MIN(p.x, q.x), LL.x, conf->cw, conf->gw);
+	    x1 = cellIdx(MAX(p.x, q.x), LL.x, conf->cw, conf->gw);
+	    y0 = cellIdx(MIN(p.y, q.y), LL.y, conf->ch, conf->gh);
+	    y1 = cellIdx(MAX(p.y, q.y), LL.y, conf->ch, conf->gh);
+	    for (y = y0; y <= y1; y++)
+		for (x = x0; x <= x1; x++) {
+		    if (i == 0)
+			cnt[y * conf->gw + x + 1]++;
+		    else
+			conf->cellseg[cnt[y * conf->gw + x]++] = k;
+		}
+	}
+	if (i == 0) {
+	    for (k = 0; k < ncells; k++)
+		cnt[k + 1] += cnt[k];
+	    conf->cellstart = (int *) malloc((ncells + 1) * sizeof(int));
+	    memcpy(conf->cellstart, cnt, (ncells + 1) * sizeof(int));
+	    conf->cellseg = (int *) malloc(MAX(cnt[ncells], 1) * sizeof(int));
+	}
+    }
+    free(cnt);
+}
+
+/* clear:
+ * Return true if no polygon line segment non-trivially intersects
+ * the segment [a,b], ignoring segments in [s1,e1) and [s2,e2).
+ *
+ * A segment can only be reported if it crosses [a,b], or if one of its
+ * endpoints c has wind(a,b,c) == 0 and inBetween(a,b,c). As wind()
+ * treats areas below .0001 as zero, such a c lies within .0001/|b.y-a.y|
+ * horizontally of a vertical [a,b], or else within .0001/|b.x-a.x|
+ * vertically of the line ab over the x range of [a,b]. We therefore
+ * only test the segments of the grid cells meeting that region, walking
+ * the cells from a towards b, which gives the same answer as testing
+ * all segments.
+ */
+static int clear(vconfig_t * conf, Ppoint_t a, Ppoint_t b,
+		 int s1, int e1, int s2, int e2)
+{
+    Ppoint_t *pts = conf->P;
+    int *nextPt = conf->next;
+    double len = sqrt(dist2(a, b));
+    double slack = 1e-6 * (conf->cw + conf->ch);
+    double del, dely, xl, xr, ya, yb, t;
+    int x, y, x0, x1, y0, y1, dx, dy, c, i, k;
+
+    del = ((len > 0) ? .0001 / len : HUGE_VAL) + slack;
+    dely = (a.x != b.x) ? .0001 / fabs(b.x - a.x) + slack : del;
+
+    x0 = cellIdx(a.x + (a.x <= b.x ? -del : del), conf->LL.x, conf->cw,
+		 conf->gw);
+    x1 = cellIdx(b.x + (a.x <= b.x ? del : -del), conf->LL.x, conf->cw,
+		 conf->gw);
+    dx = (x0 <= x1) ? 1 : -1;
+    for (x = x0; x != x1 + dx; x += dx) {
+	/* part of [a,b] within del of column x */
+	xl = (x == 0) ? -HUGE_VAL : conf->LL.x + x * conf->cw - del;
+	xr = (x == conf->gw - 1) ? HUGE_VAL : conf->LL.x + (x + 1) * conf->cw + del;
+	if (a.x == b.x) {
+	    ya = a.y;
+	    yb = b.y;
+	} else {
+	    t = (xl - a.x) / (b.x - a.x);
+	    ya = a.y + MIN(MAX(t, 0), 1) * (b.y - a.y);
+	    t = (xr - a.x) / (b.x - a.x);
+	    yb = a.y + MIN(MAX(t, 0), 1) * (b.y - a.y);
+	}
+	if (a.y <= b.y) {
+	    y0 = cellIdx(MIN(ya, yb) - dely, conf->LL.y, conf->ch, conf->gh);
+	    y1 = cellIdx(MAX(ya, yb) + dely, conf->LL.y, conf->ch, conf->gh);
+	    dy = 1;
+	} else {
+	    y0 = cellIdx(MAX(ya, yb) + dely, conf->LL.y, conf->ch, conf->gh);
+	    y1 = cellIdx(MIN(ya, yb) - dely, conf->LL.y, conf->ch, conf->gh);
+	    dy = -1;
+	}
+	for (y = y0; y != y1 + dy; y += dy) {
+	    c = y * conf->gw + x;
+	    for (i = conf->cellstart[c]; i < conf->cellstart[c + 1]; i++) {
+		k = conf->cellseg[i];
+		if ((s1 <= k && k < e1) || (s2 <= k && k < e2))
+		    continue;
+		if (INTERSECT(a, b, pts[k], pts[nextPt[k]], pts[conf->prev[k]]))
+		    return 0;
+	    }
+	}
     }
     return 1;
 }
@@ -258,6 +394,9 @@ static int clear(Ppoint_t pti, Ppoint_t ptj,
  * If two nodes cannot see each other, the matrix entry is 0.
  * If two nodes can see each other, the matrix entry is the distance
  * between them.
+ * The rows are independent, so each one fills in its lower triangle
+ * in parallel; the closing edges of the polygons and the upper
+ * triangle are filled in afterwards.
  */
 static void compVis(vconfig_t * conf, int start)
 {
@@ -267,17 +406,16 @@ static void compVis(vconfig_t * conf, int start)
     int *prevPt = conf->prev;
     array2 wadj = conf->vis;
     int j, i, previ;
-    COORD d;
 
+#pragma omp parallel for private(j, previ) schedule(dynamic, 16)
     for (i = start; i < V; i++) {
 	/* add edge between i and previ.
 	 * Note that this works for the cases of polygons of 1 and 2
 	 * vertices, though needless work is done.
 	 */
 	previ = prevPt[i];
-	d = dist(pts[i], pts[previ]);
-	wadj[i][previ] = d;
-	wadj[previ][i] = d;
+	if (previ < i)
+	    wadj[i][previ] = dist(pts[i], pts[previ]);
 
 	/* Check remaining, earlier vertices */
 	if (previ == i - 1)
@@ -287,11 +425,55 @@ static void compVis(vconfig_t * conf, int start)
 	for (; j >= 0; j--) {
 	    if (inCone(i, j, pts, nextPt, prevPt) &&
 		inCone(j, i, pts, nextPt, prevPt) &&
-		clear(pts[i], pts[j], V, V, V, pts, nextPt, prevPt)) {
+		clear(conf, pts[i], pts[j], V, V, V, V)) {
 		/* if i and j see each other, add edge */
-		d = dist(pts[i], pts[j]);
-		wadj[i][j] = d;
-		wadj[j][i] = d;
+		wadj[i][j] = dist(pts[i], pts[j]);
+	    }
+	}
+    }
+
+    for (i = start; i < V; i++) {
+	previ = prevPt[i];
+	if (previ > i)
+	    wadj[previ][i] = dist(pts[i], pts[previ]);
+    }
+    for (i = 0; i < V; i++)
+	for (j = 0; j < i; j++)
+	    wadj[j][i] = wadj[i][j];
+}
+
+/* mkAdj:
+ * Build the adjacency lists of the visibility graph from the lower
+ * triangle of conf->vis.
+ */
+static void mkAdj(vconfig_t * conf)
+{
+    int V = conf->N;
+    array2 wadj = conf->vis;
+    int i, j, n;
+
+    conf->adjstart = (int *) malloc((V + 1) * sizeof(int));
+    n = 0;
+    for (i = 0; i < V; i++) {
+	conf->adjstart[i] = n;
+	for (j = 0; j < V; j++)
+	    if (j != i && (i > j ? wadj[i][j] : wadj[j][i]) != 0)
+		n++;
+    }
+    conf->adjstart[V] = n;
+    conf->adj = (int *) malloc(MAX(n, 1) * sizeof(int));
+    conf->adjw = (COORD *) malloc(MAX(n, 1) * sizeof(COORD));
+    n = 0;
+    for (i = 0; i < V; i++) {
+	for (j = 0; j < V; j++) {
+	    COORD d;
+	    if (j == i)
+		continue;
+	    d = (i > j ? wadj[i][j] : wadj[j][i]);
+	    if (d != 0) {
+		conf->adj[n] = j;
+		conf->adjw[n] = d;
+		n++;
 	    }
 	}
     }
@@ -300,12 +482,30 @@ static void compVis(vconfig_t * conf, int start)
 /* visibility:
  * Given a vconfig_t conf, representing polygonal barriers,
  * compute the visibility graph of the vertices of conf. 
- * The graph is stored in conf->vis. 
+ * The graph is stored in conf->vis, and as adjacency lists.
  */
 void visibility(vconfig_t * conf)
 {
+    mkGrid(conf);
     conf->vis = allocArray(conf->N, 2);
     compVis(conf, 0);
+    mkAdj(conf);
+}
+
+/* freeVisibility:
+ * Free the data allocated by visibility.
+ */
+void freeVisibility(vconfig_t * conf)
+{
+    if (conf->vis) {
+	free(conf->vis[0]);
+	free(conf->vis);
+    }
+    free(conf->adjstart);
+    free(conf->adj);
+    free(conf->adjw);
+    free(conf->cellstart);
+    free(conf->cellseg);
 }
 
 /* polyhit:
@@ -364,7 +564,7 @@ COORD *ptVis(vconfig_t * conf, int pp, Ppoint_t p)
     for (k = 0; k < start; k++) {
 	pk = pts[k];
 	if (in_cone(pts[prevPt[k]], pk, pts[nextPt[k]], p) &&
-	    clear(p, pk, start, end, V, pts, nextPt, prevPt)) {
+	    clear(conf, p, pk, start, end, start, end)) {
 	    /* if p and pk see each other, add edge */
 	    d = dist(p, pk);
 	    vadj[k] = d;
@@ -378,7 +578,7 @@ COORD *ptVis(vconfig_t * conf, int pp, Ppoint_t p)
     for (k = end; k < V; k++) {
 	pk = pts[k];
 	if (in_cone(pts[prevPt[k]], pk, pts[nextPt[k]], p) &&
-	    clear(p, pk, start, end, V, pts, nextPt, prevPt)) {
+	    clear(conf, p, pk, start, end, start, end)) {
 	    /* if p and pk see each other, add edge */
 	    d = dist(p, pk);
 	    vadj[k] = d;
@@ -399,11 +599,6 @@ COORD *ptVis(vconfig_t * conf, int pp, Ppoint_t p)
  */
 int directVis(Ppoint_t p, int pp, Ppoint_t q, int qp, vconfig_t * conf)
 {
-    int V = conf->N;
-    Ppoint_t *pts = conf->P;
-    int *nextPt = conf->next;
-    /* int*   prevPt = conf->prev; */
-    int k;
     int s1, e1;
     int s2, e2;
 
@@ -434,17 +629,5 @@ int directVis(Ppoint_t p, int pp, Ppoint_t q, int qp, vconfig_t * conf)
 	e2 = conf->start[pp + 1];
     }
 
-    for (k = 0; k < s1; k++) {
-	if (INTERSECT(p, q, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
-    }
-    for (k = e1; k < s2; k++) {
-	if (INTERSECT(p, q, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
-    }
-    for (k = e2; k < V; k++) {
-	if (INTERSECT(p, q, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
-    }
-    return 1;
+    return clear(conf, p, q, s1, e1, s2, e2);
 }
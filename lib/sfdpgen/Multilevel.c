@@ -38,6 +38,7 @@ Multilevel_control Multilevel_control_new(int scheme, int mode){
 
   ctrl->coarsen_scheme = scheme;
   ctrl->coarsen_mode = mode;
+  ctrl->nthreads = 0;
   return ctrl;
 }
 
@@ -127,6 +128,81 @@ static void maximal_independent_vertex_set(SparseMatrix A, int randomize, int **
 }
 
 
+static void maximal_independent_vertex_set_luby(SparseMatrix A, int randomize, int nthreads, int **vset, int *nvset, int *nzc){
+  /* a parallel version of maximal_independent_vertex_set. Every vertex gets a priority (a random permutation
+     if randomize). In each round, an undecided vertex whose priority beats those of all its undecided neighbors joins
+     the C set, and the undecided neighbors of the new C vertices go to the F set. The vertex with the highest priority
+     always joins, so this terminates, usually after O(log n) rounds. Each round only reads the states left by the 
+     previous one, so the result does not depend on the number of threads. */
+  int i, j, *ia, *ja, m, *p, *join, nundecided, nz = 0;
+  int *v;
+
+  assert(A);
+  assert(SparseMatrix_known_strucural_symmetric(A));
+  ia = A->ia;
+  ja = A->ja;
+  m = A->m;
+  assert(A->n == m);
+  v = *vset = N_GNEW(m,int);
+  join = N_GNEW(m,int);
+  for (i = 0; i < m; i++) v[i] = MAX_IND_VTX_SET_U;
+  nthreads = get_num_threads(nthreads);
+
+  if (randomize){
+    p = random_permutation(m);
+  } else {
+    p = N_GNEW(m,int);
+    for (i = 0; i < m; i++) p[i] = m - i;/* lower numbered vertices first, as the serial scheme */
+  }
+
+  do {
+#pragma omp parallel for private(j) num_threads(nthreads) schedule(dynamic, 256)
+    for (i = 0; i < m; i++){
+      join[i] = FALSE;
+      if (v[i] != MAX_IND_VTX_SET_U) continue;
+      join[i] = TRUE;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	if (ja[j] != i && v[ja[j]] == MAX_IND_VTX_SET_U && p[ja[j]] > p[i]){
+	  join[i] = FALSE;
+	  break;
+	}
+      }
+    }
+
+    nundecided = 0;
+#pragma omp parallel for private(j) num_threads(nthreads) schedule(dynamic, 256) reduction(+:nundecided)
+    for (i = 0; i < m; i++){
+      if (v[i] != MAX_IND_VTX_SET_U) continue;
+      if (join[i]) {
+	v[i] = MAX_IND_VTX_SET_C;
+	continue;
+      }
+      for (j = ia[i]; j < ia[i+1]; j++){
+	if (join[ja[j]]) break;
+      }
+      if (j < ia[i+1]) {
+	v[i] = MAX_IND_VTX_SET_F;
+      } else {
+	nundecided++;
+      }
+    }
+  } while (nundecided > 0);
+
+  /* number the C vertices and count the entries of the restriction matrix as maximal_independent_vertex_set does */
+  *nvset = 0;
+  for (i = 0; i < m; i++){
+    if (v[i] != MAX_IND_VTX_SET_C) continue;
+    v[i] = (*nvset)++;
+    for (j = ia[i]; j < ia[i+1]; j++){
+      if (i != ja[j]) nz++;
+    }
+  }
+  *nzc = nz + *nvset;
+
+  FREE(p);
+  FREE(join);
+}
+
 static void maximal_independent_vertex_set_RS(SparseMatrix A, int randomize, int **vset, int *nvset, int *nzc){
   /* The Ruge-Stuben coarsening scheme. Initially all vertices are in the U set (with marker MAX_IND_VTX_SET_U),
      with gain equal to their degree. Select vertex with highest gain into a C set (with
@@ -321,6 +397,79 @@ static void maximal_independent_edge_set_heavest_edge_pernode(SparseMatrix A, in
 
 
 
+static int matching_edge_beats(real w1, int p1, int q1, real w2, int p2, int q2){
+  /* whether edge 1, with weight w1 and end point priorities p1 and q1, ranks above edge 2.
+     Ties in weight are broken by the priorities, which gives a strict order on the edges */
+  if (w1 != w2) return w1 > w2;
+  if (MAX(p1, q1) != MAX(p2, q2)) return MAX(p1, q1) > MAX(p2, q2);
+  return MIN(p1, q1) > MIN(p2, q2);
+}
+
+static void maximal_independent_edge_set_handshake(SparseMatrix A, int randomize, int nthreads, int **matching, int *nmatch){
+  /* a parallel heavy edge matching. In each round every unmatched vertex points at its best unmatched neighbor,
+     the heaviest edge first, ties broken by random vertex priorities. Two vertices pointing at each other get matched.
+     The best of all remaining edges is always matched, so the rounds go on until the matching is maximal.
+     Each round only reads the matching of the previous one, so the result does not depend on the number of threads. */
+  int i, j, k, *ia, *ja, m, n, *p, *cand, *match, nnew;
+  real *a = NULL, w, wbest;
+
+  assert(A);
+  assert(SparseMatrix_known_strucural_symmetric(A));
+  ia = A->ia;
+  ja = A->ja;
+  m = A->m;
+  n = A->n;
+  assert(n == m);
+  if (A->type == MATRIX_TYPE_REAL) {
+    assert(SparseMatrix_is_symmetric(A, FALSE));
+    a = (real*) A->a;
+  }
+  match = *matching = N_GNEW(m,int);
+  cand = N_GNEW(m,int);
+  for (i = 0; i < m; i++) match[i] = i;
+  *nmatch = n;
+  nthreads = get_num_threads(nthreads);
+
+  if (randomize){
+    p = random_permutation(m);
+  } else {
+    p = N_GNEW(m,int);
+    for (i = 0; i < m; i++) p[i] = m - i;
+  }
+
+  do {
+#pragma omp parallel for private(j, k, w, wbest) num_threads(nthreads) schedule(dynamic, 256)
+    for (i = 0; i < m; i++){
+      cand[i] = -1;
+      if (match[i] != i) continue;
+      wbest = 0;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	k = ja[j];
+	if (k == i || match[k] != k) continue;
+	w = a ? a[j] : 1.;
+	if (cand[i] < 0 || matching_edge_beats(w, p[i], p[k], wbest, p[i], p[cand[i]])){
+	  cand[i] = k;
+	  wbest = w;
+	}
+      }
+    }
+
+    nnew = 0;
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 256) reduction(+:nnew)
+    for (i = 0; i < m; i++){
+      if (cand[i] > i && cand[cand[i]] == i){
+	match[i] = cand[i];
+	match[cand[i]] = i;
+	nnew++;
+      }
+    }
+    *nmatch -= nnew;
+  } while (nnew > 0);
+
+  FREE(p);
+  FREE(cand);
+}
+
 #define node_degree(i) (ia[(i)+1] - ia[(i)])
 
 static void maximal_independent_edge_set_heavest_edge_pernode_leaves_first(SparseMatrix A, int randomize, int **cluster, int **clusterp, int *ncluster){
@@ -1074,6 +1223,9 @@ static void Multilevel_coarsen_internal(SparseMatrix A, SparseMatrix *cA, Sparse
   case COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_DEGREE_SCALED:
     if (ctrl->coarsen_scheme == COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_DEGREE_SCALED) 
       maximal_independent_edge_set_heavest_edge_pernode_scaled(A, ctrl->randomize, &matching, &nmatch);
+  case COARSEN_INDEPENDENT_EDGE_SET_HANDSHAKE:
+    if (ctrl->coarsen_scheme == COARSEN_INDEPENDENT_EDGE_SET_HANDSHAKE) 
+      maximal_independent_edge_set_handshake(A, ctrl->randomize, ctrl->nthreads, &matching, &nmatch);
     nc = nmatch;
     if ((ctrl->coarsen_mode == COARSEN_MODE_GENTLE && nc > ctrl->min_coarsen_factor*n) || nc == n || nc < ctrl->minsize) {
 #ifdef DEBUG_PRINT
@@ -1129,8 +1281,11 @@ static void Multilevel_coarsen_internal(SparseMatrix A, SparseMatrix *cA, Sparse
     break;
   case COARSEN_INDEPENDENT_VERTEX_SET:
   case COARSEN_INDEPENDENT_VERTEX_SET_RS:
+  case COARSEN_INDEPENDENT_VERTEX_SET_LUBY:
     if (ctrl->coarsen_scheme == COARSEN_INDEPENDENT_VERTEX_SET){
       maximal_independent_vertex_set(A, ctrl->randomize, &vset, &nvset, &nzc);
+    } else if (ctrl->coarsen_scheme == COARSEN_INDEPENDENT_VERTEX_SET_LUBY){
+      maximal_independent_vertex_set_luby(A, ctrl->randomize, ctrl->nthreads, &vset, &nvset, &nzc);
     } else {
       maximal_independent_vertex_set_RS(A, ctrl->randomize, &vset, &nvset, &nzc);
     }
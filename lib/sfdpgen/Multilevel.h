@@ -37,7 +37,7 @@ enum {MAX_IND_VTX_SET_U = -100, MAX_IND_VTX_SET_F = -1, MAX_IND_VTX_SET_C = 0};
 
 enum {MAX_CLUSTER_SIZE = 4};
 
-enum {EDGE_BASED_STA, COARSEN_INDEPENDENT_EDGE_SET, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_LEAVES_FIRST, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_SUPERNODES_FIRST, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_DEGREE_SCALED, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_CLUSTER_PERNODE_LEAVES_FIRST, EDGE_BASED_STO, VERTEX_BASED_STA, COARSEN_INDEPENDENT_VERTEX_SET, COARSEN_INDEPENDENT_VERTEX_SET_RS, VERTEX_BASED_STO, COARSEN_HYBRID};
+enum {EDGE_BASED_STA, COARSEN_INDEPENDENT_EDGE_SET, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_LEAVES_FIRST, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_SUPERNODES_FIRST, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_EDGE_PERNODE_DEGREE_SCALED, COARSEN_INDEPENDENT_EDGE_SET_HEAVEST_CLUSTER_PERNODE_LEAVES_FIRST, COARSEN_INDEPENDENT_EDGE_SET_HANDSHAKE, EDGE_BASED_STO, VERTEX_BASED_STA, COARSEN_INDEPENDENT_VERTEX_SET, COARSEN_INDEPENDENT_VERTEX_SET_RS, COARSEN_INDEPENDENT_VERTEX_SET_LUBY, VERTEX_BASED_STO, COARSEN_HYBRID};
 
 enum {COARSEN_MODE_GENTLE, COARSEN_MODE_FORCEFUL};
 
@@ -48,6 +48,7 @@ struct Multilevel_control_struct {
   int randomize;
   int coarsen_scheme;
   int coarsen_mode;
+  int nthreads;/* threads for the parallel schemes (COARSEN_INDEPENDENT_EDGE_SET_HANDSHAKE, COARSEN_INDEPENDENT_VERTEX_SET_LUBY). <= 0: the OpenMP default */
 };
 
 typedef struct Multilevel_control_struct *Multilevel_control;
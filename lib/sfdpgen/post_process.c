@@ -800,23 +800,14 @@ static void uniform_stress_augment_rhs(int m, int dim, real *x, real *y, real al
   }
 }
 
-static real uniform_stress_solve(SparseMatrix Lw, real alpha, int dim, real *x0, real *rhs, real tol, int maxit, int *flag){
-  Operator Ax;
-  Operator Precon;
-
-  Ax = Operator_uniform_stress_matmul(Lw, alpha);
-  Precon = Operator_uniform_stress_diag_precon_new(Lw, alpha);
-
-  return cg(Ax, Precon, Lw->m, dim, x0, rhs, tol, maxit, flag);
-
-}
-
 real StressMajorizationSmoother_smooth(StressMajorizationSmoother sm, int dim, real *x, int maxit_sm, real tol) {
   SparseMatrix Lw = sm->Lw, Lwd = sm->Lwd, Lwdd = NULL;
   int i, j, k, m, *id, *jd, *iw, *jw, idiag, flag = 0, iter = 0;
   real *w, *dd, *d, *y = NULL, *x0 = NULL, *x00 = NULL, diag, diff = 1, *lambda = sm->lambda, res, alpha = 0., M = 0.;
   SparseMatrix Lc = NULL;
   real dij, dist;
+  Operator Ax = NULL, Precon = NULL;
+  int precon_ic = FALSE;
 
 
   Lwdd = SparseMatrix_copy(Lwd);
@@ -846,6 +837,18 @@ real StressMajorizationSmoother_smooth(StressMajorizationSmoother sm, int dim, r
     M = ((real*) (sm->data))[1];
   }
 
+  /* Lw is the same in every iteration, so the operators for the CG solves, including the factoring of the 
+     preconditioner, are set up once. Each solve starts from the current x */
+  if (sm->scheme == SM_SCHEME_UNIFORM_STRESS){
+    Ax = Operator_uniform_stress_matmul(Lw, alpha);
+    Precon = Operator_uniform_stress_diag_precon_new(Lw, alpha);
+  } else {
+    Ax = Operator_matmul_new(Lw);
+    Precon = Operator_ic0_precon_new(Lw);
+    precon_ic = (Precon != NULL);
+    if (!Precon) Precon = Operator_diag_precon_new(Lw);
+  }
+
   while (iter++ < maxit_sm && diff > tol){
 #ifdef GVIEWER
     if (Gviewer) {
@@ -972,12 +975,7 @@ real StressMajorizationSmoother_smooth(StressMajorizationSmoother sm, int dim, r
     }
 #endif
 
-    if (sm->scheme == SM_SCHEME_UNIFORM_STRESS){
-      res = uniform_stress_solve(Lw, alpha, dim, x, y, sm->tol_cg, sm->maxit_cg, &flag);
-    } else {
-      res = SparseMatrix_solve(Lw, dim, x, y,  sm->tol_cg, sm->maxit_cg, SOLVE_METHOD_CG, &flag);
-      //res = SparseMatrix_solve(Lw, dim, x, y,  sm->tol_cg, 1, SOLVE_METHOD_JACOBI, &flag);
-    }
+    res = cg(Ax, Precon, m, dim, x, y, sm->tol_cg, sm->maxit_cg, &flag);
 
     if (flag) goto RETURN;
 #ifdef DEBUG_PRINT
@@ -1003,6 +1001,17 @@ real StressMajorizationSmoother_smooth(StressMajorizationSmoother sm, int dim, r
 #endif
 
  RETURN:
+  if (sm->scheme == SM_SCHEME_UNIFORM_STRESS){
+    if (Ax) Operator_uniform_stress_matmul_delete(Ax);
+    if (Precon) Operator_diag_precon_delete(Precon);
+  } else {
+    if (Ax) Operator_matmul_delete(Ax);
+    if (precon_ic) {
+      Operator_ic0_precon_delete(Precon);
+    } else if (Precon) {
+      Operator_diag_precon_delete(Precon);
+    }
+  }
   SparseMatrix_delete(Lwdd);
   if (Lc) {
     SparseMatrix_delete(Lc);
@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <spring_electrical.h>
+#include <Multilevel.h>
 #include <overlap.h>
 #include <uniform_stress.h>
 #include <stress_model.h>
@@ -39,21 +40,18 @@ static void sfdp_init_edge(edge_t * e)
     common_init_edge(e);
 }
 
-static void sfdp_init_node_edge(graph_t * g)
+static void sfdp_init_node_edge(graph_t * g, int incremental)
 {
     node_t *n;
     edge_t *e;
-#if 0
     int nnodes = agnnodes(g);
-    attrsym_t *N_pos = agfindnodeattr(g, "pos");
-#endif
+    attrsym_t *N_pos = incremental ? agfindnodeattr(g, "pos") : NULL;
 
     for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
 	neato_init_node(n);
-#if 0
-   FIX so that user positions works with multiscale
-	user_pos(N_pos, NULL, n, nnodes); 
-#endif
+	/* user positions are only used as the layout to refine in incremental mode */
+	if (N_pos)
+	    user_pos(N_pos, NULL, n, nnodes); 
     }
     for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
 	for (e = agfstout(g, n); e; e = agnxtout(g, e))
@@ -61,7 +59,7 @@ static void sfdp_init_node_edge(graph_t * g)
     }
 }
 
-static void sfdp_init_graph(Agraph_t * g)
+static void sfdp_init_graph(Agraph_t * g, int incremental)
 {
     int outdim;
 
@@ -70,7 +68,7 @@ static void sfdp_init_graph(Agraph_t * g)
     GD_ndim(agroot(g)) = late_int(g, agfindgraphattr(g, "dim"), outdim, 2);
     Ndim = GD_ndim(agroot(g)) = MIN(GD_ndim(agroot(g)), MAXDIM);
     GD_odim(agroot(g)) = MIN(outdim, Ndim);
-    sfdp_init_node_edge(g);
+    sfdp_init_node_edge(g, incremental);
 }
 
 /* getPos:
@@ -96,14 +94,41 @@ static real *getPos(Agraph_t * g, spring_electrical_control ctrl)
     return pos;
 }
 
+/* getChanges:
+ * For incremental layout: nodes with a position keep it unless
+ * they are close to a change, the others are new.
+ * Returns NULL if no node has a position.
+ */
+static int *getChanges(Agraph_t * g)
+{
+    Agnode_t *n;
+    int *changes = N_NEW(agnnodes(g), int);
+    int nold = 0;
+
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	if (hasPos(n)) {
+	    changes[ND_id(n)] = NODE_UNCHANGED;
+	    nold++;
+	} else
+	    changes[ND_id(n)] = NODE_NEW;
+    }
+    if (nold == 0) {
+	free(changes);
+	return NULL;
+    }
+    return changes;
+}
+
 static void sfdpLayout(graph_t * g, spring_electrical_control ctrl,
-		       int hops, pointf pad)
+		       int hops, pointf pad, int incremental)
 {
     real *sizes;
     real *pos;
     Agnode_t *n;
     int flag, i;
+    int *changes = NULL;
     int n_edge_label_nodes = 0, *edge_label_nodes = NULL;
+    int spmv_kernel, spmv_nthreads;
     SparseMatrix D = NULL;
     SparseMatrix A;
 
@@ -121,6 +146,11 @@ static void sfdpLayout(graph_t * g, spring_electrical_control ctrl,
     else
 	sizes = NULL;
     pos = getPos(g, ctrl);
+    if (incremental)
+	ctrl->node_changes = changes = getChanges(g);
+    /* the thread count is an attribute of this graph, so the previous setting is put back below */
+    SparseMatrix_get_multiply_kernel(&spmv_kernel, &spmv_nthreads);
+    SparseMatrix_set_multiply_kernel(SPMV_KERNEL_DEFAULT, ctrl->nthreads);
 
     switch (ctrl->method) {
     case METHOD_SPRING_ELECTRICAL:
@@ -157,6 +187,7 @@ static void sfdpLayout(graph_t * g, spring_electrical_control ctrl,
 	}
 	break;
     }
+    SparseMatrix_set_multiply_kernel(spmv_kernel, spmv_nthreads);
 
     for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
 	real *npos = pos + (Ndim * ND_id(n));
@@ -165,6 +196,8 @@ static void sfdpLayout(graph_t * g, spring_electrical_control ctrl,
 	}
     }
 
+    ctrl->node_changes = NULL;
+    free(changes);
     free(sizes);
     free(pos);
     SparseMatrix_delete (A);
@@ -218,11 +251,7 @@ late_smooth (graph_t* g, Agsym_t* sym, int dflt)
     if (!sym) return dflt;
     s = agxget (g, sym);
     if (isdigit(*s)) {
-#if (HAVE_GTS || HAVE_TRIANGLE)
 	if ((v = atoi (s)) <= SMOOTHING_RNG)
-#else
-	if ((v = atoi (s)) <= SMOOTHING_SPRING)
-#endif
 	    rv = v;
 	else
 	    rv = dflt;
@@ -236,16 +265,12 @@ late_smooth (graph_t* g, Agsym_t* sym, int dflt)
 	    rv = SMOOTHING_NONE;
 	else if (!strcasecmp(s, "power_dist"))
 	    rv = SMOOTHING_STRESS_MAJORIZATION_POWER_DIST;
-#if (HAVE_GTS || HAVE_TRIANGLE)
 	else if (!strcasecmp(s, "rng"))
 	    rv = SMOOTHING_RNG;
-#endif
 	else if (!strcasecmp(s, "spring"))
 	    rv = SMOOTHING_SPRING;
-#if (HAVE_GTS || HAVE_TRIANGLE)
 	else if (!strcasecmp(s, "triangle"))
 	    rv = SMOOTHING_TRIANGLE;
-#endif
 	else
 	    rv = dflt;
     }
@@ -285,6 +310,20 @@ late_quadtree_scheme (graph_t* g, Agsym_t* sym, int dflt)
     return rv;
 }
 
+static int
+late_coarsening (graph_t* g, Agsym_t* sym, int dflt)
+{
+    char* s;
+
+    if (!sym) return dflt;
+    s = agxget (g, sym);
+    if (!strcasecmp(s, "handshake"))
+	return COARSEN_INDEPENDENT_EDGE_SET_HANDSHAKE;
+    else if (!strcasecmp(s, "luby"))
+	return COARSEN_INDEPENDENT_VERTEX_SET_LUBY;
+    else
+	return dflt;
+}
 
 /* tuneControl:
  * Use user values to reset control
@@ -315,6 +354,8 @@ tuneControl (graph_t* g, spring_electrical_control ctrl)
     ctrl->beautify_leaves = mapBool (agget(g, "beautify"), FALSE);
     ctrl->do_shrinking = mapBool (agget(g, "overlap_shrink"), TRUE);
     ctrl->rotation = late_double(g, agfindgraphattr(g, "rotation"), 0.0, -MAXDOUBLE);
+    ctrl->nthreads = late_int(g, agfindgraphattr(g, "threads"), 0, 0);
+    ctrl->multilevel_coarsen_scheme = late_coarsening(g, agfindgraphattr(g, "coarsening"), ctrl->multilevel_coarsen_scheme);
     ctrl->edge_labeling_scheme = late_int(g, agfindgraphattr(g, "label_scheme"), 0, 0);
     if (ctrl->edge_labeling_scheme > 4) {
 	agerr (AGWARN, "label_scheme = %d > 4 : ignoring\n", ctrl->edge_labeling_scheme);
@@ -327,7 +368,11 @@ void sfdp_layout(graph_t * g)
     int doAdjust;
     adjust_data am;
     int hops = -1;
-    sfdp_init_graph(g);
+    int incremental = mapBool(agget(g, "incremental"), FALSE);
+    double save_scale = PSinputscale;
+
+    PSinputscale = get_inputscale(g);
+    sfdp_init_graph(g, incremental);
     doAdjust = (Ndim == 2);
 
     if (agnnodes(g)) {
@@ -340,11 +385,7 @@ void sfdp_layout(graph_t * g)
 	spring_electrical_control ctrl = spring_electrical_control_new();
 
 	tuneControl (g, ctrl);
-#if (HAVE_GTS || HAVE_TRIANGLE)
 	graphAdjustMode(g, &am, "prism0");
-#else
-	graphAdjustMode(g, &am, 0);
-#endif
 
 	if ((am.mode == AM_PRISM) && doAdjust) {
 	    doAdjust = 0;  /* overlap removal done in sfpd */
@@ -364,9 +405,14 @@ void sfdp_layout(graph_t * g)
 	    ctrl->overlap = -1;
 	}
 
-	ccs = ccomps(g, &ncc, 0);
-	if (ncc == 1) {
-	    sfdpLayout(g, ctrl, hops, pad);
+	/* an incremental layout keeps the components where they were instead of packing them */
+	if (incremental) {
+	    ccs = NULL;
+	    ncc = 0;
+	} else
+	    ccs = ccomps(g, &ncc, 0);
+	if (incremental || ncc == 1) {
+	    sfdpLayout(g, ctrl, hops, pad, incremental);
 	    if (doAdjust) removeOverlapWith(g, &am);
 	    spline_edges(g);
 	} else {
@@ -377,7 +423,7 @@ void sfdp_layout(graph_t * g)
 	    for (i = 0; i < ncc; i++) {
 		sg = ccs[i];
 		nodeInduce(sg);
-		sfdpLayout(sg, ctrl, hops, pad);
+		sfdpLayout(sg, ctrl, hops, pad, incremental);
 		if (doAdjust) removeOverlapWith(sg, &am);
 		setEdgeType(sg, ET_LINE);
 		spline_edges(sg);
@@ -392,6 +438,7 @@ void sfdp_layout(graph_t * g)
     }
 
     dotneato_postprocess(g);
+    PSinputscale = save_scale;
 }
 
 static void sfdp_cleanup_graph(graph_t * g)
@@ -32,6 +32,7 @@ struct uniform_stress_matmul_data{
 
 void Operator_uniform_stress_matmul_delete(Operator o){
   FREE(o->data);
+  FREE(o);
 }
 
 real *Operator_uniform_stress_matmul_apply(Operator o, real *x, real *y){
@@ -159,6 +160,137 @@ void Operator_diag_precon_delete(Operator o){
   if (o) FREE(o);
 }
 
+struct ic0_precon_data {
+  /* the incomplete Cholesky factor L, A ~ L L^T. Row i of L holds the entries of the lower triangle of A in row i, 
+     in increasing column order, with the diagonal last */
+  int n;
+  int *ia;
+  int *ja;
+  real *l;
+};
+
+real* Operator_ic0_precon_apply(Operator o, real *x, real *y){
+  /* y = (L L^T)^{-1} x, by a forward and a backward substitution. y is the only array written */
+  struct ic0_precon_data *d = (struct ic0_precon_data*) o->data;
+  int i, j, n = d->n, *ia = d->ia, *ja = d->ja;
+  real *l = d->l, sum;
+
+  for (i = 0; i < n; i++){
+    sum = x[i];
+    for (j = ia[i]; j < ia[i+1] - 1; j++) sum -= l[j]*y[ja[j]];
+    y[i] = sum/l[ia[i+1] - 1];
+  }
+  for (i = n - 1; i >= 0; i--){
+    y[i] /= l[ia[i+1] - 1];
+    for (j = ia[i]; j < ia[i+1] - 1; j++) y[ja[j]] -= l[j]*y[i];
+  }
+  return y;
+}
+
+static int ic0_factorize(int n, int *ia, int *ja, real *a, real shift, real *l, int *mask){
+  /* the IC(0) factor of A + shift*diag(A) into l, which has the pattern of ia/ja. Returns FALSE if a pivot is 
+     not safely positive. mask is a scratch array of length n set to -1 */
+  int i, j, k, kk;
+  real sum, diag;
+
+  for (i = 0; i < n; i++){
+    for (j = ia[i]; j < ia[i+1]; j++) mask[ja[j]] = j;
+    for (j = ia[i]; j < ia[i+1] - 1; j++){
+      /* l_ik = (a_ik - sum_{jj < k} l_{i,jj} l_{k,jj})/l_kk, over the columns shared by rows i and k */
+      k = ja[j];
+      sum = a[j];
+      for (kk = ia[k]; kk < ia[k+1] - 1; kk++){
+	if (mask[ja[kk]] >= 0 && mask[ja[kk]] < j) sum -= l[mask[ja[kk]]]*l[kk];
+      }
+      l[j] = sum/l[ia[k+1] - 1];
+    }
+    j = ia[i+1] - 1;
+    diag = a[j]*(1 + shift);
+    sum = diag;
+    for (k = ia[i]; k < j; k++) sum -= l[k]*l[k];
+    for (k = ia[i]; k < ia[i+1]; k++) mask[ja[k]] = -1;
+    if (sum <= SQRT_MACHINEACC*diag) return FALSE;
+    l[j] = sqrt(sum);
+  }
+  return TRUE;
+}
+
+Operator Operator_ic0_precon_new(SparseMatrix A){
+  /* incomplete Cholesky preconditioner with no fill-in, for a symmetric matrix with a positive diagonal, such as a 
+     Laplacian. A singular or indefinite A is factored with its diagonal increased by a growing fraction until all
+     the pivots are positive. Returns NULL if A has a missing or nonpositive diagonal entry */
+  Operator o;
+  struct ic0_precon_data *d;
+  int i, j, k, m = A->m, *ia = A->ia, *ja = A->ja, *mask, col, nz = 0;
+  real *a = (real*) A->a, *la, val, shift = 0;
+
+  assert(A->type == MATRIX_TYPE_REAL);
+  assert(a);
+
+  d = MALLOC(sizeof(struct ic0_precon_data));
+  d->n = m;
+  d->ia = MALLOC(sizeof(int)*(m + 1));
+  for (i = 0; i < m; i++){
+    for (j = ia[i]; j < ia[i+1]; j++) if (ja[j] <= i) nz++;
+  }
+  d->ja = MALLOC(sizeof(int)*MAX(nz, 1));
+  d->l = MALLOC(sizeof(real)*MAX(nz, 1));
+  la = MALLOC(sizeof(real)*MAX(nz, 1));
+
+  /* the lower triangle of A, each row sorted by column by insertion, with the diagonal ending up last */
+  nz = 0;
+  d->ia[0] = 0;
+  for (i = 0; i < m; i++){
+    for (j = ia[i]; j < ia[i+1]; j++){
+      if (ja[j] > i) continue;
+      col = ja[j];
+      val = a[j];
+      for (k = nz; k > d->ia[i] && d->ja[k-1] > col; k--){
+	d->ja[k] = d->ja[k-1];
+	la[k] = la[k-1];
+      }
+      d->ja[k] = col;
+      la[k] = val;
+      nz++;
+    }
+    d->ia[i+1] = nz;
+    if (nz == d->ia[i] || d->ja[nz-1] != i || la[nz-1] <= 0 || (nz > d->ia[i] + 1 && d->ja[nz-2] == i)){
+      /* no diagonal, a nonpositive one, or a repeated one */
+      FREE(la);
+      FREE(d->l); FREE(d->ja); FREE(d->ia); FREE(d);
+      return NULL;
+    }
+  }
+
+  mask = MALLOC(sizeof(int)*m);
+  for (i = 0; i < m; i++) mask[i] = -1;
+  while (!ic0_factorize(m, d->ia, d->ja, la, shift, d->l, mask)){
+    shift = (shift == 0) ? 0.001 : 10*shift;
+    if (shift > 1) break;/* not reached for a Laplacian, which is diagonally dominant by then */
+  }
+  FREE(mask);
+  FREE(la);
+  if (shift > 1){
+    FREE(d->l); FREE(d->ja); FREE(d->ia); FREE(d);
+    return NULL;
+  }
+
+  o = MALLOC(sizeof(struct Operator_struct));
+  o->data = d;
+  o->Operator_apply = Operator_ic0_precon_apply;
+  return o;
+}
+
+void Operator_ic0_precon_delete(Operator o){
+  struct ic0_precon_data *d = (struct ic0_precon_data*) o->data;
+
+  FREE(d->ia);
+  FREE(d->ja);
+  FREE(d->l);
+  FREE(d);
+  FREE(o);
+}
+
 static real conjugate_gradient(Operator A, Operator precon, int n, real *x, real *rhs, real tol, int maxit, int *flag){
   real *z, *r, *p, *q, res = 10*tol, alpha;
   real rho = 1.0e20, rho_old = 1, res0, beta;
@@ -225,6 +357,9 @@ static real conjugate_gradient(Operator A, Operator precon, int n, real *x, real
 }
 
 real cg(Operator Ax, Operator precond, int n, int dim, real *x0, real *rhs, real tol, int maxit, int *flag){
+  /* solve for each of the dim columns of rhs, starting from the same column of x0. The columns are solved in turn:
+     dim is only 2 or 3, and the matrix-vector products within each solve run row-parallel on all the threads set by
+     SparseMatrix_set_multiply_kernel */
   real *x, *b, res = 0;
   int k, i;
   x = N_GNEW(n, real);
@@ -307,6 +442,14 @@ real SparseMatrix_solve(SparseMatrix A, int dim, real *x0, real *rhs, real tol,
     Operator_matmul_delete(Ax);
     Operator_diag_precon_delete(precond);
     break;
+  case SOLVE_METHOD_CG_IC:
+    precond = Operator_ic0_precon_new(A);
+    if (!precond) return SparseMatrix_solve(A, dim, x0, rhs, tol, maxit, SOLVE_METHOD_CG, flag);
+    Ax =  Operator_matmul_new(A);
+    res = cg(Ax, precond, n, dim, x0, rhs, tol, maxit, flag);
+    Operator_matmul_delete(Ax);
+    Operator_ic0_precon_delete(precond);
+    break;
   case SOLVE_METHOD_JACOBI:{
     jacobi(A, dim, x0, rhs, maxit, flag);
     break;
@@ -17,7 +17,8 @@
 
 #include "SparseMatrix.h"
 
-enum {SOLVE_METHOD_CG, SOLVE_METHOD_JACOBI};
+/* SOLVE_METHOD_CG_IC: conjugate gradient with an incomplete Cholesky preconditioner, instead of the diagonal one */
+enum {SOLVE_METHOD_CG, SOLVE_METHOD_JACOBI, SOLVE_METHOD_CG_IC};
 
 typedef struct Operator_struct *Operator;
 
@@ -31,8 +32,19 @@ real cg(Operator Ax, Operator precond, int n, int dim, real *x0, real *rhs, real
 real SparseMatrix_solve(SparseMatrix A, int dim, real *x0, real *rhs, real tol, int maxit, int method, int *flag);
 
 Operator Operator_uniform_stress_matmul(SparseMatrix A, real alpha);
+void Operator_uniform_stress_matmul_delete(Operator o);
 
 Operator Operator_uniform_stress_diag_precon_new(SparseMatrix A, real alpha);
 
+Operator Operator_matmul_new(SparseMatrix A);
+void Operator_matmul_delete(Operator o);
+
+Operator Operator_diag_precon_new(SparseMatrix A);
+void Operator_diag_precon_delete(Operator o);
+
+/* NULL if A does not have a positive diagonal */
+Operator Operator_ic0_precon_new(SparseMatrix A);
+void Operator_ic0_precon_delete(Operator o);
+
 #endif
  
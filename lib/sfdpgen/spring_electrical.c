@@ -69,6 +69,8 @@ spring_electrical_control spring_electrical_control_new(){
   ctrl->initial_scaling = -4;
   ctrl->rotation = 0.;
   ctrl->edge_labeling_scheme = 0;
+  ctrl->nthreads = 0;
+  ctrl->node_changes = NULL;
   return ctrl;
 }
 
@@ -150,6 +152,66 @@ real average_edge_length(SparseMatrix A, int dim, real *coord){
   return dist/ia[A->m];
 }
 
+/* attractive_force_2d, attractive_force_3d, attractive_force_generic:
+ * add the attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i)   of the neighbors of node i to f.
+ * attractive_force_kernel picks one of them once per layout, so the edge loops do not branch on dim.
+ */
+typedef void (*attractive_force_fn)(int dim, int *ia, int *ja, real *x, int i, real CRK, real *f);
+
+static void attractive_force_2d(int dim, int *ia, int *ja, real *x, int i, real CRK, real *f){
+  int j;
+  real dx, dy, dist;
+
+  for (j = ia[i]; j < ia[i+1]; j++){
+    if (ja[j] == i) continue;
+    dx = x[i*2] - x[ja[j]*2];
+    dy = x[i*2+1] - x[ja[j]*2+1];
+    dist = sqrt(dx*dx + dy*dy);
+    f[0] -= CRK*dx*dist;
+    f[1] -= CRK*dy*dist;
+  }
+}
+
+static void attractive_force_3d(int dim, int *ia, int *ja, real *x, int i, real CRK, real *f){
+  int j;
+  real dx, dy, dz, dist;
+
+  for (j = ia[i]; j < ia[i+1]; j++){
+    if (ja[j] == i) continue;
+    dx = x[i*3] - x[ja[j]*3];
+    dy = x[i*3+1] - x[ja[j]*3+1];
+    dz = x[i*3+2] - x[ja[j]*3+2];
+    dist = sqrt(dx*dx + dy*dy + dz*dz);
+    f[0] -= CRK*dx*dist;
+    f[1] -= CRK*dy*dist;
+    f[2] -= CRK*dz*dist;
+  }
+}
+
+static void attractive_force_generic(int dim, int *ia, int *ja, real *x, int i, real CRK, real *f){
+  int j, k;
+  real dist;
+
+  for (j = ia[i]; j < ia[i+1]; j++){
+    if (ja[j] == i) continue;
+    dist = distance(x, dim, i, ja[j]);
+    for (k = 0; k < dim; k++){
+      f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*dist;
+    }
+  }
+}
+
+static attractive_force_fn attractive_force_kernel(int dim){
+  switch (dim){
+  case 2:
+    return attractive_force_2d;
+  case 3:
+    return attractive_force_3d;
+  default:
+    return attractive_force_generic;
+  }
+}
+
 #ifdef ENERGY
 static real spring_electrical_energy(int dim, SparseMatrix A, real *x, real p, real CRK, real KP){
       /* 1. Grad[||x-y||^k,x] = k||x-y||^(k-1)*0.5*(x-y)/||x-y|| = k/2*||x-y||^(k-2) (x-y) 
@@ -462,12 +524,13 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
   /* x is a point to a 1D array, x[i*dim+j] gives the coordinate of the i-th node at dimension j.  */
   SparseMatrix A = A0;
   int m, n;
-  int i, j, k;
+  int i, k;
   real p = ctrl->p, K = ctrl->K, C = ctrl->C, CRK, tol = ctrl->tol, maxiter = ctrl->maxiter, cool = ctrl->cool, step = ctrl->step, KP;
   int *ia = NULL, *ja = NULL;
   real *xold = NULL;
-  real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
+  real *f = NULL, F, Fnorm = 0, Fnorm0;
   int iter = 0;
+  attractive_force_fn attractive = attractive_force_kernel(dim);
   int adaptive_cooling = ctrl->adaptive_cooling;
   QuadTree qt = NULL;
   real counts[4], *force = NULL;
@@ -556,7 +619,7 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
     start = clock();
 #endif
 
-    QuadTree_get_repulsive_force(qt, force, x, ctrl->bh, p, KP, counts, flag);
+    QuadTree_get_repulsive_force(qt, force, x, ctrl->bh, p, KP, counts, ctrl->nthreads, flag);
 
     assert(!(*flag));
 
@@ -567,14 +630,7 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
 
     /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
     for (i = 0; i < n; i++){
-      f = &(force[i*dim]);
-      for (j = ia[i]; j < ia[i+1]; j++){
-	if (ja[j] == i) continue;
-	dist = distance(x, dim, i, ja[j]);
-	for (k = 0; k < dim; k++){
-	  f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*dist;
-	}
-      }
+      attractive(dim, ia, ja, x, i, CRK, &(force[i*dim]));
     }
   
 
@@ -667,6 +723,7 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
   real *xold = NULL;
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
+  attractive_force_fn attractive = attractive_force_kernel(dim);
   int adaptive_cooling = ctrl->adaptive_cooling;
   QuadTree qt = NULL;
   int USE_QT = FALSE;
@@ -816,13 +873,7 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
     for (i = 0; i < n; i++){
       for (k = 0; k < dim; k++) f[k] = 0.;
       /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
-      for (j = ia[i]; j < ia[i+1]; j++){
-	if (ja[j] == i) continue;
-	dist = distance(x, dim, i, ja[j]);
-	for (k = 0; k < dim; k++){
-	  f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*dist;
-	}
-      }
+      attractive(dim, ia, ja, x, i, CRK, f);
       for (k = 0; k < dim; k++) force[i*dim+k] += f[k];
     }
 
@@ -918,6 +969,81 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
 
 
 
+static void supernode_repulsive_force(QuadTree qt, int n, int dim, real *x, int self, real bh, real p, real KP, int nthreads,
+				      real *force, real *nsuper_avg, real *counts_avg, int *flag){
+  /* repulsive force K^(1 - p)/||x_i-x_j||^(1 - p) (x_i - x_j) on every node, using the supernodes of the quadtree.
+     The quadtree holds a copy of the coordinates, so the force on each node is independent of the others and
+     the nodes are shared out among nthreads threads. Each node is summed by one thread in a fixed order, 
+     so the result does not depend on the number of threads.
+     self: whether point i of x is point i of the quadtree, which then does not repel itself
+     force: force[i*dim+k] is set to the repulsive force on node i
+     nsuper_avg, counts_avg: the total number of supernodes and of cells visited, for the quadtree level optimizer
+     flag: nonzero if the supernodes of some node could not be found, in which case the forces are incomplete
+  */
+  real nsuper_sum = 0, counts_sum = 0;
+  int i, flag_or = 0;
+
+#pragma omp parallel num_threads(nthreads) reduction(+:nsuper_sum,counts_sum) reduction(|:flag_or)
+  {
+    int nsuper = 0, nsupermax = 10, j, k, flag0;
+    real *center = NULL, *supernode_wgts = NULL, *distances = NULL, counts = 0, dist, dd, *f;
+
+    center = MALLOC(sizeof(real)*nsupermax*dim);
+    supernode_wgts = MALLOC(sizeof(real)*nsupermax);
+    distances = MALLOC(sizeof(real)*nsupermax);
+
+#pragma omp for schedule(dynamic, 256)
+    for (i = 0; i < n; i++){
+      f = &(force[i*dim]);
+      for (k = 0; k < dim; k++) f[k] = 0.;
+      QuadTree_get_supernodes(qt, bh, &(x[dim*i]), self ? i : -1, &nsuper, &nsupermax, 
+			      &center, &supernode_wgts, &distances, &counts, &flag0);
+      counts_sum += counts;
+      nsuper_sum += nsuper;
+      if (flag0){
+	flag_or |= flag0;
+	continue;
+      }
+      /* the loop over the supernodes is written out for 2D and 3D, the dimensions sfdp is run in */
+      switch (dim){
+      case 2:
+	for (j = 0; j < nsuper; j++){
+	  dist = MAX(distances[j], MINDIST);
+	  dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+	  f[0] += supernode_wgts[j]*KP*(x[i*2] - center[j*2])/dd;
+	  f[1] += supernode_wgts[j]*KP*(x[i*2+1] - center[j*2+1])/dd;
+	}
+	break;
+      case 3:
+	for (j = 0; j < nsuper; j++){
+	  dist = MAX(distances[j], MINDIST);
+	  dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+	  f[0] += supernode_wgts[j]*KP*(x[i*3] - center[j*3])/dd;
+	  f[1] += supernode_wgts[j]*KP*(x[i*3+1] - center[j*3+1])/dd;
+	  f[2] += supernode_wgts[j]*KP*(x[i*3+2] - center[j*3+2])/dd;
+	}
+	break;
+      default:
+	for (j = 0; j < nsuper; j++){
+	  dist = MAX(distances[j], MINDIST);
+	  dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+	  for (k = 0; k < dim; k++){
+	    f[k] += supernode_wgts[j]*KP*(x[i*dim+k] - center[j*dim+k])/dd;
+	  }
+	}
+      }
+    }
+
+    FREE(center);
+    FREE(supernode_wgts);
+    FREE(distances);
+  }
+
+  *nsuper_avg = nsuper_sum;
+  *counts_avg = counts_sum;
+  *flag = flag_or;
+}
+
 void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_control ctrl, real *node_weights, real *x, int *flag){
   /* x is a point to a 1D array, x[i*dim+j] gives the coordinate of the i-th node at dimension j.  */
   SparseMatrix A = A0;
@@ -928,11 +1054,12 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   real *xold = NULL;
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
+  attractive_force_fn attractive = attractive_force_kernel(dim);
   int adaptive_cooling = ctrl->adaptive_cooling;
   QuadTree qt = NULL;
   int USE_QT = FALSE;
-  int nsuper = 0, nsupermax = 10;
-  real *center = NULL, *supernode_wgts = NULL, *distances = NULL, nsuper_avg, counts = 0, counts_avg = 0;
+  int nthreads = get_num_threads(ctrl->nthreads);
+  real *force = NULL, nsuper_avg, counts_avg = 0;
 #ifdef TIME
   clock_t start, end, start0, start2;
   real qtree_cpu = 0, qtree_cpu0 = 0;
@@ -950,9 +1077,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   if (n >= ctrl->quadtree_size) {
     USE_QT = TRUE;
     qtree_level_optimizer = oned_optimizer_new(max_qtree_level);
-    center = MALLOC(sizeof(real)*nsupermax*dim);
-    supernode_wgts = MALLOC(sizeof(real)*nsupermax);
-    distances = MALLOC(sizeof(real)*nsupermax);
+    force = MALLOC(sizeof(real)*dim*n);
   }
   *flag = 0;
   if (m != n) {
@@ -1034,7 +1159,19 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
 	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
       }
 
-	  
+      /* repulsive force. Only depends on the quadtree, so it is done for all nodes up front, in parallel */
+#ifdef TIME
+      start = clock();
+#endif
+      supernode_repulsive_force(qt, n, dim, x, TRUE, ctrl->bh, p, KP, nthreads, force, &nsuper_avg, &counts_avg, flag);
+#ifdef TIME
+      end = clock();
+      qtree_cpu += ((real) (end - start)) / CLOCKS_PER_SEC;
+#endif
+      if (*flag) {
+	QuadTree_delete(qt);
+	goto RETURN;
+      }
     }
 #ifdef TIME
     start2 = clock();
@@ -1043,39 +1180,11 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
     for (i = 0; i < n; i++){
       for (k = 0; k < dim; k++) f[k] = 0.;
       /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
-      for (j = ia[i]; j < ia[i+1]; j++){
-	if (ja[j] == i) continue;
-	dist = distance(x, dim, i, ja[j]);
-	for (k = 0; k < dim; k++){
-	  f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*dist;
-	}
-      }
+      attractive(dim, ia, ja, x, i, CRK, f);
 
       /* repulsive force K^(1 - p)/||x_i-x_j||^(1 - p) (x_i - x_j) */
       if (USE_QT){
-#ifdef TIME
-	start = clock();
-#endif
-	QuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax, 
-				&center, &supernode_wgts, &distances, &counts, flag);
-
-#ifdef TIME
-	end = clock();
-	qtree_cpu += ((real) (end - start)) / CLOCKS_PER_SEC;
-#endif
-	counts_avg += counts;
-	nsuper_avg += nsuper;
-	if (*flag) goto RETURN;
-	for (j = 0; j < nsuper; j++){
-	  dist = MAX(distances[j], MINDIST);
-	  for (k = 0; k < dim; k++){
-	    if (p == -1){
-	      f[k] += supernode_wgts[j]*KP*(x[i*dim+k] - center[j*dim+k])/(dist*dist);
-	    } else {
-	      f[k] += supernode_wgts[j]*KP*(x[i*dim+k] - center[j*dim+k])/pow(dist, 1.- p);
-	    }
-	  }
-	}
+	for (k = 0; k < dim; k++) f[k] += force[i*dim+k];
       } else {
 	if (ctrl->use_node_weights && node_weights){
 	  for (j = 0; j < n; j++){
@@ -1182,12 +1291,242 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   if (xold) FREE(xold);
   if (A != A0) SparseMatrix_delete(A);
   if (f) FREE(f);
-  if (center) FREE(center);
-  if (supernode_wgts) FREE(supernode_wgts);
-  if (distances) FREE(distances);
+  if (force) FREE(force);
 
 }
 
+void spring_electrical_embedding_incremental(int dim, SparseMatrix A0, spring_electrical_control ctrl, real *node_weights, real *x, int *changes, int *flag){
+  /* refine a previous layout x after the graph has changed, instead of laying it out from scratch.
+     changes[i] is NODE_UNCHANGED, NODE_CHANGED (edges added or removed) or NODE_NEW (no previous position).
+     New nodes are first put at the average of their placed neighbors. Nodes within INCREMENTAL_HOPS hops of a change
+     then move for up to INCREMENTAL_MAXITER iterations, nodes within 2*INCREMENTAL_HOPS hops only for the first
+     INCREMENTAL_RELAX_ITER iterations, and all other nodes keep their positions. Edges between unchanged nodes that are
+     much longer than the rest (new edges, typically) count as changes too.
+     The repulsion of the nodes that keep their positions comes from one quadtree built up front, 
+     so an iteration costs time in the number of moving nodes only. No multilevel hierarchy is needed.
+  */
+  SparseMatrix A = A0;
+  int m, n, i, j, k, l, iter = 0, nplaced, nactive, nfrozen, nrelax, hops = INCREMENTAL_HOPS;
+  int *ia, *ja, *dist = NULL, *active = NULL, *frozen = NULL, *queue = NULL, *placed = NULL;
+  real p = ctrl->p, K = ctrl->K, C = ctrl->C, CRK, KP, step, cool = ctrl->cool, tol = ctrl->tol, len, F, nsuper, counts;
+  real *xa = NULL, *xf = NULL, *wa = NULL, *wf = NULL, *force = NULL, *force2 = NULL, *xmin = NULL, *xmax = NULL, f[3];
+  QuadTree qt_frozen = NULL, qt;
+  int nthreads = get_num_threads(ctrl->nthreads);
+  int max_qtree_level = ctrl->max_qtree_level;
+
+  *flag = 0;
+  if (!A || dim <= 0) return;
+  if (dim > 3) {
+    *flag = ERROR_DIMENSION_NOT_SUPPORTED;
+    return;
+  }
+  m = A->m, n = A->n;
+  if (n <= 0) return;
+  if (m != n) {
+    *flag = ERROR_NOT_SQUARE_MATRIX;
+    return;
+  }
+  assert(A->format == FORMAT_CSR);
+  A = SparseMatrix_symmetrize(A, TRUE);
+  ia = A->ia;
+  ja = A->ja;
+
+  /* the natural length comes from the edges of the previous layout */
+  if (K < 0){
+    K = 0;
+    l = 0;
+    for (i = 0; i < n; i++){
+      if (changes[i] == NODE_NEW) continue;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	if (ja[j] == i || changes[ja[j]] == NODE_NEW) continue;
+	K += distance(x, dim, i, ja[j]);
+	l++;
+      }
+    }
+    K = (l > 0 && K > 0) ? K/l : 1.;
+    ctrl->K = K;
+  }
+  if (C < 0) ctrl->C = C = 0.2;
+  if (p >= 0) ctrl->p = p = -1;
+  KP = pow(K, 1 - p);
+  CRK = pow(C, (2.-p)/3.)/K;
+
+  /* place the new nodes, by rounds, at the average of their placed neighbors. Nodes with no placed
+     neighbor at all end up at random in the bounding box of the old layout */
+  placed = MALLOC(sizeof(int)*n);
+  xmin = MALLOC(sizeof(real)*dim);
+  xmax = MALLOC(sizeof(real)*dim);
+  nplaced = 0;
+  for (i = 0; i < n; i++){
+    placed[i] = (changes[i] != NODE_NEW);
+    if (!placed[i]) continue;
+    for (k = 0; k < dim; k++){
+      if (nplaced == 0 || x[i*dim+k] < xmin[k]) xmin[k] = x[i*dim+k];
+      if (nplaced == 0 || x[i*dim+k] > xmax[k]) xmax[k] = x[i*dim+k];
+    }
+    nplaced++;
+  }
+  if (nplaced == 0){
+    for (k = 0; k < dim; k++) {
+      xmin[k] = 0;
+      xmax[k] = K;
+    }
+  }
+  srand(ctrl->random_seed);
+  do {
+    l = 0;
+    for (i = 0; i < n; i++){
+      if (placed[i]) continue;
+      for (k = 0; k < dim; k++) f[k] = 0;
+      m = 0;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	if (placed[ja[j]] != 1) continue;
+	for (k = 0; k < dim; k++) f[k] += x[ja[j]*dim+k];
+	m++;
+      }
+      if (m == 0) continue;
+      for (k = 0; k < dim; k++) x[i*dim+k] = f[k]/m + 0.1*K*(drand() - 0.5);
+      placed[i] = 2;/* a round only uses nodes placed before it */
+      l++;
+    }
+    for (i = 0; i < n; i++) if (placed[i] == 2) placed[i] = 1;
+  } while (l > 0);
+  for (i = 0; i < n; i++){
+    if (placed[i]) continue;
+    for (k = 0; k < dim; k++) x[i*dim+k] = xmin[k] + (xmax[k] - xmin[k])*drand();
+  }
+
+  /* edges between old nodes that are much longer than the natural length are new edges */
+  for (i = 0; i < n; i++){
+    if (changes[i] != NODE_UNCHANGED) continue;
+    for (j = ia[i]; j < ia[i+1]; j++){
+      if (ja[j] == i || changes[ja[j]] == NODE_NEW) continue;
+      if (distance(x, dim, i, ja[j]) > INCREMENTAL_LONG_EDGE*K) {
+	changes[i] = NODE_CHANGED;
+	if (changes[ja[j]] == NODE_UNCHANGED) changes[ja[j]] = NODE_CHANGED;
+      }
+    }
+  }
+
+  /* hop distance from the changes, up to 2*hops */
+  dist = MALLOC(sizeof(int)*n);
+  queue = MALLOC(sizeof(int)*n);
+  l = 0;
+  for (i = 0; i < n; i++){
+    dist[i] = -1;
+    if (changes[i] != NODE_UNCHANGED) {
+      dist[i] = 0;
+      queue[l++] = i;
+    }
+  }
+  for (m = 0; m < l; m++){
+    i = queue[m];
+    if (dist[i] >= 2*hops) continue;
+    for (j = ia[i]; j < ia[i+1]; j++){
+      if (dist[ja[j]] >= 0) continue;
+      dist[ja[j]] = dist[i] + 1;
+      queue[l++] = ja[j];
+    }
+  }
+
+  /* the moving nodes. Those further than hops away only move for a few iterations */
+  nactive = l;
+  if (nactive == 0) goto RETURN;
+  active = MALLOC(sizeof(int)*nactive);
+  nrelax = 0;
+  for (m = 0; m < nactive; m++){
+    active[m] = queue[m];
+    if (dist[queue[m]] > hops) nrelax++;
+  }
+  nfrozen = n - nactive;
+
+  xa = MALLOC(sizeof(real)*nactive*dim);
+  force = MALLOC(sizeof(real)*nactive*dim);
+  force2 = MALLOC(sizeof(real)*nactive*dim);
+  if (ctrl->use_node_weights && node_weights) wa = MALLOC(sizeof(real)*nactive);
+  for (m = 0; m < nactive; m++){
+    if (wa) wa[m] = node_weights[active[m]];
+  }
+
+  if (nfrozen > 0){
+    frozen = MALLOC(sizeof(int)*nfrozen);
+    xf = MALLOC(sizeof(real)*nfrozen*dim);
+    if (wa) wf = MALLOC(sizeof(real)*nfrozen);
+    l = 0;
+    for (i = 0; i < n; i++){
+      if (dist[i] >= 0) continue;
+      for (k = 0; k < dim; k++) xf[l*dim+k] = x[i*dim+k];
+      if (wf) wf[l] = node_weights[i];
+      frozen[l++] = i;
+    }
+    qt_frozen = QuadTree_new_from_point_list(dim, nfrozen, max_qtree_level, xf, wf);
+  }
+
+  step = 0.1*K;
+  do {
+    iter++;
+    for (m = 0; m < nactive; m++){
+      for (k = 0; k < dim; k++) xa[m*dim+k] = x[active[m]*dim+k];
+    }
+
+    /* repulsion, from the nodes that do not move and from those that do */
+    if (qt_frozen) {
+      supernode_repulsive_force(qt_frozen, nactive, dim, xa, FALSE, ctrl->bh, p, KP, nthreads, force, &nsuper, &counts, flag);
+      if (*flag) goto RETURN;
+    } else {
+      for (m = 0; m < nactive*dim; m++) force[m] = 0;
+    }
+    qt = QuadTree_new_from_point_list(dim, nactive, max_qtree_level, xa, wa);
+    supernode_repulsive_force(qt, nactive, dim, xa, TRUE, ctrl->bh, p, KP, nthreads, force2, &nsuper, &counts, flag);
+    QuadTree_delete(qt);
+    if (*flag) goto RETURN;
+
+    for (m = 0; m < nactive; m++){
+      i = active[m];
+      if (dist[i] > hops && iter > INCREMENTAL_RELAX_ITER) continue;
+      for (k = 0; k < dim; k++) f[k] = force[m*dim+k] + force2[m*dim+k];
+
+      /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
+      for (j = ia[i]; j < ia[i+1]; j++){
+	if (ja[j] == i) continue;
+	len = distance(x, dim, i, ja[j]);
+	for (k = 0; k < dim; k++){
+	  f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*len;
+	}
+      }
+
+      F = 0.;
+      for (k = 0; k < dim; k++) F += f[k]*f[k];
+      F = sqrt(F);
+      if (F > 0) for (k = 0; k < dim; k++) x[i*dim+k] += step*f[k]/F;
+    }
+
+    step = cool*step;
+  } while (step > tol*K && iter < INCREMENTAL_MAXITER);
+
+#ifdef DEBUG_PRINT
+  if (Verbose) fprintf(stderr, "incremental layout: %d moving nodes (%d only for %d iterations), %d fixed, %d iterations\n", 
+		       nactive, nrelax, INCREMENTAL_RELAX_ITER, nfrozen, iter);
+#endif
+
+ RETURN:
+  if (A != A0) SparseMatrix_delete(A);
+  if (qt_frozen) QuadTree_delete(qt_frozen);
+  FREE(placed);
+  FREE(xmin);
+  FREE(xmax);
+  FREE(dist);
+  FREE(queue);
+  FREE(active);
+  FREE(frozen);
+  FREE(xa);
+  FREE(xf);
+  FREE(wa);
+  FREE(wf);
+  FREE(force);
+  FREE(force2);
+}
+
 static void scale_coord(int n, int dim, real *x, int *id, int *jd, real *d, real dj){
   int i, j, k;
   real w_ij, dist, s = 0, stop = 0, sbot = 0., nz = 0;
@@ -1519,6 +1858,7 @@ void spring_electrical_spring_embedding(int dim, SparseMatrix A0, SparseMatrix D
   real *xold = NULL;
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
+  attractive_force_fn attractive = attractive_force_kernel(dim);
   int adaptive_cooling = ctrl->adaptive_cooling;
   QuadTree qt = NULL;
   int USE_QT = FALSE;
@@ -1594,13 +1934,7 @@ void spring_electrical_spring_embedding(int dim, SparseMatrix A0, SparseMatrix D
       for (k = 0; k < dim; k++) f[k] = 0.;
       /* attractive force   C^((2-p)/3) ||x_i-x_j||/K * (x_j - x_i) */
 
-      for (j = ia[i]; j < ia[i+1]; j++){
-	if (ja[j] == i) continue;
-	dist = distance(x, dim, i, ja[j]);
-	for (k = 0; k < dim; k++){
-	  f[k] -= CRK*(x[i*dim+k] - x[ja[j]*dim+k])*dist;
-	}
-      }
+      attractive(dim, ia, ja, x, i, CRK, f);
 
       for (j = id[i]; j < id[i+1]; j++){
 	if (jd[j] == i) continue;
@@ -2025,6 +2359,43 @@ static SparseMatrix shorting_edge_label_nodes(SparseMatrix A, int n_edge_label_n
 
 }
 
+static int *shorted_node_changes(int dim, SparseMatrix A, int n_edge_label_nodes, int *edge_label_nodes, int *changes, real *x, real *x2){
+  /* copy the positions of the nodes that are not edge labels into x2, numbered as in shorting_edge_label_nodes, and
+     return their changes in that numbering, or NULL if changes is NULL. A node next to an edge label node that is
+     not NODE_UNCHANGED counts as changed, since the edges it gets from the shorting have changed too */
+  int *mask, *changes2 = NULL;
+  int i, ii, j, k, nnodes = 0;
+
+  mask = MALLOC(sizeof(int)*A->m);
+  for (i = 0; i < A->m; i++) mask[i] = 1;
+  for (i = 0; i < n_edge_label_nodes; i++) {
+    if (edge_label_nodes[i] >= 0 && edge_label_nodes[i] < A->m) mask[edge_label_nodes[i]] = -1;
+  }
+  for (i = 0; i < A->m; i++) {
+    if (mask[i] >= 0) mask[i] = nnodes++;
+  }
+
+  if (changes) changes2 = MALLOC(sizeof(int)*MAX(nnodes, 1));
+  for (i = 0; i < A->m; i++){
+    if (mask[i] < 0) continue;
+    for (k = 0; k < dim; k++) x2[mask[i]*dim+k] = x[i*dim+k];
+    if (changes2) changes2[mask[i]] = changes[i];
+  }
+
+  if (changes2){
+    for (i = 0; i < n_edge_label_nodes; i++){
+      ii = edge_label_nodes[i];
+      if (ii < 0 || ii >= A->m || changes[ii] == NODE_UNCHANGED) continue;
+      for (j = A->ia[ii]; j < A->ia[ii+1]; j++){
+	if (mask[A->ja[j]] >= 0 && changes2[mask[A->ja[j]]] == NODE_UNCHANGED) changes2[mask[A->ja[j]]] = NODE_CHANGED;
+      }
+    }
+  }
+
+  FREE(mask);
+  return changes2;
+}
+
 static void multilevel_spring_electrical_embedding_core(int dim, SparseMatrix A0, SparseMatrix D0, spring_electrical_control ctrl, real *node_weights, real *label_sizes, 
 					    real *x, int n_edge_label_nodes, int *edge_label_nodes, int *flag){
   
@@ -2032,7 +2403,7 @@ static void multilevel_spring_electrical_embedding_core(int dim, SparseMatrix A0
   Multilevel_control mctrl = NULL;
   int n, plg, coarsen_scheme_used;
   SparseMatrix A = A0, D = D0, P = NULL;
-  Multilevel grid, grid0;
+  Multilevel grid, grid0 = NULL;
   real *xc = NULL, *xf = NULL;
   struct spring_electrical_control_struct ctrl0;
 #ifdef TIME
@@ -2070,10 +2441,14 @@ static void multilevel_spring_electrical_embedding_core(int dim, SparseMatrix A0
   if ((ctrl->edge_labeling_scheme == ELSCHEME_STRAIGHTLINE_PENALTY || ctrl->edge_labeling_scheme == ELSCHEME_STRAIGHTLINE_PENALTY2)
       && n_edge_label_nodes > 0){
     SparseMatrix A2;
+    int *changes = ctrl->node_changes;
 
     real *x2 = MALLOC(sizeof(real)*(A->m)*dim);
     A2 = shorting_edge_label_nodes(A, n_edge_label_nodes, edge_label_nodes);
+    ctrl->node_changes = shorted_node_changes(dim, A, n_edge_label_nodes, edge_label_nodes, changes, x, x2);
     multilevel_spring_electrical_embedding(dim, A2, NULL, ctrl, NULL, NULL, x2, 0, NULL, flag);
+    if (ctrl->node_changes) FREE(ctrl->node_changes);
+    ctrl->node_changes = changes;
 
     assert(!(*flag));
     attach_edge_label_coordinates(dim, A, n_edge_label_nodes, edge_label_nodes, x, x2);
@@ -2086,8 +2461,20 @@ static void multilevel_spring_electrical_embedding_core(int dim, SparseMatrix A0
     return;
   }
 
+  if (ctrl->node_changes && ctrl->method == METHOD_SPRING_ELECTRICAL && dim <= 3){
+    /* refine the given layout around the changes. No hierarchy, smoothing or rotation, which would move everything.
+       Higher dimensions get the full layout below */
+    if (ctrl->p == AUTOP) ctrl->p = power_law_graph(A) ? -1.8 : -1;
+    spring_electrical_embedding_incremental(dim, A, ctrl, node_weights, x, ctrl->node_changes, flag);
+    if (*flag) goto RETURN;
+    remove_overlap(dim, A, x, label_sizes, ctrl->overlap, ctrl->initial_scaling,
+		   ctrl->edge_labeling_scheme, n_edge_label_nodes, edge_label_nodes, A, ctrl->do_shrinking, flag);
+    goto RETURN;
+  }
+
   mctrl = Multilevel_control_new(ctrl->multilevel_coarsen_scheme, ctrl->multilevel_coarsen_mode);
   mctrl->maxlevel = ctrl->multilevels;
+  mctrl->nthreads = ctrl->nthreads;
   grid0 = Multilevel_new(A, D, node_weights, mctrl);
 
   grid = Multilevel_get_coarsest(grid0);
@@ -2204,7 +2591,7 @@ static void multilevel_spring_electrical_embedding_core(int dim, SparseMatrix A0
   *ctrl = ctrl0;
   if (A != A0) SparseMatrix_delete(A);
   if (D && D != D0) SparseMatrix_delete(D);
-  Multilevel_control_delete(mctrl);
+  if (mctrl) Multilevel_control_delete(mctrl);
   Multilevel_delete(grid0);
 }
 
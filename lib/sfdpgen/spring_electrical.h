@@ -16,7 +16,7 @@
 
 #include <SparseMatrix.h>
 
-enum {ERROR_NOT_SQUARE_MATRIX = -100};
+enum {ERROR_NOT_SQUARE_MATRIX = -100, ERROR_DIMENSION_NOT_SUPPORTED = -101};
 
 /* a flag to indicate that p should be set auto */
 #define AUTOP -1.0001234
@@ -27,6 +27,10 @@ enum {QUAD_TREE_HYBRID_SIZE = 10000};
 
 enum {QUAD_TREE_NONE = 0, QUAD_TREE_NORMAL, QUAD_TREE_FAST, QUAD_TREE_HYBRID};
 
+enum {NODE_UNCHANGED = 0, NODE_CHANGED, NODE_NEW};
+
+enum {INCREMENTAL_HOPS = 2, INCREMENTAL_MAXITER = 100, INCREMENTAL_RELAX_ITER = 10, INCREMENTAL_LONG_EDGE = 3};
+
 enum {METHOD_STA = -1, METHOD_SPRING_ELECTRICAL, METHOD_SPRING_MAXENT, METHOD_STRESS_MAXENT, METHOD_STRESS_APPROX, METHOD_STRESS, METHOD_UNIFORM_STRESS, METHOD_FULL_STRESS, METHOD_NONE, METHOD_STO};
 
 struct spring_electrical_control_struct {
@@ -63,6 +67,9 @@ struct spring_electrical_control_struct {
 			       0 (no action, default), 1 (penalty based method to make that kind of node close to the center of its neighbor), 
 			       1 (penalty based method to make that kind of node close to the old center of its neighbor),
 			       3 (two step process of overlap removal and straightening) */
+  int nthreads;/* number of threads used for the repulsive force. <= 0 means the OpenMP default (OMP_NUM_THREADS, or all cores) */
+  int *node_changes;/* if not NULL, refine the layout passed in with spring_electrical_embedding_incremental.
+		       node_changes[i] is NODE_UNCHANGED, NODE_CHANGED or NODE_NEW */
 };
 
 typedef struct  spring_electrical_control_struct  *spring_electrical_control; 
@@ -71,6 +78,7 @@ spring_electrical_control spring_electrical_control_new(void);
 
 void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_control ctrl, real *node_weights, real *x, int *flag);
 void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrical_control ctrl, real *node_weights, real *x, int *flag);
+void spring_electrical_embedding_incremental(int dim, SparseMatrix A0, spring_electrical_control ctrl, real *node_weights, real *x, int *changes, int *flag);
 
 void multilevel_spring_electrical_embedding(int dim, SparseMatrix A0, SparseMatrix D, spring_electrical_control ctrl, real *node_weights, real *label_sizes, 
 					    real *x, int n_edge_label_nodes, int *edge_label_nodes, int *flag);
@@ -15,103 +15,200 @@
 #include "geom.h"
 #include "arith.h"
 #include "math.h"
-#include "LinkedList.h"
 #include "QuadTree.h"
 
-extern real distance_cropped(real *x, int dim, int i, int j);
-
-struct node_data_struct {
-  real node_weight;
-  real *coord;
-  real id;
-  void *data;
+/* number of cells carved out of one block of a QuadTree_pool */
+#define QUADTREE_POOL_BLOCK 1024
+
+struct QuadTree_pool_struct {
+  /* storage for a tree built by QuadTree_new_from_point_list. The points are kept in the arrays
+     ids, weights and coords, sorted so that the points of every leaf are contiguous. 
+     The cells are allocated QUADTREE_POOL_BLOCK at a time; a block also holds the center, average,
+     force and qts arrays of its cells. */
+  QuadTree root;
+  int dim;
+  int *ids;
+  real *weights;
+  real *coords;
+  void **blocks;
+  int nblocks;
+  int nblocks_max;
+  int nused;/* cells used in the last block */
 };
 
-typedef struct node_data_struct *node_data;
-
-
-static node_data node_data_new(int dim, real weight, real *coord, int id){
-  node_data nd;
-  int i;
-  nd = MALLOC(sizeof(struct node_data_struct));
-  nd->node_weight = weight;
-  nd->coord = MALLOC(sizeof(real)*dim);
-  nd->id = id;
-  for (i = 0; i < dim; i++) nd->coord[i] = coord[i];
-  nd->data = NULL;
-  return nd;
+static QuadTree_pool QuadTree_pool_new(int dim, int n){
+  QuadTree_pool pool;
+  pool = MALLOC(sizeof(struct QuadTree_pool_struct));
+  pool->root = NULL;
+  pool->dim = dim;
+  pool->ids = MALLOC(sizeof(int)*n);
+  pool->weights = MALLOC(sizeof(real)*n);
+  pool->coords = MALLOC(sizeof(real)*n*dim);
+  pool->nblocks_max = 10;
+  pool->blocks = MALLOC(sizeof(void*)*pool->nblocks_max);
+  pool->nblocks = 0;
+  pool->nused = QUADTREE_POOL_BLOCK;
+  return pool;
 }
 
-void node_data_delete(void *d){
-  node_data nd = (node_data) d;
-  FREE(nd->coord);
-  /*delete outside   if (nd->data) FREE(nd->data);*/
-  FREE(nd);
+static void QuadTree_pool_delete(QuadTree_pool pool){
+  int i;
+  for (i = 0; i < pool->nblocks; i++) FREE(pool->blocks[i]);
+  FREE(pool->blocks);
+  FREE(pool->ids);
+  FREE(pool->weights);
+  FREE(pool->coords);
+  FREE(pool);
 }
 
-real node_data_get_weight(void *d){
-  node_data nd = (node_data) d;
-  return nd->node_weight;
-}
+static QuadTree QuadTree_pool_new_cell(QuadTree_pool pool, real *center, real width, int max_level){
+  /* a cell of the pooled tree. Its force array (data) is set to zero, and its 2^dim children to NULL */
+  int dim = pool->dim, nq = 1<<dim, i;
+  size_t cell_size = sizeof(struct QuadTree_struct) + sizeof(real)*3*dim + sizeof(QuadTree)*nq;
+  char *mem;
+  QuadTree q;
+  real *r;
 
-real* node_data_get_coord(void *d){
-  node_data nd = (node_data) d;
-  return nd->coord;
-}
+  if (pool->nused >= QUADTREE_POOL_BLOCK){
+    if (pool->nblocks >= pool->nblocks_max){
+      pool->nblocks_max += MAX(10, pool->nblocks_max/2);
+      pool->blocks = REALLOC(pool->blocks, sizeof(void*)*pool->nblocks_max);
+    }
+    pool->blocks[pool->nblocks++] = MALLOC(cell_size*QUADTREE_POOL_BLOCK);
+    pool->nused = 0;
+  }
+  mem = ((char*) pool->blocks[pool->nblocks - 1]) + cell_size*(pool->nused++);
 
-int node_data_get_id(void *d){
-  node_data nd = (node_data) d;
-  return nd->id;
+  q = (QuadTree) mem;
+  r = (real*) (mem + sizeof(struct QuadTree_struct));
+  q->dim = dim;
+  q->n = 0;
+  q->center = r;
+  q->average = r + dim;
+  q->data = r + 2*dim;
+  for (i = 0; i < dim; i++) {
+    q->center[i] = center[i];
+    q->average[i] = 0;
+    ((real*) q->data)[i] = 0;
+  }
+  q->qts = (QuadTree*) (r + 3*dim);
+  for (i = 0; i < nq; i++) q->qts[i] = NULL;
+  assert(width > 0);
+  q->width = width;
+  q->total_weight = 0;
+  q->ids = NULL;
+  q->weights = NULL;
+  q->coords = NULL;
+  q->max_level = max_level;
+  q->pool = pool;
+  return q;
 }
 
-#define node_data_get_data(d) (((node_data) (d))->data)
-
-
-void check_or_realloc_arrays(int dim, int *nsuper, int *nsupermax, real **center, real **supernode_wgts, real **distances){
+static void check_or_realloc_arrays(int dim, int *nsuper, int *nsupermax, real **center, real **supernode_wgts, real **distances){
   
   if (*nsuper >= *nsupermax) {
-    *nsupermax = *nsuper + MAX(10, (int) 0.2*(*nsuper));
+    *nsupermax = *nsuper + MAX(10, (int) (0.2*(*nsuper)));
     *center = REALLOC(*center, sizeof(real)*(*nsupermax)*dim);
     *supernode_wgts = REALLOC(*supernode_wgts, sizeof(real)*(*nsupermax));
     *distances = REALLOC(*distances, sizeof(real)*(*nsupermax));
   }
 }
 
+static real QuadTree_point_distance(real *p1, real *p2, int dim){
+  /* point_distance, written out for the 2D and 3D trees used by the force kernels so that
+     their inner loops do not go through the general dim loop */
+  real d0, d1, d2;
+
+  switch (dim){
+  case 2:
+    d0 = p1[0] - p2[0];
+    d1 = p1[1] - p2[1];
+    return sqrt(d0*d0 + d1*d1);
+  case 3:
+    d0 = p1[0] - p2[0];
+    d1 = p1[1] - p2[1];
+    d2 = p1[2] - p2[2];
+    return sqrt(d0*d0 + d1*d1 + d2*d2);
+  default:
+    return point_distance(p1, p2, dim);
+  }
+}
+
+static void QuadTree_pair_force(real *f1, real *f2, real *x1, real *x2, real wkp, real dd, int dim){
+  /* add the repulsive force wkp*(x1 - x2)/dd between two points or cells to f1, and subtract it from f2 */
+  real f;
+  int k;
+
+  switch (dim){
+  case 2:
+    f = wkp*(x1[0] - x2[0])/dd; f1[0] += f; f2[0] -= f;
+    f = wkp*(x1[1] - x2[1])/dd; f1[1] += f; f2[1] -= f;
+    break;
+  case 3:
+    f = wkp*(x1[0] - x2[0])/dd; f1[0] += f; f2[0] -= f;
+    f = wkp*(x1[1] - x2[1])/dd; f1[1] += f; f2[1] -= f;
+    f = wkp*(x1[2] - x2[2])/dd; f1[2] += f; f2[2] -= f;
+    break;
+  default:
+    for (k = 0; k < dim; k++){
+      f = wkp*(x1[k] - x2[k])/dd;
+      f1[k] += f;
+      f2[k] -= f;
+    }
+  }
+}
+
+static void QuadTree_add_force(real *f1, real *x1, real *x2, real wkp, real dd, int dim){
+  /* the one sided QuadTree_pair_force: only f1 is updated */
+  int k;
+
+  switch (dim){
+  case 2:
+    f1[0] += wkp*(x1[0] - x2[0])/dd;
+    f1[1] += wkp*(x1[1] - x2[1])/dd;
+    break;
+  case 3:
+    f1[0] += wkp*(x1[0] - x2[0])/dd;
+    f1[1] += wkp*(x1[1] - x2[1])/dd;
+    f1[2] += wkp*(x1[2] - x2[2])/dd;
+    break;
+  default:
+    for (k = 0; k < dim; k++) f1[k] += wkp*(x1[k] - x2[k])/dd;
+  }
+}
+
 void QuadTree_get_supernodes_internal(QuadTree qt, real bh, real *point, int nodeid, int *nsuper, int *nsupermax, real **center, real **supernode_wgts, real **distances, real *counts, int *flag){
-  SingleLinkedList l;
   real *coord, dist;
-  int dim, i;
+  int dim, i, j;
 
   (*counts)++;
 
   if (!qt) return;
   dim = qt->dim;
-  l = qt->l;
-  if (l){
-    while (l){
+  if (qt->ids){
+    for (j = 0; j < qt->n; j++){
       check_or_realloc_arrays(dim, nsuper, nsupermax, center, supernode_wgts, distances);
-      if (node_data_get_id(SingleLinkedList_get_data(l)) != nodeid){
-	coord = node_data_get_coord(SingleLinkedList_get_data(l));
+      if (qt->ids[j] != nodeid){
+	coord = &(qt->coords[j*dim]);
 	for (i = 0; i < dim; i++){
 	  (*center)[dim*(*nsuper)+i] = coord[i];
 	}
-	(*supernode_wgts)[*nsuper] = node_data_get_weight(SingleLinkedList_get_data(l));
-	(*distances)[*nsuper] = point_distance(point, coord, dim);
+	(*supernode_wgts)[*nsuper] = qt->weights[j];
+	(*distances)[*nsuper] = QuadTree_point_distance(point, coord, dim);
 	(*nsuper)++;
       }
-      l = SingleLinkedList_get_next(l);
     }
   }
 
   if (qt->qts){
-    dist = point_distance(qt->center, point, dim); 
+    dist = QuadTree_point_distance(qt->center, point, dim); 
     if (qt->width < bh*dist){
       check_or_realloc_arrays(dim, nsuper, nsupermax, center, supernode_wgts, distances);
       for (i = 0; i < dim; i++){
         (*center)[dim*(*nsuper)+i] = qt->average[i];
       }
       (*supernode_wgts)[*nsuper] = qt->total_weight;
-      (*distances)[*nsuper] = point_distance(qt->average, point, dim); 
+      (*distances)[*nsuper] = QuadTree_point_distance(qt->average, point, dim); 
       (*nsuper)++;
     } else {
       for (i = 0; i < 1<<dim; i++){
@@ -132,25 +229,18 @@ void QuadTree_get_supernodes(QuadTree qt, real bh, real *point, int nodeid, int
   *nsuper = 0;
 
   *flag = 0;
-  *nsupermax = 10;
-  if (!*center) *center = MALLOC(sizeof(real)*(*nsupermax)*dim);
-  if (!*supernode_wgts) *supernode_wgts = MALLOC(sizeof(real)*(*nsupermax));
-  if (!*distances) *distances = MALLOC(sizeof(real)*(*nsupermax));
+  /* arrays passed in are *nsupermax long, and are kept across calls so they are only grown once */
+  if (!*center || !*supernode_wgts || !*distances){
+    *nsupermax = 10;
+    *center = REALLOC(*center, sizeof(real)*(*nsupermax)*dim);
+    *supernode_wgts = REALLOC(*supernode_wgts, sizeof(real)*(*nsupermax));
+    *distances = REALLOC(*distances, sizeof(real)*(*nsupermax));
+  }
   QuadTree_get_supernodes_internal(qt, bh, point, nodeid, nsuper, nsupermax, center, supernode_wgts, distances, counts, flag);
 
 }
 
 
-static real *get_or_assign_node_force(real *force, int i, SingleLinkedList l, int dim){
-
-  real *f = (real*) node_data_get_data(SingleLinkedList_get_data(l));
-
-  if (!f){
-    node_data_get_data(SingleLinkedList_get_data(l)) = &(force[i*dim]);
-    f = (real*) node_data_get_data(SingleLinkedList_get_data(l));
-  }
-  return f;
-}
 static real *get_or_alloc_force_qt(QuadTree qt, int dim){
   int i;
   real *force = (real*) qt->data;
@@ -166,20 +256,16 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, real *
   /* calculate the all to all reopulsive force and accumulate on each node of the quadtree if an interaction is possible.
      force[i*dim+j], j=1,...,dim is teh force on node i 
    */
-  SingleLinkedList l1, l2;
-  real *x1, *x2, dist, wgt1, wgt2, f, *f1, *f2, w1, w2;
-  int dim, i, j, i1, i2, k;
+  real *x1, *x2, dist, dd, wgt1, wgt2, *f1, *f2, w1, w2;
+  int dim, i, j, i1, i2, j1, j2;
   QuadTree qt11, qt12; 
 
   if (!qt1 || !qt2) return;
   assert(qt1->n > 0 && qt2->n > 0);
   dim = qt1->dim;
 
-  l1 = qt1->l;
-  l2 = qt2->l;
-
   /* far enough, calculate repulsive force */
-  dist = point_distance(qt1->average, qt2->average, dim); 
+  dist = QuadTree_point_distance(qt1->average, qt2->average, dim); 
   if (qt1->width + qt2->width < bh*dist){
     counts[0]++;
     x1 = qt1->average;
@@ -189,50 +275,30 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, real *
     w2 = qt2->total_weight;
     f2 = get_or_alloc_force_qt(qt2, dim);
     assert(dist > 0);
-    for (k = 0; k < dim; k++){
-      if (p == -1){
-	f = w1*w2*KP*(x1[k] - x2[k])/(dist*dist);
-      } else {
-	f = w1*w2*KP*(x1[k] - x2[k])/pow(dist, 1.- p);
-      }
-      f1[k] += f;
-      f2[k] -= f;
-    }
+    dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+    QuadTree_pair_force(f1, f2, x1, x2, w1*w2*KP, dd, dim);
     return;
   }
 
 
   /* both at leaves, calculate repulsive force */
-  if (l1 && l2){
-    while (l1){
-      x1 = node_data_get_coord(SingleLinkedList_get_data(l1));
-      wgt1 = node_data_get_weight(SingleLinkedList_get_data(l1));
-      i1 = node_data_get_id(SingleLinkedList_get_data(l1));
-      f1 = get_or_assign_node_force(force, i1, l1, dim);
-      l2 = qt2->l;
-      while (l2){
-	x2 = node_data_get_coord(SingleLinkedList_get_data(l2));
-	wgt2 = node_data_get_weight(SingleLinkedList_get_data(l2));
-	i2 = node_data_get_id(SingleLinkedList_get_data(l2));
-	f2 = get_or_assign_node_force(force, i2, l2, dim);
-	if ((qt1 == qt2 && i2 < i1) || i1 == i2) {
-	  l2 = SingleLinkedList_get_next(l2);
-	  continue;
-	}
+  if (qt1->ids && qt2->ids){
+    for (j1 = 0; j1 < qt1->n; j1++){
+      x1 = &(qt1->coords[j1*dim]);
+      wgt1 = qt1->weights[j1];
+      i1 = qt1->ids[j1];
+      f1 = &(force[i1*dim]);
+      for (j2 = 0; j2 < qt2->n; j2++){
+	i2 = qt2->ids[j2];
+	if ((qt1 == qt2 && j2 < j1) || i1 == i2) continue;
+	x2 = &(qt2->coords[j2*dim]);
+	wgt2 = qt2->weights[j2];
+	f2 = &(force[i2*dim]);
 	counts[1]++;
-	dist = distance_cropped(x, dim, i1, i2);
-	for (k = 0; k < dim; k++){
-	  if (p == -1){
-	    f = wgt1*wgt2*KP*(x1[k] - x2[k])/(dist*dist);
-	  } else {
-	    f = wgt1*wgt2*KP*(x1[k] - x2[k])/pow(dist, 1.- p);
-	  }
-	  f1[k] += f;
-	  f2[k] -= f;
-	}
-	l2 = SingleLinkedList_get_next(l2);
+	dist = MAX(QuadTree_point_distance(&(x[i1*dim]), &(x[i2*dim]), dim), MINDIST);
+	dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+	QuadTree_pair_force(f1, f2, x1, x2, wgt1*wgt2*KP, dd, dim);
       }
-      l1 = SingleLinkedList_get_next(l1);
     }
     return;
   }
@@ -249,22 +315,22 @@ static void QuadTree_repulsive_force_interact(QuadTree qt1, QuadTree qt2, real *
       }
   } else {
     /* split the one with bigger box, or one not at the last level */
-    if (qt1->width > qt2->width && !l1){
+    if (qt1->width > qt2->width && !qt1->ids){
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt1->qts[i];
 	QuadTree_repulsive_force_interact(qt11, qt2, x, force, bh, p, KP, counts);
       }
-    } else if (qt2->width > qt1->width && !l2){
+    } else if (qt2->width > qt1->width && !qt2->ids){
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt2->qts[i];
 	QuadTree_repulsive_force_interact(qt11, qt1, x, force, bh, p, KP, counts);
       }
-    } else if (!l1){/* pick one that is not at the last level */
+    } else if (!qt1->ids){/* pick one that is not at the last level */
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt1->qts[i];
 	QuadTree_repulsive_force_interact(qt11, qt2, x, force, bh, p, KP, counts);
       }
-    } else if (!l2){
+    } else if (!qt2->ids){
       for (i = 0; i < 1<<dim; i++){
 	qt11 = qt2->qts[i];
 	QuadTree_repulsive_force_interact(qt11, qt1, x, force, bh, p, KP, counts);
@@ -279,8 +345,7 @@ static void QuadTree_repulsive_force_accumulate(QuadTree qt, real *force, real *
   /* push down forces on cells into the node level */
   real wgt, wgt2;
   real *f, *f2;
-  SingleLinkedList l = qt->l;
-  int i, k, dim;
+  int i, j, k, dim;
   QuadTree qt2;
 
   dim = qt->dim;
@@ -289,14 +354,13 @@ static void QuadTree_repulsive_force_accumulate(QuadTree qt, real *force, real *
   assert(wgt > 0);
   counts[2]++;
 
-  if (l){
-    while (l){
-      i = node_data_get_id(SingleLinkedList_get_data(l));
-      f2 = get_or_assign_node_force(force, i, l, dim);
-      wgt2 = node_data_get_weight(SingleLinkedList_get_data(l));
+  if (qt->ids){
+    for (j = 0; j < qt->n; j++){
+      i = qt->ids[j];
+      f2 = &(force[i*dim]);
+      wgt2 = qt->weights[j];
       wgt2 = wgt2/wgt;
       for (k = 0; k < dim; k++) f2[k] += wgt2*f[k];
-      l = SingleLinkedList_get_next(l);
     }
     return;
   }
@@ -314,7 +378,103 @@ static void QuadTree_repulsive_force_accumulate(QuadTree qt, real *force, real *
 
 }
 
-void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int *flag){
+static void QuadTree_repulsive_force_interact_onesided(QuadTree qt1, QuadTree qt2, real *x, real *force, real bh, real p, real KP, real *counts){
+  /* same as QuadTree_repulsive_force_interact, but only the force on qt1 and the nodes under it is accumulated. 
+     Different target cells can therefore be processed concurrently, since they write to disjoint cells and nodes.
+   */
+  real *x1, *x2, dist, dd, wgt1, wgt2, *f1, w1, w2;
+  int dim, i, j, i1, i2, j1, j2;
+
+  if (!qt1 || !qt2) return;
+  assert(qt1->n > 0 && qt2->n > 0);
+  dim = qt1->dim;
+
+  /* far enough, calculate repulsive force */
+  dist = QuadTree_point_distance(qt1->average, qt2->average, dim); 
+  if (qt1->width + qt2->width < bh*dist){
+    counts[0]++;
+    x1 = qt1->average;
+    w1 = qt1->total_weight;
+    f1 = get_or_alloc_force_qt(qt1, dim);
+    x2 = qt2->average;
+    w2 = qt2->total_weight;
+    dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+    QuadTree_add_force(f1, x1, x2, w1*w2*KP, dd, dim);
+    return;
+  }
+
+  /* both at leaves, calculate repulsive force */
+  if (qt1->ids && qt2->ids){
+    for (j1 = 0; j1 < qt1->n; j1++){
+      x1 = &(qt1->coords[j1*dim]);
+      wgt1 = qt1->weights[j1];
+      i1 = qt1->ids[j1];
+      f1 = &(force[i1*dim]);
+      for (j2 = 0; j2 < qt2->n; j2++){
+	i2 = qt2->ids[j2];
+	if (i1 == i2) continue;
+	x2 = &(qt2->coords[j2*dim]);
+	wgt2 = qt2->weights[j2];
+	counts[1]++;
+	dist = MAX(QuadTree_point_distance(&(x[i1*dim]), &(x[i2*dim]), dim), MINDIST);
+	dd = (p == -1) ? dist*dist : pow(dist, 1.- p);
+	QuadTree_add_force(f1, x1, x2, wgt1*wgt2*KP, dd, dim);
+      }
+    }
+    return;
+  }
+
+  if (qt1 == qt2){
+    /* identical, every ordered pair of children */
+    for (i = 0; i < 1<<dim; i++){
+      for (j = 0; j < 1<<dim; j++){
+	QuadTree_repulsive_force_interact_onesided(qt1->qts[i], qt1->qts[j], x, force, bh, p, KP, counts);
+      }
+    }
+  } else if (qt1->width > qt2->width && !qt1->ids){
+    /* split the one with bigger box, or one not at the last level */
+    for (i = 0; i < 1<<dim; i++) QuadTree_repulsive_force_interact_onesided(qt1->qts[i], qt2, x, force, bh, p, KP, counts);
+  } else if (qt2->width > qt1->width && !qt2->ids){
+    for (i = 0; i < 1<<dim; i++) QuadTree_repulsive_force_interact_onesided(qt1, qt2->qts[i], x, force, bh, p, KP, counts);
+  } else if (!qt1->ids){
+    for (i = 0; i < 1<<dim; i++) QuadTree_repulsive_force_interact_onesided(qt1->qts[i], qt2, x, force, bh, p, KP, counts);
+  } else if (!qt2->ids){
+    for (i = 0; i < 1<<dim; i++) QuadTree_repulsive_force_interact_onesided(qt1, qt2->qts[i], x, force, bh, p, KP, counts);
+  } else {
+    assert(0);
+  }
+}
+
+static QuadTree *QuadTree_get_frontier(QuadTree qt, int nmin, int *ncells){
+  /* cut the tree at the first level that has at least nmin cells (or at the leaves). Returns 
+     the cells of the cut in a fixed order, so that the cut does not depend on the number of threads. */
+  QuadTree *cells, *next, *tmp;
+  int n, nnext, i, j, dim = qt->dim, split;
+
+  cells = MALLOC(sizeof(QuadTree));
+  cells[0] = qt;
+  n = 1;
+  do {
+    split = FALSE;
+    next = MALLOC(sizeof(QuadTree)*n*(1<<dim));
+    nnext = 0;
+    for (i = 0; i < n; i++){
+      if (cells[i]->qts){
+	split = TRUE;
+	for (j = 0; j < 1<<dim; j++) if (cells[i]->qts[j]) next[nnext++] = cells[i]->qts[j];
+      } else {
+	next[nnext++] = cells[i];
+      }
+    }
+    tmp = cells; cells = next; FREE(tmp);
+    n = nnext;
+  } while (split && n < nmin);
+
+  *ncells = n;
+  return cells;
+}
+
+void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int nthreads, int *flag){
   /* get repulsice force by a more efficient algortihm: we consider two cells, if they are well separated, we
      calculate the overall repulsive force on the cell level, if not well separated, we divide one of the cell.
      If both cells are at the leaf level, we calcuaulate repulsicve force among individual nodes. Finally
@@ -330,8 +490,14 @@ void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, re
      .  counts[1]: number of cell-node interaction
      .  counts[2]: number of total cells in the quadtree
      . Al normalized by dividing by number of nodes
+     nthreads: number of threads to use. With more than one thread, the tree is cut into a fixed set of 
+     .  subtrees, and each subtree gathers the forces acting on it (see QuadTree_repulsive_force_interact_onesided).
+     .  This evaluates every cell-cell interaction twice, but the result does not depend on the thread count.
   */
   int n = qt->n, dim = qt->dim, i;
+  QuadTree *cells;
+  int ncells;
+  real c0 = 0, c1 = 0, c2 = 0;
 
   for (i = 0; i < 4; i++) counts[i] = 0;
 
@@ -339,11 +505,133 @@ void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, re
 
   for (i = 0; i < dim*n; i++) force[i] = 0;
 
-  QuadTree_repulsive_force_interact(qt, qt, x, force, bh, p, KP, counts);
-  QuadTree_repulsive_force_accumulate(qt, force, counts);
+  nthreads = get_num_threads(nthreads);
+  if (nthreads <= 1){
+    QuadTree_repulsive_force_interact(qt, qt, x, force, bh, p, KP, counts);
+    QuadTree_repulsive_force_accumulate(qt, force, counts);
+  } else {
+    cells = QuadTree_get_frontier(qt, QUADTREE_PARALLEL_CELLS, &ncells);
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1) reduction(+:c0,c1,c2)
+    for (i = 0; i < ncells; i++){
+      real cnt[4] = {0, 0, 0, 0};
+      QuadTree_repulsive_force_interact_onesided(cells[i], qt, x, force, bh, p, KP, cnt);
+      QuadTree_repulsive_force_accumulate(cells[i], force, cnt);
+      c0 += cnt[0]; c1 += cnt[1]; c2 += cnt[2];
+    }
+    /* each interaction was seen from both sides */
+    counts[0] = c0/2; counts[1] = c1/2; counts[2] = c2;
+    FREE(cells);
+  }
   for (i = 0; i < 4; i++) counts[i] /= n;
 
 }
+static int QuadTree_get_quadrant(int dim, real *center, real *coord){
+  /* find the quadrant that a point of coordinates coord is going into with reference to the center.
+     if coord - center == {+,-,+,+} = {1,0,1,1}, then it will sit in the i-quadrant where
+     i's binary representation is 1011 (that is, decimal 11).
+   */
+  int d = 0, i;
+
+  for (i = dim - 1; i >= 0; i--){
+    if (coord[i] - center[i] < 0){
+      d = 2*d;
+    } else {
+      d = 2*d+1;
+    }
+  }
+  return d;
+}
+
+/* QuadTree_get_quadrant written out for 2D and 3D, for the per-point loop of QuadTree_build */
+#define QUADRANT_2D(center, coord) \
+  (((coord)[1] - (center)[1] < 0 ? 0 : 2) + ((coord)[0] - (center)[0] < 0 ? 0 : 1))
+#define QUADRANT_3D(center, coord) \
+  (((coord)[2] - (center)[2] < 0 ? 0 : 4) + QUADRANT_2D(center, coord))
+
+static void quadrant_center(int dim, real *center, real width, int i, real *child){
+  /* center of the child in quadrant i of a cell centered at center. width is the width of the child */
+  int k;
+  for (k = 0; k < dim; k++){/* decompose child id into binary, if {1,0}, say, then
+				     add {width/2, -width/2} to the parents' center
+				     to get the child's center. */
+    if (i%2 == 0){
+      child[k] = center[k] - width;
+    } else {
+      child[k] = center[k] + width;
+    }
+    i = (i - i%2)/2;
+  }
+}
+
+static void QuadTree_build(QuadTree q, real *coord, real *weight, int *order, int *tmp, int *quadrant, int *bucket,
+			   int lo, int hi, int level){
+  /* fill the pooled cell q with the points order[lo], ..., order[hi-1], and recursively its children.
+     The points of the cell are sorted by quadrant with a counting sort, so each child receives
+     a contiguous range of order, and the leaves end up in depth first order.
+     tmp, quadrant: scratch arrays of the same length as order.
+     bucket: scratch array of size (max_level + 1)*(2^dim + 1)
+   */
+  QuadTree_pool pool = q->pool;
+  int dim = q->dim, nq = 1<<dim, i, j, k, ii, *start;
+  real w, child_center[10], *cc = child_center;
+
+  q->n = hi - lo;
+  q->total_weight = 0;
+  for (k = 0; k < dim; k++) q->average[k] = 0;
+  for (j = lo; j < hi; j++){
+    i = order[j];
+    w = weight ? weight[i] : 1;
+    q->total_weight += w;
+    for (k = 0; k < dim; k++) q->average[k] += coord[i*dim+k];
+  }
+  for (k = 0; k < dim; k++) q->average[k] /= q->n;
+
+  if (q->n == 1 || level >= q->max_level){
+    /* a leaf: copy its points next to each other */
+    q->qts = NULL;
+    q->ids = &(pool->ids[lo]);
+    q->weights = &(pool->weights[lo]);
+    q->coords = &(pool->coords[lo*dim]);
+    for (j = lo; j < hi; j++){
+      i = order[j];
+      pool->ids[j] = i;
+      pool->weights[j] = weight ? weight[i] : 1;
+      for (k = 0; k < dim; k++) pool->coords[j*dim+k] = coord[i*dim+k];
+    }
+    return;
+  }
+
+  /* counting sort of the points by quadrant */
+  start = &(bucket[level*(nq + 1)]);
+  for (ii = 0; ii <= nq; ii++) start[ii] = 0;
+  switch (dim){
+  case 2:
+    for (j = lo; j < hi; j++) quadrant[j] = QUADRANT_2D(q->center, &(coord[order[j]*2]));
+    break;
+  case 3:
+    for (j = lo; j < hi; j++) quadrant[j] = QUADRANT_3D(q->center, &(coord[order[j]*3]));
+    break;
+  default:
+    for (j = lo; j < hi; j++) quadrant[j] = QuadTree_get_quadrant(dim, q->center, &(coord[order[j]*dim]));
+  }
+  for (j = lo; j < hi; j++) start[quadrant[j] + 1]++;
+  start[0] = lo;
+  for (ii = 0; ii < nq; ii++) start[ii + 1] += start[ii];
+  for (j = lo; j < hi; j++) tmp[start[quadrant[j]]++] = order[j];
+  for (j = lo; j < hi; j++) order[j] = tmp[j];
+  /* start[ii] is now the end of quadrant ii */
+
+  if (dim > 10) cc = MALLOC(sizeof(real)*dim);
+  for (ii = 0; ii < nq; ii++){
+    j = (ii == 0) ? lo : start[ii - 1];
+    if (j == start[ii]) continue;
+    quadrant_center(dim, q->center, q->width/2, ii, cc);
+    q->qts[ii] = QuadTree_pool_new_cell(pool, cc, q->width/2, q->max_level);
+    QuadTree_build(q->qts[ii], coord, weight, order, tmp, quadrant, bucket, j, start[ii], level + 1);
+  }
+  if (cc != child_center) FREE(cc);
+}
+
 QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord, real *weight){
   /* form a new QuadTree data structure from a list of coordinates of n points
      coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1]
@@ -351,8 +639,12 @@ QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord
    */
   real *xmin, *xmax, *center, width;
   QuadTree qt = NULL;
+  QuadTree_pool pool;
+  int *order, *tmp, *quadrant, *bucket;
   int i, k;
 
+  if (n <= 0) return NULL;
+
   xmin = MALLOC(sizeof(real)*dim);
   xmax = MALLOC(sizeof(real)*dim);
   center = MALLOC(sizeof(real)*dim);
@@ -375,19 +667,22 @@ QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord
   }
   if (width == 0) width = 0.00001;/* if we only have one point, width = 0! */
   width *= 0.52;
-  qt = QuadTree_new(dim, center, width, max_level);
 
-  if (weight){
-    for (i = 0; i < n; i++){
-      qt = QuadTree_add(qt, &(coord[i*dim]), weight[i], i);
-    }
-  } else {
-    for (i = 0; i < n; i++){
-      qt = QuadTree_add(qt, &(coord[i*dim]), 1, i);
-    }
-  }
+  pool = QuadTree_pool_new(dim, n);
+  pool->root = qt = QuadTree_pool_new_cell(pool, center, width, max_level);
+
+  order = MALLOC(sizeof(int)*n);
+  tmp = MALLOC(sizeof(int)*n);
+  quadrant = MALLOC(sizeof(int)*n);
+  bucket = MALLOC(sizeof(int)*(MAX(max_level, 0) + 1)*((1<<dim) + 1));
+  for (i = 0; i < n; i++) order[i] = i;
 
+  QuadTree_build(qt, coord, weight, order, tmp, quadrant, bucket, 0, n, 0);
 
+  FREE(order);
+  FREE(tmp);
+  FREE(quadrant);
+  FREE(bucket);
   FREE(xmin);
   FREE(xmax);
   FREE(center);
@@ -407,15 +702,23 @@ QuadTree QuadTree_new(int dim, real *center, real width, int max_level){
   q->total_weight = 0;
   q->average = NULL;
   q->qts = NULL;
-  q->l = NULL;
+  q->ids = NULL;
+  q->weights = NULL;
+  q->coords = NULL;
   q->max_level = max_level;
   q->data = NULL;
+  q->pool = NULL;
   return q;
 }
 
 void QuadTree_delete(QuadTree q){
   int i, dim;
   if (!q) return;
+  if (q->pool){
+    /* everything below the root lives in the pool */
+    if (q->pool->root == q) QuadTree_pool_delete(q->pool);
+    return;
+  }
   dim = q->dim;
   FREE(q->center);
   FREE(q->average);
@@ -426,55 +729,44 @@ void QuadTree_delete(QuadTree q){
     }
     FREE(q->qts);
   }
-  SingleLinkedList_delete(q->l, node_data_delete);
+  FREE(q->ids);
+  FREE(q->weights);
+  FREE(q->coords);
   FREE(q);
 }
 
-static int QuadTree_get_quadrant(int dim, real *center, real *coord){
-  /* find the quadrant that a point of coordinates coord is going into with reference to the center.
-     if coord - center == {+,-,+,+} = {1,0,1,1}, then it will sit in the i-quadrant where
-     i's binary representation is 1011 (that is, decimal 11).
-   */
-  int d = 0, i;
-
-  for (i = dim - 1; i >= 0; i--){
-    if (coord[i] - center[i] < 0){
-      d = 2*d;
-    } else {
-      d = 2*d+1;
-    }
-  }
-  return d;
-}
-
 QuadTree QuadTree_new_in_quadrant(int dim, real *center, real width, int max_level, int i){
   /* a new quadtree in quadrant i of the original cell. The original cell is centered at 'center".
      The new cell have width "width".
    */
   QuadTree qt;
-  int k;
 
   qt = QuadTree_new(dim, center, width, max_level);
-  center = qt->center;/* right now this has the center for the parent */
-  for (k = 0; k < dim; k++){/* decompose child id into binary, if {1,0}, say, then
-				     add {width/2, -width/2} to the parents' center
-				     to get the child's center. */
-    if (i%2 == 0){
-      center[k]  -= width;
-    } else {
-      center[k] += width;
-    }
-    i = (i - i%2)/2;
-  }
+  quadrant_center(dim, center, width, i, qt->center);
   return qt;
 
 }
+
+static void QuadTree_leaf_append(QuadTree q, real *coord, real weight, int id){
+  /* append a point to the arrays of a leaf, which grow by doubling */
+  int n = q->n, dim = q->dim, k;
+
+  if ((n & (n - 1)) == 0){
+    q->ids = REALLOC(q->ids, sizeof(int)*MAX(1, 2*n));
+    q->weights = REALLOC(q->weights, sizeof(real)*MAX(1, 2*n));
+    q->coords = REALLOC(q->coords, sizeof(real)*MAX(1, 2*n)*dim);
+  }
+  q->ids[n] = id;
+  q->weights[n] = weight;
+  for (k = 0; k < dim; k++) q->coords[n*dim+k] = coord[k];
+}
+
 static QuadTree QuadTree_add_internal(QuadTree q, real *coord, real weight, int id, int level){
   int i, dim = q->dim, ii;
-  node_data nd = NULL;
 
   int max_level = q->max_level;
-  int idd;
+
+  assert(!q->pool);
 
   /* Make sure that coord is within bounding box */
   for (i = 0; i < q->dim; i++) {
@@ -489,13 +781,12 @@ static QuadTree QuadTree_add_internal(QuadTree q, real *coord, real weight, int
 
   if (q->n == 0){
     /* if this node is empty right now */
-    q->n = 1;
     q->total_weight = weight;
     q->average = MALLOC(sizeof(real)*dim);
     for (i = 0; i < q->dim; i++) q->average[i] = coord[i];
-    nd = node_data_new(q->dim, weight, coord, id);
-    assert(!(q->l));
-    q->l = SingleLinkedList_new(nd);
+    assert(!(q->ids));
+    QuadTree_leaf_append(q, coord, weight, id);
+    q->n = 1;
   } else if (level < max_level){
     /* otherwise open up into 2^dim quadtrees unless the level is too high */
     q->total_weight += weight;
@@ -513,34 +804,35 @@ static QuadTree QuadTree_add_internal(QuadTree q, real *coord, real weight, int
     q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, weight, id, level + 1);
     assert(q->qts[ii]);
 
-    if (q->l){
-      idd = node_data_get_id(SingleLinkedList_get_data(q->l));
+    if (q->ids){
       assert(q->n == 1);
-      coord = node_data_get_coord(SingleLinkedList_get_data(q->l));
-      weight = node_data_get_weight(SingleLinkedList_get_data(q->l));
+      coord = q->coords;
       ii = QuadTree_get_quadrant(dim, q->center, coord);
       assert(ii < 1<<dim && ii >= 0);
 
       if (q->qts[ii] == NULL) q->qts[ii] = QuadTree_new_in_quadrant(q->dim, q->center, (q->width)/2, max_level, ii);
 
-      q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, weight, idd, level + 1);
+      q->qts[ii] = QuadTree_add_internal(q->qts[ii], coord, q->weights[0], q->ids[0], level + 1);
       assert(q->qts[ii]);
       
-      /* delete the old node data on parent */
-      SingleLinkedList_delete(q->l, node_data_delete);
-      q->l = NULL;
+      /* delete the old point on parent */
+      FREE(q->ids);
+      FREE(q->weights);
+      FREE(q->coords);
+      q->ids = NULL;
+      q->weights = NULL;
+      q->coords = NULL;
     }
     
     (q->n)++;
   } else {
     assert(!(q->qts));
-    /* level is too high, append data in the linked list */
-    (q->n)++;
+    /* level is too high, append data to the leaf */
     q->total_weight += weight;
     for (i = 0; i < q->dim; i++) q->average[i] = ((q->average[i])*q->n + coord[i])/(q->n + 1);
-    nd = node_data_new(q->dim, weight, coord, id);
-    assert(q->l);
-    q->l = SingleLinkedList_prepend(q->l, nd);
+    assert(q->ids);
+    QuadTree_leaf_append(q, coord, weight, id);
+    (q->n)++;
   }
   return q;
 }
@@ -609,28 +901,25 @@ static void draw_polygon(FILE *fp, int dim, real *center, real width){
 }
 static void QuadTree_print_internal(FILE *fp, QuadTree q, int level){
   /* dump a quad tree in Mathematica format. */
-  SingleLinkedList l, l0;
   real *coord;
-  int i, dim;
+  int i, j, dim;
 
   if (!q) return;
 
   draw_polygon(fp, q->dim, q->center, q->width);
   dim = q->dim;
   
-  l0 = l = q->l;
-  if (l){
+  if (q->ids){
     printf(",(*a*) {Red,");
-    while (l){
-      if (l != l0) printf(",");
-      coord = node_data_get_coord(SingleLinkedList_get_data(l));
-      fprintf(fp, "(*node %d*) Point[{",  node_data_get_id(SingleLinkedList_get_data(l)));
+    for (j = 0; j < q->n; j++){
+      if (j > 0) printf(",");
+      coord = &(q->coords[j*dim]);
+      fprintf(fp, "(*node %d*) Point[{",  q->ids[j]);
       for (i = 0; i < dim; i++){
 	if (i != 0) printf(",");
 	fprintf(fp, "%f",coord[i]);
       }
       fprintf(fp, "}]");
-      l = SingleLinkedList_get_next(l);
     }
     fprintf(fp, "}");
   }
@@ -668,26 +957,23 @@ void QuadTree_print(FILE *fp, QuadTree q){
 
 static void QuadTree_get_nearest_internal(QuadTree qt, real *x, real *y, real *min, int *imin, int tentative, int *flag){
   /* get the narest point years to {x[0], ..., x[dim]} and store in y.*/
-  SingleLinkedList l;
   real *coord, dist;
-  int dim, i, iq = -1;
+  int dim, i, j, iq = -1;
   real qmin;
   real *point = x;
 
   *flag = 0;
   if (!qt) return;
   dim = qt->dim;
-  l = qt->l;
-  if (l){
-    while (l){
-      coord = node_data_get_coord(SingleLinkedList_get_data(l));
+  if (qt->ids){
+    for (j = 0; j < qt->n; j++){
+      coord = &(qt->coords[j*dim]);
       dist = point_distance(point, coord, dim);
       if(*min < 0 || dist < *min) {
 	*min = dist;
-	*imin = node_data_get_id(SingleLinkedList_get_data(l));
+	*imin = qt->ids[j];
 	for (i = 0; i < dim; i++) y[i] = coord[i];
       }
-      l = SingleLinkedList_get_next(l);
     }
   }
   
@@ -14,16 +14,18 @@
 #ifndef QUAD_TREE_H
 #define QUAD_TREE_H
 
-#include "LinkedList.h"
 /* #include "sfdpinternal.h" */
 #include <stdio.h>
 
 typedef struct QuadTree_struct *QuadTree;
 
+typedef struct QuadTree_pool_struct *QuadTree_pool;
+
 struct QuadTree_struct {
   /* a data structure containing coordinates of n items, their average is in "average".
      The current level is a square or cube of width "width", which is subdivided into 
-     2^dim QuadTrees qts. At the last level, all coordinates are stored in a single linked list l. 
+     2^dim QuadTrees qts. At the last level, the n points of the cell are stored in the arrays
+     ids, weights and coords: point j has id ids[j], weight weights[j] and coordinates coords[j*dim+k], k = 0, ..., dim - 1.
      total_weight is the combined weights of the nodes */
   int n;/* number of items */
   real total_weight;
@@ -33,9 +35,12 @@ struct QuadTree_struct {
 		"radius" */
   real *average;/* the average coordinates. Array of length dim. Allocated inside  */
   QuadTree *qts;/* subtree . If dim = 2, there are 4, dim = 3 gives 8 */
-  SingleLinkedList l;
+  int *ids;/* points of a leaf cell, NULL for other cells */
+  real *weights;
+  real *coords;
   int max_level;
   void *data;
+  QuadTree_pool pool;/* if not NULL, the cell, its arrays and its subtrees live in a block storage owned by the root of the tree */
 };
 
 
@@ -43,10 +48,12 @@ QuadTree QuadTree_new(int dim, real *center, real width, int max_level);
 
 void QuadTree_delete(QuadTree q);
 
-QuadTree QuadTree_add(QuadTree q, real *coord, real weight, int id);/* coord is copied in */
+QuadTree QuadTree_add(QuadTree q, real *coord, real weight, int id);/* coord is copied in. Not for trees made by QuadTree_new_from_point_list */
 
 void QuadTree_print(FILE *fp, QuadTree q);
 
+/* build a tree of n points in one pass. The cells and the points are stored in a few large arrays, with
+   the points of each leaf contiguous, so a traversal touches memory in order. */
 QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord, real *weight);
 
 real point_distance(real *p1, real *p2, int dim);
@@ -54,7 +61,10 @@ real point_distance(real *p1, real *p2, int dim);
 void QuadTree_get_supernodes(QuadTree qt, real bh, real *point, int nodeid, int *nsuper, 
 			     int *nsupermax, real **center, real **supernode_wgts, real **distances, real *counts, int *flag);
 
-void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int *flag);
+/* minimum number of subtrees the tree is cut into when the repulsive force is computed on several threads */
+enum {QUADTREE_PARALLEL_CELLS = 256};
+
+void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int nthreads, int *flag);
 
 /* find the nearest point and put in ymin, index in imin and distance in min */
 void QuadTree_get_nearest(QuadTree qt, real *x, real *ymin, int *imin, real *min, int *flag);
@@ -11,10 +11,19 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include "logic.h"
 #include "memory.h"
 #include "arith.h"
@@ -24,6 +33,34 @@
 #include "LinkedList.h"
 #include "PriorityQueue.h"
 #endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SPMV_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* file layout of SparseMatrix_export_mapped: a SparseMatrix_map_header, then the ia, ja and a arrays, 
+   each starting at a multiple of SPARSEMATRIX_MAP_ALIGN bytes */
+#define SPARSEMATRIX_MAP_MAGIC "GVSPMAT"
+enum {SPARSEMATRIX_MAP_VERSION = 1, SPARSEMATRIX_MAP_ALIGN = 64, SPARSEMATRIX_MAP_BYTE_ORDER = 0x01020304};
+
+struct SparseMatrix_map_header {
+  char magic[8];
+  int version;
+  int byte_order;/* SPARSEMATRIX_MAP_BYTE_ORDER as written by the exporting machine */
+  int int_size;
+  int offset_size;
+  int m, n, nz, type, format, property, size;
+  size_t ia_offset, ja_offset, a_offset;/* byte offsets from the start of the file */
+  size_t length;/* of the whole file */
+};
+
+/* products with fewer nonzeros than this are not worth spreading over threads */
+#define SPMV_PARALLEL_NZ 20000
+
+/* per thread, so that layouts running concurrently on different threads keep their own settings */
+static int spmv_kernel = SPMV_KERNEL_DEFAULT;
+static int spmv_nthreads = 0;
+#pragma omp threadprivate(spmv_kernel, spmv_nthreads)
 
 static size_t size_of_matrix_type(int type){
   int size = 0;
@@ -316,6 +353,8 @@ static SparseMatrix SparseMatrix_init(int m, int n, int type, size_t sz, int for
   A->a = NULL;
   A->format = format;
   A->property = 0;
+  A->map = NULL;
+  A->map_len = 0;
   clear_flag(A->property, MATRIX_PATTERN_SYMMETRIC);
   clear_flag(A->property, MATRIX_SYMMETRIC);
   clear_flag(A->property, MATRIX_SKEW);
@@ -347,10 +386,48 @@ static SparseMatrix SparseMatrix_alloc(SparseMatrix A, int nz){
   return A;
 }
 
+static void SparseMatrix_unmap_storage(void *map, size_t len){
+#if HAVE_SYS_MMAN_H
+  munmap(map, len);
+#else
+  FREE(map);
+#endif
+}
+
+static void SparseMatrix_own_arrays(SparseMatrix A){
+  /* give a matrix imported by SparseMatrix_import_mapped its own copy of ia, ja and a, so that they can be 
+     reallocated or freed. Nothing to do for any other matrix */
+  size_t nia, nz_t = (size_t) A->nzmax;
+  void *v;
+
+  if (!A->map) return;
+  nia = (A->format == FORMAT_COORD) ? nz_t : ((size_t) A->m) + 1;
+  if (A->ia) {
+    v = MALLOC(sizeof(int)*nia);
+    MEMCPY(v, A->ia, sizeof(int)*nia);
+    A->ia = v;
+  }
+  if (A->ja) {
+    v = MALLOC(sizeof(int)*nz_t);
+    MEMCPY(v, A->ja, sizeof(int)*nz_t);
+    A->ja = v;
+  }
+  if (A->a) {
+    v = MALLOC(A->size*nz_t);
+    MEMCPY(v, A->a, A->size*nz_t);
+    A->a = v;
+  }
+  SparseMatrix_unmap_storage(A->map, A->map_len);
+  A->map = NULL;
+  A->map_len = 0;
+}
+
 static SparseMatrix SparseMatrix_realloc(SparseMatrix A, int nz){
   int format = A->format;
   size_t nz_t = (size_t) nz; /* size_t is 64 bit on 64 bit machine. Using nz*A->size can overflow. */
 
+  SparseMatrix_own_arrays(A);
+
   switch (format){
   case FORMAT_COORD:
     A->ia = REALLOC(A->ia, sizeof(int)*nz_t);
@@ -411,6 +488,11 @@ void SparseMatrix_delete(SparseMatrix A){
   /* return a sparse matrix skeleton with row dimension m and storage nz. If nz == 0, 
      only row pointers are allocated */
   if (!A) return;
+  if (A->map) {
+    SparseMatrix_unmap_storage(A->map, A->map_len);
+    FREE(A);
+    return;
+  }
   if (A->ia) FREE(A->ia);
   if (A->ja) FREE(A->ja);
   if (A->a) FREE(A->a);
@@ -712,6 +794,168 @@ SparseMatrix SparseMatrix_import_binary(char *name){
   return A;
 }
 
+static size_t map_align(size_t offset){
+  return (offset + SPARSEMATRIX_MAP_ALIGN - 1)/SPARSEMATRIX_MAP_ALIGN*SPARSEMATRIX_MAP_ALIGN;
+}
+
+static size_t map_ia_length(int m, int nz, int format){
+  return (format == FORMAT_COORD) ? (size_t) nz : ((size_t) m) + 1;
+}
+
+static void map_write_padded(FILE *f, void *data, size_t len, size_t *pos, size_t offset){
+  /* pad the file from *pos to offset with zeros, then write len bytes of data */
+  static char zeros[SPARSEMATRIX_MAP_ALIGN];
+  size_t written = 1;
+
+  while (*pos < offset && written > 0){
+    written = fwrite(zeros, 1, MIN(offset - *pos, sizeof(zeros)), f);
+    *pos += written;
+  }
+  if (len > 0) *pos += fwrite(data, 1, len, f);
+}
+
+void SparseMatrix_export_mapped(char *name, SparseMatrix A, int *flag){
+  /* write A in the format read by SparseMatrix_import_mapped. flag is 1 if the file can not be written */
+  struct SparseMatrix_map_header h;
+  size_t nia = map_ia_length(A->m, A->nz, A->format), pos = 0;
+  size_t alen = (A->a && A->size > 0) ? A->size*((size_t) A->nz) : 0;
+  FILE *f;
+
+  *flag = 0;
+  if (A->format != FORMAT_CSR && A->format != FORMAT_COORD) {
+    *flag = 1;
+    return;
+  }
+  f = fopen(name, "wb");
+  if (!f) {
+    *flag = 1;
+    return;
+  }
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, SPARSEMATRIX_MAP_MAGIC, sizeof(h.magic));
+  h.version = SPARSEMATRIX_MAP_VERSION;
+  h.byte_order = SPARSEMATRIX_MAP_BYTE_ORDER;
+  h.int_size = sizeof(int);
+  h.offset_size = sizeof(size_t);
+  h.m = A->m;
+  h.n = A->n;
+  h.nz = A->nz;
+  h.type = A->type;
+  h.format = A->format;
+  h.property = A->property;
+  h.size = alen > 0 ? A->size : 0;
+  h.ia_offset = map_align(sizeof(h));
+  h.ja_offset = map_align(h.ia_offset + sizeof(int)*nia);
+  h.a_offset = map_align(h.ja_offset + sizeof(int)*((size_t) A->nz));
+  h.length = h.a_offset + alen;
+
+  map_write_padded(f, &h, sizeof(h), &pos, 0);
+  map_write_padded(f, A->ia, sizeof(int)*nia, &pos, h.ia_offset);
+  map_write_padded(f, A->ja, sizeof(int)*((size_t) A->nz), &pos, h.ja_offset);
+  map_write_padded(f, A->a, alen, &pos, h.a_offset);
+  if (fclose(f) != 0 || pos != h.length) *flag = 1;
+}
+
+static int map_header_valid(struct SparseMatrix_map_header *h, size_t len){
+  /* check a header read from a file of len bytes: its format and sizes, and that ia, ja and a lie in the file in turn */
+  size_t nia, nz;
+
+  if (memcmp(h->magic, SPARSEMATRIX_MAP_MAGIC, sizeof(h->magic)) != 0 || h->version != SPARSEMATRIX_MAP_VERSION
+      || h->byte_order != SPARSEMATRIX_MAP_BYTE_ORDER || h->int_size != sizeof(int) || h->offset_size != sizeof(size_t)) return FALSE;
+  if (h->m < 0 || h->n < 0 || h->nz < 0 || (h->format != FORMAT_CSR && h->format != FORMAT_COORD)) return FALSE;
+  if (h->size != 0 && ((size_t) h->size) != size_of_matrix_type(h->type)) return FALSE;
+  if (h->length != len || h->ia_offset % SPARSEMATRIX_MAP_ALIGN || h->ja_offset % SPARSEMATRIX_MAP_ALIGN
+      || h->a_offset % SPARSEMATRIX_MAP_ALIGN) return FALSE;
+
+  nia = map_ia_length(h->m, h->nz, h->format);
+  nz = (size_t) h->nz;
+  if (h->ia_offset < sizeof(*h) || h->ia_offset > len || (len - h->ia_offset)/sizeof(int) < nia) return FALSE;
+  if (h->ja_offset < h->ia_offset + sizeof(int)*nia || h->ja_offset > len || (len - h->ja_offset)/sizeof(int) < nz) return FALSE;
+  if (h->a_offset < h->ja_offset + sizeof(int)*nz || h->a_offset > len) return FALSE;
+  if (h->size > 0 && (len - h->a_offset)/h->size < nz) return FALSE;
+  return TRUE;
+}
+
+static int map_indices_valid(SparseMatrix A){
+  /* check that every entry of ia and ja of a mapped matrix is within its m, n and nz */
+  int i;
+
+  if (A->format == FORMAT_COORD){
+    for (i = 0; i < A->nz; i++){
+      if (A->ia[i] < 0 || A->ia[i] >= A->m || A->ja[i] < 0 || A->ja[i] >= A->n) return FALSE;
+    }
+    return TRUE;
+  }
+  if (A->ia[0] != 0 || A->ia[A->m] != A->nz) return FALSE;
+  for (i = 0; i < A->m; i++){
+    if (A->ia[i + 1] < A->ia[i]) return FALSE;
+  }
+  for (i = 0; i < A->nz; i++){
+    if (A->ja[i] < 0 || A->ja[i] >= A->n) return FALSE;
+  }
+  return TRUE;
+}
+
+SparseMatrix SparseMatrix_import_mapped(char *name, int *flag){
+  /* map a file written by SparseMatrix_export_mapped. The matrix uses the mapping as its storage until it is deleted.
+     The header is read and checked before anything is mapped, so other files are turned down after one small read */
+  struct SparseMatrix_map_header h;
+  struct stat st;
+  SparseMatrix A;
+  size_t len;
+  char *map;
+  FILE *f;
+
+  *flag = 0;
+  f = fopen(name, "rb");
+  if (!f || fstat(fileno(f), &st) != 0) {
+    if (f) fclose(f);
+    *flag = 1;
+    return NULL;
+  }
+  len = (size_t) st.st_size;
+  if (len < sizeof(h) || fread(&h, sizeof(h), 1, f) != 1 || !map_header_valid(&h, len)) {
+    fclose(f);
+    *flag = 2;
+    return NULL;
+  }
+#if HAVE_SYS_MMAN_H
+  /* private and writable: the routines that work on a matrix in place may change it, without touching the file */
+  map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+  if (map == MAP_FAILED) map = NULL;
+#else
+  map = MALLOC(len);
+  if (fseek(f, 0, SEEK_SET) != 0 || fread(map, 1, len, f) != len) {
+    FREE(map);
+    map = NULL;
+  }
+#endif
+  fclose(f);
+  if (!map) {
+    *flag = 1;
+    return NULL;
+  }
+
+  A = SparseMatrix_init(h.m, h.n, h.type, (size_t) h.size, FORMAT_COORD);
+  A->format = h.format;
+  A->nz = A->nzmax = h.nz;
+  A->property = h.property;
+  A->ia = (int*) (map + h.ia_offset);
+  A->ja = (int*) (map + h.ja_offset);
+  if (h.size > 0 && h.nz > 0) A->a = map + h.a_offset;
+  A->map = map;
+  A->map_len = len;
+
+  /* the file may have changed since the header was read, and a corrupt one must not send later code out of bounds */
+  if (memcmp(map, &h, sizeof(h)) != 0 || !map_indices_valid(A)){
+    SparseMatrix_delete(A);
+    *flag = 2;
+    return NULL;
+  }
+  return A;
+}
+
 static void SparseMatrix_export_coord(FILE *f, SparseMatrix A){
   int *ia, *ja;
   real *a;
@@ -1112,9 +1356,88 @@ static void dense_transpose(real *v, int m, int n){
 }
 
 
+static int spmv_resolve_kernel(int kernel){
+  /* SPMV_KERNEL_DEFAULT is replaced by the choice from GV_SPMV_KERNEL, or SPMV_KERNEL_THREADED */
+  char *s;
+
+  if (kernel != SPMV_KERNEL_DEFAULT) return kernel;
+  if ((s = getenv("GV_SPMV_KERNEL"))){
+    if (strcmp(s, "serial") == 0) return SPMV_KERNEL_SERIAL;
+    if (strcmp(s, "simd") == 0) return SPMV_KERNEL_SIMD;
+  }
+  return SPMV_KERNEL_THREADED;
+}
+
+void SparseMatrix_set_multiply_kernel(int kernel, int nthreads){
+  /* sets the kernel for the products started from the calling thread; the products only read these settings */
+  spmv_kernel = spmv_resolve_kernel(kernel);
+  spmv_nthreads = nthreads;
+}
+
+void SparseMatrix_get_multiply_kernel(int *kernel, int *nthreads){
+  /* the settings of the calling thread, as passed to SparseMatrix_set_multiply_kernel, so that they can be restored */
+  *kernel = spmv_kernel;
+  *nthreads = spmv_nthreads;
+}
+
+#ifdef HAVE_SPMV_AVX2
+__attribute__((target("avx2,fma")))
+static real csr_row_product_avx2(int start, int end, int *ja, real *a, real *v){
+  /* sum_j a[j]*v[ja[j]], j = start, ..., end - 1, four entries at a time */
+  __m256d sum = _mm256_setzero_pd();
+  real s[4];
+  int j;
+
+  for (j = start; j + 4 <= end; j += 4){
+    __m128i idx = _mm_loadu_si128((__m128i*) &(ja[j]));
+    sum = _mm256_fmadd_pd(_mm256_loadu_pd(&(a[j])), _mm256_i32gather_pd(v, idx, 8), sum);
+  }
+  _mm256_storeu_pd(s, sum);
+  s[0] = (s[0] + s[1]) + (s[2] + s[3]);
+  for (; j < end; j++) s[0] += a[j]*v[ja[j]];
+  return s[0];
+}
+#endif
+
+static int spmv_get_kernel(int *nthreads){
+  /* the kernel to use, and the number of threads for it. The settings are only read, so products may run
+     concurrently; without a call to SparseMatrix_set_multiply_kernel the default is resolved on each call */
+  int kernel = spmv_resolve_kernel(spmv_kernel);
+
+  *nthreads = (kernel == SPMV_KERNEL_SERIAL) ? 1 : get_num_threads(spmv_nthreads);
+#ifdef HAVE_SPMV_AVX2
+  if (kernel == SPMV_KERNEL_SIMD && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SPMV_KERNEL_SIMD;
+#endif
+  return (kernel == SPMV_KERNEL_SERIAL) ? SPMV_KERNEL_SERIAL : SPMV_KERNEL_THREADED;
+}
+
+static void csr_multiply_vector_real(int m, int *ia, int *ja, real *a, real *v, real *u){
+  /* u = A v for a real CSR matrix. Rows are independent, so they are shared out among threads */
+  int i, j, nthreads, kernel;
+
+  kernel = spmv_get_kernel(&nthreads);
+
+#ifdef HAVE_SPMV_AVX2
+  if (kernel == SPMV_KERNEL_SIMD){
+#pragma omp parallel for num_threads(nthreads) if(ia[m] > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
+    for (i = 0; i < m; i++) u[i] = csr_row_product_avx2(ia[i], ia[i+1], ja, a, v);
+    return;
+  }
+#endif
+
+#pragma omp parallel for private(j) num_threads(nthreads) if(ia[m] > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
+  for (i = 0; i < m; i++){
+    u[i] = 0.;
+    for (j = ia[i]; j < ia[i+1]; j++){
+      u[i] += a[j]*v[ja[j]];
+    }
+  }
+}
+
 static void SparseMatrix_multiply_dense1(SparseMatrix A, real *v, real **res, int dim, int transposed, int res_transposed){
   /* A v or A^T v where v a dense matrix of second dimension dim. Real only for now. */
-  int i, j, k, *ia, *ja, n, m;
+  int i, j, k, *ia, *ja, n, m, nthreads;
   real *a, *u;
 
   assert(A->format == FORMAT_CSR);
@@ -1129,6 +1452,8 @@ static void SparseMatrix_multiply_dense1(SparseMatrix A, real *v, real **res, in
 
   if (!transposed){
     if (!u) u = MALLOC(sizeof(real)*((size_t) m)*((size_t) dim));
+    spmv_get_kernel(&nthreads);
+#pragma omp parallel for private(j, k) num_threads(nthreads) if(((size_t) ia[m])*dim > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
     for (i = 0; i < m; i++){
       for (k = 0; k < dim; k++) u[i*dim+k] = 0.;
       for (j = ia[i]; j < ia[i+1]; j++){
@@ -1215,7 +1540,7 @@ void SparseMatrix_multiply_dense(SparseMatrix A, int ATransposed, real *v, int v
 
 void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int transposed){
   /* A v or A^T v. Real only for now. */
-  int i, j, *ia, *ja, n, m;
+  int i, j, *ia, *ja, n, m, nthreads;
   real *a, *u = NULL;
   int *ai;
   assert(A->format == FORMAT_CSR);
@@ -1226,6 +1551,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int trans
   m = A->m;
   n = A->n;
   u = *res;
+  spmv_get_kernel(&nthreads);
 
   switch (A->type){
   case MATRIX_TYPE_REAL:
@@ -1233,12 +1559,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int trans
     if (v){
       if (!transposed){
 	if (!u) u = MALLOC(sizeof(real)*((size_t)m));
-	for (i = 0; i < m; i++){
-	  u[i] = 0.;
-	  for (j = ia[i]; j < ia[i+1]; j++){
-	    u[i] += a[j]*v[ja[j]];
-	  }
-	}
+	csr_multiply_vector_real(m, ia, ja, a, v, u);
       } else {
 	if (!u) u = MALLOC(sizeof(real)*((size_t)n));
 	for (i = 0; i < n; i++) u[i] = 0.;
@@ -1252,6 +1573,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int trans
       /* v is assumed to be all 1's */
       if (!transposed){
 	if (!u) u = MALLOC(sizeof(real)*((size_t)m));
+#pragma omp parallel for private(j) num_threads(nthreads) if(ia[m] > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
 	for (i = 0; i < m; i++){
 	  u[i] = 0.;
 	  for (j = ia[i]; j < ia[i+1]; j++){
@@ -1274,6 +1596,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int trans
     if (v){
       if (!transposed){
 	if (!u) u = MALLOC(sizeof(real)*((size_t)m));
+#pragma omp parallel for private(j) num_threads(nthreads) if(ia[m] > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
 	for (i = 0; i < m; i++){
 	  u[i] = 0.;
 	  for (j = ia[i]; j < ia[i+1]; j++){
@@ -1293,6 +1616,7 @@ void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int trans
       /* v is assumed to be all 1's */
       if (!transposed){
 	if (!u) u = MALLOC(sizeof(real)*((size_t)m));
+#pragma omp parallel for private(j) num_threads(nthreads) if(ia[m] > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
 	for (i = 0; i < m; i++){
 	  u[i] = 0.;
 	  for (j = ia[i]; j < ia[i+1]; j++){
@@ -1360,6 +1684,7 @@ SparseMatrix SparseMatrix_multiply_by_scaler(SparseMatrix A, real s){
 
   switch (A->type){
   case MATRIX_TYPE_INTEGER:
+    SparseMatrix_own_arrays(A);
     b = MALLOC(sizeof(real)*A->nz);
     ai = (int*) A->a;
     for (i = 0; i < A->nz; i++) b[i] = ai[i];
@@ -1397,355 +1722,237 @@ SparseMatrix SparseMatrix_multiply_by_scaler(SparseMatrix A, real s){
 }
 
 
-SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B){
-  int m;
-  SparseMatrix C = NULL;
-  int *mask = NULL;
-  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja, *ic, *jc;
-  int i, j, k, jj, type, nz;
-
-  assert(A->format == B->format && A->format == FORMAT_CSR);/* other format not yet supported */
+static int SparseMatrix_multiply_row_count(SparseMatrix A, SparseMatrix B, SparseMatrix C, int i, int *mask){
+  /* number of distinct columns in row i of A*B (C == NULL) or A*B*C. Columns seen are marked with -i-2 in mask */
+  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja;
+  int j, l, k, lend, kend, col, nz = 0;
 
-  m = A->m;
-  if (A->n != B->m) return NULL;
-  if (A->type != B->type){
-#ifdef DEBUG
-    printf("in SparseMatrix_multiply, the matrix types do not match, right now only multiplication of matrices of the same type is supported\n");
-#endif
-    return NULL;
-  }
-  type = A->type;
-  
-  mask = MALLOC(sizeof(int)*((size_t)(B->n)));
-  if (!mask) return NULL;
-
-  for (i = 0; i < B->n; i++) mask[i] = -1;
-
-  nz = 0;
-  for (i = 0; i < m; i++){
-    for (j = ia[i]; j < ia[i+1]; j++){
-      jj = ja[j];
-      for (k = ib[jj]; k < ib[jj+1]; k++){
-	if (mask[jb[k]] != -i - 2){
-	  if ((nz+1) <= nz) {
-#ifdef DEBUG_PRINT
-	    fprintf(stderr,"overflow in SparseMatrix_multiply !!!\n");
-#endif
-	    return NULL;
-	  }
+  for (j = ia[i]; j < ia[i+1]; j++){
+    for (l = ib[ja[j]], lend = ib[ja[j]+1]; l < lend; l++){
+      if (!C){
+	col = jb[l];
+	if (mask[col] != -i - 2){
+	  mask[col] = -i - 2;
+	  nz++;
+	}
+	continue;
+      }
+      for (k = C->ia[jb[l]], kend = C->ia[jb[l]+1]; k < kend; k++){
+	col = C->ja[k];
+	if (mask[col] != -i - 2){
+	  mask[col] = -i - 2;
 	  nz++;
-	  mask[jb[k]] = -i - 2;
 	}
       }
     }
   }
+  return nz;
+}
 
-  C = SparseMatrix_new(m, B->n, nz, type, FORMAT_CSR);
-  if (!C) goto RETURN;
-  ic = C->ia;
-  jc = C->ja;
-  
-  nz = 0;
+static void SparseMatrix_multiply_row(SparseMatrix A, SparseMatrix B, SparseMatrix C, int i, int *mask, int *jd, void *d, int sta, int end){
+  /* row i of A*B (C == NULL) or A*B*C, accumulated Gustavson style into positions sta, sta+1, ... of jd and d,
+     with mask[col] the position of column col. Any mask value outside [sta, end) is stale, so one mask
+     serves all the rows a thread gets, in whatever order. */
+  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja;
+  int *ic = C ? C->ia : NULL, *jc = C ? C->ja : NULL;
+  int j, l, k, lend, kstart, kend, col, nz = sta;
 
-  switch (type){
+  switch (A->type){
   case MATRIX_TYPE_REAL:
     {
-      real *a = (real*) A->a;
-      real *b = (real*) B->a;
-      real *c = (real*) C->a;
-      ic[0] = 0;
-      for (i = 0; i < m; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  jj = ja[j];
-	  for (k = ib[jj]; k < ib[jj+1]; k++){
-	    if (mask[jb[k]] < ic[i]){
-	      mask[jb[k]] = nz;
-	      jc[nz] = jb[k];
-	      c[nz] = a[j]*b[k];
-	      nz++;
+      real *a = (real*) A->a, *b = (real*) B->a, *c = C ? (real*) C->a : NULL, *dd = (real*) d, t;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	for (l = ib[ja[j]], lend = ib[ja[j]+1]; l < lend; l++){
+	  t = a[j]*b[l];
+	  if (!C){
+	    col = jb[l];
+	    if (mask[col] < sta || mask[col] >= end){
+	      mask[col] = nz;
+	      jd[nz] = col;
+	      dd[nz++] = t;
 	    } else {
-	      assert(jc[mask[jb[k]]] == jb[k]);
-	      c[mask[jb[k]]] += a[j]*b[k];
+	      dd[mask[col]] += t;
+	    }
+	    continue;
+	  }
+	  for (k = ic[jb[l]], kend = ic[jb[l]+1]; k < kend; k++){
+	    col = jc[k];
+	    if (mask[col] < sta || mask[col] >= end){
+	      mask[col] = nz;
+	      jd[nz] = col;
+	      dd[nz++] = t*c[k];
+	    } else {
+	      dd[mask[col]] += t*c[k];
 	    }
 	  }
 	}
-	ic[i+1] = nz;
       }
     }
     break;
   case MATRIX_TYPE_COMPLEX:
     {
-      real *a = (real*) A->a;
-      real *b = (real*) B->a;
-      real *c = (real*) C->a;
-      a = (real*) A->a;
-      b = (real*) B->a;
-      c = (real*) C->a;
-      ic[0] = 0;
-      for (i = 0; i < m; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  jj = ja[j];
-	  for (k = ib[jj]; k < ib[jj+1]; k++){
-	    if (mask[jb[k]] < ic[i]){
-	      mask[jb[k]] = nz;
-	      jc[nz] = jb[k];
-	      c[2*nz] = a[2*j]*b[2*k] - a[2*j+1]*b[2*k+1];/*real part */
-	      c[2*nz+1] = a[2*j]*b[2*k+1] + a[2*j+1]*b[2*k];/*img part */
+      real *a = (real*) A->a, *b = (real*) B->a, *c = C ? (real*) C->a : NULL, *dd = (real*) d, re, im, tre, tim;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	for (l = ib[ja[j]], lend = ib[ja[j]+1]; l < lend; l++){
+	  tre = a[2*j]*b[2*l] - a[2*j+1]*b[2*l+1];
+	  tim = a[2*j]*b[2*l+1] + a[2*j+1]*b[2*l];
+	  if (C) {
+	    kstart = ic[jb[l]]; kend = ic[jb[l]+1];
+	  } else {/* a one entry loop over B's entry l */
+	    kstart = l; kend = l + 1;
+	  }
+	  for (k = kstart; k < kend; k++){
+	    if (C){
+	      col = jc[k];
+	      re = tre*c[2*k] - tim*c[2*k+1];
+	      im = tim*c[2*k] + tre*c[2*k+1];
+	    } else {
+	      col = jb[l];
+	      re = tre; im = tim;
+	    }
+	    if (mask[col] < sta || mask[col] >= end){
+	      mask[col] = nz;
+	      jd[nz] = col;
+	      dd[2*nz] = re;
+	      dd[2*nz+1] = im;
 	      nz++;
 	    } else {
-	      assert(jc[mask[jb[k]]] == jb[k]);
-	      c[2*mask[jb[k]]] += a[2*j]*b[2*k] - a[2*j+1]*b[2*k+1];/*real part */
-	      c[2*mask[jb[k]]+1] += a[2*j]*b[2*k+1] + a[2*j+1]*b[2*k];/*img part */
+	      dd[2*mask[col]] += re;
+	      dd[2*mask[col]+1] += im;
 	    }
 	  }
 	}
-	ic[i+1] = nz;
       }
     }
     break;
   case MATRIX_TYPE_INTEGER:
     {
-      int *a = (int*) A->a;
-      int *b = (int*) B->a;
-      int *c = (int*) C->a;
-      ic[0] = 0;
-      for (i = 0; i < m; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  jj = ja[j];
-	  for (k = ib[jj]; k < ib[jj+1]; k++){
-	    if (mask[jb[k]] < ic[i]){
-	      mask[jb[k]] = nz;
-	      jc[nz] = jb[k];
-	      c[nz] = a[j]*b[k];
-	      nz++;
+      int *a = (int*) A->a, *b = (int*) B->a, *c = C ? (int*) C->a : NULL, *dd = (int*) d, t;
+      for (j = ia[i]; j < ia[i+1]; j++){
+	for (l = ib[ja[j]], lend = ib[ja[j]+1]; l < lend; l++){
+	  if (C) {
+	    kstart = ic[jb[l]]; kend = ic[jb[l]+1];
+	  } else {
+	    kstart = l; kend = l + 1;
+	  }
+	  for (k = kstart; k < kend; k++){
+	    col = C ? jc[k] : jb[l];
+	    t = C ? a[j]*b[l]*c[k] : a[j]*b[l];
+	    if (mask[col] < sta || mask[col] >= end){
+	      mask[col] = nz;
+	      jd[nz] = col;
+	      dd[nz++] = t;
 	    } else {
-	      assert(jc[mask[jb[k]]] == jb[k]);
-	      c[mask[jb[k]]] += a[j]*b[k];
+	      dd[mask[col]] += t;
 	    }
 	  }
 	}
-	ic[i+1] = nz;
       }
     }
     break;
   case MATRIX_TYPE_PATTERN:
-    ic[0] = 0;
-    for (i = 0; i < m; i++){
-      for (j = ia[i]; j < ia[i+1]; j++){
-	jj = ja[j];
-	for (k = ib[jj]; k < ib[jj+1]; k++){
-	  if (mask[jb[k]] < ic[i]){
-	    mask[jb[k]] = nz;
-	    jc[nz] = jb[k];
-	    nz++;
-	  } else {
-	    assert(jc[mask[jb[k]]] == jb[k]);
+    for (j = ia[i]; j < ia[i+1]; j++){
+      for (l = ib[ja[j]], lend = ib[ja[j]+1]; l < lend; l++){
+	if (C) {
+	  kstart = ic[jb[l]]; kend = ic[jb[l]+1];
+	} else {
+	  kstart = l; kend = l + 1;
+	}
+	for (k = kstart; k < kend; k++){
+	  col = C ? jc[k] : jb[l];
+	  if (mask[col] < sta || mask[col] >= end){
+	    mask[col] = nz;
+	    jd[nz++] = col;
 	  }
 	}
       }
-      ic[i+1] = nz;
     }
     break;
-  case MATRIX_TYPE_UNKNOWN:
   default:
-    SparseMatrix_delete(C);
-    C = NULL; goto RETURN;
     break;
   }
-  
-  C->nz = nz;
-
- RETURN:
-  FREE(mask);
-  return C;
-
 }
 
-
-
-SparseMatrix SparseMatrix_multiply3(SparseMatrix A, SparseMatrix B, SparseMatrix C){
-  int m;
-  SparseMatrix D = NULL;
-  int *mask = NULL;
-  int *ia = A->ia, *ja = A->ja, *ib = B->ia, *jb = B->ja, *ic = C->ia, *jc = C->ja, *id, *jd;
-  int i, j, k, l, ll, jj, type, nz;
+static SparseMatrix SparseMatrix_multiply_internal(SparseMatrix A, SparseMatrix B, SparseMatrix C){
+  /* A*B if C == NULL, otherwise A*B*C. Rows of the product are independent, so both the counting pass and 
+     the filling pass share the rows out among threads, each with its own mask. Every row comes out with the same
+     column order and summation order as a serial sweep would give. */
+  SparseMatrix D = NULL, L = C ? C : B;
+  int m = A->m, n = L->n, type = A->type;
+  int i, nthreads, *id, overflow = FALSE;
+  size_t nz;
 
   assert(A->format == B->format && A->format == FORMAT_CSR);/* other format not yet supported */
+  assert(!C || C->format == FORMAT_CSR);
 
-  m = A->m;
   if (A->n != B->m) return NULL;
-  if (B->n != C->m) return NULL;
-
-  if (A->type != B->type || B->type != C->type){
+  if (C && B->n != C->m) return NULL;
+  if (A->type != B->type || (C && B->type != C->type)){
 #ifdef DEBUG
     printf("in SparseMatrix_multiply, the matrix types do not match, right now only multiplication of matrices of the same type is supported\n");
 #endif
     return NULL;
   }
-  type = A->type;
-  
-  mask = MALLOC(sizeof(int)*((size_t)(C->n)));
-  if (!mask) return NULL;
+  if (type != MATRIX_TYPE_REAL && type != MATRIX_TYPE_COMPLEX && type != MATRIX_TYPE_INTEGER && type != MATRIX_TYPE_PATTERN) return NULL;
 
-  for (i = 0; i < C->n; i++) mask[i] = -1;
+  spmv_get_kernel(&nthreads);
+  id = MALLOC(sizeof(int)*((size_t)(m + 1)));
+  if (!id) return NULL;
+
+  /* count the entries of each row */
+#pragma omp parallel num_threads(nthreads) if(A->ia[m] + B->ia[B->m] > SPMV_PARALLEL_NZ)
+  {
+    int ii, *mask = MALLOC(sizeof(int)*((size_t) MAX(n, 1)));
+    for (ii = 0; ii < n; ii++) mask[ii] = -1;
+#pragma omp for schedule(dynamic, 64)
+    for (ii = 0; ii < m; ii++) id[ii+1] = SparseMatrix_multiply_row_count(A, B, C, ii, mask);
+    FREE(mask);
+  }
 
+  id[0] = 0;
   nz = 0;
   for (i = 0; i < m; i++){
-    for (j = ia[i]; j < ia[i+1]; j++){
-      jj = ja[j];
-      for (l = ib[jj]; l < ib[jj+1]; l++){
-	ll = jb[l];
-	for (k = ic[ll]; k < ic[ll+1]; k++){
-	  if (mask[jc[k]] != -i - 2){
-	    if ((nz+1) <= nz) {
+    nz += (size_t) id[i+1];
+    if (nz > INT_MAX) {
+      overflow = TRUE;
+      break;
+    }
+    id[i+1] = (int) nz;
+  }
+  if (overflow){
 #ifdef DEBUG_PRINT
-	      fprintf(stderr,"overflow in SparseMatrix_multiply !!!\n");
+    fprintf(stderr,"overflow in SparseMatrix_multiply !!!\n");
 #endif
-	      return NULL;
-	    }
-	    nz++;
-	    mask[jc[k]] = -i - 2;
-	  }
-	}
-      }
-    }
+    FREE(id);
+    return NULL;
   }
 
-  D = SparseMatrix_new(m, C->n, nz, type, FORMAT_CSR);
+  D = SparseMatrix_new(m, n, (int) nz, type, FORMAT_CSR);
   if (!D) goto RETURN;
-  id = D->ia;
-  jd = D->ja;
-  
-  nz = 0;
+  MEMCPY(D->ia, id, sizeof(int)*((size_t)(m + 1)));
 
-  switch (type){
-  case MATRIX_TYPE_REAL:
-    {
-      real *a = (real*) A->a;
-      real *b = (real*) B->a;
-      real *c = (real*) C->a;
-      real *d = (real*) D->a;
-      id[0] = 0;
-      for (i = 0; i < m; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  jj = ja[j];
-	  for (l = ib[jj]; l < ib[jj+1]; l++){
-	    ll = jb[l];
-	    for (k = ic[ll]; k < ic[ll+1]; k++){
-	      if (mask[jc[k]] < id[i]){
-		mask[jc[k]] = nz;
-		jd[nz] = jc[k];
-		d[nz] = a[j]*b[l]*c[k];
-		nz++;
-	      } else {
-		assert(jd[mask[jc[k]]] == jc[k]);
-		d[mask[jc[k]]] += a[j]*b[l]*c[k];
-	      }
-	    }
-	  }
-	}
-	id[i+1] = nz;
-      }
-    }
-    break;
-  case MATRIX_TYPE_COMPLEX:
-    {
-      real *a = (real*) A->a;
-      real *b = (real*) B->a;
-      real *c = (real*) C->a;
-      real *d = (real*) D->a;
-      id[0] = 0;
-      for (i = 0; i < m; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  jj = ja[j];
-	  for (l = ib[jj]; l < ib[jj+1]; l++){
-	    ll = jb[l];
-	    for (k = ic[ll]; k < ic[ll+1]; k++){
-	      if (mask[jc[k]] < id[i]){
-		mask[jc[k]] = nz;
-		jd[nz] = jc[k];
-		d[2*nz] = (a[2*j]*b[2*l] - a[2*j+1]*b[2*l+1])*c[2*k] 
-		  - (a[2*j]*b[2*l+1] + a[2*j+1]*b[2*l])*c[2*k+1];/*real part */
-		d[2*nz+1] = (a[2*j]*b[2*l+1] + a[2*j+1]*b[2*l])*c[2*k]
-		  + (a[2*j]*b[2*l] - a[2*j+1]*b[2*l+1])*c[2*k+1];/*img part */
-		nz++;
-	      } else {
-		assert(jd[mask[jc[k]]] == jc[k]);
-		d[2*mask[jc[k]]] += (a[2*j]*b[2*l] - a[2*j+1]*b[2*l+1])*c[2*k] 
-		  - (a[2*j]*b[2*l+1] + a[2*j+1]*b[2*l])*c[2*k+1];/*real part */
-		d[2*mask[jc[k]]+1] += (a[2*j]*b[2*l+1] + a[2*j+1]*b[2*l])*c[2*k]
-		  + (a[2*j]*b[2*l] - a[2*j+1]*b[2*l+1])*c[2*k+1];/*img part */
-	      }
-	    }
-	  }
-	}
-	id[i+1] = nz;
-      }
-    }
-    break;
-  case MATRIX_TYPE_INTEGER:
-    {
-      int *a = (int*) A->a;
-      int *b = (int*) B->a;
-      int *c = (int*) C->a;
-      int *d = (int*) D->a;
-      id[0] = 0;
-      for (i = 0; i < m; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  jj = ja[j];
-	  for (l = ib[jj]; l < ib[jj+1]; l++){
-	    ll = jb[l];
-	    for (k = ic[ll]; k < ic[ll+1]; k++){
-	      if (mask[jc[k]] < id[i]){
-		mask[jc[k]] = nz;
-		jd[nz] = jc[k];
-		d[nz] += a[j]*b[l]*c[k];
-		nz++;
-	      } else {
-		assert(jd[mask[jc[k]]] == jc[k]);
-		d[mask[jc[k]]] += a[j]*b[l]*c[k];
-	      }
-	    }
-	  }
-	}
-	id[i+1] = nz;
-      }
-    }
-    break;
-  case MATRIX_TYPE_PATTERN:
-    id[0] = 0;
-    for (i = 0; i < m; i++){
-      for (j = ia[i]; j < ia[i+1]; j++){
-	jj = ja[j];
-	for (l = ib[jj]; l < ib[jj+1]; l++){
-	  ll = jb[l];
-	  for (k = ic[ll]; k < ic[ll+1]; k++){
-	    if (mask[jc[k]] < id[i]){
-	      mask[jc[k]] = nz;
-	      jd[nz] = jc[k];
-	      nz++;
-	    } else {
-	      assert(jd[mask[jc[k]]] == jc[k]);
-	    }
-	  }
-	}
-      }
-      id[i+1] = nz;
-    }
-    break;
-  case MATRIX_TYPE_UNKNOWN:
-  default:
-    SparseMatrix_delete(D);
-    D = NULL; goto RETURN;
-    break;
+  /* fill in the rows at the offsets just computed */
+#pragma omp parallel num_threads(nthreads) if(A->ia[m] + B->ia[B->m] > SPMV_PARALLEL_NZ)
+  {
+    int ii, *mask = MALLOC(sizeof(int)*((size_t) MAX(n, 1)));
+    for (ii = 0; ii < n; ii++) mask[ii] = -1;
+#pragma omp for schedule(dynamic, 64)
+    for (ii = 0; ii < m; ii++) SparseMatrix_multiply_row(A, B, C, ii, mask, D->ja, D->a, id[ii], id[ii+1]);
+    FREE(mask);
   }
-  
-  D->nz = nz;
+  D->nz = (int) nz;
 
  RETURN:
-  FREE(mask);
+  FREE(id);
   return D;
+}
+
+SparseMatrix SparseMatrix_multiply(SparseMatrix A, SparseMatrix B){
+  return SparseMatrix_multiply_internal(A, B, NULL);
+}
 
+SparseMatrix SparseMatrix_multiply3(SparseMatrix A, SparseMatrix B, SparseMatrix C){
+  return SparseMatrix_multiply_internal(A, B, C);
 }
 
 /* For complex matrix:
@@ -1974,7 +2181,7 @@ SparseMatrix SparseMatrix_coordinate_form_add_entries(SparseMatrix A, int nentri
 
   if (nz + nentries >= A->nzmax){
     nzmax = nz + nentries;
-     nzmax = MAX(10, (int) 0.2*nzmax) + nzmax;
+    nzmax = MAX(10, (int) (0.2*nzmax)) + nzmax;
     A = SparseMatrix_realloc(A, nzmax);
   }
   MEMCPY((char*) A->ia + ((size_t)nz)*sizeof(int)/sizeof(char), irn, sizeof(int)*((size_t)nentries));
@@ -2311,8 +2518,10 @@ SparseMatrix SparseMatrix_to_complex(SparseMatrix A){
   ja = A->ja;
   switch (A->type){
   case MATRIX_TYPE_REAL:{
-    real *a = (real*) A->a;
+    real *a;
     int nz = A->nz;
+    SparseMatrix_own_arrays(A);
+    a = (real*) A->a;
     A->a = a = REALLOC(a, 2*sizeof(real)*nz);
     for (i = nz - 1; i >= 0; i--){
       a[2*i] = a[i];
@@ -2326,9 +2535,12 @@ SparseMatrix SparseMatrix_to_complex(SparseMatrix A){
     break;
   }
   case MATRIX_TYPE_INTEGER:{
-    int *a = (int*) A->a;
+    int *a;
     int nz = A->nz;
-    real *aa = A->a = MALLOC(2*sizeof(real)*nz);
+    real *aa;
+    SparseMatrix_own_arrays(A);
+    a = (int*) A->a;
+    aa = A->a = MALLOC(2*sizeof(real)*nz);
     for (i = nz - 1; i >= 0; i--){
       aa[2*i] = (real) a[i];
       aa[2*i - 1] = 0;
@@ -3318,6 +3530,7 @@ SparseMatrix SparseMatrix_set_entries_to_real_one(SparseMatrix A){
   real *a;
   int i;
 
+  SparseMatrix_own_arrays(A);
   if (A->a) FREE(A->a);
   A->a = MALLOC(sizeof(real)*((size_t)A->nz));
   a = (real*) (A->a);
@@ -4085,9 +4298,9 @@ void SparseMatrix_page_rank(SparseMatrix A, real teleport_probablity, int weight
 
  */
   int n = A->n;
-  int i, j;
-  int *ia = A->ia, *ja = A->ja;
-  real *x, *y, *diag, res;
+  int i, j, k, nthreads;
+  int *ia = A->ia, *ja = A->ja, *tia, *tja, *tpos;
+  real *x, *y, *diag, res, yi;
   real *a = NULL;
   int iter = 0;
 
@@ -4100,12 +4313,12 @@ void SparseMatrix_page_rank(SparseMatrix A, real teleport_probablity, int weight
       a = (real*) A->a;
       break;
     case MATRIX_TYPE_COMPLEX:/* take real part */
-      a = MALLOC(sizeof(real)*n);
-      for (i = 0; i < n; i++) a[i] = ((real*) A->a)[2*i];
+      a = MALLOC(sizeof(real)*MAX(ia[n], 1));
+      for (i = 0; i < ia[n]; i++) a[i] = ((real*) A->a)[2*i];
       break;
     case MATRIX_TYPE_INTEGER:
-      a = MALLOC(sizeof(real)*n);
-      for (i = 0; i < n; i++) a[i] = ((int*) A->a)[i];
+      a = MALLOC(sizeof(real)*MAX(ia[n], 1));
+      for (i = 0; i < ia[n]; i++) a[i] = ((int*) A->a)[i];
       break;
     case MATRIX_TYPE_PATTERN:
     case MATRIX_TYPE_UNKNOWN:
@@ -4143,24 +4356,42 @@ void SparseMatrix_page_rank(SparseMatrix A, real teleport_probablity, int weight
   }
   for (i = 0; i < n; i++) diag[i] = 1./MAX(diag[i], MACHINEACC);
 
+  /* the iteration gathers along columns of A. Build the column structure once: column i has the
+     entries tpos[k] of rows tja[k], k = tia[i], ..., tia[i+1] - 1, in increasing row order, so every
+     y[i] is summed in the same order as a row by row scatter would, and columns can go to different threads. */
+  tia = MALLOC(sizeof(int)*(n+1));
+  tja = MALLOC(sizeof(int)*MAX(ia[n], 1));
+  tpos = MALLOC(sizeof(int)*MAX(ia[n], 1));
+  for (i = 0; i <= n; i++) tia[i] = 0;
+  for (j = 0; j < ia[n]; j++) tia[ja[j]+1]++;
+  for (i = 0; i < n; i++) tia[i+1] += tia[i];
+  for (i = 0; i < n; i++){
+    for (j = ia[i]; j < ia[i+1]; j++){
+      k = tia[ja[j]]++;
+      tja[k] = i;
+      tpos[k] = j;
+    }
+  }
+  for (i = n; i > 0; i--) tia[i] = tia[i-1];
+  tia[0] = 0;
+  spmv_get_kernel(&nthreads);
+
   /* iterate */
   do {
     iter++;
-    for (i = 0; i < n; i++) y[i] = 0;
-    if (weighted){
-      for (i = 0; i < n; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  if (ja[j] == i) continue;
-	  y[ja[j]] += a[j]*x[i]*diag[i];
-	}
-      }
-    } else {
-      for (i = 0; i < n; i++){
-	for (j = ia[i]; j < ia[i+1]; j++){
-	  if (ja[j] == i) continue;
-	  y[ja[j]] += x[i]*diag[i];
+#pragma omp parallel for private(k, j, yi) num_threads(nthreads) if(ia[n] > SPMV_PARALLEL_NZ) schedule(dynamic, 256)
+    for (i = 0; i < n; i++){
+      yi = 0;
+      for (k = tia[i]; k < tia[i+1]; k++){
+	j = tja[k];
+	if (j == i) continue;
+	if (weighted){
+	  yi += a[tpos[k]]*x[j]*diag[j];
+	} else {
+	  yi += x[j]*diag[j];
 	}
       }
+      y[i] = yi;
     }
     for (i = 0; i < n; i++){
       y[i] = (1-teleport_probablity)*y[i] + teleport_probablity/n;
@@ -4182,5 +4413,8 @@ void SparseMatrix_page_rank(SparseMatrix A, real teleport_probablity, int weight
 
   FREE(y);
   FREE(diag);
+  FREE(tia);
+  FREE(tja);
+  FREE(tpos);
   if (a && a != A->a) FREE(a);
 }
@@ -35,6 +35,8 @@ struct SparseMatrix_struct {
   int format;/* whether it is CSR, CSC, COORD. By default it is in CSR format */
   int property; /* pattern_symmetric/symmetric/skew/hermitian*/
   int size;/* size of each entry. This allows for general matrix where each entry is, say, a matrix itself */
+  void *map; /* if not NULL, ia, ja and a point into this mapping of a file, map_len bytes long, see SparseMatrix_import_mapped */
+  size_t map_len;
 };
 
 typedef struct SparseMatrix_struct* SparseMatrix;
@@ -65,6 +67,15 @@ SparseMatrix SparseMatrix_import_binary_fp(FILE *f);/* import into a preopenned
 void SparseMatrix_export_binary(char *name, SparseMatrix A, int *flag);
 void SparseMatrix_export_binary_fp(FILE *f, SparseMatrix A);/* export binary into a file preopened */
 
+/* a versioned binary format whose ia, ja and a arrays are aligned so that SparseMatrix_import_mapped can map
+   the file into memory and use them in place, without copying. The mapping is private: changes to 
+   the matrix are not written back, and pages are shared between processes until they are modified.
+   The file is only readable on machines with the same byte order and int/size_t sizes as the writer.
+   Only CSR and coordinate matrices are supported. The import checks every index in ia and ja against m, n and nz.
+   import flag: 0 on success, 1 if the file cannot be opened or mapped, 2 if it is not in this format or is corrupt */
+void SparseMatrix_export_mapped(char *name, SparseMatrix A, int *flag);
+SparseMatrix SparseMatrix_import_mapped(char *name, int *flag);
+
 void SparseMatrix_delete(SparseMatrix A);
 
 SparseMatrix SparseMatrix_add(SparseMatrix A, SparseMatrix B);
@@ -87,6 +98,17 @@ SparseMatrix SparseMatrix_transpose(SparseMatrix A);
 SparseMatrix SparseMatrix_symmetrize(SparseMatrix A, int pattern_symmetric_only);
 SparseMatrix SparseMatrix_symmetrize_nodiag(SparseMatrix A, int pattern_symmetric_only);
 void SparseMatrix_multiply_vector(SparseMatrix A, real *v, real **res, int transposed);/* if v = NULL, v is assumed to be {1,1,...,1}*/
+
+/* kernels for the products with a vector or a dense matrix (SparseMatrix_multiply_vector, SparseMatrix_multiply_dense).
+   SPMV_KERNEL_THREADED splits the rows over threads and gives the same result as SPMV_KERNEL_SERIAL;
+   SPMV_KERNEL_SIMD also vectorizes the rows of real matrices with AVX2 (when the processor has it),
+   which changes the order of summation. Transposed products are always serial.
+   SPMV_KERNEL_DEFAULT is SPMV_KERNEL_THREADED, or the value ("serial", "threaded" or "simd") of the environment variable GV_SPMV_KERNEL.
+   The matrix-matrix products (SparseMatrix_multiply, SparseMatrix_multiply3) are threaded unless the kernel is SPMV_KERNEL_SERIAL. */
+enum {SPMV_KERNEL_DEFAULT = -1, SPMV_KERNEL_SERIAL, SPMV_KERNEL_THREADED, SPMV_KERNEL_SIMD};
+/* nthreads <= 0: the OpenMP default. The settings belong to the calling thread */
+void SparseMatrix_set_multiply_kernel(int kernel, int nthreads);
+void SparseMatrix_get_multiply_kernel(int *kernel, int *nthreads);
 SparseMatrix SparseMatrix_remove_diagonal(SparseMatrix A);
 SparseMatrix SparseMatrix_remove_upper(SparseMatrix A);/* remove diag and upper diag */
 SparseMatrix SparseMatrix_divide_row_by_degree(SparseMatrix A);
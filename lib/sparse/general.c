@@ -13,6 +13,9 @@
 
 #include "general.h"
 #include <errno.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef DEBUG
 double _statistics[10];
@@ -365,3 +368,12 @@ int validQ_int_string(char *to_convert, int *v){
   *v = (int) val;
   return 1;
 }
+
+int get_num_threads(int nthreads){
+#ifdef _OPENMP
+  if (nthreads > 0) return nthreads;
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
@@ -144,6 +144,10 @@ int validQ_int_string(char *to_convert, int *v);
 /* check to see if this is a string of digits consists of 0-9 */
 int digitsQ(char *to_convert);
 
+/* number of threads a parallel kernel should use. nthreads > 0 is taken as is, otherwise the
+   OpenMP default is used (OMP_NUM_THREADS, or the number of cores). Always 1 without OpenMP. */
+int get_num_threads(int nthreads);
+
 #endif
 
 
@@ -368,6 +368,24 @@ Constraint* Block::splitBetween(Variable* vl, Variable* vr, Block* &lb, Block* &
 	deleted = true;
 	return c;
 }
+/**
+ * Some of the active constraints of this block have been made inactive:
+ * breaks it into the new blocks spanned by what remains of its active
+ * constraint tree, appending them to blocks.  The new blocks keep the
+ * position of this one.
+ */
+void Block::splitInactive(vector<Block*> &blocks) {
+	for(vector<Variable*>::iterator i=vars->begin();i!=vars->end();i++) {
+		Variable *v=*i;
+		if(v->block!=this) continue;
+		Block *b=new Block();
+		populateSplitBlock(b,v,NULL);
+		b->posn=posn;
+		b->wposn=b->posn*b->weight;
+		blocks.push_back(b);
+	}
+	deleted=true;
+}
 /**
  * Creates two new blocks, l and r, and splits this block across constraint c,
  * placing the left subtree of constraints (and associated variables) into l
@@ -53,6 +53,7 @@ public:
 	void mergeOut(Block *b);
 	void split(Block *&l, Block *&r, Constraint *c);
 	Constraint* splitBetween(Variable* vl, Variable* vr, Block* &lb, Block* &rb);
+	void splitInactive(std::vector<Block*> &blocks);
 	void setUpInConstraints();
 	void setUpOutConstraints();
 	double cost();
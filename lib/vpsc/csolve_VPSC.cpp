@@ -111,6 +111,9 @@ void solveVPSC(VPSC* vpsc) {
 void splitIncVPSC(IncVPSC* vpsc) {
 	vpsc->splitBlocks();
 }
+void updateIncVPSC(IncVPSC* vpsc, int m, Constraint* cs[]) {
+	vpsc->updateConstraints(m,cs);
+}
 void setVariableDesiredPos(Variable *v, double desiredPos) {
 	v->desiredPosition = desiredPos;
 }
@@ -72,6 +72,7 @@ typedef struct IncVPSC IncVPSC;
 #endif
 VPSC* newIncVPSC(int n, Variable* vs[], int m, Constraint* cs[]);
 void splitIncVPSC(IncVPSC*);
+void updateIncVPSC(IncVPSC*, int m, Constraint* cs[]);
 int getSplitCnt(IncVPSC *vpsc);
 #ifdef __cplusplus
 }
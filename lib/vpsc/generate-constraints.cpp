@@ -122,7 +122,6 @@ struct Event {
 	double pos;
 	Event(EventType t, Node *v, double p) : type(t),v(v),pos(p) {};
 };
-Event **events;
 int compare_events(const void *a, const void *b) {
 	Event *ea=*(Event**)a;
 	Event *eb=*(Event**)b;
@@ -145,7 +144,7 @@ int compare_events(const void *a, const void *b) {
  * all overlap in the x pass, or leave some overlaps for the y pass.
  */
 int generateXConstraints(const int n, Rectangle** rs, Variable** vars, Constraint** &cs, const bool useNeighbourLists) {
-	events=new Event*[2*n];
+	Event **events=new Event*[2*n];
 	int i,m,ctr=0;
 	for(i=0;i<n;i++) {
 		vars[i]->desiredPosition=rs[i]->getCentreX();
@@ -230,7 +229,7 @@ int generateXConstraints(const int n, Rectangle** rs, Variable** vars, Constrain
  * Prepares constraints in order to apply VPSC vertically to remove ALL overlap.
  */
 int generateYConstraints(const int n, Rectangle** rs, Variable** vars, Constraint** &cs) {
-	events=new Event*[2*n];
+	Event **events=new Event*[2*n];
 	int ctr=0,i,m;
 	for(i=0;i<n;i++) {
 		vars[i]->desiredPosition=rs[i]->getCentreY();
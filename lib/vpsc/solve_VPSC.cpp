@@ -33,6 +33,7 @@ using std::endl;
 using std::ostringstream;
 using std::list;
 using std::set;
+using std::vector;
 
 IncVPSC::IncVPSC(const unsigned n, Variable *vs[], const unsigned m, Constraint *cs[]) 
 	: VPSC(n,vs,m,cs) {
@@ -266,6 +267,67 @@ void IncVPSC::splitBlocks() {
 #endif
 	bs->cleanup();
 }
+/**
+ * Replaces the constraint set by cs, keeping the blocks of the last solve
+ * so that the next one starts from there rather than from scratch.
+ * Constraints found in both sets are left as they are.  A dropped active
+ * constraint hands its place in the block to a new one between the same
+ * variables with the same gap, if there is one, and otherwise the block is
+ * split where it was.  The dropped constraints must not be deleted before
+ * this call.
+ */
+void IncVPSC::updateConstraints(const unsigned m, Constraint *cs[]) {
+#ifdef RECTANGLE_OVERLAP_LOGGING
+	ofstream f(LOGFILE,ios::app);
+	f<<"updateConstraints()..."<<endl;
+#endif
+	vector<Block*> cut;
+	for(unsigned i=0;i<m;i++) {
+		cs[i]->visited=true;
+	}
+	for(unsigned i=0;i<this->m;i++) {
+		Constraint *c=this->cs[i];
+		if(c->visited || !c->active) continue;
+		c->active=false;
+		Constraint *nc=NULL;
+		for(Constraints::iterator j=c->left->out.begin();j!=c->left->out.end();j++) {
+			Constraint *d=*j;
+			if(d->visited && !d->active && d->right==c->right
+					&& d->gap==c->gap && d->equality==c->equality) {
+				nc=d;
+				break;
+			}
+		}
+		if(nc!=NULL) {
+			nc->active=true;
+			continue;
+		}
+#ifdef RECTANGLE_OVERLAP_LOGGING
+		f<<"  dropped active constraint: "<<*c<<endl;
+#endif
+		// split each block once, however many of its constraints went
+		Block *b=c->left->block;
+		if(!b->deleted) {
+			b->deleted=true;
+			cut.push_back(b);
+		}
+	}
+	vector<Block*> parts;
+	for(vector<Block*>::iterator i=cut.begin();i!=cut.end();i++) {
+		(*i)->splitInactive(parts);
+	}
+	bs->insert(parts.begin(),parts.end());
+	inactive.clear();
+	for(unsigned i=0;i<m;i++) {
+		cs[i]->visited=false;
+		if(!cs[i]->active) {
+			inactive.push_back(cs[i]);
+		}
+	}
+	this->cs=cs;
+	this->m=m;
+	bs->cleanup();
+}
 
 /**
  * Scan constraint list for the most violated constraint, or the first equality
@@ -305,7 +367,6 @@ double IncVPSC::mostViolated(ConstraintList &l, Constraint* &v) {
 
 #include <map>
 using std::map;
-using std::vector;
 struct node {
 	set<node*> in;
 	set<node*> out;
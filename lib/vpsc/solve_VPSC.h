@@ -54,6 +54,7 @@ public:
 	void solve();
 	void moveBlocks();
 	void splitBlocks();
+	void updateConstraints(const unsigned m, Constraint *cs[]);
 	IncVPSC(const unsigned n, Variable *vs[], const unsigned m, Constraint *cs[]);
 private:
 	typedef std::vector<Constraint*> ConstraintList;
@@ -0,0 +1,253 @@
+#!/bin/sh
+#
+# Graphviz layout benchmark
+#
+# Generates graphs of several families and sizes with gvgen, lays each
+# out with every layout engine and renders it in each output format.
+# For every run, reports the wall time, the peak resident set size, the
+# layout and render times that dot prints with -v, and the times of the
+# engine phases that -v reports. Output is CSV (default) or JSON on
+# stdout.
+#
+# Graphs are written to a directory and reused if they are already
+# there. Passing the same directory to runs of two builds therefore
+# lays out the same graphs, even for the random families.
+#
+# Needs the time(1) of GNU (-f) or of the BSDs (-l) for the RSS; set
+# TIME in the environment if it is not /usr/bin/time. Without it, the
+# wall time is taken with date(1) and no RSS is reported.
+
+DOT=../cmd/dot/dot_builtins
+GVGEN=../cmd/tools/gvgen
+ENGINES="dot neato fdp sfdp twopi circo osage patchwork"
+FAMILIES="grid tree powerlaw random complete"
+SIZES="100 1000"
+FORMATS="svg"
+GRAPHDIR=bgraphs
+REPEAT=1
+TIMEOUT=
+OUTPUT=csv
+TIME=${TIME:-/usr/bin/time}
+
+usage ()
+{
+  cat <<EOF
+Usage: $0 [-d dot] [-g gvgen] [-e engines] [-f families] [-s sizes]
+          [-T formats] [-G graphdir] [-r repeat] [-t timeout] [-j]
+ -d dot      : dot executable ($DOT)
+ -g gvgen    : gvgen executable ($GVGEN)
+ -e engines  : layout engines ("$ENGINES")
+ -f families : graph families ("$FAMILIES")
+ -s sizes    : approximate node counts ("$SIZES")
+ -T formats  : output formats ("$FORMATS")
+ -G graphdir : where the graphs are kept ($GRAPHDIR)
+ -r repeat   : runs of each test ($REPEAT)
+ -t timeout  : seconds after which a run is stopped, if timeout(1) exists
+ -j          : write JSON instead of CSV
+EOF
+  exit $1
+}
+
+while getopts "d:g:e:f:s:T:G:r:t:j?" c
+do
+  case $c in
+  d ) DOT=$OPTARG ;;
+  g ) GVGEN=$OPTARG ;;
+  e ) ENGINES=$OPTARG ;;
+  f ) FAMILIES=$OPTARG ;;
+  s ) SIZES=$OPTARG ;;
+  T ) FORMATS=$OPTARG ;;
+  G ) GRAPHDIR=$OPTARG ;;
+  r ) REPEAT=$OPTARG ;;
+  t ) TIMEOUT=$OPTARG ;;
+  j ) OUTPUT=json ;;
+  \? ) usage 0 ;;
+  * ) usage 1 ;;
+  esac
+done
+
+for p in "$DOT" "$GVGEN"
+do
+  if [ ! -x "$p" ]
+  then
+    echo "$0: cannot execute $p" >&2
+    exit 1
+  fi
+done
+
+TMPERR=${TMPDIR:-/tmp}/gvbench$$.err
+TMPTIME=${TMPDIR:-/tmp}/gvbench$$.time
+trap 'rm -f $TMPERR $TMPTIME' 0 1 2 15
+
+# Select the time(1) flavor: TIMEKIND is gnu, bsd or none
+if $TIME -f "%e %M" true 2>/dev/null
+then
+  TIMEKIND=gnu
+elif $TIME -l true 2>/dev/null
+then
+  TIMEKIND=bsd
+else
+  echo "$0: no $TIME supporting -f or -l; not reporting the RSS" >&2
+  TIMEKIND=none
+fi
+
+if [ -n "$TIMEOUT" ] && command -v timeout >/dev/null 2>&1
+then
+  RUNPFX="timeout $TIMEOUT"
+else
+  RUNPFX=
+fi
+
+# gvgen flags for family $1 at about $2 nodes
+genflags ()
+{
+  n=$2
+  case $1 in
+  grid )
+    s=$(awk "BEGIN { print int(sqrt($n) + 0.5) }")
+    echo "-g$s,$s" ;;
+  tree )
+    # a binary tree of depth d has 2^(d+1) - 1 nodes
+    d=$(awk "BEGIN { d = int(log($n + 1)/log(2) + 0.5) - 1; print (d < 1) ? 1 : d }")
+    echo "-t$d" ;;
+  powerlaw )
+    echo "-P$n,2" ;;
+  random )
+    echo "-r$n,$((n / 2))" ;;
+  complete )
+    # about 2n edges
+    k=$(awk "BEGIN { print int(sqrt(4*$n) + 0.5) }")
+    echo "-k$k" ;;
+  * )
+    echo "$0: unknown graph family $1" >&2
+    return 1 ;;
+  esac
+}
+
+# Run the command, leaving its wall time and peak RSS in kilobytes in
+# WALL and RSS, and its exit status in STATUS
+timed ()
+{
+  if [ $TIMEKIND = gnu ]
+  then
+    $TIME -o $TMPTIME -f "%e %M" "$@" 2>$TMPERR
+    STATUS=$?
+    # a failing command adds a line before the times
+    read WALL RSS <<EOF
+$(tail -n 1 $TMPTIME)
+EOF
+  elif [ $TIMEKIND = none ]
+  then
+    # %N is not supported everywhere, so fall back to whole seconds
+    start=$(date +%s.%N | sed 's/\.N*$//')
+    "$@" 2>$TMPERR
+    STATUS=$?
+    end=$(date +%s.%N | sed 's/\.N*$//')
+    WALL=$(awk "BEGIN { printf \"%.2f\", $end - $start }")
+    RSS=
+  else
+    $TIME -l "$@" 2>$TMPERR
+    STATUS=$?
+    WALL=$(awk '$2 == "real" { print $1 }' $TMPERR)
+    # bytes on macOS, kilobytes on the other BSDs
+    RSS=$(awk '/maximum resident set size/ { print $1 }' $TMPERR)
+    if [ "$(uname)" = Darwin ] && [ -n "$RSS" ]
+    then
+      RSS=$((RSS / 1024))
+    fi
+  fi
+}
+
+# Sum the dot -v timings of the phase $1 (gvLayoutJobs or gvRenderJobs)
+phase ()
+{
+  awk -v p="$1" '$1 == p { t += $(NF-1) } END { printf "%.2f", t }' $TMPERR
+}
+
+# The engine phases timed by dot -v, in order, as name=secs separated by
+# ";" for CSV, or as the members of a JSON object. A phase is named by
+# its message, less the graph name $1, up to the first ":", "=" or digit;
+# a phase that runs more than once is summed
+phases ()
+{
+  awk -v g="$1" -v out=$OUTPUT '
+    $NF ~ /^secs?\.?$/ && $1 != "gvLayoutJobs" && $1 != "gvRenderJobs" {
+      name = $0
+      sub(" " g ":", ":", name)
+      sub(/[:=0-9].*/, "", name)
+      sub(/ *$/, "", name)
+      gsub(/ /, "_", name)
+      if (name == "") next
+      if (!(name in t)) names[n++] = name
+      t[name] += $(NF-1)
+    }
+    END {
+      for (i = 0; i < n; i++) {
+        if (out == "csv")
+          printf "%s%s=%.2f", (i ? ";" : ""), names[i], t[names[i]]
+        else
+          printf "%s\"%s\": %.2f", (i ? ", " : ""), names[i], t[names[i]]
+      }
+    }' $TMPERR
+}
+
+FIRST=1
+report ()
+{
+  if [ $OUTPUT = csv ]
+  then
+    if [ $FIRST = 1 ]
+    then
+      echo "family,nodes,edges,engine,format,run,status,wall_secs,maxrss_kb,layout_secs,render_secs,phases"
+    fi
+    echo "$1,$2,$3,$4,$5,$6,$7,$8,$9,${10},${11},${12}"
+  else
+    if [ $FIRST = 1 ]
+    then
+      echo "["
+    else
+      echo ","
+    fi
+    printf '  {"family": "%s", "nodes": %s, "edges": %s, "engine": "%s", "format": "%s", "run": %s, "status": %s, "wall_secs": %s, "maxrss_kb": %s, "layout_secs": %s, "render_secs": %s, "phases": {%s}}' \
+      "$1" "$2" "$3" "$4" "$5" "$6" "$7" "${8:-null}" "${9:-null}" "${10}" "${11}" "${12}"
+  fi
+  FIRST=0
+}
+
+mkdir -p $GRAPHDIR || exit 1
+
+for family in $FAMILIES
+do
+  for size in $SIZES
+  do
+    flags=$(genflags $family $size) || exit 1
+    graph=$GRAPHDIR/$family$size.gv
+    if [ ! -s $graph ]
+    then
+      $GVGEN $flags -N$family$size > $graph || exit 1
+    fi
+    edges=$(grep -c -- "--" $graph)
+    nodes=$(awk '$2 == "--" { print $1; print $3 } NF == 1 && $1 != "}" { print $1 }' $graph | sort -u | wc -l | tr -d ' ')
+
+    for engine in $ENGINES
+    do
+      for format in $FORMATS
+      do
+        run=1
+        while [ $run -le $REPEAT ]
+        do
+          timed $RUNPFX $DOT -v -K$engine -T$format -o /dev/null $graph
+          report $family $nodes $edges $engine $format $run $STATUS \
+            "$WALL" "$RSS" "$(phase gvLayoutJobs)" "$(phase gvRenderJobs)" \
+            "$(phases $family$size)"
+          run=$((run + 1))
+        done
+      done
+    done
+  done
+done
+
+if [ $OUTPUT = json ] && [ $FIRST = 0 ]
+then
+  printf '\n]\n'
+fi